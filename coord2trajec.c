@@ -8,23 +8,183 @@
 * trajectory for jerbobot
 */
 
+#include <stdlib.h>
+#include <unistd.h> // for getopt
+#include <math.h>
+
+#include "jb_main_defs.h"
+#include "jb_traj_io.h"
+#include "jb_smooth.h"
 #include "coord2trajec.h"
 
-int file_open(char *coord_in, rc_vector_t *trajec) {
-	int status; 
+void print_plan(const jb_traj_t *tr, const jb_waypoint_t *wp, int n) {
+	int i, k;
+	const jb_traj_segment_t *seg;
+
+	printf(" wp | requested | planned  |   peak speed (rad/s)   |  peak accel (rad/s2)\n");
+	printf("    |    (s)    |   (s)    |   x_r     y_r     z    |   x_r     y_r     z\n");
+	printf("%3d | %9.3f | %8.3f |\n", 0, wp[0].t, tr->seg[0].t0);
+	for (i = 0; i < tr->n && i < n - 1; ++i) {
+		seg = &tr->seg[i];
+		// peaks are at the cruise and the constant acceleration phases
+		printf("%3d | %9.3f | %8.3f | ", i + 1, wp[i + 1].t, seg->t1);
+		for (k = 0; k < JB_TRAJ_AXES; ++k) {
+			printf("%7.2f ", fabs(seg->d[k] * seg->prof.v[3]));
+		}
+		printf("| ");
+		for (k = 0; k < JB_TRAJ_AXES; ++k) {
+			printf("%7.2f ", fabs(seg->d[k] * seg->prof.a[1]));
+		}
+		printf("%s\n", (seg->t1 > wp[i + 1].t + 1e-9) ? " LATE" : "");
+	}
+}
+
+void write_samples(jb_traj_t *tr, double dt, FILE *out) {
+	int i;
+	double t, pos[JB_TRAJ_AXES], vel[JB_TRAJ_AXES];
+	double end = tr->seg[tr->n - 1].t1;
+
+	fprintf(out, "t,x_r,y_r,z,v_xr,v_yr,v_z\n");
+	for (i = 0; ; ++i) {
+		t = tr->seg[0].t0 + i * dt;
+		if (t > end) t = end;
+		jb_traj_eval(tr, t, pos, vel);
+		fprintf(out, "%.4f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+			t, pos[0], pos[1], pos[2], vel[0], vel[1], vel[2]);
+		if (t >= end) break;
+	}
+}
+
+void print_smooth(const jb_smooth_t *sm, const jb_traj_t *tr, const jb_waypoint_t *wp, int n) {
+	int k;
+	double v[JB_TRAJ_AXES], a[JB_TRAJ_AXES], j[JB_TRAJ_AXES];
+
+	jb_smooth_peaks(sm, v, a, j);
+	printf("smooth path through %d waypoints\n", n);
+	printf("  last waypoint at %8.3f s, requested %.3f s, stopping at each %.3f s\n",
+		sm->t_end, wp[n - 1].t, tr->seg[tr->n - 1].t1);
+	if (sm->stretch > 1.0) {
+		printf("  takes %.3f times as long as requested to stay within the limits\n", sm->stretch);
+	}
+	printf("                 x_r     y_r     z\n");
+	printf("  peak speed ");
+	for (k = 0; k < JB_TRAJ_AXES; ++k) printf("%7.2f ", v[k]);
+	printf("rad/s\n  peak accel ");
+	for (k = 0; k < JB_TRAJ_AXES; ++k) printf("%7.2f ", a[k]);
+	printf("rad/s2\n  peak jerk  ");
+	for (k = 0; k < JB_TRAJ_AXES; ++k) printf("%7.1f ", j[k]);
+	printf("rad/s3\n");
+}
+
+void write_smooth_samples(jb_smooth_t *sm, double dt, FILE *out) {
+	int i;
+	double t, pos[JB_TRAJ_AXES], vel[JB_TRAJ_AXES];
 
-	FILE *fptr = fopen(coord_in, "r");
-	if (fptr == NULL) {
-		fprintf(stderr, "ERROR: Could not open file");
-		return(-1);
+	fprintf(out, "t,x_r,y_r,z,v_xr,v_yr,v_z\n");
+	for (i = 0; ; ++i) {
+		t = sm->t0 + i * dt;
+		if (t > sm->t_end) t = sm->t_end;
+		jb_smooth_eval(sm, t, pos, vel, NULL);
+		fprintf(out, "%.4f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+			t, pos[0], pos[1], pos[2], vel[0], vel[1], vel[2]);
+		if (t >= sm->t_end) break;
 	}
-	
-	fscanf(fptr, "1%d", trajec); // CHECK ON THIS SYNTAX
+}
 
-	return 0;
+static void __print_usage(void) {
+	printf("\n");
+	printf("Usage: coord2trajec [-v vel] [-a accel] [-j jerk] [-p] [-s dt] [-b out] [file]\n");
+	printf(" -v <vel>    x_r/y_r velocity limit, default %d rad/s\n", VEL_MAX);
+	printf(" -a <accel>  x_r/y_r acceleration limit, default %d rad/s2\n", ACCEL_MAX);
+	printf(" -j <jerk>   x_r/y_r jerk limit, default %d rad/s3\n", JERK_MAX);
+	printf(" -p          plan a smooth path through the waypoints, as jb_main -p\n");
+	printf(" -s <dt>     print planned setpoints every dt seconds as csv\n");
+	printf(" -b <out>    write the waypoints to out as a binary trajectory file\n");
+	printf(" -h          print this help message\n");
+	printf(" file defaults to %s\n", FILEIN);
+	printf("\n");
 }
 
-void coord_convert(const int *trajec, int *coord_omni) { 
-	// while still have inputs from input trajectory, 
-	// write to coord_omni
-}
\ No newline at end of file
+int main(int argc, char *argv[]) {
+	int c, n, late, smooth = 0;
+	double dt = 0.0;
+	const char *file = FILEIN;
+	const char *bin_out = NULL;
+	jb_waypoint_t *wp = NULL;
+	jb_traj_t tr = JB_TRAJ_INITIALIZER;
+	jb_smooth_t sm = JB_SMOOTH_INITIALIZER;
+	jb_plan_limits_t lim = jb_plan_default_limits();
+
+	while ((c = getopt(argc, argv, "v:a:j:ps:b:h")) != -1) {
+		switch (c) {
+		case 'v':
+			lim.v_max[0] = lim.v_max[1] = atof(optarg);
+			break;
+		case 'a':
+			lim.a_pos[0] = lim.a_pos[1] = atof(optarg);
+			lim.a_neg[0] = lim.a_neg[1] = lim.a_pos[0];
+			break;
+		case 'j':
+			lim.j_max[0] = lim.j_max[1] = atof(optarg);
+			break;
+		case 'p':
+			smooth = 1;
+			break;
+		case 's':
+			dt = atof(optarg);
+			if (dt <= 0.0) {
+				fprintf(stderr, "ERROR: sample period must be positive\n");
+				return -1;
+			}
+			break;
+		case 'b':
+			bin_out = optarg;
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+	if (optind < argc) file = argv[optind];
+
+	n = jb_wp_load(file, &wp);
+	if (n < 0) return -1;
+	if (bin_out != NULL) {
+		if (jb_wp_write_binary(bin_out, wp, n)) {
+			free(wp);
+			return -1;
+		}
+		printf("wrote %d waypoints to %s\n", n, bin_out);
+	}
+	jb_plan_global_to_axes(wp, wp, n);
+	late = jb_plan_trajectory(&tr, wp, n, &lim);
+	if (late < 0) {
+		free(wp);
+		return -1;
+	}
+
+	if (smooth) {
+		if (jb_smooth_plan(&sm, wp, n, &lim)) {
+			free(wp);
+			jb_traj_free(&tr);
+			return -1;
+		}
+		if (dt > 0.0) write_smooth_samples(&sm, dt, stdout);
+		else print_smooth(&sm, &tr, wp, n);
+		late = sm.stretch > 1.0;
+	}
+	else if (dt > 0.0) {
+		write_samples(&tr, dt, stdout);
+	}
+	else {
+		print_plan(&tr, wp, n);
+		if (late) printf("%d of %d waypoints late\n", late, n - 1);
+	}
+	free(wp);
+	jb_traj_free(&tr);
+	jb_smooth_free(&sm);
+	return late ? 1 : 0;
+}
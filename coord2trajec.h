@@ -6,17 +6,49 @@
 *
 * Convert input coordinates to 
 * stored trajectory for jerbobot 
+*
+* Offline front end to the jb_main planner: reads a trajectory file,
+* plans it with the same limits jb_main uses and reports where each
+* waypoint is actually reached, so a file can be checked and tuned
+* without the robot. Build with "make coord2trajec" in jb_main.
+*
+* Usage: coord2trajec [-v vel] [-a accel] [-j jerk] [-p] [-s dt] [-b out] [file]
+*	-v, -a, -j	override the x_r/y_r limits (rad/s, rad/s2, rad/s3)
+*	-p		plan a smooth path through the waypoints instead of
+*			stopping at each, see jb_smooth.h, and compare when the
+*			last waypoint is reached each way
+*	-s dt		also print the planned setpoints every dt seconds as
+*			csv: t, x_r, y_r, z, v_xr, v_yr, v_z
+*	-b out		convert file to the binary format, see jb_traj_io.h
+*	file		text or binary, defaults to FILEIN
 */
 
+#ifndef COORD2TRAJEC_H
+#define COORD2TRAJEC_H
+
 #include <stdio.h>
-#include <stdlib.h>
-#include <rc/math.h>
+#include "jb_planner.h"
+#include "jb_smooth.h"
+
+// REQ: tr planned from wp, n waypoints
+// EFFECT:	print requested and planned arrival of each waypoint
+//			with the peak speed and acceleration of each axis
+void print_plan(const jb_traj_t *tr, const jb_waypoint_t *wp, int n);
+
+// REQ: tr planned, dt > 0
+// MOD:	tr (segment cache)
+// EFFECT:	write the planned setpoints every dt seconds to out as csv
+void write_samples(jb_traj_t *tr, double dt, FILE *out);
 
-void file_open(char *coord_in, rc_vector_t *trajec) { }
+// REQ: sm planned from wp, n waypoints, tr planned from the same
+// EFFECT:	print when the smooth path reaches the last waypoint next to
+//			the requested time and stopping at each, and the peak
+//			speed, acceleration and jerk of each axis
+void print_smooth(const jb_smooth_t *sm, const jb_traj_t *tr, const jb_waypoint_t *wp, int n);
 
-// REQ: movement command within field limits
-// MOD:	write to omni-wheel, rotated coords
-// EFFECT:	convert cartesian coords to rotated 45
-//			, relevant to omni-wheels
-void coord_convert(const int *coord_dif, int *coord_omni) { }
+// REQ: sm planned, dt > 0
+// MOD:	sm (segment cache)
+// EFFECT:	write the smooth path's setpoints every dt seconds to out as csv
+void write_smooth_samples(jb_smooth_t *sm, double dt, FILE *out);
 
+#endif // COORD2TRAJEC_H
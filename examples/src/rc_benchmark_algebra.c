@@ -10,6 +10,10 @@
  *             used as a test to see if the compiled math library is using the
  *             CPU hardware vectorized floating point units.
  *
+ *             With -k it instead compares the fixed-size kernels in
+ *             <rc/math/small_matrix.h> against rc_matrix_t for each size from
+ *             2x2 to 6x6 and prints the time per call and the speedup.
+ *
  *
  * @author     James Strawson
  * @date       1/29/2018
@@ -19,6 +23,7 @@
 #include <stdint.h>
 #include <getopt.h>
 #include <stdlib.h> // for atoi
+#include <math.h> // for fabs
 #include <rc/time.h>
 #include <rc/math.h>
 
@@ -31,17 +36,120 @@
 // ns consumed just by reading the thread time
 #define TIMER_DELAY 2100
 
+// calls per timed loop in the small matrix benchmark
+#define SMALL_REPS	200000
+
 
 static void __print_usage(void)
 {
 	printf("\n");
 	printf("-d         use default matrix size (%dx%d)\n",DEFAULT_DIM,DEFAULT_DIM);
 	printf("-s {size}  use custom matrix size\n");
+	printf("-k         compare fixed-size 2x2 to 6x6 kernels against rc_matrix_t\n");
 	printf("-h         print this help message\n");
 	printf("\n");
 }
 
 
+static double __max_diff(rc_matrix_t A, double* b)
+{
+	int i;
+	double d, max = 0.0;
+	for(i=0;i<A.rows*A.cols;i++){
+		d = fabs(A.d[0][i]-b[i]);
+		if(d>max) max = d;
+	}
+	return max;
+}
+
+static void __print_small(const char* op, int n, double generic, double fixed, double err)
+{
+	printf("%-10s %dx%d %10.1f %10.1f %8.1fx   %.1e\n", op, n, n, generic, fixed,
+		generic/fixed, err);
+}
+
+/*
+ * Times one size of the fixed-size kernels against the rc_matrix_t functions
+ * on the same well conditioned symmetric positive definite matrix.
+ */
+#define BENCH_SMALL(N)\
+static void __bench_small_##N(void)\
+{\
+	int i;\
+	uint64_t t1;\
+	double generic, fixed;\
+	rc_matrix_t A = RC_MATRIX_INITIALIZER;\
+	rc_matrix_t B = RC_MATRIX_INITIALIZER;\
+	rc_matrix_t C = RC_MATRIX_INITIALIZER;\
+	rc_mat##N##_t a, c;\
+	rc_matrix_random(&A, N, N);\
+	for(i=0;i<N;i++) A.d[i][i] += N;\
+	rc_matrix_transpose(A, &B);\
+	rc_matrix_add_inplace(&A, B);\
+	rc_matrix_alloc(&C, N, N);\
+	rc_mat##N##_from_matrix(&a, A);\
+	t1 = TIMER;\
+	for(i=0;i<SMALL_REPS;i++) rc_matrix_multiply(A, A, &C);\
+	generic = (double)(TIMER-t1)/SMALL_REPS;\
+	t1 = TIMER;\
+	for(i=0;i<SMALL_REPS;i++) rc_mat##N##_multiply(&a, &a, &c);\
+	fixed = (double)(TIMER-t1)/SMALL_REPS;\
+	__print_small("multiply", N, generic, fixed, __max_diff(C, c.d[0]));\
+	t1 = TIMER;\
+	for(i=0;i<SMALL_REPS;i++) rc_algebra_invert_matrix(A, &C);\
+	generic = (double)(TIMER-t1)/SMALL_REPS;\
+	t1 = TIMER;\
+	for(i=0;i<SMALL_REPS;i++) rc_mat##N##_invert(&a, &c);\
+	fixed = (double)(TIMER-t1)/SMALL_REPS;\
+	__print_small("invert", N, generic, fixed, __max_diff(C, c.d[0]));\
+	t1 = TIMER;\
+	for(i=0;i<SMALL_REPS;i++) rc_mat##N##_invert_spd(&a, &c);\
+	fixed = (double)(TIMER-t1)/SMALL_REPS;\
+	__print_small("invert_spd", N, generic, fixed, __max_diff(C, c.d[0]));\
+	rc_matrix_free(&A);\
+	rc_matrix_free(&B);\
+	rc_matrix_free(&C);\
+}
+
+BENCH_SMALL(2)
+BENCH_SMALL(3)
+BENCH_SMALL(4)
+BENCH_SMALL(5)
+BENCH_SMALL(6)
+
+static void __bench_small(void)
+{
+	int i;
+	uint64_t t1;
+	double generic, fixed, err;
+	double q[4] = {0.9, 0.1, -0.3, 0.2};
+	double v[3] = {1.0, 2.0, 3.0};
+	double v1[3], v2[3], len;
+
+	printf("operation  size   rc_matrix  fixed(ns)  speedup  max error\n");
+	__bench_small_2();
+	__bench_small_3();
+	__bench_small_4();
+	__bench_small_5();
+	__bench_small_6();
+
+	len = rc_quaternion_norm_array(q);
+	for(i=0;i<4;i++) q[i] /= len;
+	t1 = TIMER;
+	for(i=0;i<SMALL_REPS;i++){
+		v1[0]=v[0]; v1[1]=v[1]; v1[2]=v[2];
+		rc_quaternion_rotate_vector_array(v1, q);
+	}
+	generic = (double)(TIMER-t1)/SMALL_REPS;
+	t1 = TIMER;
+	for(i=0;i<SMALL_REPS;i++) rc_mat3_rotate_quaternion(q, v, v2);
+	fixed = (double)(TIMER-t1)/SMALL_REPS;
+	err = fmax(fabs(v1[0]-v2[0]), fmax(fabs(v1[1]-v2[1]), fabs(v1[2]-v2[2])));
+	printf("%-10s %s %10.1f %10.1f %8.1fx   %.1e\n", "q rotate", "3  ", generic,
+		fixed, generic/fixed, err);
+}
+
+
 int main(int argc, char *argv[])
 {
 	int dim = 0;
@@ -71,7 +179,7 @@ int main(int argc, char *argv[])
 	}
 	// parse arguments
 	opterr = 0;
-	while ((c = getopt(argc, argv, "ds:h")) != -1){
+	while ((c = getopt(argc, argv, "ds:kh")) != -1){
 		switch (c){
 		case 'd': // default size option
 			if(dim!=0){
@@ -94,6 +202,14 @@ int main(int argc, char *argv[])
 				return -1;
 			}
 			break;
+		case 'k': // small fixed-size matrices
+			if(dim!=0){
+				printf("invalid combination of arguments\n");
+				__print_usage();
+				return -1;
+			}
+			__bench_small();
+			return 0;
 		case 'h':
 			__print_usage();
 			return 0;
@@ -132,8 +248,9 @@ int main(int argc, char *argv[])
 	printf("%10dus Time to multiply matrices\n", diff);
 
 	// calculate floating pointer operations per second, both multiplication
-	// and addition count as operations, hence multiply by 2
-	flops = ((uint64_t)2*dim*dim*dim*1000000000)/(diff);
+	// and addition count as operations, hence multiply by 2. diff is in us.
+	if(diff<1) diff = 1;
+	flops = ((uint64_t)2*dim*dim*dim*1000000)/(diff);
 	mflops = flops/(uint64_t)1000000;
 	printf("%10d MFLOPS multiplying matrices\n", mflops);
 
@@ -8,9 +8,12 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>	// for rand
+#include <math.h>	// for cos, sin
 #include <rc/math.h>
 
 #define DIM 3
+#define FIT_POINTS 200
 
 int main()
 {
@@ -25,6 +28,15 @@ int main()
 	rc_vector_t b	= RC_VECTOR_INITIALIZER;
 	rc_vector_t x	= RC_VECTOR_INITIALIZER;
 	rc_vector_t y	= RC_VECTOR_INITIALIZER;
+	rc_matrix_t S	= RC_MATRIX_INITIALIZER;
+	rc_matrix_t T	= RC_MATRIX_INITIALIZER;
+	rc_vector_t D	= RC_VECTOR_INITIALIZER;
+	rc_vector_t v	= RC_VECTOR_INITIALIZER;
+	rc_vector_t c	= RC_VECTOR_INITIALIZER;
+	rc_vector_t l	= RC_VECTOR_INITIALIZER;
+	rc_ellipsoid_fit_t fit = RC_ELLIPSOID_FIT_INITIALIZER;
+	double p[3], ctr[3], lens[3], res, th, ph;
+	int i;
 
 	printf("Let's test some linear algebra functions....\n\n");
 
@@ -80,7 +92,75 @@ int main()
 	rc_algebra_lin_system_solve_qr(A,b,&y);
 	rc_vector_print(y);
 
+	// make a symmetric positive definite matrix S = A*A' + I
+	printf("\nSymmetric positive definite S = A*A' + I:\n");
+	rc_matrix_transpose(A,&T);
+	rc_matrix_multiply(A,T,&S);
+	rc_matrix_identity(&T,DIM);
+	rc_matrix_add_inplace(&S,T);
+	rc_matrix_print(S);
+
+	// cholesky decomposition of S
+	printf("\nCholesky decomposition S = L*L', L:\n");
+	rc_algebra_cholesky_decomp(S,&L);
+	rc_matrix_print(L);
+	printf("L*L' should equal S:\n");
+	rc_matrix_transpose(L,&T);
+	rc_matrix_left_multiply_inplace(L,&T);
+	rc_matrix_print(T);
+
+	// compare cholesky solution with gaussian elimination
+	printf("\nCholesky solution x to the equation Sx=b:\n");
+	rc_algebra_cholesky_solve(L,b,&x);
+	rc_vector_print(x);
+	printf("Gaussian Elimination solution for comparison:\n");
+	rc_algebra_lin_system_solve(S,b,&y);
+	rc_vector_print(y);
+
+	// rank one update then downdate should return the original factor
+	printf("\nL after rank one update with b and downdate with b again:\n");
+	rc_algebra_cholesky_update(&L,b);
+	rc_algebra_cholesky_downdate(&L,b);
+	rc_matrix_print(L);
+
+	// LDL' decomposition avoids the square roots
+	printf("\nLDL' decomposition of S\n");
+	rc_algebra_ldl_decomp(S,&L,&D);
+	printf("L:\n");
+	rc_matrix_print(L);
+	printf("D:\n");
+	rc_vector_print(D);
+	printf("LDL' solution x to the equation Sx=b:\n");
+	rc_algebra_ldl_solve(L,D,b,&v);
+	rc_vector_print(v);
+
+	// noisy points on an ellipsoid like a magnetometer sweep, fit all at
+	// once and one point at a time
+	printf("\nEllipsoid centered at (20,-10,35) with lengths (45,50,55)\n");
+	rc_matrix_alloc(&A,FIT_POINTS,3);
+	for(i=0;i<FIT_POINTS;i++){
+		th = 2.0*M_PI*rand()/(double)RAND_MAX;
+		ph = acos(2.0*rand()/(double)RAND_MAX-1.0);
+		p[0] =  20.0 + 45.0*sin(ph)*cos(th) + 0.2*(rand()/(double)RAND_MAX-0.5);
+		p[1] = -10.0 + 50.0*sin(ph)*sin(th) + 0.2*(rand()/(double)RAND_MAX-0.5);
+		p[2] =  35.0 + 55.0*cos(ph) + 0.2*(rand()/(double)RAND_MAX-0.5);
+		A.d[i][0] = p[0];
+		A.d[i][1] = p[1];
+		A.d[i][2] = p[2];
+		rc_algebra_ellipsoid_fit_add(&fit,p);
+	}
+	rc_algebra_fit_ellipsoid(A,&c,&l);
+	printf("batch fit center and lengths:\n");
+	rc_vector_print(c);
+	rc_vector_print(l);
+	rc_algebra_ellipsoid_fit_solve(&fit,ctr,lens,&res);
+	printf("streaming fit center and lengths, residual %.4f:\n", res);
+	printf("%7.4f  %7.4f  %7.4f\n", ctr[0], ctr[1], ctr[2]);
+	printf("%7.4f  %7.4f  %7.4f\n", lens[0], lens[1], lens[2]);
+
 	// free memory
+	rc_vector_free(&c);
+	rc_vector_free(&l);
 	rc_matrix_free(&A);
 	rc_matrix_free(&Ainv);
 	rc_matrix_free(&AA);
@@ -92,6 +172,10 @@ int main()
 	rc_vector_free(&b);
 	rc_vector_free(&x);
 	rc_vector_free(&y);
+	rc_matrix_free(&S);
+	rc_matrix_free(&T);
+	rc_vector_free(&D);
+	rc_vector_free(&v);
 	printf("\nDONE\n");
 	return 0;
 }
@@ -0,0 +1,81 @@
+/**
+ * @file rc_test_encoder_velocity.c
+ * @example rc_test_encoder_velocity
+ * @brief checks encoder speeds from snapshots, including counter wrap-around
+ *
+ * Needs no hardware. Builds pairs of rc_encoder_snapshot_t by hand and checks
+ * the speeds rc_encoder_velocity gives: forwards and backwards across the
+ * signed 32-bit wrap, with each channel captured at its own time, and that
+ * snapshots out of order are rejected. Also checks that rc_encoder_snapshot
+ * refuses to run before the encoders are initialized rather than returning
+ * made up counts.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <rc/encoder.h>
+
+static int __check(const char* name, int ch, double got, double expect)
+{
+	if(fabs(got-expect) <= 1e-9*fabs(expect)) return 0;
+	printf("FAIL: %s channel %d speed is %f expected %f\n", name, ch+1, got, expect);
+	return 1;
+}
+
+int main(void)
+{
+	int i, fails = 0;
+	double vel[RC_ENCODER_CHANNELS];
+	rc_encoder_snapshot_t prev, curr;
+	// counts before and after, chosen to cross the wrap both ways
+	const int32_t before[RC_ENCODER_CHANNELS] = {INT32_MAX-49, INT32_MIN+20, -5, 1000};
+	const int32_t after[RC_ENCODER_CHANNELS] = {INT32_MIN+50, INT32_MAX-9, 5, 1000};
+	const double moved[RC_ENCODER_CHANNELS] = {100.0, -30.0, 10.0, 0.0};
+
+	// channels 1-3 captured 10ms apart, channel 4 on its own schedule
+	for(i=0;i<RC_ENCODER_CHANNELS;i++){
+		prev.counts[i] = before[i];
+		curr.counts[i] = after[i];
+		prev.ch_t_ns[i] = 1000000000ull;
+		curr.ch_t_ns[i] = 1010000000ull;
+	}
+	curr.ch_t_ns[3] = 1020000000ull;
+	prev.t_ns = prev.ch_t_ns[0];
+	curr.t_ns = curr.ch_t_ns[0];
+
+	if(rc_encoder_velocity(&prev, &curr, vel)){
+		printf("FAIL: rc_encoder_velocity rejected valid snapshots\n");
+		fails++;
+	}
+	else{
+		for(i=0;i<3;i++) fails += __check("wrap", i, vel[i], moved[i]/0.01);
+		fails += __check("own capture time", 3, vel[3], 0.0);
+	}
+
+	// a full wrap forward from the most negative count
+	prev.counts[0] = INT32_MIN;
+	curr.counts[0] = INT32_MAX;
+	if(rc_encoder_velocity(&prev, &curr, vel) || __check("full range", 0, vel[0], -1.0/0.01)){
+		fails++;
+	}
+
+	// swapped snapshots must be refused, not turned into negative speeds
+	if(rc_encoder_velocity(&curr, &prev, vel)!=-1){
+		printf("FAIL: snapshots out of order accepted\n");
+		fails++;
+	}
+
+	// nothing is initialized here so there is nothing to read
+	if(rc_encoder_snapshot(&curr)!=-1){
+		printf("FAIL: rc_encoder_snapshot succeeded without rc_encoder_init\n");
+		fails++;
+	}
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
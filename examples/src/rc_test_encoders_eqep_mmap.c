@@ -0,0 +1,163 @@
+/**
+ * @file rc_test_encoders_eqep_mmap.c
+ * @example rc_test_encoders_eqep_mmap
+ * @brief checks and times memory-mapped eQEP encoder reads
+ *
+ * By default this needs no hardware. It creates a fake eQEP register file in
+ * /dev/shm, points rc_encoder_eqep_init_mmap at it, writes known counts into
+ * the fake QPOSCNT registers and checks that rc_encoder_eqep_read,
+ * rc_encoder_eqep_read_all and rc_encoder_eqep_write see the same values. It
+ * then reports how long a read takes.
+ *
+ * With -m the real eQEP registers are mapped from /dev/mem instead and the
+ * read timing is compared against the sysfs driver. Needs root.
+ *
+ * @verbatim
+ Usage:
+	-m               Use the real eQEP hardware instead of a fake register file
+	-n <reads>       Number of reads to time, default 100000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi
+#include <stdint.h>
+#include <unistd.h> // for getopt, ftruncate
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <rc/encoder_eqep.h>
+#include <rc/time.h>
+
+#define FAKE_FILE	"/dev/shm/rc_test_eqep_regs"
+#define QPOSCNT(ch)	(((ch)-1)*0x2000 + 0x180)
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-m               Use the real eQEP hardware instead of a fake register file\n");
+	printf("-n <reads>       Number of reads to time, default 100000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+// average time of one rc_encoder_eqep_read in ns
+static double __time_reads(int n)
+{
+	volatile int sink = 0;
+	uint64_t start;
+	int i;
+	start = rc_nanos_since_boot();
+	for(i=0;i<n;i++) sink += rc_encoder_eqep_read((i%3)+1);
+	(void)sink;
+	return (double)(rc_nanos_since_boot()-start)/n;
+}
+
+// writes into the fake registers directly and checks the library sees it
+static int __check_fake(volatile uint32_t* regs)
+{
+	const int32_t vals[3] = {12345, -67890, 2147483647};
+	int pos[3];
+	int ch, fails = 0;
+
+	for(ch=1;ch<=3;ch++) regs[QPOSCNT(ch)/4] = (uint32_t)vals[ch-1];
+	for(ch=1;ch<=3;ch++){
+		if(rc_encoder_eqep_read(ch)!=vals[ch-1]){
+			printf("FAIL: read ch%d returned %d expected %d\n", ch,
+				rc_encoder_eqep_read(ch), vals[ch-1]);
+			fails++;
+		}
+	}
+	if(rc_encoder_eqep_read_all(pos) || pos[0]!=vals[0] || pos[1]!=vals[1] || pos[2]!=vals[2]){
+		printf("FAIL: read_all returned %d %d %d\n", pos[0], pos[1], pos[2]);
+		fails++;
+	}
+	for(ch=1;ch<=3;ch++){
+		rc_encoder_eqep_write(ch, -ch);
+		if((int32_t)regs[QPOSCNT(ch)/4]!=-ch){
+			printf("FAIL: write ch%d left register at %d\n", ch, (int32_t)regs[QPOSCNT(ch)/4]);
+			fails++;
+		}
+	}
+	return fails;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, fd, fails;
+	int hardware = 0;
+	int n = 100000;
+	volatile uint32_t* regs;
+
+	while((opt = getopt(argc, argv, "mn:h")) != -1){
+		switch (opt) {
+		case 'm':
+			hardware = 1;
+			break;
+		case 'n':
+			n = atoi(optarg);
+			if(n<1){
+				fprintf(stderr,"ERROR: number of reads must be positive\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	if(hardware){
+		if(rc_encoder_eqep_init()){
+			fprintf(stderr,"ERROR: failed to run rc_encoder_eqep_init\n");
+			return -1;
+		}
+		printf("sysfs read: %8.1f ns\n", __time_reads(n));
+		if(rc_encoder_eqep_init_mmap(NULL, 0)){
+			fprintf(stderr,"ERROR: failed to run rc_encoder_eqep_init_mmap\n");
+			return -1;
+		}
+		printf("mmap read:  %8.1f ns\n", __time_reads(n));
+		rc_encoder_eqep_cleanup();
+		return 0;
+	}
+
+	// build a zeroed register file on tmpfs and map it ourselves too
+	fd = open(FAKE_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if(fd==-1){
+		perror("ERROR: failed to create " FAKE_FILE);
+		return -1;
+	}
+	if(ftruncate(fd, RC_ENCODER_EQEP_MMAP_LEN)){
+		perror("ERROR: failed to size " FAKE_FILE);
+		close(fd);
+		return -1;
+	}
+	regs = mmap(0, RC_ENCODER_EQEP_MMAP_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(regs==MAP_FAILED){
+		perror("ERROR: failed to map " FAKE_FILE);
+		return -1;
+	}
+
+	if(rc_encoder_eqep_init_mmap(FAKE_FILE, 0)){
+		fprintf(stderr,"ERROR: failed to run rc_encoder_eqep_init_mmap\n");
+		return -1;
+	}
+	fails = __check_fake(regs);
+	printf("mmap read:  %8.1f ns\n", __time_reads(n));
+
+	rc_encoder_eqep_cleanup();
+	munmap((void*)regs, RC_ENCODER_EQEP_MMAP_LEN);
+	unlink(FAKE_FILE);
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
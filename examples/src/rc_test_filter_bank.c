@@ -0,0 +1,165 @@
+/**
+ * @file rc_test_filter_bank.c
+ * @example rc_test_filter_bank
+ * @brief checks an rc_filter_bank_t against the same filters run one at a
+ * time
+ *
+ * Seven filters of different orders and relative degrees, some with
+ * saturation and soft start and one with a denominator that doesn't lead with
+ * 1, are loaded into a bank. Both are fed the same random inputs and must give
+ * the same outputs and saturation flags every step, before and after a reset.
+ * Finally the time of a step is compared between marching the filters one by
+ * one and marching the bank.
+ *
+ * @verbatim
+ Usage:
+	-n <steps>       Number of steps to time, default 100000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi, rand
+#include <stdint.h>
+#include <math.h>   // for fabs
+#include <unistd.h> // for getopt
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define CH		7
+#define DT		0.01
+#define CHECK_STEPS	2000
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-n <steps>       Number of steps to time, default 100000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+static int __make_filters(rc_filter_t* f)
+{
+	int ret = 0;
+	double num[] = {0.5};
+	double den[] = {2.0, -1.0};
+
+	ret |= rc_filter_pid(&f[0], 1.5, 0.5, 0.05, 4*DT, DT);
+	ret |= rc_filter_enable_saturation(&f[0], -1.0, 1.0);
+	ret |= rc_filter_enable_soft_start(&f[0], 0.5);
+	ret |= rc_filter_butterworth_lowpass(&f[1], 4, DT, 10.0);
+	ret |= rc_filter_first_order_lowpass(&f[2], DT, 0.1);
+	ret |= rc_filter_enable_saturation(&f[2], -0.3, 0.3);
+	ret |= rc_filter_integrator(&f[3], DT);
+	ret |= rc_filter_enable_saturation(&f[3], -0.2, 0.1);
+	ret |= rc_filter_enable_soft_start(&f[3], 1.0);
+	ret |= rc_filter_moving_average(&f[4], 5, DT);
+	ret |= rc_filter_double_integrator(&f[5], DT);
+	ret |= rc_filter_alloc_from_arrays(&f[6], DT, num, 1, den, 2);
+	return ret;
+}
+
+// runs both for a number of steps, returns the number of mismatching steps
+static int __compare(rc_filter_t* f, rc_filter_bank_t* bank, int steps)
+{
+	int i, j, bad = 0;
+	double in[CH], out[CH], y;
+
+	for(i=0;i<steps;i++){
+		for(j=0;j<CH;j++) in[j] = 2.0*rand()/(double)RAND_MAX - 1.0;
+		rc_filter_bank_march(bank, in, out);
+		for(j=0;j<CH;j++){
+			y = rc_filter_march(&f[j], in[j]);
+			if(fabs(y-out[j]) > 1e-9*(1.0+fabs(y)) ||
+			   rc_filter_get_saturation_flag(&f[j])!=rc_filter_bank_get_saturation_flag(bank,j)){
+				if(bad==0) printf("FAIL: channel %d differs at step %d, %g vs %g\n",
+								j, i, y, out[j]);
+				bad++;
+			}
+		}
+	}
+	return bad;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, i, j, order = 0, fails = 0;
+	int steps = 100000;
+	uint64_t start;
+	double single_ns, bank_ns, in[CH], out[CH];
+	rc_filter_t f[CH];
+	rc_filter_bank_t bank = RC_FILTER_BANK_INITIALIZER;
+
+	while((opt = getopt(argc, argv, "n:h")) != -1){
+		switch (opt) {
+		case 'n':
+			steps = atoi(optarg);
+			if(steps<1){
+				fprintf(stderr,"ERROR: number of steps must be positive\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	for(j=0;j<CH;j++) f[j] = rc_filter_empty();
+	if(__make_filters(f)){
+		fprintf(stderr,"ERROR: failed to make filters\n");
+		return -1;
+	}
+	for(j=0;j<CH;j++) if(f[j].order>order) order = f[j].order;
+	if(rc_filter_bank_alloc(&bank, CH, order, DT)){
+		fprintf(stderr,"ERROR: failed to allocate filter bank\n");
+		return -1;
+	}
+	for(j=0;j<CH;j++){
+		if(rc_filter_bank_set_channel(&bank, j, f[j])){
+			fprintf(stderr,"ERROR: failed to set channel %d\n", j);
+			return -1;
+		}
+	}
+	printf("%d channels, bank order %d, stride %d\n", CH, bank.order, bank.stride);
+
+	// a filter of higher order than the bank must be refused
+	if(rc_filter_bank_alloc(&bank, CH, order-1, DT)==0 &&
+	   rc_filter_bank_set_channel(&bank, 1, f[1])==0){
+		printf("FAIL: filter of order %d accepted by bank of order %d\n",
+							f[1].order, order-1);
+		fails++;
+	}
+	rc_filter_bank_alloc(&bank, CH, order, DT);
+	for(j=0;j<CH;j++) rc_filter_bank_set_channel(&bank, j, f[j]);
+
+	if(__compare(f, &bank, CHECK_STEPS)) fails++;
+	for(j=0;j<CH;j++) rc_filter_reset(&f[j]);
+	rc_filter_bank_reset(&bank);
+	if(__compare(f, &bank, CHECK_STEPS)) fails++;
+
+	// time a step both ways
+	for(j=0;j<CH;j++) in[j] = 0.1*j;
+	start = rc_nanos_since_boot();
+	for(i=0;i<steps;i++){
+		for(j=0;j<CH;j++) out[j] = rc_filter_march(&f[j], in[j]);
+	}
+	single_ns = (double)(rc_nanos_since_boot()-start)/steps;
+	start = rc_nanos_since_boot();
+	for(i=0;i<steps;i++) rc_filter_bank_march(&bank, in, out);
+	bank_ns = (double)(rc_nanos_since_boot()-start)/steps;
+	printf("step time, %d filters: %8.1f ns   bank: %8.1f ns\n", CH, single_ns, bank_ns);
+
+	for(j=0;j<CH;j++) rc_filter_free(&f[j]);
+	rc_filter_bank_free(&bank);
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
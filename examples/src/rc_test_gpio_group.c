@@ -0,0 +1,135 @@
+/**
+ * @file rc_test_gpio_group.c
+ * @example rc_test_gpio_group
+ * @brief checks multi-line gpio handles and times a group write
+ *
+ * Requests several output lines of one gpio chip as a single rc_gpio_group_t,
+ * walks a single high bit across them and reads every pattern back with
+ * rc_gpio_group_get_values. Then times a group write against writing the
+ * same lines one at a time with rc_gpio_set_value.
+ *
+ * No BeagleBone needed, any chip works. On a PC a simulated chip can be made
+ * with the gpio-mockup module, for example:
+ *
+ * @verbatim
+ sudo modprobe gpio-mockup gpio_mockup_ranges=-1,8
+ sudo rc_test_gpio_group -c <chip> -n 8
+ * @endverbatim
+ *
+ * where chip is the number of the new /dev/gpiochipX. Don't point this at
+ * lines driving real hardware.
+ *
+ * @verbatim
+ Usage:
+	-c <chip>        gpio chip to use, /dev/gpiochipX, required
+	-n <lines>       test lines 0 to n-1 of the chip, default 8
+	-i <writes>      number of writes to time, default 10000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi
+#include <unistd.h> // for getopt
+#include <rc/gpio.h>
+#include <rc/time.h>
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-c <chip>        gpio chip to use, /dev/gpiochipX, required\n");
+	printf("-n <lines>       test lines 0 to n-1 of the chip, default 8\n");
+	printf("-i <writes>      number of writes to time, default 10000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, i, j, fails = 0;
+	int chip = -1;
+	int lines = 8;
+	int writes = 10000;
+	int pins[RC_GPIO_GROUP_MAX_LINES];
+	int set[RC_GPIO_GROUP_MAX_LINES];
+	int got[RC_GPIO_GROUP_MAX_LINES];
+	uint64_t start;
+	double group_ns, single_ns;
+	rc_gpio_group_t group = RC_GPIO_GROUP_INITIALIZER;
+
+	while((opt = getopt(argc, argv, "c:n:i:h")) != -1){
+		switch (opt) {
+		case 'c':
+			chip = atoi(optarg);
+			break;
+		case 'n':
+			lines = atoi(optarg);
+			break;
+		case 'i':
+			writes = atoi(optarg);
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+	if(chip<0 || lines<1 || lines>RC_GPIO_GROUP_MAX_LINES || writes<1){
+		__print_usage();
+		return -1;
+	}
+
+	for(i=0;i<lines;i++) pins[i] = i;
+	if(rc_gpio_group_init(&group, chip, pins, lines, GPIOHANDLE_REQUEST_OUTPUT)){
+		fprintf(stderr,"ERROR: failed to request lines of gpiochip%d\n", chip);
+		return -1;
+	}
+
+	// walking one, every pattern must read back exactly
+	for(i=0;i<lines;i++){
+		for(j=0;j<lines;j++) set[j] = (i==j);
+		if(rc_gpio_group_set_values(&group, set) || rc_gpio_group_get_values(&group, got)){
+			fails++;
+			continue;
+		}
+		for(j=0;j<lines;j++){
+			if(got[j]!=set[j]){
+				printf("FAIL: pattern %d line %d read %d expected %d\n", i, j, got[j], set[j]);
+				fails++;
+			}
+		}
+	}
+
+	start = rc_nanos_since_boot();
+	for(i=0;i<writes;i++){
+		for(j=0;j<lines;j++) set[j] = i&1;
+		rc_gpio_group_set_values(&group, set);
+	}
+	group_ns = (double)(rc_nanos_since_boot()-start)/writes;
+	rc_gpio_group_cleanup(&group);
+
+	// same lines through one handle each for comparison
+	for(i=0;i<lines;i++){
+		if(rc_gpio_init(chip, pins[i], GPIOHANDLE_REQUEST_OUTPUT)){
+			fprintf(stderr,"ERROR: failed to request line %d\n", pins[i]);
+			return -1;
+		}
+	}
+	start = rc_nanos_since_boot();
+	for(i=0;i<writes;i++){
+		for(j=0;j<lines;j++) rc_gpio_set_value(chip, pins[j], i&1);
+	}
+	single_ns = (double)(rc_nanos_since_boot()-start)/writes;
+	for(i=0;i<lines;i++) rc_gpio_cleanup(chip, pins[i]);
+
+	printf("%d lines, group write: %8.1f ns   one by one: %8.1f ns\n",
+		lines, group_ns, single_ns);
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
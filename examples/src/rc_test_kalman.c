@@ -13,24 +13,55 @@
  * -                  [ 0 ]
  *
  *
+ * With -t it doesn't run the live demo and instead times the update step.
+ * The allocating update the library used to have is kept here as a reference
+ * and timed against rc_kalman_update_lin with the full and the sequential
+ * measurement update. All three must agree. -m adds redundant position
+ * sensors so there is more than one measurement to process.
+ *
+ * @verbatim
+ Usage:
+	-t               Time the update step instead of running the demo
+	-n <steps>       Number of steps to time, default 100000
+	-m <sensors>     Number of position sensors, default 1
+	-s               Use the sequential measurement update in the demo
+	-h               Print this help message
+ * @endverbatim
+ *
  * @author     James Strawson
  * @date       4/26/2018
  */
 
 
 #include <stdio.h>
+#include <stdlib.h> // for atoi
+#include <stdint.h>
+#include <math.h>   // for fabs
 #include <signal.h>
+#include <unistd.h> // for getopt
+#include <rc/math/algebra.h>
 #include <rc/math/kalman.h>
+#include <rc/math/workspace.h>
 #include <rc/time.h>
 
 #define Nx 2
-#define Ny 1
 #define Nu 1
 #define DT 0.05
 #define REVERSE_TIME 2.0
 
 static int running = 1;
 
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-t               Time the update step instead of running the demo\n");
+	printf("-n <steps>       Number of steps to time, default 100000\n");
+	printf("-m <sensors>     Number of position sensors, default 1\n");
+	printf("-s               Use the sequential measurement update in the demo\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
 // interrupt handler to catch ctrl-c
 static void __signal_handler(__attribute__ ((unused)) int dummy)
 {
@@ -38,10 +69,116 @@ static void __signal_handler(__attribute__ ((unused)) int dummy)
 	return;
 }
 
-int main()
+// the update as it was before the filter kept its own working memory, every
+// temporary is allocated and freed on each call and S is inverted
+static int __update_lin_alloc(rc_kalman_t* kf, rc_vector_t u, rc_vector_t y)
+{
+	rc_matrix_t L = RC_MATRIX_INITIALIZER;
+	rc_matrix_t newP = RC_MATRIX_INITIALIZER;
+	rc_matrix_t S = RC_MATRIX_INITIALIZER;
+	rc_matrix_t FT = RC_MATRIX_INITIALIZER;
+	rc_vector_t h = RC_VECTOR_INITIALIZER;
+	rc_vector_t z = RC_VECTOR_INITIALIZER;
+	rc_vector_t tmp1 = RC_VECTOR_INITIALIZER;
+	rc_vector_t tmp2 = RC_VECTOR_INITIALIZER;
+	int ret = 0;
+
+	// x_pre = F*x_est + G*u
+	ret |= rc_matrix_times_col_vec(kf->F, kf->x_est, &tmp1);
+	ret |= rc_matrix_times_col_vec(kf->G, u, &tmp2);
+	ret |= rc_vector_sum(tmp1, tmp2, &kf->x_pre);
+	// P = F*P*F^T + Q
+	ret |= rc_matrix_multiply(kf->F, kf->P, &newP);
+	ret |= rc_matrix_transpose(kf->F, &FT);
+	ret |= rc_matrix_right_multiply_inplace(&newP, FT);
+	ret |= rc_matrix_add_inplace(&newP, kf->Q);
+	ret |= rc_matrix_symmetrize(&newP);
+	// h = H*x_pre, S = H*P*H^T + R, L = P*H^T*S^-1
+	ret |= rc_matrix_times_col_vec(kf->H, kf->x_pre, &h);
+	ret |= rc_matrix_transpose(kf->H, &S);
+	ret |= rc_matrix_multiply(newP, S, &L);
+	ret |= rc_matrix_left_multiply_inplace(newP, &S);
+	ret |= rc_matrix_left_multiply_inplace(kf->H, &S);
+	ret |= rc_matrix_add_inplace(&S, kf->R);
+	ret |= rc_algebra_invert_matrix_inplace(&S);
+	ret |= rc_matrix_right_multiply_inplace(&L, S);
+	// x_est = x_pre + L*(y-h), P = P - L*H*P
+	ret |= rc_vector_subtract(y, h, &z);
+	ret |= rc_matrix_times_col_vec(L, z, &tmp1);
+	ret |= rc_vector_sum(kf->x_pre, tmp1, &kf->x_est);
+	ret |= rc_matrix_multiply(kf->H, newP, &S);
+	ret |= rc_matrix_left_multiply_inplace(L, &S);
+	ret |= rc_matrix_subtract_inplace(&newP, S);
+	ret |= rc_matrix_symmetrize(&newP);
+	ret |= rc_matrix_duplicate(newP, &kf->P);
+
+	rc_matrix_free(&L);
+	rc_matrix_free(&newP);
+	rc_matrix_free(&S);
+	rc_matrix_free(&FT);
+	rc_vector_free(&h);
+	rc_vector_free(&z);
+	rc_vector_free(&tmp1);
+	rc_vector_free(&tmp2);
+	kf->step++;
+	return ret;
+}
+
+// runs one filter through the given update, returns ns per step
+static double __time_update(const char* name, rc_kalman_t* kf, int steps,
+			int (*update)(rc_kalman_t*, rc_vector_t, rc_vector_t),
+			rc_vector_t u, rc_vector_t y)
+{
+	int i;
+	uint64_t start;
+	double ns;
+	unsigned long heap_calls;
+
+	// feed the same toggling input as the demo so the filters stay comparable
+	rc_workspace_heap_guard(RC_HEAP_GUARD_COUNT);
+	start = rc_nanos_since_boot();
+	for(i=0;i<steps;i++){
+		u.d[0] = ((i/40)%2) ? -1.0 : 1.0;
+		if(update(kf, u, y)){
+			fprintf(stderr, "ERROR: %s update failed\n", name);
+			break;
+		}
+	}
+	ns = (double)(rc_nanos_since_boot()-start)/steps;
+	heap_calls = rc_workspace_heap_count();
+	rc_workspace_heap_guard(RC_HEAP_GUARD_OFF);
+	printf("%-12s %9.1f ns/step %8.2f heap calls/step\n", name, ns,
+						(double)heap_calls/steps);
+	return ns;
+}
+
+static int __compare(const char* name, rc_kalman_t* a, rc_kalman_t* b)
+{
+	int i, j;
+	double err = 0.0;
+	for(i=0;i<Nx;i++){
+		err = fmax(err, fabs(a->x_est.d[i]-b->x_est.d[i]));
+		for(j=0;j<Nx;j++) err = fmax(err, fabs(a->P.d[i][j]-b->P.d[i][j]));
+	}
+	printf("%-12s max difference from allocating update %g\n", name, err);
+	if(err>1e-9){
+		printf("FAIL: %s does not match\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
 {
 	// declare variables
-	int counter;
+	int counter, opt, i;
+	int timing = 0;
+	int sequential = 0;
+	int steps = 100000;
+	int Ny = 1;
+	int fails = 0;
+	rc_kalman_t kf_alloc	= RC_KALMAN_INITIALIZER;
+	rc_kalman_t kf_seq	= RC_KALMAN_INITIALIZER;
 
 	rc_kalman_t kf	= RC_KALMAN_INITIALIZER;
 	rc_matrix_t F	= RC_MATRIX_INITIALIZER;
@@ -53,6 +190,37 @@ int main()
 	rc_vector_t u	= RC_VECTOR_INITIALIZER;
 	rc_vector_t y	= RC_VECTOR_INITIALIZER;
 
+	while((opt = getopt(argc, argv, "tn:m:sh")) != -1){
+		switch (opt) {
+		case 't':
+			timing = 1;
+			break;
+		case 'n':
+			steps = atoi(optarg);
+			if(steps<1){
+				fprintf(stderr,"ERROR: number of steps must be positive\n");
+				return -1;
+			}
+			break;
+		case 'm':
+			Ny = atoi(optarg);
+			if(Ny<1){
+				fprintf(stderr,"ERROR: number of sensors must be positive\n");
+				return -1;
+			}
+			break;
+		case 's':
+			sequential = 1;
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
 	// allocate appropriate memory for system
 	rc_matrix_zeros(&F, Nx, Nx);
 	rc_matrix_zeros(&G, Nx, Nu);
@@ -69,14 +237,17 @@ int main()
 	F.d[1][0] = 0;
 	F.d[1][1] = 1;
 	G.d[0][0] = 0.5*DT*DT;
-	G.d[0][1] = DT;
-	H.d[0][0] = 1;
-	H.d[0][1] = 0;
+	G.d[1][0] = DT;
+	// every sensor measures position
+	for(i=0;i<Ny;i++){
+		H.d[i][0] = 1;
+		H.d[i][1] = 0;
+	}
 
 	// covariance matrices
 	Q.d[0][0] = 0.1;
 	Q.d[1][1] = 0.0001;
-	R.d[0][0] = 1.0;
+	for(i=0;i<Ny;i++) R.d[i][i] = 1.0;
 
 	// initial P
 	Pi.d[0][0] = 0.0001;
@@ -85,9 +256,27 @@ int main()
 
 	if(rc_kalman_alloc_lin(&kf,F,G,H,Q,R,Pi)==-1) return -1;
 
+	if(timing){
+		if(rc_kalman_alloc_lin(&kf_alloc,F,G,H,Q,R,Pi)==-1) return -1;
+		if(rc_kalman_alloc_lin(&kf_seq,F,G,H,Q,R,Pi)==-1) return -1;
+		if(rc_kalman_set_sequential(&kf_seq, 1)==-1) return -1;
+		for(i=0;i<Ny;i++) y.d[i] = 0.5;
+		printf("timing %d steps with %d states and %d measurements\n", steps, Nx, Ny);
+		__time_update("allocating", &kf_alloc, steps, __update_lin_alloc, u, y);
+		__time_update("full", &kf, steps, rc_kalman_update_lin, u, y);
+		__time_update("sequential", &kf_seq, steps, rc_kalman_update_lin, u, y);
+		fails += __compare("full", &kf, &kf_alloc);
+		fails += __compare("sequential", &kf_seq, &kf_alloc);
+		rc_kalman_free(&kf_alloc);
+		rc_kalman_free(&kf_seq);
+	}
+	else if(sequential){
+		if(rc_kalman_set_sequential(&kf, 1)==-1) return -1;
+	}
+
 	// set signal handler so the loop can exit cleanly
 	signal(SIGINT, __signal_handler);
-	running = 1;
+	running = !timing;
 	counter = REVERSE_TIME/(DT*2.0);
 	u.d[0]=1.0;
 	while(running){
@@ -97,7 +286,7 @@ int main()
 			if(u.d[0]<1.0) u.d[0]=1.0;
 			else u.d[0]=-1.0;
 			// bump up y to see x_est track
-			y.d[0]+=0.5;
+			for(i=0;i<Ny;i++) y.d[i]+=0.5;
 		}
 
 		// update filter
@@ -111,7 +300,7 @@ int main()
 		counter++;
 		rc_usleep(DT*1000000);
 	}
-	printf("\n");
+	if(!timing) printf("\n");
 
 	rc_matrix_free(&F);
 	rc_matrix_free(&G);
@@ -122,5 +311,6 @@ int main()
 	rc_vector_free(&u);
 	rc_vector_free(&y);
 	rc_kalman_free(&kf);
+	if(fails) return -1;
 	return 0;
 }
@@ -0,0 +1,127 @@
+/**
+ * @file rc_test_periodic.c
+ * @example rc_test_periodic
+ * @brief measures wakeup jitter and overruns of the rc_periodic executor
+ *
+ * Runs a small dummy workload in an rc_periodic_t executor for a fixed time
+ * and prints the jitter histogram. Works on any Linux system so scheduling
+ * behavior can be checked off the robot.
+ *
+ * @verbatim
+ Usage:
+	-r <hz>          Base rate of the executor, default 200
+	-s <seconds>     How long to run, default 5
+	-w <us>          Busy-work per cycle in microseconds, default 100
+	-p <pri>         Run with SCHED_FIFO at this priority, default SCHED_OTHER
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi
+#include <unistd.h> // for getopt
+#include <signal.h>
+#include <rc/periodic.h>
+#include <rc/time.h>
+
+static int running = 1;
+static int work_us = 100;
+static int slow_ticks = 0;
+static int thread_ready = 0;
+static int early_ticks = 0;
+
+// busy-waits to stand in for a control law
+static void __fast_task(void)
+{
+	uint64_t end = rc_nanos_since_boot() + (uint64_t)work_us*1000;
+	while(rc_nanos_since_boot() < end);
+}
+
+static void __slow_task(void)
+{
+	if(!thread_ready) early_ticks++;
+	slow_ticks++;
+}
+
+// should run once in the executor thread before any task
+static void __thread_init(void)
+{
+	thread_ready = 1;
+}
+
+// interrupt handler to catch ctrl-c
+static void __signal_handler(__attribute__ ((unused)) int dummy)
+{
+	running=0;
+	return;
+}
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-r <hz>          Base rate of the executor, default 200\n");
+	printf("-s <seconds>     How long to run, default 5\n");
+	printf("-w <us>          Busy-work per cycle in microseconds, default 100\n");
+	printf("-p <pri>         Run with SCHED_FIFO at this priority\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	double rate = 200.0;
+	double seconds = 5.0;
+	int policy = SCHED_OTHER;
+	int priority = 0;
+	uint64_t start;
+	rc_periodic_t ex = RC_PERIODIC_INITIALIZER;
+
+	while((opt = getopt(argc, argv, "r:s:w:p:h")) != -1){
+		switch (opt) {
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 's':
+			seconds = atof(optarg);
+			break;
+		case 'w':
+			work_us = atoi(optarg);
+			break;
+		case 'p':
+			policy = SCHED_FIFO;
+			priority = atoi(optarg);
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	signal(SIGINT, __signal_handler);
+
+	if(rc_periodic_init(&ex, rate, policy, priority)) return -1;
+	if(rc_periodic_set_thread_init(&ex, __thread_init)) return -1;
+	if(rc_periodic_add_task(&ex, __fast_task, 1)) return -1;
+	if(rc_periodic_add_task(&ex, __slow_task, 10)) return -1;
+
+	printf("running at %.1fhz for %.1fs with %dus of work per cycle\n", rate, seconds, work_us);
+	if(rc_periodic_start(&ex)) return -1;
+
+	start = rc_nanos_since_boot();
+	while(running && rc_nanos_since_boot()-start < (uint64_t)(seconds*1e9)){
+		rc_usleep(100000);
+	}
+	rc_periodic_stop(&ex, 1.0);
+
+	rc_periodic_print_stats(&ex);
+	printf("slow task ran %d times\n", slow_ticks);
+	if(!thread_ready || early_ticks){
+		printf("FAIL: thread init didn't run before the first cycle\n");
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file rc_test_pwm_mmap.c
+ * @example rc_test_pwm_mmap
+ * @brief checks and times memory-mapped PWM duty cycle writes
+ *
+ * By default this needs no hardware. It creates a fake EHRPWM register file
+ * in /dev/shm with a 25kHz period programmed into subsystems 1 and 2, and the
+ * longest period the counter allows into subsystem 0, points rc_pwm_init_mmap
+ * at it and checks that rc_pwm_set_duty and rc_pwm_set_duty_ns land in the
+ * right compare registers. It then reports how long a duty cycle update takes.
+ *
+ * With -m the real PWM subsystem 1 is started at 25kHz and the update time of
+ * sysfs and mapped registers are compared. Needs root and drives the motor
+ * outputs of channels 1 and 2 at 0 duty.
+ *
+ * @verbatim
+ Usage:
+	-m               Use the real PWM hardware instead of a fake register file
+	-n <writes>      Number of writes to time, default 100000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi
+#include <stdint.h>
+#include <unistd.h> // for getopt, ftruncate
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <rc/pwm.h>
+#include <rc/time.h>
+
+#define FAKE_FILE	"/dev/shm/rc_test_pwm_regs"
+#define REG(ss,off)	(((ss)*0x2000 + 0x200 + (off))/2)
+#define TBPRD		0x0A
+#define CMPA		0x12
+#define CMPB		0x14
+#define PERIOD_COUNTS	4000	// 25kHz with the 100MHz time-base clock
+#define FULL_PERIOD_NS	655360	// 65536 counts, TBPRD at 0xFFFF
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-m               Use the real PWM hardware instead of a fake register file\n");
+	printf("-n <writes>      Number of writes to time, default 100000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+// average time of one rc_pwm_set_duty call on subsystem 1 in ns
+static double __time_writes(int n)
+{
+	uint64_t start;
+	int i;
+	start = rc_nanos_since_boot();
+	for(i=0;i<n;i++) rc_pwm_set_duty(1, (i&1)?'B':'A', 0.0);
+	return (double)(rc_nanos_since_boot()-start)/n;
+}
+
+static int __expect(volatile uint16_t* regs, int ss, int off, unsigned int val)
+{
+	if(regs[REG(ss,off)]==val) return 0;
+	printf("FAIL: subsystem %d register 0x%02x is %d expected %d\n", ss, off,
+		regs[REG(ss,off)], val);
+	return 1;
+}
+
+static int __check_fake(volatile uint16_t* regs)
+{
+	int ss, fails = 0;
+	for(ss=1;ss<3;ss++){
+		rc_pwm_set_duty(ss, 'A', 0.25);
+		rc_pwm_set_duty(ss, 'B', 1.0);
+		fails += __expect(regs, ss, CMPA, PERIOD_COUNTS/4);
+		fails += __expect(regs, ss, CMPB, PERIOD_COUNTS);
+		rc_pwm_set_duty_ns(ss, 'A', 10000);	// a quarter of 40us
+		rc_pwm_set_duty_ns(ss, 'B', 0);
+		fails += __expect(regs, ss, CMPA, PERIOD_COUNTS/4);
+		fails += __expect(regs, ss, CMPB, 0);
+	}
+	// with TBPRD at 0xFFFF a full period is 65536 counts, which must saturate
+	// instead of wrapping to 0
+	rc_pwm_set_duty(0, 'A', 1.0);
+	rc_pwm_set_duty(0, 'B', 0.5);
+	fails += __expect(regs, 0, CMPA, 0xFFFF);
+	fails += __expect(regs, 0, CMPB, 0x8000);
+	rc_pwm_set_duty_ns(0, 'B', FULL_PERIOD_NS);
+	fails += __expect(regs, 0, CMPB, 0xFFFF);
+	// out of range duty must be rejected and leave the register alone
+	if(rc_pwm_set_duty(1, 'A', 1.5)!=-1){
+		printf("FAIL: duty 1.5 accepted\n");
+		fails++;
+	}
+	fails += __expect(regs, 1, CMPA, PERIOD_COUNTS/4);
+	// cleanup zeros the outputs
+	rc_pwm_set_duty(2, 'B', 0.5);
+	rc_pwm_cleanup(2);
+	fails += __expect(regs, 2, CMPB, 0);
+	return fails;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, fd, ss, fails;
+	int hardware = 0;
+	int n = 100000;
+	volatile uint16_t* regs;
+
+	while((opt = getopt(argc, argv, "mn:h")) != -1){
+		switch (opt) {
+		case 'm':
+			hardware = 1;
+			break;
+		case 'n':
+			n = atoi(optarg);
+			if(n<1){
+				fprintf(stderr,"ERROR: number of writes must be positive\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	if(hardware){
+		if(rc_pwm_init(1, 25000)){
+			fprintf(stderr,"ERROR: failed to run rc_pwm_init\n");
+			return -1;
+		}
+		printf("sysfs write: %8.1f ns\n", __time_writes(n));
+		if(rc_pwm_init_mmap(NULL, 0)){
+			fprintf(stderr,"ERROR: failed to run rc_pwm_init_mmap\n");
+			return -1;
+		}
+		printf("mmap write:  %8.1f ns\n", __time_writes(n));
+		rc_pwm_cleanup(1);
+		return 0;
+	}
+
+	// build a register file with a period in each subsystem
+	fd = open(FAKE_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if(fd==-1){
+		perror("ERROR: failed to create " FAKE_FILE);
+		return -1;
+	}
+	if(ftruncate(fd, RC_PWM_MMAP_LEN)){
+		perror("ERROR: failed to size " FAKE_FILE);
+		close(fd);
+		return -1;
+	}
+	regs = mmap(0, RC_PWM_MMAP_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(regs==MAP_FAILED){
+		perror("ERROR: failed to map " FAKE_FILE);
+		return -1;
+	}
+	for(ss=1;ss<3;ss++) regs[REG(ss,TBPRD)] = PERIOD_COUNTS-1;
+	regs[REG(0,TBPRD)] = 0xFFFF;
+
+	if(rc_pwm_init_mmap(FAKE_FILE, 0)){
+		fprintf(stderr,"ERROR: failed to run rc_pwm_init_mmap\n");
+		return -1;
+	}
+	fails = __check_fake(regs);
+	printf("mmap write:  %8.1f ns\n", __time_writes(n));
+
+	rc_pwm_cleanup(0);
+	rc_pwm_cleanup(1);
+	munmap((void*)regs, RC_PWM_MMAP_LEN);
+	unlink(FAKE_FILE);
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file rc_test_ring_buffer.c
+ * @example rc_test_ring_buffer
+ * @brief checks the ring buffer against a plain array of the same history
+ *
+ * Buffers of sizes that are and aren't powers of two are fed random values
+ * around a large offset, which is where a running variance loses precision
+ * first. After every insert each position, the window pointer and the running
+ * mean and standard deviation must agree with values worked out directly from
+ * a copy of the history. Finally the constant time rc_ringbuf_std_dev is timed
+ * against the two pass calculation it replaced.
+ *
+ * @verbatim
+ Usage:
+	-n <inserts>     Number of inserts per buffer, default 20000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi, rand, calloc
+#include <stdint.h>
+#include <math.h>   // for fabs, sqrt
+#include <unistd.h> // for getopt
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define OFFSET		1000.0
+#define TIME_SIZE	1000
+#define TIME_CALLS	10000
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-n <inserts>     Number of inserts per buffer, default 20000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+// two pass standard deviation, as rc_ringbuf_std_dev used to do it
+static double __std_dev(const double* v, int n, double* mean_out)
+{
+	int i;
+	double mean = 0.0, sqr = 0.0;
+	for(i=0;i<n;i++) mean += v[i];
+	mean /= n;
+	for(i=0;i<n;i++) sqr += (v[i]-mean)*(v[i]-mean);
+	if(mean_out!=NULL) *mean_out = mean;
+	return sqrt(sqr/(n-1));
+}
+
+// returns the number of failed checks for one buffer size
+static int __check(int size, int inserts)
+{
+	int i, j, bad = 0;
+	double val, mean, std, mean_err = 0.0, std_err = 0.0;
+	const double* w;
+	double* hist = (double*)calloc(size, sizeof(double)); // oldest first
+	rc_ringbuf_t buf = RC_RINGBUF_INITIALIZER;
+
+	if(hist==NULL || rc_ringbuf_alloc(&buf, size)){
+		fprintf(stderr,"ERROR: failed to allocate\n");
+		free(hist);
+		return 1;
+	}
+	for(i=0;i<inserts;i++){
+		val = OFFSET + rand()/(double)RAND_MAX;
+		rc_ringbuf_insert(&buf, val);
+		for(j=0;j<size-1;j++) hist[j] = hist[j+1];
+		hist[size-1] = val;
+
+		w = rc_ringbuf_get_window(&buf, size);
+		for(j=0;j<size;j++){
+			if(fabs(rc_ringbuf_get_value(&buf, j)-hist[size-1-j])>0.0 ||
+			   fabs(w[j]-hist[j])>0.0){
+				if(!bad) printf("FAIL: size %d, value %d wrong after %d inserts\n",
+									size, j, i+1);
+				bad = 1;
+			}
+		}
+		std = __std_dev(hist, size, &mean);
+		if(fabs(rc_ringbuf_mean(buf)-mean)>mean_err) mean_err = fabs(rc_ringbuf_mean(buf)-mean);
+		if(fabs(rc_ringbuf_std_dev(buf)-std)>std_err) std_err = fabs(rc_ringbuf_std_dev(buf)-std);
+	}
+	printf("size %4d capacity %4d  max mean error %.2e  max std dev error %.2e\n",
+					size, buf.capacity, mean_err, std_err);
+	if(mean_err>1e-9 || std_err>1e-6){
+		printf("FAIL: size %d, running statistics drifted\n", size);
+		bad = 1;
+	}
+	rc_ringbuf_free(&buf);
+	free(hist);
+	return bad;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, i, fails = 0;
+	int inserts = 20000;
+	const int sizes[] = {2, 3, 5, 8, 100, 256};
+	uint64_t start;
+	double sink = 0.0, two_pass_ns, running_ns;
+	rc_ringbuf_t buf = RC_RINGBUF_INITIALIZER;
+
+	while((opt = getopt(argc, argv, "n:h")) != -1){
+		switch (opt) {
+		case 'n':
+			inserts = atoi(optarg);
+			if(inserts<1){
+				fprintf(stderr,"ERROR: number of inserts must be positive\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	for(i=0;i<(int)(sizeof(sizes)/sizeof(sizes[0]));i++){
+		fails += __check(sizes[i], inserts);
+	}
+
+	// time the standard deviation of a full buffer both ways
+	rc_ringbuf_alloc(&buf, TIME_SIZE);
+	for(i=0;i<TIME_SIZE;i++) rc_ringbuf_insert(&buf, rand()/(double)RAND_MAX);
+	start = rc_nanos_since_boot();
+	for(i=0;i<TIME_CALLS;i++) sink += __std_dev(rc_ringbuf_get_window(&buf, TIME_SIZE), TIME_SIZE, NULL);
+	two_pass_ns = (double)(rc_nanos_since_boot()-start)/TIME_CALLS;
+	start = rc_nanos_since_boot();
+	for(i=0;i<TIME_CALLS;i++) sink += rc_ringbuf_std_dev(buf);
+	running_ns = (double)(rc_nanos_since_boot()-start)/TIME_CALLS;
+	printf("std dev of %d values, two pass: %.1f ns  running: %.1f ns  (%g)\n",
+					TIME_SIZE, two_pass_ns, running_ns, sink);
+	rc_ringbuf_free(&buf);
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,320 @@
+/**
+ * @file rc_test_single_precision.c
+ * @example rc_test_single_precision
+ * @brief checks the float math functions against the double ones and times
+ * both
+ *
+ * Random vectors and matrices are converted to float and run through the
+ * float dot product, norm, matrix multiply, matrix times vector, determinant
+ * and 3x3 and 6x6 inverses. Each result must match the double version to
+ * within float rounding. A Butterworth lowpass and a PID controller designed
+ * in double and converted with rc_filterf_from_filter must track the double
+ * filter marching the same input. The PID gets a looser tolerance since its
+ * integral gain is the small difference of much larger coefficients.
+ *
+ * Then the time per call of filter march, dot product and matrix multiply is
+ * printed in both precisions.
+ *
+ * @verbatim
+ Usage:
+	-n <loops>       Number of loops to time, default 100000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi, rand
+#include <math.h>   // for fabs
+#include <unistd.h> // for getopt
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define DT		0.001
+#define LEN		256
+#define DIM		32
+#define CHECK_STEPS	4000
+// float has 24 bits of mantissa, allow some rounding on top of that
+#define TOL		1e-5
+
+static int loops = 100000;
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-n <loops>       Number of loops to time, default 100000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+static double __rand_input(void)
+{
+	return 2.0*rand()/(double)RAND_MAX - 1.0;
+}
+
+// relative error check, returns 1 and prints on failure
+static int __check_tol(const char* name, double expect, double got, double scale, double tol)
+{
+	double err = fabs(expect-got)/(scale>1.0?scale:1.0);
+	printf("%-28s double % .7e float % .7e rel err %.1e\n", name, expect, got, err);
+	if(err>tol){
+		printf("FAIL: %s\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+static int __check(const char* name, double expect, double got, double scale)
+{
+	return __check_tol(name, expect, got, scale, TOL);
+}
+
+static double __max_diff(rc_matrix_t A, rc_matrixf_t B)
+{
+	int i, j;
+	double d, max = 0.0;
+	for(i=0;i<A.rows;i++){
+		for(j=0;j<A.cols;j++){
+			d = fabs(A.d[i][j]-(double)B.d[i][j]);
+			if(d>max) max = d;
+		}
+	}
+	return max;
+}
+
+static int __algebra_checks(void)
+{
+	int i, fails = 0;
+	double err, scale;
+	rc_vector_t a = RC_VECTOR_INITIALIZER;
+	rc_vector_t b = RC_VECTOR_INITIALIZER;
+	rc_vector_t c = RC_VECTOR_INITIALIZER;
+	rc_vectorf_t af = RC_VECTORF_INITIALIZER;
+	rc_vectorf_t bf = RC_VECTORF_INITIALIZER;
+	rc_vectorf_t cf = RC_VECTORF_INITIALIZER;
+	rc_matrix_t A = RC_MATRIX_INITIALIZER;
+	rc_matrix_t B = RC_MATRIX_INITIALIZER;
+	rc_matrix_t C = RC_MATRIX_INITIALIZER;
+	rc_matrixf_t Af = RC_MATRIXF_INITIALIZER;
+	rc_matrixf_t Bf = RC_MATRIXF_INITIALIZER;
+	rc_matrixf_t Cf = RC_MATRIXF_INITIALIZER;
+	rc_mat3_t M3, I3;
+	rc_mat3f_t M3f, I3f;
+	rc_mat6_t M6, I6;
+	rc_mat6f_t M6f, I6f;
+
+	rc_vector_random(&a, LEN);
+	rc_vector_random(&b, LEN);
+	rc_vectorf_from_vector(&af, a);
+	rc_vectorf_from_vector(&bf, b);
+	fails += __check("dot product", rc_vector_dot_product(a,b),
+			(double)rc_vectorf_dot_product(af,bf), sqrt((double)LEN));
+	fails += __check("2-norm", rc_vector_norm(a,2.0),
+			(double)rc_vectorf_norm(af,2.0f), 1.0);
+	fails += __check("std dev", rc_vector_std_dev(a),
+			(double)rc_vectorf_std_dev(af), 1.0);
+
+	rc_matrix_random(&A, DIM, DIM);
+	rc_matrix_random(&B, DIM, DIM);
+	rc_matrixf_from_matrix(&Af, A);
+	rc_matrixf_from_matrix(&Bf, B);
+	rc_matrix_multiply(A, B, &C);
+	rc_matrixf_multiply(Af, Bf, &Cf);
+	fails += __check("multiply max error", 0.0, __max_diff(C,Cf), sqrt((double)DIM));
+	// the result may overwrite an input
+	rc_matrixf_multiply(Af, Bf, &Bf);
+	fails += __check("multiply into B max error", 0.0, __max_diff(C,Bf), sqrt((double)DIM));
+	rc_vector_random(&a, DIM);
+	rc_vectorf_from_vector(&af, a);
+	rc_matrix_times_col_vec(A, a, &c);
+	rc_matrixf_times_col_vec(Af, af, &cf);
+	err = 0.0;
+	for(i=0;i<DIM;i++) if(fabs(c.d[i]-(double)cf.d[i])>err) err = fabs(c.d[i]-(double)cf.d[i]);
+	fails += __check("times col vec max error", 0.0, err, sqrt((double)DIM));
+
+	// ragged edges and more than one packed panel each way
+	rc_matrix_free(&A);
+	rc_matrix_free(&B);
+	rc_matrix_random(&A, 19, 150);
+	rc_matrix_random(&B, 150, 70);
+	rc_matrixf_from_matrix(&Af, A);
+	rc_matrixf_from_matrix(&Bf, B);
+	rc_matrix_multiply(A, B, &C);
+	rc_matrixf_multiply(Af, Bf, &Cf);
+	fails += __check("19x150x70 multiply max error", 0.0, __max_diff(C,Cf), sqrt(150.0));
+
+	// keep the determinant small enough to compare with a relative tolerance
+	rc_matrix_free(&A);
+	rc_matrix_random(&A, 6, 6);
+	for(i=0;i<6;i++) A.d[i][i] += 4.0;
+	rc_matrixf_from_matrix(&Af, A);
+	scale = rc_matrix_determinant(A);
+	fails += __check("determinant", scale, (double)rc_matrixf_determinant(Af), fabs(scale));
+
+	rc_mat6_from_matrix(&M6, A);
+	rc_mat6f_from_matrix(&M6f, Af);
+	rc_mat6_invert(&M6, &I6);
+	rc_mat6f_invert(&M6f, &I6f);
+	rc_mat6_to_matrix(&I6, &C);
+	rc_mat6f_to_matrix(&I6f, &Cf);
+	fails += __check("mat6 invert max error", 0.0, __max_diff(C,Cf), 1.0);
+
+	rc_matrix_free(&A);
+	rc_matrix_random(&A, 3, 3);
+	for(i=0;i<3;i++) A.d[i][i] += 2.0;
+	rc_matrixf_from_matrix(&Af, A);
+	rc_mat3_from_matrix(&M3, A);
+	rc_mat3f_from_matrix(&M3f, Af);
+	rc_mat3_invert(&M3, &I3);
+	rc_mat3f_invert(&M3f, &I3f);
+	rc_mat3_to_matrix(&I3, &C);
+	rc_mat3f_to_matrix(&I3f, &Cf);
+	fails += __check("mat3 invert max error", 0.0, __max_diff(C,Cf), 1.0);
+
+	rc_vector_free(&a);
+	rc_vector_free(&b);
+	rc_vector_free(&c);
+	rc_vectorf_free(&af);
+	rc_vectorf_free(&bf);
+	rc_vectorf_free(&cf);
+	rc_matrix_free(&A);
+	rc_matrix_free(&B);
+	rc_matrix_free(&C);
+	rc_matrixf_free(&Af);
+	rc_matrixf_free(&Bf);
+	rc_matrixf_free(&Cf);
+	return fails;
+}
+
+// marches both with the same input, returns 1 if they drift apart
+static int __filter_check(const char* name, rc_filter_t* f, double tol)
+{
+	int i;
+	double x, a, b, err = 0.0, peak = 0.0;
+	rc_filterf_t ff = RC_FILTERF_INITIALIZER;
+
+	if(rc_filterf_from_filter(&ff, *f)){
+		printf("FAIL: %s conversion\n", name);
+		return 1;
+	}
+	for(i=0;i<CHECK_STEPS;i++){
+		x = __rand_input();
+		a = rc_filter_march(f, x);
+		b = (double)rc_filterf_march(&ff, (float)x);
+		if(fabs(a-b)>err) err = fabs(a-b);
+		if(fabs(a)>peak) peak = fabs(a);
+	}
+	rc_filterf_free(&ff);
+	return __check_tol(name, peak, peak+err, peak, tol);
+}
+
+static int __filter_checks(void)
+{
+	int fails = 0;
+	rc_filter_t f = RC_FILTER_INITIALIZER;
+
+	// same inputs however many random numbers the algebra checks used
+	srand(1);
+	rc_filter_butterworth_lowpass(&f, 2, DT, 2.0*M_PI*20.0);
+	fails += __filter_check("butterworth max error", &f, TOL);
+	// the PID numerator coefficients nearly cancel to leave ki*dt, rounding
+	// them to float moves the integral gain by a few parts in 10^4 and the
+	// integrator lets that add up
+	rc_filter_pid(&f, 2.0, 0.5, 0.02, 10*DT, DT);
+	rc_filter_enable_saturation(&f, -3.0, 3.0);
+	fails += __filter_check("pid max error", &f, 1e-3);
+	rc_filter_free(&f);
+	return fails;
+}
+
+static void __timing(void)
+{
+	int i;
+	uint64_t start;
+	double x, y = 0.0, t, tf;
+	float yf = 0.0f;
+	rc_filter_t f = RC_FILTER_INITIALIZER;
+	rc_filterf_t ff = RC_FILTERF_INITIALIZER;
+	rc_vector_t a = RC_VECTOR_INITIALIZER;
+	rc_vectorf_t af = RC_VECTORF_INITIALIZER;
+	rc_matrix_t A = RC_MATRIX_INITIALIZER;
+	rc_matrix_t C = RC_MATRIX_INITIALIZER;
+	rc_matrixf_t Af = RC_MATRIXF_INITIALIZER;
+	rc_matrixf_t Cf = RC_MATRIXF_INITIALIZER;
+
+	rc_filter_butterworth_lowpass(&f, 4, DT, 2.0*M_PI*20.0);
+	rc_filterf_from_filter(&ff, f);
+	start = rc_nanos_since_boot();
+	for(i=0;i<loops;i++) y += rc_filter_march(&f, (i&1)?1.0:-1.0);
+	t = (rc_nanos_since_boot()-start)/(double)loops;
+	start = rc_nanos_since_boot();
+	for(i=0;i<loops;i++) yf += rc_filterf_march(&ff, (i&1)?1.0f:-1.0f);
+	tf = (rc_nanos_since_boot()-start)/(double)loops;
+	printf("4th order filter march       double %7.1fns  float %7.1fns\n", t, tf);
+
+	rc_vector_random(&a, LEN);
+	rc_vectorf_from_vector(&af, a);
+	start = rc_nanos_since_boot();
+	for(i=0;i<loops;i++) y += rc_vector_dot_product(a, a);
+	t = (rc_nanos_since_boot()-start)/(double)loops;
+	start = rc_nanos_since_boot();
+	for(i=0;i<loops;i++) yf += rc_vectorf_dot_product(af, af);
+	tf = (rc_nanos_since_boot()-start)/(double)loops;
+	printf("%d element dot product      double %7.1fns  float %7.1fns\n", LEN, t, tf);
+
+	rc_matrix_random(&A, DIM, DIM);
+	rc_matrixf_from_matrix(&Af, A);
+	start = rc_nanos_since_boot();
+	for(i=0;i<loops/100+1;i++) rc_matrix_multiply(A, A, &C);
+	t = (rc_nanos_since_boot()-start)/(double)(loops/100+1);
+	start = rc_nanos_since_boot();
+	for(i=0;i<loops/100+1;i++) rc_matrixf_multiply(Af, Af, &Cf);
+	tf = (rc_nanos_since_boot()-start)/(double)(loops/100+1);
+	printf("%dx%d matrix multiply        double %7.1fus  float %7.1fus\n",
+			DIM, DIM, t/1e3, tf/1e3);
+	// keep the loops from being optimized away
+	x = y + (double)yf + C.d[0][0] + (double)Cf.d[0][0];
+	if(isnan(x)) printf("\n");
+
+	rc_filter_free(&f);
+	rc_filterf_free(&ff);
+	rc_vector_free(&a);
+	rc_vectorf_free(&af);
+	rc_matrix_free(&A);
+	rc_matrix_free(&C);
+	rc_matrixf_free(&Af);
+	rc_matrixf_free(&Cf);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, fails = 0;
+
+	while((opt = getopt(argc, argv, "n:h")) != -1){
+		switch (opt) {
+		case 'n':
+			loops = atoi(optarg);
+			if(loops<1){
+				fprintf(stderr,"ERROR: number of loops must be positive\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	fails += __algebra_checks();
+	fails += __filter_checks();
+	__timing();
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
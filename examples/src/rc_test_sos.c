@@ -0,0 +1,190 @@
+/**
+ * @file rc_test_sos.c
+ * @example rc_test_sos
+ * @brief checks second order section filters against rc_filter_t
+ *
+ * Butterworth filters designed directly as sections and filters converted
+ * from rc_filter_t, including one with complex zeros and one with more poles
+ * than zeros, must give the same output as the rc_filter_t they replace.
+ * Block processing must match marching one sample at a time and a prefilled
+ * lowpass must start at its input. An 8th order lowpass at 1Hz sampled at
+ * 1kHz shows the difference in stability, then the time per sample of each
+ * way of filtering is printed.
+ *
+ * @verbatim
+ Usage:
+	-n <samples>     Number of samples to time, default 100000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi, rand
+#include <stdint.h>
+#include <math.h>   // for fabs
+#include <unistd.h> // for getopt
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define DT		0.001
+#define CHECK_STEPS	4000
+#define BLOCK		64
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-n <samples>     Number of samples to time, default 100000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+static double __rand_input(void)
+{
+	return 2.0*rand()/(double)RAND_MAX - 1.0;
+}
+
+// feeds both the same random input, returns 1 if they ever differ
+static int __compare(const char* name, rc_filter_t* f, rc_sos_t* s)
+{
+	int i;
+	double x, a, b, err = 0.0, peak = 0.0;
+
+	for(i=0;i<CHECK_STEPS;i++){
+		x = __rand_input();
+		a = rc_filter_march(f, x);
+		b = rc_sos_march(s, x);
+		if(fabs(a-b)>err) err = fabs(a-b);
+		if(fabs(a)>peak) peak = fabs(a);
+	}
+	printf("%-28s %d sections, max error %.2e of peak %.3f\n", name, s->sections, err, peak);
+	if(err>1e-6*(1.0+peak)){
+		printf("FAIL: %s differs from rc_filter_t\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, i, j, fails = 0;
+	int samples = 100000;
+	uint64_t start;
+	double x, y, err, single_ns, march_ns, block_ns;
+	double in[BLOCK], out[BLOCK];
+	// (z^2 - 1.2z + 0.85)/(z^2 - 1.5z + 0.7) scaled, complex zeros and poles
+	double lead_num[] = {0.5, -0.6, 0.425};
+	double lead_den[] = {2.0, -3.0, 1.4};
+	rc_filter_t f = RC_FILTER_INITIALIZER;
+	rc_sos_t s = RC_SOS_INITIALIZER;
+	rc_sos_t s2 = RC_SOS_INITIALIZER;
+
+	while((opt = getopt(argc, argv, "n:h")) != -1){
+		switch (opt) {
+		case 'n':
+			samples = atoi(optarg);
+			if(samples<BLOCK){
+				fprintf(stderr,"ERROR: number of samples must be at least %d\n", BLOCK);
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	// direct designs
+	rc_filter_butterworth_lowpass(&f, 4, DT, 2.0*M_PI*20.0);
+	rc_sos_butterworth_lowpass(&s, 4, DT, 2.0*M_PI*20.0);
+	fails += __compare("butterworth lowpass 4", &f, &s);
+	// rc_filter_t's highpass has a passband gain of wc^order
+	rc_filter_butterworth_highpass(&f, 3, DT, 2.0*M_PI*50.0);
+	f.gain = pow(2.0*M_PI*50.0, -3.0);
+	rc_sos_butterworth_highpass(&s, 3, DT, 2.0*M_PI*50.0);
+	fails += __compare("butterworth highpass 3", &f, &s);
+
+	// conversions
+	rc_filter_butterworth_lowpass(&f, 5, DT, 2.0*M_PI*30.0);
+	rc_sos_from_filter(&s, f);
+	fails += __compare("converted lowpass 5", &f, &s);
+	rc_filter_pid(&f, 2.0, 1.0, 0.01, 4*DT, DT);
+	rc_sos_from_filter(&s, f);
+	fails += __compare("converted pid", &f, &s);
+	rc_filter_alloc_from_arrays(&f, DT, lead_num, 3, lead_den, 3);
+	f.gain = 1.5;
+	rc_sos_from_filter(&s, f);
+	fails += __compare("converted complex zeros", &f, &s);
+	rc_filter_double_integrator(&f, DT);
+	rc_sos_from_filter(&s, f);
+	fails += __compare("converted double integrator", &f, &s);
+
+	// block processing against single steps
+	rc_sos_butterworth_lowpass(&s, 6, DT, 2.0*M_PI*40.0);
+	rc_sos_butterworth_lowpass(&s2, 6, DT, 2.0*M_PI*40.0);
+	err = 0.0;
+	for(i=0;i<CHECK_STEPS/BLOCK;i++){
+		for(j=0;j<BLOCK;j++) in[j] = __rand_input();
+		rc_sos_process(&s2, in, out, BLOCK);
+		for(j=0;j<BLOCK;j++){
+			y = rc_sos_march(&s, in[j]);
+			if(fabs(y-out[j])>err) err = fabs(y-out[j]);
+		}
+	}
+	printf("block against single steps, max error %.2e\n", err);
+	if(err>1e-12){
+		printf("FAIL: block processing differs\n");
+		fails++;
+	}
+
+	// prefill puts the lowpass straight into steady state
+	rc_sos_prefill(&s, 9.81);
+	y = rc_sos_march(&s, 9.81);
+	printf("prefilled with 9.81, first output %.12f\n", y);
+	if(fabs(y-9.81)>1e-9){
+		printf("FAIL: prefilled output not at steady state\n");
+		fails++;
+	}
+
+	// low cutoff and high order, the step response should settle at 1
+	rc_filter_butterworth_lowpass(&f, 8, DT, 2.0*M_PI*1.0);
+	rc_sos_butterworth_lowpass(&s, 8, DT, 2.0*M_PI*1.0);
+	for(i=0;i<20000;i++){
+		x = rc_filter_march(&f, 1.0);
+		y = rc_sos_march(&s, 1.0);
+	}
+	printf("8th order 1Hz lowpass step after 20s, rc_filter_t: %g  sections: %.9f\n", x, y);
+	if(fabs(y-1.0)>1e-6){
+		printf("FAIL: sections did not settle at 1\n");
+		fails++;
+	}
+
+	// time a sample each way with a 6th order lowpass
+	rc_filter_butterworth_lowpass(&f, 6, DT, 2.0*M_PI*40.0);
+	rc_sos_butterworth_lowpass(&s, 6, DT, 2.0*M_PI*40.0);
+	for(j=0;j<BLOCK;j++) in[j] = 0.01*j;
+	start = rc_nanos_since_boot();
+	for(i=0;i<samples;i++) rc_filter_march(&f, in[i%BLOCK]);
+	single_ns = (double)(rc_nanos_since_boot()-start)/samples;
+	start = rc_nanos_since_boot();
+	for(i=0;i<samples;i++) rc_sos_march(&s, in[i%BLOCK]);
+	march_ns = (double)(rc_nanos_since_boot()-start)/samples;
+	start = rc_nanos_since_boot();
+	for(i=0;i<samples/BLOCK;i++) rc_sos_process(&s, in, out, BLOCK);
+	block_ns = (double)(rc_nanos_since_boot()-start)/(samples/BLOCK*BLOCK);
+	printf("ns per sample, rc_filter_march: %.1f  rc_sos_march: %.1f  rc_sos_process: %.1f\n",
+						single_ns, march_ns, block_ns);
+
+	rc_filter_free(&f);
+	rc_sos_free(&s);
+	rc_sos_free(&s2);
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
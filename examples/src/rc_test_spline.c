@@ -0,0 +1,329 @@
+/**
+ * @file rc_test_spline.c
+ * @example rc_test_spline
+ * @brief checks cubic and quintic splines and the banded solvers under them
+ *
+ * The tridiagonal and banded solvers must agree with
+ * rc_algebra_lin_system_solve, the banded one on a matrix that needs
+ * pivoting. Splines fitted through random waypoints at uneven times, with
+ * each end condition, must pass through every waypoint, be continuous up to
+ * their order minus one across every knot and meet their end condition.
+ * Natural splines must reproduce a straight line exactly, time scaling must
+ * only change the speed and batch evaluation must match single evaluation.
+ * The tridiagonal solver must take its scratch row from an active
+ * rc_workspace_t and a cubic fit inside one must not touch the heap. Then the
+ * time to fit a long path and to evaluate one sample is printed.
+ *
+ * @verbatim
+ Usage:
+	-n <knots>       Number of knots to time fitting with, default 2000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi, rand
+#include <stdint.h>
+#include <math.h>   // for fabs
+#include <unistd.h> // for getopt
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define KNOTS		12
+#define DIM		3
+#define TOL		1e-8
+#define EVAL_SAMPLES	100000
+#define WS_BYTES	(16*1024)
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-n <knots>       Number of knots to time fitting with, default 2000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+static double __rand(void)
+{
+	return 2.0*rand()/(double)RAND_MAX - 1.0;
+}
+
+// uneven knot times and random waypoints
+static void __random_path(rc_vector_t* t, rc_matrix_t* p, int n, int dim)
+{
+	int i,k;
+	rc_vector_alloc(t,n);
+	rc_matrix_alloc(p,n,dim);
+	t->d[0] = 0.0;
+	for(i=1;i<n;i++) t->d[i] = t->d[i-1] + 0.2 + 0.8*rand()/(double)RAND_MAX;
+	for(i=0;i<n;i++) for(k=0;k<dim;k++) p->d[i][k] = __rand();
+}
+
+// m'th derivative of one segment's polynomial at tau
+static double __deriv(const double* c, int order, int m, double tau)
+{
+	int j,q;
+	double f, x = 0.0;
+	for(j=order;j>=m;j--){
+		// d^m/dtau^m of tau^j is j!/(j-m)! tau^(j-m)
+		for(f=1.0,q=j;q>j-m;q--) f *= q;
+		x = x*tau + f*c[j];
+	}
+	return x;
+}
+
+// checks interpolation, continuity and end conditions, returns 1 on failure
+static int __check(const char* name, rc_spline_t* s, rc_vector_t t, rc_matrix_t p, rc_spline_end_t end)
+{
+	int i,k,m,fails = 0;
+	double h,l,r,scale,err_p = 0.0,err_c = 0.0,err_e = 0.0;
+	double pos[DIM];
+	const double *cl,*cr;
+
+	// through every waypoint
+	for(i=0;i<s->knots;i++){
+		rc_spline_eval(s,t.d[i],pos,NULL,NULL);
+		for(k=0;k<s->dim;k++) err_p = fmax(err_p,fabs(pos[k]-p.d[i][k]));
+	}
+	// derivatives 0 to order-1 match across each interior knot, relative to
+	// their size since higher derivatives get large
+	for(i=0;i<s->knots-2;i++){
+		h = t.d[i+1]-t.d[i];
+		for(k=0;k<s->dim;k++){
+			cl = s->c.d[i*s->dim+k];
+			cr = s->c.d[(i+1)*s->dim+k];
+			for(m=0;m<s->order;m++){
+				l = __deriv(cl,s->order,m,h);
+				r = __deriv(cr,s->order,m,0.0);
+				scale = 1.0+fabs(l)+fabs(r);
+				err_c = fmax(err_c,fabs(l-r)/scale);
+			}
+		}
+	}
+	// end conditions, REST zeros the derivatives from 1, NATURAL from
+	// (order+1)/2, up to (order-1)/2 of them
+	h = t.d[s->knots-1]-t.d[s->knots-2];
+	for(k=0;k<s->dim;k++){
+		cl = s->c.d[k];
+		cr = s->c.d[(s->knots-2)*s->dim+k];
+		for(m=0;m<(s->order-1)/2;m++){
+			int d = (end==RC_SPLINE_REST) ? 1+m : (s->order+1)/2+m;
+			err_e = fmax(err_e,fabs(__deriv(cl,s->order,d,0.0)));
+			err_e = fmax(err_e,fabs(__deriv(cr,s->order,d,h))/(1.0+fabs(cr[s->order])));
+		}
+	}
+	printf("%-22s through knots %.1e  continuity %.1e  ends %.1e\n", name, err_p, err_c, err_e);
+	if(err_p>TOL || err_c>TOL || err_e>TOL){
+		printf("FAIL: %s\n", name);
+		fails = 1;
+	}
+	return fails;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, i, j, fails = 0;
+	int knots = 2000;
+	unsigned long heap_calls;
+	uint64_t start;
+	double err, x, fit3_us, fit5_us, eval_ns, v0[DIM], v1[DIM], p0[DIM], p1[DIM];
+	rc_vector_t t = RC_VECTOR_INITIALIZER;
+	rc_vector_t b = RC_VECTOR_INITIALIZER;
+	rc_vector_t x1 = RC_VECTOR_INITIALIZER;
+	rc_vector_t x2 = RC_VECTOR_INITIALIZER;
+	rc_vector_t sub = RC_VECTOR_INITIALIZER;
+	rc_vector_t diag = RC_VECTOR_INITIALIZER;
+	rc_vector_t sup = RC_VECTOR_INITIALIZER;
+	rc_matrix_t A = RC_MATRIX_INITIALIZER;
+	rc_matrix_t Ab = RC_MATRIX_INITIALIZER;
+	rc_matrix_t p = RC_MATRIX_INITIALIZER;
+	rc_matrix_t P = RC_MATRIX_INITIALIZER;
+	rc_matrix_t V = RC_MATRIX_INITIALIZER;
+	rc_spline_t s = RC_SPLINE_INITIALIZER;
+	rc_spline_t s_ws = RC_SPLINE_INITIALIZER;
+	rc_workspace_t ws = RC_WORKSPACE_INITIALIZER;
+	const char* names[4] = {"cubic natural", "cubic rest", "quintic natural", "quintic rest"};
+
+	while((opt = getopt(argc, argv, "n:h")) != -1){
+		switch (opt) {
+		case 'n':
+			knots = atoi(optarg);
+			if(knots<3){
+				fprintf(stderr,"ERROR: number of knots must be at least 3\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	// tridiagonal solve against the dense one
+	rc_vector_random(&sub,KNOTS-1);
+	rc_vector_random(&sup,KNOTS-1);
+	rc_vector_random(&diag,KNOTS);
+	rc_vector_random(&b,KNOTS);
+	rc_matrix_zeros(&A,KNOTS,KNOTS);
+	for(i=0;i<KNOTS;i++){
+		diag.d[i] += 3.0;
+		A.d[i][i] = diag.d[i];
+		if(i>0) A.d[i][i-1] = sub.d[i-1];
+		if(i<KNOTS-1) A.d[i][i+1] = sup.d[i];
+	}
+	rc_algebra_tridiag_solve(sub,diag,sup,b,&x1);
+	rc_algebra_lin_system_solve(A,b,&x2);
+	err = 0.0;
+	for(i=0;i<KNOTS;i++) err = fmax(err,fabs(x1.d[i]-x2.d[i]));
+	printf("tridiagonal solve      error %.1e\n", err);
+	if(err>TOL){
+		printf("FAIL: tridiagonal solve\n");
+		fails++;
+	}
+	// x1 already has the right size so the only memory taken is the scratch
+	if(rc_workspace_alloc(&ws,WS_BYTES)){
+		fprintf(stderr,"ERROR: failed to allocate workspace\n");
+		return -1;
+	}
+	rc_workspace_begin(&ws);
+	if(rc_algebra_tridiag_solve(sub,diag,sup,b,&x1)) fails++;
+	rc_workspace_end(&ws);
+	if(ws.high_water<KNOTS*sizeof(double)){
+		printf("FAIL: tridiagonal solve scratch not taken from the workspace\n");
+		fails++;
+	}
+
+	// banded solve with 2 sub and 3 super diagonals and a zero diagonal, so
+	// it has to pivot
+	rc_matrix_zeros(&A,KNOTS,KNOTS);
+	rc_matrix_zeros(&Ab,KNOTS,6);
+	for(i=0;i<KNOTS;i++){
+		for(j=i-2;j<=i+3;j++){
+			if(j<0 || j>=KNOTS || j==i) continue;
+			A.d[i][j] = Ab.d[i][j-i+2] = __rand();
+		}
+	}
+	rc_algebra_band_solve(Ab,2,3,b,&x1);
+	rc_algebra_lin_system_solve(A,b,&x2);
+	err = 0.0;
+	for(i=0;i<KNOTS;i++) err = fmax(err,fabs(x1.d[i]-x2.d[i]));
+	printf("banded solve           error %.1e\n", err);
+	if(err>1e3*TOL){
+		printf("FAIL: banded solve\n");
+		fails++;
+	}
+
+	// each kind of spline through a random path
+	__random_path(&t,&p,KNOTS,DIM);
+	for(i=0;i<4;i++){
+		rc_spline_end_t end = (i%2) ? RC_SPLINE_REST : RC_SPLINE_NATURAL;
+		if(i<2) rc_spline_cubic(&s,t,p,end);
+		else rc_spline_quintic(&s,t,p,end);
+		fails += __check(names[i],&s,t,p,end);
+	}
+
+	// natural splines reproduce a straight line
+	for(i=0;i<KNOTS;i++) for(j=0;j<DIM;j++) p.d[i][j] = (j+1)*t.d[i] - 0.5*j;
+	for(i=0;i<2;i++){
+		if(i==0) rc_spline_cubic(&s,t,p,RC_SPLINE_NATURAL);
+		else rc_spline_quintic(&s,t,p,RC_SPLINE_NATURAL);
+		err = 0.0;
+		for(j=0;j<200;j++){
+			x = t.d[KNOTS-1]*j/199.0;
+			rc_spline_eval(&s,x,p0,v0,NULL);
+			err = fmax(err,fabs(p0[2]-(3.0*x-1.0)) + fabs(v0[2]-3.0));
+		}
+		printf("%s line error %.1e\n", i ? "quintic" : "cubic  ", err);
+		if(err>TOL){
+			printf("FAIL: natural spline did not reproduce a line\n");
+			fails++;
+		}
+	}
+
+	// stretching time by 2 halves the velocity at the same point on the path
+	__random_path(&t,&p,KNOTS,DIM);
+	rc_spline_quintic(&s,t,p,RC_SPLINE_REST);
+	x = 0.37*t.d[KNOTS-1];
+	rc_spline_eval(&s,x,p0,v0,NULL);
+	rc_spline_scale_time(&s,2.0);
+	rc_spline_eval(&s,2.0*x,p1,v1,NULL);
+	err = 0.0;
+	for(j=0;j<DIM;j++) err = fmax(err,fabs(p1[j]-p0[j]) + fabs(2.0*v1[j]-v0[j]));
+	printf("time scaling           error %.1e\n", err);
+	if(err>TOL){
+		printf("FAIL: time scaling\n");
+		fails++;
+	}
+
+	// batch evaluation, out of order and past both ends
+	rc_vector_alloc(&b,50);
+	for(i=0;i<50;i++) b.d[i] = (1.2*__rand()+0.5)*t.d[KNOTS-1];
+	rc_spline_eval_batch(&s,b,&P,&V,NULL);
+	err = 0.0;
+	for(i=0;i<50;i++){
+		rc_spline_eval(&s,b.d[i],p0,v0,NULL);
+		for(j=0;j<DIM;j++) err = fmax(err,fabs(P.d[i][j]-p0[j]) + fabs(V.d[i][j]-v0[j]));
+	}
+	rc_spline_eval(&s,-1.0,p0,v0,NULL);
+	for(j=0;j<DIM;j++) err = fmax(err,fabs(p0[j]-p.d[0][j]) + fabs(v0[j]));
+	printf("batch evaluation       error %.1e\n", err);
+	if(err>TOL){
+		printf("FAIL: batch evaluation\n");
+		fails++;
+	}
+
+	// fitting in a workspace stays off the heap
+	rc_workspace_heap_guard(RC_HEAP_GUARD_COUNT);
+	rc_workspace_begin(&ws);
+	if(rc_spline_cubic(&s_ws,t,p,RC_SPLINE_REST)) fails++;
+	rc_spline_free(&s_ws);
+	rc_workspace_end(&ws);
+	heap_calls = rc_workspace_heap_count();
+	rc_workspace_heap_guard(RC_HEAP_GUARD_OFF);
+	printf("cubic fit in workspace %lu heap calls\n", heap_calls);
+	if(heap_calls!=0){
+		printf("FAIL: cubic fit used the heap inside a workspace\n");
+		fails++;
+	}
+	rc_workspace_free(&ws);
+
+	// timing
+	__random_path(&t,&p,knots,DIM);
+	start = rc_nanos_since_boot();
+	rc_spline_cubic(&s,t,p,RC_SPLINE_REST);
+	fit3_us = (rc_nanos_since_boot()-start)/1e3;
+	start = rc_nanos_since_boot();
+	rc_spline_quintic(&s,t,p,RC_SPLINE_REST);
+	fit5_us = (rc_nanos_since_boot()-start)/1e3;
+	start = rc_nanos_since_boot();
+	for(i=0;i<EVAL_SAMPLES;i++){
+		rc_spline_eval(&s,t.d[knots-1]*i/EVAL_SAMPLES,p0,v0,v1);
+	}
+	eval_ns = (double)(rc_nanos_since_boot()-start)/EVAL_SAMPLES;
+	printf("%d knots in %d dimensions, fit cubic: %.0fus  quintic: %.0fus  eval: %.0fns\n",
+					knots, DIM, fit3_us, fit5_us, eval_ns);
+
+	rc_vector_free(&t);
+	rc_vector_free(&b);
+	rc_vector_free(&x1);
+	rc_vector_free(&x2);
+	rc_vector_free(&sub);
+	rc_vector_free(&diag);
+	rc_vector_free(&sup);
+	rc_matrix_free(&A);
+	rc_matrix_free(&Ab);
+	rc_matrix_free(&p);
+	rc_matrix_free(&P);
+	rc_matrix_free(&V);
+	rc_spline_free(&s);
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
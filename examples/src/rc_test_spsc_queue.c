@@ -0,0 +1,202 @@
+/**
+ * @file rc_test_spsc_queue.c
+ * @example rc_test_spsc_queue
+ * @brief stress tests the lock-free queue and sequence lock between threads
+ *
+ * A producer thread pushes numbered records through a small rc_spsc_queue_t
+ * to a consumer thread as fast as it can, retrying whenever the queue is
+ * full. The consumer must receive every record exactly once and in order,
+ * first popping one at a time and then peeking and releasing whole runs.
+ * Records are also checked for being torn between the two threads.
+ *
+ * A writer thread then keeps replacing a value in an rc_seqlock_t whose
+ * fields all hold the same count while a reader copies it out. Every copy
+ * must have equal fields and the count must never go backwards.
+ *
+ * Throughput is printed for each. Run it on a multicore machine to really
+ * have the threads race, on a single core it still checks correctness.
+ *
+ * @verbatim
+ Usage:
+	-n <records>     Number of records to pass, default 2000000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi
+#include <stdint.h>
+#include <unistd.h> // for getopt, sysconf
+#include <pthread.h>
+#include <sched.h>  // for sched_yield
+#include <stdatomic.h>
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define QUEUE_SIZE	256
+#define SEQ_FIELDS	16
+
+typedef struct record_t{
+	uint64_t seq;
+	uint64_t check;
+	double pad[6];
+} record_t;
+
+static rc_spsc_queue_t queue = RC_SPSC_QUEUE_INITIALIZER;
+static rc_seqlock_t slot = RC_SEQLOCK_INITIALIZER;
+static uint64_t records = 2000000;
+static atomic_int writing;
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-n <records>     Number of records to pass, default 2000000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+static void* __producer(__attribute__((unused)) void* ptr)
+{
+	uint64_t i;
+	record_t r = {0};
+	for(i=0;i<records;i++){
+		r.seq = i;
+		r.check = ~i;
+		r.pad[5] = (double)i;
+		// full, let the consumer run on a single core and try again
+		while(rc_spsc_queue_push(&queue, &r)) sched_yield();
+	}
+	return NULL;
+}
+
+// pops or peeks every record, returns the number of bad ones
+static uint64_t __consume(int peek)
+{
+	uint64_t next = 0, bad = 0;
+	int i, n;
+	record_t r;
+	record_t* run;
+
+	while(next<records){
+		if(peek){
+			run = (record_t*)rc_spsc_queue_peek(&queue, &n);
+			for(i=0;i<n;i++){
+				if(run[i].seq!=next || run[i].check!=~next || (uint64_t)run[i].pad[5]!=next) bad++;
+				next++;
+			}
+			if(n) rc_spsc_queue_release(&queue, n);
+			else sched_yield();
+		}
+		else if(rc_spsc_queue_pop(&queue, &r)==1){
+			if(r.seq!=next || r.check!=~next || (uint64_t)r.pad[5]!=next) bad++;
+			next++;
+		}
+		else sched_yield();
+	}
+	return bad;
+}
+
+static int __queue_pass(int peek)
+{
+	pthread_t thread;
+	uint64_t start, bad;
+	double sec;
+
+	rc_spsc_queue_alloc(&queue, QUEUE_SIZE, sizeof(record_t));
+	start = rc_nanos_since_boot();
+	pthread_create(&thread, NULL, __producer, NULL);
+	bad = __consume(peek);
+	pthread_join(thread, NULL);
+	sec = (rc_nanos_since_boot()-start)/1e9;
+	printf("%-14s %llu records in %.3fs, %.1f M records/s, %lu pushes refused while full\n",
+			peek?"peek/release:":"pop:", (unsigned long long)records, sec,
+			records/sec/1e6, rc_spsc_queue_dropped(queue));
+	if(bad || rc_spsc_queue_count(queue)!=0){
+		printf("FAIL: %llu records out of order or torn\n", (unsigned long long)bad);
+		return 1;
+	}
+	return 0;
+}
+
+static void* __writer(__attribute__((unused)) void* ptr)
+{
+	uint64_t i, j;
+	uint64_t v[SEQ_FIELDS];
+	for(i=1;i<=records;i++){
+		for(j=0;j<SEQ_FIELDS;j++) v[j] = i;
+		rc_seqlock_write(&slot, v);
+	}
+	atomic_store(&writing, 0);
+	return NULL;
+}
+
+static int __seqlock_pass(void)
+{
+	pthread_t thread;
+	uint64_t v[SEQ_FIELDS];
+	uint64_t start, last = 0, reads = 0, torn = 0, backwards = 0, j;
+	unsigned int version;
+	double sec;
+
+	rc_seqlock_alloc(&slot, sizeof(v));
+	atomic_store(&writing, 1);
+	start = rc_nanos_since_boot();
+	pthread_create(&thread, NULL, __writer, NULL);
+	while(atomic_load(&writing)){
+		rc_seqlock_read(&slot, v);
+		for(j=1;j<SEQ_FIELDS;j++) if(v[j]!=v[0]) torn++;
+		if(v[0]<last) backwards++;
+		last = v[0];
+		reads++;
+	}
+	pthread_join(thread, NULL);
+	sec = (rc_nanos_since_boot()-start)/1e9;
+	rc_seqlock_read(&slot, v);
+	version = rc_seqlock_version(slot);
+	printf("seqlock:       %u writes and %llu reads in %.3fs, last value %llu\n",
+			version, (unsigned long long)reads, sec, (unsigned long long)v[0]);
+	rc_seqlock_free(&slot);
+	if(torn || backwards || v[0]!=records || version!=records){
+		printf("FAIL: %llu torn reads, %llu went backwards\n",
+			(unsigned long long)torn, (unsigned long long)backwards);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, fails = 0;
+
+	while((opt = getopt(argc, argv, "n:h")) != -1){
+		switch (opt) {
+		case 'n':
+			if(atoi(optarg)<1){
+				fprintf(stderr,"ERROR: number of records must be positive\n");
+				return -1;
+			}
+			records = atoi(optarg);
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	printf("%ld cpus online, queue of %d %zu byte records\n",
+			sysconf(_SC_NPROCESSORS_ONLN), QUEUE_SIZE, sizeof(record_t));
+	fails += __queue_pass(0);
+	fails += __queue_pass(1);
+	rc_spsc_queue_free(&queue);
+	fails += __seqlock_pass();
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file rc_test_trace.c
+ * @example rc_test_trace
+ * @brief checks the latency trace histograms and percentiles
+ *
+ * Needs no hardware. Records known durations and checks that each lands in a
+ * histogram bucket which contains it and is no wider than 1/8 of its lower
+ * bound, that the summary percentiles of a uniform spread of samples are
+ * within that accuracy, and that samples recorded from two threads are merged.
+ * It then reports how long one record takes.
+ *
+ * @verbatim
+ Usage:
+	-n <samples>     Number of samples to time, default 1000000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi
+#include <stdint.h>
+#include <inttypes.h> // for PRIu64, SCNu64
+#include <unistd.h> // for getopt
+#include <pthread.h>
+#include <rc/trace.h>
+#include <rc/time.h>
+
+#define DUMP_FILE	"/tmp/rc_test_trace.csv"
+#define SPREAD		10000	// samples 1..SPREAD ns for the percentile check
+
+static int probe;
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-n <samples>     Number of samples to time, default 1000000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+// reads back the one non-empty bucket of the dump
+static int __read_bucket(uint64_t* lower, uint64_t* upper, uint64_t* count)
+{
+	FILE* f;
+	char name[64];
+	int rows = 0;
+	if(rc_trace_dump(DUMP_FILE)) return -1;
+	f = fopen(DUMP_FILE, "r");
+	if(f==NULL) return -1;
+	if(fscanf(f, "%*[^\n]\n")!=0){
+		fclose(f);
+		return -1;
+	}
+	while(fscanf(f, "%63[^,],%" SCNu64 ",%" SCNu64 ",%" SCNu64 "\n",
+			name, lower, upper, count)==4) rows++;
+	fclose(f);
+	return rows==1 ? 0 : -1;
+}
+
+static int __check_bucket(uint64_t ns)
+{
+	uint64_t lower, upper, count;
+	rc_trace_reset();
+	rc_trace_record(probe, ns);
+	if(__read_bucket(&lower, &upper, &count)){
+		printf("FAIL: %" PRIu64 "ns should fill exactly one bucket\n", ns);
+		return 1;
+	}
+	if(count!=1 || ns<lower || (ns>=upper && upper!=UINT64_MAX)){
+		printf("FAIL: %" PRIu64 "ns landed in [%" PRIu64 ",%" PRIu64 ")\n", ns, lower, upper);
+		return 1;
+	}
+	// the last bucket collects everything too long to track
+	if(upper!=UINT64_MAX && (upper-lower)*8 > (lower<8 ? 8 : lower)){
+		printf("FAIL: bucket [%" PRIu64 ",%" PRIu64 ") is too wide\n", lower, upper);
+		return 1;
+	}
+	return 0;
+}
+
+static int __near(const char* what, uint64_t got, uint64_t expect)
+{
+	// a percentile is reported as the middle of its bucket, so it is off by
+	// at most half a bucket width
+	if(got*16 >= expect*15 && got*16 <= expect*17) return 0;
+	printf("FAIL: %s is %" PRIu64 " expected about %" PRIu64 "\n", what, got, expect);
+	return 1;
+}
+
+static int __check_percentiles(void)
+{
+	rc_trace_summary_t s;
+	uint64_t i;
+	int fails = 0;
+	rc_trace_reset();
+	for(i=1;i<=SPREAD;i++) rc_trace_record(probe, i);
+	if(rc_trace_get_summary(probe, &s)) return 1;
+	if(s.count!=SPREAD || s.min_ns!=1 || s.max_ns!=SPREAD){
+		printf("FAIL: count %" PRIu64 " min %" PRIu64 " max %" PRIu64 "\n", s.count, s.min_ns, s.max_ns);
+		fails++;
+	}
+	if(s.mean_ns<(SPREAD+1)/2.0-1e-6 || s.mean_ns>(SPREAD+1)/2.0+1e-6){
+		printf("FAIL: mean is %f expected %f\n", s.mean_ns, (SPREAD+1)/2.0);
+		fails++;
+	}
+	fails += __near("p50", s.p50_ns, SPREAD/2);
+	fails += __near("p90", s.p90_ns, SPREAD*9/10);
+	fails += __near("p99", s.p99_ns, SPREAD*99/100);
+	fails += __near("p99.9", s.p999_ns, SPREAD*999/1000);
+	if(s.p999_ns>s.max_ns){
+		printf("FAIL: p99.9 is above the max\n");
+		fails++;
+	}
+	return fails;
+}
+
+static void* __recorder(__attribute__((unused)) void* ptr)
+{
+	int i;
+	rc_trace_thread_init();
+	for(i=0;i<1000;i++) rc_trace_record(probe, 100);
+	return NULL;
+}
+
+static int __check_threads(void)
+{
+	rc_trace_summary_t s;
+	pthread_t thread;
+	int i;
+	rc_trace_reset();
+	if(pthread_create(&thread, NULL, __recorder, NULL)) return 1;
+	for(i=0;i<1000;i++) rc_trace_record(probe, 200);
+	pthread_join(thread, NULL);
+	if(rc_trace_get_summary(probe, &s)) return 1;
+	if(s.count!=2000 || s.min_ns!=100 || s.max_ns!=200){
+		printf("FAIL: merged count %" PRIu64 " min %" PRIu64 " max %" PRIu64 "\n", s.count, s.min_ns, s.max_ns);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, i, n = 1000000, fails = 0;
+	uint64_t start, ns;
+	const uint64_t values[] = {0, 1, 7, 8, 9, 15, 16, 17, 100, 1000, 12345,
+		999999, 1000000, 123456789, 1ull<<40, (1ull<<41)-1, 1ull<<50, UINT64_MAX};
+
+	while((opt = getopt(argc, argv, "n:h")) != -1){
+		switch (opt) {
+		case 'n':
+			n = atoi(optarg);
+			if(n<1){
+				fprintf(stderr,"ERROR: number of samples must be positive\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	probe = rc_trace_register("test");
+	if(probe<0 || rc_trace_thread_init()) return -1;
+
+	for(i=0;i<(int)(sizeof(values)/sizeof(values[0]));i++){
+		fails += __check_bucket(values[i]);
+	}
+	for(ns=1;ns<1000000;ns+=ns/3+1) fails += __check_bucket(ns);
+	fails += __check_percentiles();
+	fails += __check_threads();
+	remove(DUMP_FILE);
+
+	rc_trace_reset();
+	start = rc_nanos_since_boot();
+	for(i=0;i<n;i++) rc_trace_record(probe, (uint64_t)i);
+	printf("record:  %8.1f ns\n", (double)(rc_nanos_since_boot()-start)/n);
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
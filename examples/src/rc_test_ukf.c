@@ -0,0 +1,318 @@
+/**
+ * @file rc_test_ukf.c
+ * @example rc_test_ukf
+ * @brief compares the unscented and extended Kalman filters on an omni base
+ *
+ * Simulates the pose (x, y, theta) of the omni-wheel base driving circles.
+ * The filters are driven by wheel odometry with slip noise, using the same
+ * update as the position controller in jb_main, and corrected each step with
+ * noisy ranges to two beacons and a heading measurement. The EKF from
+ * <rc/math/kalman.h> with hand written Jacobians, the UKF and the square
+ * root UKF all run on the same data.
+ *
+ * Prints the RMS error of each against the true pose next to plain dead
+ * reckoning, and the mean and worst time of a filter step. The test fails if
+ * the two UKF forms disagree, if the UKF does no better than dead reckoning
+ * or clearly worse than the EKF, if any filter step uses the heap or if a UKF
+ * step takes longer than the 5ms control period.
+ *
+ * @verbatim
+ Usage:
+	-n <steps>       Number of 5ms steps to simulate, default 20000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi, rand
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h> // for getopt
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define Nx		3
+#define Nu		3
+#define Ny		3
+#define DT		0.005		// control period of jb_main
+#define BUDGET_NS	5000000		// one control period
+#define OMNI_ANGLE	(M_PI/4)	// ANGLE_GLOBAL2OMNI in jb_main
+#define SLIP_STD	0.0005		// odometry noise per step, m and rad
+#define RANGE_STD	0.05		// beacon range noise, m
+#define HEADING_STD	0.02		// heading noise, rad
+
+// beacons at known positions
+static const double beacon[2][2] = {{3.0, 0.0}, {0.0, 3.0}};
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-n <steps>       Number of 5ms steps to simulate, default 20000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+static double __wrap(double a)
+{
+	return a - 2.0*M_PI*floor((a+M_PI)/(2.0*M_PI));
+}
+
+// normally distributed noise with Box-Muller
+static double __noise(double std)
+{
+	double u1 = (rand()+1.0)/((double)RAND_MAX+2.0);
+	double u2 = (rand()+1.0)/((double)RAND_MAX+2.0);
+	return std*sqrt(-2.0*log(u1))*cos(2.0*M_PI*u2);
+}
+
+// odometry u = [dX_r, dY_r, dtheta] moved along the omni axes, heading first
+// as in __position_controller
+static void __process(const double* x, const double* u, double* x_new,
+					__attribute__ ((unused)) void* arg)
+{
+	double th = x[2] + u[2];
+	double c = cos(OMNI_ANGLE + th);
+	double s = sin(OMNI_ANGLE + th);
+	x_new[0] = x[0] + u[0]*c - u[1]*s;
+	x_new[1] = x[1] + u[0]*s + u[1]*c;
+	x_new[2] = __wrap(th);
+}
+
+// ranges to both beacons and the heading
+static void __measure(const double* x, double* y, __attribute__ ((unused)) void* arg)
+{
+	int i;
+	for(i=0;i<2;i++) y[i] = hypot(x[0]-beacon[i][0], x[1]-beacon[i][1]);
+	y[2] = x[2];
+}
+
+// Jacobians of __process at x and of __measure at the prediction x_pre
+static void __jacobians(const double* x, const double* u, const double* x_pre,
+						rc_matrix_t* F, rc_matrix_t* H)
+{
+	int i;
+	double r, th = x[2] + u[2];
+	double c = cos(OMNI_ANGLE + th);
+	double s = sin(OMNI_ANGLE + th);
+	F->d[0][0] = 1.0;
+	F->d[0][1] = 0.0;
+	F->d[0][2] = -u[0]*s - u[1]*c;
+	F->d[1][0] = 0.0;
+	F->d[1][1] = 1.0;
+	F->d[1][2] =  u[0]*c - u[1]*s;
+	F->d[2][0] = 0.0;
+	F->d[2][1] = 0.0;
+	F->d[2][2] = 1.0;
+	for(i=0;i<2;i++){
+		r = hypot(x_pre[0]-beacon[i][0], x_pre[1]-beacon[i][1]);
+		H->d[i][0] = (x_pre[0]-beacon[i][0])/r;
+		H->d[i][1] = (x_pre[1]-beacon[i][1])/r;
+		H->d[i][2] = 0.0;
+	}
+	H->d[2][0] = 0.0;
+	H->d[2][1] = 0.0;
+	H->d[2][2] = 1.0;
+}
+
+// running error statistics of one estimator
+typedef struct err_t{
+	double pos2;
+	double th2;
+} err_t;
+
+static void __add_err(err_t* e, const double* est, const double* truth)
+{
+	double dx = est[0]-truth[0];
+	double dy = est[1]-truth[1];
+	double dth = __wrap(est[2]-truth[2]);
+	e->pos2 += dx*dx + dy*dy;
+	e->th2 += dth*dth;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, i, k, fails = 0;
+	int steps = 20000;
+	uint64_t t0;
+	double t, ns, ukf_diff = 0.0;
+	double truth[Nx] = {0.0, 0.0, 0.0};
+	double dead[Nx] = {0.0, 0.0, 0.0};
+	double tmp[Nx];
+	double u_true[Nu];
+	double ekf_ns = 0.0, ukf_ns = 0.0, sr_ns = 0.0;
+	double ekf_max = 0.0, ukf_max = 0.0, sr_max = 0.0;
+	unsigned long heap_calls;
+	err_t e_dead = {0}, e_ekf = {0}, e_ukf = {0}, e_sr = {0};
+
+	rc_kalman_t ekf = RC_KALMAN_INITIALIZER;
+	rc_ukf_t ukf = RC_UKF_INITIALIZER;
+	rc_ukf_t sr = RC_UKF_INITIALIZER;
+	rc_matrix_t Q = RC_MATRIX_INITIALIZER;
+	rc_matrix_t R = RC_MATRIX_INITIALIZER;
+	rc_matrix_t Pi = RC_MATRIX_INITIALIZER;
+	rc_matrix_t F = RC_MATRIX_INITIALIZER;
+	rc_matrix_t H = RC_MATRIX_INITIALIZER;
+	rc_vector_t u = RC_VECTOR_INITIALIZER;
+	rc_vector_t y = RC_VECTOR_INITIALIZER;
+	rc_vector_t h = RC_VECTOR_INITIALIZER;
+	rc_vector_t x_pre = RC_VECTOR_INITIALIZER;
+
+	while((opt = getopt(argc, argv, "n:h")) != -1){
+		switch (opt) {
+		case 'n':
+			steps = atoi(optarg);
+			if(steps<1){
+				fprintf(stderr,"ERROR: number of steps must be positive\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	// noise models match the simulation
+	rc_matrix_zeros(&Q, Nx, Nx);
+	rc_matrix_zeros(&R, Ny, Ny);
+	rc_matrix_zeros(&Pi, Nx, Nx);
+	for(i=0;i<Nx;i++){
+		Q.d[i][i] = 2.0*SLIP_STD*SLIP_STD;
+		Pi.d[i][i] = 0.01;
+	}
+	R.d[0][0] = RANGE_STD*RANGE_STD;
+	R.d[1][1] = RANGE_STD*RANGE_STD;
+	R.d[2][2] = HEADING_STD*HEADING_STD;
+	rc_matrix_zeros(&F, Nx, Nx);
+	rc_matrix_zeros(&H, Ny, Nx);
+	rc_vector_zeros(&u, Nu);
+	rc_vector_zeros(&y, Ny);
+	rc_vector_zeros(&h, Ny);
+	rc_vector_zeros(&x_pre, Nx);
+
+	if(rc_kalman_alloc_ekf(&ekf, Q, R, Pi) ||
+	   rc_ukf_alloc(&ukf, Nu, Q, R, Pi, __process, __measure, NULL) ||
+	   rc_ukf_alloc(&sr, Nu, Q, R, Pi, __process, __measure, NULL) ||
+	   rc_ukf_set_state_angle(&ukf, 2) || rc_ukf_set_measurement_angle(&ukf, 2) ||
+	   rc_ukf_set_state_angle(&sr, 2) || rc_ukf_set_measurement_angle(&sr, 2) ||
+	   rc_ukf_set_sqrt(&sr, 1)){
+		fprintf(stderr,"ERROR: failed to set up filters\n");
+		return -1;
+	}
+
+	srand(1);
+	rc_workspace_heap_guard(RC_HEAP_GUARD_COUNT);
+	for(k=0;k<steps;k++){
+		// drive circles of changing radius, the odometry sees the slip
+		t = k*DT;
+		u_true[0] = 0.5*DT;
+		u_true[1] = 0.2*sin(0.3*t)*DT;
+		u_true[2] = 0.4*cos(0.05*t)*DT;
+		__process(truth, u_true, tmp, NULL);
+		for(i=0;i<Nx;i++) truth[i] = tmp[i];
+		for(i=0;i<Nu;i++) u.d[i] = u_true[i] + __noise(SLIP_STD);
+		__measure(truth, y.d, NULL);
+		y.d[0] += __noise(RANGE_STD);
+		y.d[1] += __noise(RANGE_STD);
+		y.d[2] = __wrap(y.d[2] + __noise(HEADING_STD));
+
+		// dead reckoning from odometry alone
+		__process(dead, u.d, tmp, NULL);
+		for(i=0;i<Nx;i++) dead[i] = tmp[i];
+
+		// EKF, the heading residual y-h is wrapped through h
+		t0 = rc_nanos_since_boot();
+		__process(ekf.x_est.d, u.d, x_pre.d, NULL);
+		__jacobians(ekf.x_est.d, u.d, x_pre.d, &F, &H);
+		__measure(x_pre.d, h.d, NULL);
+		h.d[2] = y.d[2] - __wrap(y.d[2]-h.d[2]);
+		if(rc_kalman_update_ekf(&ekf, F, H, x_pre, y, h)) fails++;
+		ekf.x_est.d[2] = __wrap(ekf.x_est.d[2]);
+		ns = (double)(rc_nanos_since_boot()-t0);
+		ekf_ns += ns;
+		ekf_max = fmax(ekf_max, ns);
+
+		t0 = rc_nanos_since_boot();
+		if(rc_ukf_predict(&ukf, u) || rc_ukf_update(&ukf, y)) fails++;
+		ns = (double)(rc_nanos_since_boot()-t0);
+		ukf_ns += ns;
+		ukf_max = fmax(ukf_max, ns);
+
+		t0 = rc_nanos_since_boot();
+		if(rc_ukf_predict(&sr, u) || rc_ukf_update(&sr, y)) fails++;
+		ns = (double)(rc_nanos_since_boot()-t0);
+		sr_ns += ns;
+		sr_max = fmax(sr_max, ns);
+
+		__add_err(&e_dead, dead, truth);
+		__add_err(&e_ekf, ekf.x_est.d, truth);
+		__add_err(&e_ukf, ukf.x_est.d, truth);
+		__add_err(&e_sr, sr.x_est.d, truth);
+		for(i=0;i<Nx;i++){
+			ukf_diff = fmax(ukf_diff, fabs(__wrap(ukf.x_est.d[i]-sr.x_est.d[i])));
+		}
+		if(fails) break;
+	}
+	heap_calls = rc_workspace_heap_count();
+	rc_workspace_heap_guard(RC_HEAP_GUARD_OFF);
+	if(fails){
+		printf("FAIL: a filter step failed at step %d\n", k);
+		return -1;
+	}
+
+	printf("%d steps of %.0fms, %.1fs simulated\n\n", steps, DT*1000.0, steps*DT);
+	printf("                RMS position (m)  RMS heading (rad)  mean step (us)  worst step (us)\n");
+	printf("dead reckoning  %16.4f  %17.4f\n", sqrt(e_dead.pos2/steps), sqrt(e_dead.th2/steps));
+	printf("EKF             %16.4f  %17.4f  %14.2f  %15.2f\n", sqrt(e_ekf.pos2/steps),
+			sqrt(e_ekf.th2/steps), ekf_ns/steps/1000.0, ekf_max/1000.0);
+	printf("UKF             %16.4f  %17.4f  %14.2f  %15.2f\n", sqrt(e_ukf.pos2/steps),
+			sqrt(e_ukf.th2/steps), ukf_ns/steps/1000.0, ukf_max/1000.0);
+	printf("square root UKF %16.4f  %17.4f  %14.2f  %15.2f\n\n", sqrt(e_sr.pos2/steps),
+			sqrt(e_sr.th2/steps), sr_ns/steps/1000.0, sr_max/1000.0);
+	printf("largest difference between UKF forms: %g\n", ukf_diff);
+	printf("heap calls: %lu\n", heap_calls);
+
+	if(ukf_diff>1e-6){
+		printf("FAIL: standard and square root UKF disagree\n");
+		fails++;
+	}
+	if(e_ukf.pos2>=e_dead.pos2){
+		printf("FAIL: UKF does no better than dead reckoning\n");
+		fails++;
+	}
+	if(e_ukf.pos2>1.5*e_ekf.pos2 || e_ukf.th2>1.5*e_ekf.th2){
+		printf("FAIL: UKF is clearly worse than the EKF\n");
+		fails++;
+	}
+	if(heap_calls!=0){
+		printf("FAIL: filter steps used the heap\n");
+		fails++;
+	}
+	if(ukf_max>BUDGET_NS || sr_max>BUDGET_NS){
+		printf("FAIL: a UKF step took longer than the control period\n");
+		fails++;
+	}
+
+	rc_kalman_free(&ekf);
+	rc_ukf_free(&ukf);
+	rc_ukf_free(&sr);
+	rc_matrix_free(&Q);
+	rc_matrix_free(&R);
+	rc_matrix_free(&Pi);
+	rc_matrix_free(&F);
+	rc_matrix_free(&H);
+	rc_vector_free(&u);
+	rc_vector_free(&y);
+	rc_vector_free(&h);
+	rc_vector_free(&x_pre);
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
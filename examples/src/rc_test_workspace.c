@@ -0,0 +1,230 @@
+/**
+ * @file rc_test_workspace.c
+ * @example rc_test_workspace
+ * @brief checks that math runs off the heap inside an rc_workspace_t
+ *
+ * One step here is a transpose, multiply, add and invert of 6x6 matrices
+ * followed by a linear Kalman filter update, the same calls a control loop
+ * would make. The step is run once on the heap with the heap guard counting to
+ * show the guard sees the allocations, then again inside a workspace where the
+ * guard must count zero. Both runs must give the same results and the
+ * workspace must be empty again after rc_workspace_end. Finally the time of a
+ * step is compared on the heap and in the workspace.
+ *
+ * With -a the heap guard aborts at the first heap use instead of counting, run
+ * it under gdb to see where it happened.
+ *
+ * @verbatim
+ Usage:
+	-a               Abort on heap use inside the workspace instead of counting
+	-n <steps>       Number of steps to time, default 10000
+	-h               Print this help message
+ * @endverbatim
+ */
+
+#include <stdio.h>
+#include <stdlib.h> // for atoi
+#include <stdint.h>
+#include <math.h>   // for fabs
+#include <unistd.h> // for getopt
+#include <rc/math.h>
+#include <rc/time.h>
+
+#define N		6
+#define WS_BYTES	(64*1024)
+#define DT		0.05
+
+static void __print_usage(void)
+{
+	printf("\n");
+	printf("-a               Abort on heap use inside the workspace instead of counting\n");
+	printf("-n <steps>       Number of steps to time, default 10000\n");
+	printf("-h               Print this help message\n");
+	printf("\n");
+}
+
+// C = inv(A*A' + I) then one filter update, C and kf must already be allocated
+static int __step(rc_matrix_t A, rc_matrix_t I, rc_matrix_t* C, rc_kalman_t* kf,
+						rc_vector_t u, rc_vector_t y)
+{
+	int ret = 0;
+	rc_matrix_t AT = RC_MATRIX_INITIALIZER;
+	rc_matrix_t M = RC_MATRIX_INITIALIZER;
+	rc_matrix_t S = RC_MATRIX_INITIALIZER;
+
+	ret |= rc_matrix_transpose(A, &AT);
+	ret |= rc_matrix_multiply(A, AT, &M);
+	ret |= rc_matrix_add(M, I, &S);
+	ret |= rc_algebra_invert_matrix(S, C);
+	ret |= rc_kalman_update_lin(kf, u, y);
+
+	rc_matrix_free(&AT);
+	rc_matrix_free(&M);
+	rc_matrix_free(&S);
+	return ret;
+}
+
+// a 1kg mass pushed around with a noisy position sensor, as in rc_test_kalman
+static int __kalman_init(rc_kalman_t* kf)
+{
+	int ret;
+	rc_matrix_t F = RC_MATRIX_INITIALIZER;
+	rc_matrix_t G = RC_MATRIX_INITIALIZER;
+	rc_matrix_t H = RC_MATRIX_INITIALIZER;
+	rc_matrix_t Q = RC_MATRIX_INITIALIZER;
+	rc_matrix_t R = RC_MATRIX_INITIALIZER;
+	rc_matrix_t Pi = RC_MATRIX_INITIALIZER;
+
+	rc_matrix_zeros(&F, 2, 2);
+	rc_matrix_zeros(&G, 2, 1);
+	rc_matrix_zeros(&H, 1, 2);
+	rc_matrix_zeros(&Q, 2, 2);
+	rc_matrix_zeros(&R, 1, 1);
+	rc_matrix_zeros(&Pi, 2, 2);
+	F.d[0][0] = 1.0;
+	F.d[0][1] = DT;
+	F.d[1][1] = 1.0;
+	G.d[0][0] = 0.5*DT*DT;
+	G.d[1][0] = DT;
+	H.d[0][0] = 1.0;
+	Q.d[0][0] = 0.1;
+	Q.d[1][1] = 0.0001;
+	R.d[0][0] = 1.0;
+	Pi.d[0][0] = 0.0001;
+	Pi.d[1][1] = 0.0001;
+	ret = rc_kalman_alloc_lin(kf, F, G, H, Q, R, Pi);
+
+	rc_matrix_free(&F);
+	rc_matrix_free(&G);
+	rc_matrix_free(&H);
+	rc_matrix_free(&Q);
+	rc_matrix_free(&R);
+	rc_matrix_free(&Pi);
+	return ret;
+}
+
+static int __compare(const char* name, double* a, double* b, int n)
+{
+	int i;
+	for(i=0;i<n;i++){
+		if(fabs(a[i]-b[i])>1e-12){
+			printf("FAIL: %s differs at %d, %g vs %g\n", name, i, a[i], b[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, i, fails = 0;
+	int guard = RC_HEAP_GUARD_COUNT;
+	int steps = 10000;
+	unsigned long heap_calls;
+	uint64_t start;
+	double heap_ns, ws_ns;
+	rc_workspace_t ws = RC_WORKSPACE_INITIALIZER;
+	rc_matrix_t A = RC_MATRIX_INITIALIZER;
+	rc_matrix_t I = RC_MATRIX_INITIALIZER;
+	rc_matrix_t C_heap = RC_MATRIX_INITIALIZER;
+	rc_matrix_t C_ws = RC_MATRIX_INITIALIZER;
+	rc_vector_t u = RC_VECTOR_INITIALIZER;
+	rc_vector_t y = RC_VECTOR_INITIALIZER;
+	rc_kalman_t kf_heap = RC_KALMAN_INITIALIZER;
+	rc_kalman_t kf_ws = RC_KALMAN_INITIALIZER;
+
+	while((opt = getopt(argc, argv, "an:h")) != -1){
+		switch (opt) {
+		case 'a':
+			guard = RC_HEAP_GUARD_ABORT;
+			break;
+		case 'n':
+			steps = atoi(optarg);
+			if(steps<1){
+				fprintf(stderr,"ERROR: number of steps must be positive\n");
+				return -1;
+			}
+			break;
+		case 'h':
+			__print_usage();
+			return 0;
+		default:
+			__print_usage();
+			return -1;
+		}
+	}
+
+	// everything that outlives a step is allocated at its final size up front
+	if(rc_matrix_random(&A, N, N) || rc_matrix_identity(&I, N) ||
+	   rc_matrix_zeros(&C_heap, N, N) || rc_matrix_zeros(&C_ws, N, N) ||
+	   rc_vector_zeros(&u, 1) || rc_vector_zeros(&y, 1) ||
+	   __kalman_init(&kf_heap) || __kalman_init(&kf_ws) ||
+	   rc_workspace_alloc(&ws, WS_BYTES)){
+		fprintf(stderr,"ERROR: failed to allocate test data\n");
+		return -1;
+	}
+	u.d[0] = 1.0;
+	y.d[0] = 0.5;
+
+	// on the heap the guard has to notice
+	rc_workspace_heap_guard(RC_HEAP_GUARD_COUNT);
+	if(__step(A, I, &C_heap, &kf_heap, u, y)) fails++;
+	heap_calls = rc_workspace_heap_count();
+	rc_workspace_heap_guard(RC_HEAP_GUARD_OFF);
+	printf("heap step:      %lu heap calls\n", heap_calls);
+	if(heap_calls==0){
+		printf("FAIL: heap guard saw no heap use\n");
+		fails++;
+	}
+
+	// in the workspace it must not see anything
+	rc_workspace_heap_guard(guard);
+	rc_workspace_begin(&ws);
+	if(__step(A, I, &C_ws, &kf_ws, u, y)) fails++;
+	rc_workspace_end(&ws);
+	heap_calls = rc_workspace_heap_count();
+	rc_workspace_heap_guard(RC_HEAP_GUARD_OFF);
+	printf("workspace step: %lu heap calls, %zu of %zu bytes used at most\n",
+		heap_calls, ws.high_water, ws.size);
+	if(heap_calls!=0){
+		printf("FAIL: heap used inside the workspace\n");
+		fails++;
+	}
+	if(ws.used!=0){
+		printf("FAIL: %zu bytes still taken after rc_workspace_end\n", ws.used);
+		fails++;
+	}
+	fails += __compare("inverse", C_ws.d[0], C_heap.d[0], N*N);
+	fails += __compare("x_est", kf_ws.x_est.d, kf_heap.x_est.d, 2);
+	fails += __compare("P", kf_ws.P.d[0], kf_heap.P.d[0], 4);
+
+	// time a step both ways
+	start = rc_nanos_since_boot();
+	for(i=0;i<steps;i++) __step(A, I, &C_heap, &kf_heap, u, y);
+	heap_ns = (double)(rc_nanos_since_boot()-start)/steps;
+	start = rc_nanos_since_boot();
+	for(i=0;i<steps;i++){
+		rc_workspace_begin(&ws);
+		__step(A, I, &C_ws, &kf_ws, u, y);
+		rc_workspace_end(&ws);
+	}
+	ws_ns = (double)(rc_nanos_since_boot()-start)/steps;
+	printf("step time, heap: %8.1f ns   workspace: %8.1f ns\n", heap_ns, ws_ns);
+
+	rc_workspace_free(&ws);
+	rc_matrix_free(&A);
+	rc_matrix_free(&I);
+	rc_matrix_free(&C_heap);
+	rc_matrix_free(&C_ws);
+	rc_vector_free(&u);
+	rc_vector_free(&y);
+	rc_kalman_free(&kf_heap);
+	rc_kalman_free(&kf_ws);
+
+	if(fails){
+		printf("%d checks FAILED\n", fails);
+		return -1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
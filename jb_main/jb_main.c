@@ -18,6 +18,11 @@
 
 #include "motor_5.h"
 #include "jb_main_defs.h"
+#include "jb_telemetry.h"
+#include "jb_traj_stream.h"
+#include "jb_smooth.h"
+#include "jb_replan.h"
+#include "jb_sim.h" // redirects hardware calls when built with make sim
 
 
 /**
@@ -54,6 +59,10 @@ typedef struct core_state_t {
 	double wheelAngle3;
 	double wheelAngle4;
 	double wheelAngle5; ///< "wheel" rotation for telescoping arm
+	double wheelSpeed1;	///< wheel speed from encoder snapshots (rad/s)
+	double wheelSpeed2;
+	double wheelSpeed3;
+	double wheelSpeed4;
 	double d1_u;		/// < output of test motor controller D1
 	double d4_u;
 	double d2_u;
@@ -73,14 +82,37 @@ typedef struct core_state_t {
 	double v_xr_des;	///< desired x_r velocity, to be updated by trajec
 	double v_yr_des;	///< desired x_r velocity, to be updated by trajec
 	double v_z_des;
+	double a_x;			///< body acceleration from the IMU (m/s2)
+	double a_y;
+	double theta_dot;	///< yaw rate from the IMU (rad/s)
 } core_state_t;
 
+/**
+* IMU values the controller uses, published by the DMP thread
+*/
+typedef struct imu_sample_t {
+	double accel[3];	///< m/s2
+	double gyro[3];		///< deg/s
+} imu_sample_t;
+
+/**
+* what the print loop shows, published by the controller once per cycle
+*/
+typedef struct print_snapshot_t {
+	core_state_t cstate;
+	setpoint_t setpoint;
+} print_snapshot_t;
+
 static void __print_usage(void);
-static void __position_controller(void);	///< mpu interrupt routine
+static void __position_controller(void);	///< periodic control task
+static void __imu_sample(void);		///< mpu interrupt routine
 static void __traject_new(void);
+static void __log_cycle(void);
+static void __control_thread_init(void);
 static void* __print_loop(void* ptr);		///< background thread
 static void* __battery_checker(void* ptr);	///< background thread
 static void* __estop_reader(void* ptr);		///< background thread
+static void* __traj_loader(void* ptr);		///< background thread
 static int __zero_out_controller(void);
 static int __disarm_controller(void);
 static int __arm_controller(void);
@@ -88,16 +120,29 @@ static int __arm_controller(void);
 // global variables
 static core_state_t cstate;
 static setpoint_t setpoint;
-static rc_filter_t D1 = RC_FILTER_INITIALIZER;
-static rc_filter_t D4 = RC_FILTER_INITIALIZER;
-static rc_filter_t D2 = RC_FILTER_INITIALIZER;
-static rc_filter_t D3 = RC_FILTER_INITIALIZER;
-static rc_filter_t D5 = RC_FILTER_INITIALIZER;
+// motor controllers D1-D5 run as one bank, one channel each
+enum { CH_D1, CH_D4, CH_D2, CH_D3, CH_D5, N_MOTOR_CH };
+static rc_filter_bank_t motor_bank = RC_FILTER_BANK_INITIALIZER;
 static rc_mpu_data_t mpu_data;
-static FILE* fout = NULL;
-static FILE* fin = NULL;
-static uint64_t test_start; // record start time of trial
-static rc_matrix_t trajec_mat = RC_MATRIX_INITIALIZER;
+// values shared between threads, each slot has exactly one writer and none
+// of them ever blocks the control loop
+static rc_seqlock_t imu_slot = RC_SEQLOCK_INITIALIZER;	// DMP thread -> controller
+static rc_seqlock_t batt_slot = RC_SEQLOCK_INITIALIZER;	// battery thread -> controller
+static rc_seqlock_t print_slot = RC_SEQLOCK_INITIALIZER;	// controller -> print loop
+static rc_periodic_t control_loop = RC_PERIODIC_INITIALIZER;
+static rc_encoder_snapshot_t enc_snap;	// last encoder snapshot, all channels
+
+// trace probes for the sections of the control loop, see -t option
+static int trace_controller, trace_trajectory, trace_encoders;
+static int trace_imu, trace_filters, trace_motors;
+static const char* log_filename = NULL; // binary telemetry log, see -f
+static const char* replan_filename = NULL; // watched for new waypoints, see -r
+static const char* mav_ip = NULL; // MAVLink position targets, see -m
+static uint64_t test_start; // record start time of trial, ns
+static int test_armed = 0; // set once the e-stop switch first arms the controller
+static jb_traj_stream_t traj; // planned from FILEIN a window at a time
+static jb_smooth_t smooth = JB_SMOOTH_INITIALIZER; // through FILEIN instead, see -p
+static int smooth_path = 0;
 
 /*
  * Printed if some invalid argument was given
@@ -105,8 +150,15 @@ static rc_matrix_t trajec_mat = RC_MATRIX_INITIALIZER;
 static void __print_usage(void)
 {
 	printf("\n");
-	printf("-f {filename}     print results to filename\n");
+	printf("-f {filename}     log every control cycle to binary file filename\n");
+	printf("-c {filename}     convert binary log filename to csv on stdout and exit\n");
 	printf("-s                print results to terminal\n");
+	printf("-t {filename}     trace control loop latency, save histograms to filename\n");
+	printf("-r {filename}     replan through the waypoints in filename each time it changes\n");
+	printf("-m {ip}           replan to MAVLink SET_POSITION_TARGET_LOCAL_NED targets,\n");
+	printf("                  sending heartbeats to ip\n");
+	printf("-p                follow a smooth path through the waypoints instead of\n");
+	printf("                  stopping at each, see coord2trajec -p\n");
 	printf("-h                print this help message\n");
 	printf("\n");
 }
@@ -116,18 +168,33 @@ int main(int argc, char *argv[]) {
 	pthread_t printf_thread = 0;
 	pthread_t battery_thread = 0;
 	pthread_t rc_read_thread = 0;
+	pthread_t loader_thread = 0;
 	bool adc_ok = true;
 
 	// parse arguments
 	opterr = 0;
-	while ((c = getopt(argc, argv, ":f:sh")) != -1) {
+	while ((c = getopt(argc, argv, ":f:c:st:r:m:ph")) != -1) {
 		switch (c) {
-		case 'f':  // print to file
-			fout = fopen(optarg, "w");
-			// TODO: CHECK IF WRITING TO A WRITE PROTECTED FILE
+		case 'f':  // log to file
+			log_filename = optarg;
 			break;
+		case 'c':  // offline conversion, no hardware needed
+			return (jb_telemetry_to_csv(optarg, stdout) < 0) ? -1 : 0;
 		case 's':
 			break;
+		case 't':  // trace control loop, summary printed on exit
+			rc_trace_enable(1);
+			rc_trace_dump_on_exit(optarg);
+			break;
+		case 'r':  // keep running at the end and wait for new waypoints
+			replan_filename = optarg;
+			break;
+		case 'm':
+			mav_ip = optarg;
+			break;
+		case 'p':  // spline through the waypoints, no stops
+			smooth_path = 1;
+			break;
 		case 'h':
 			__print_usage();
 			return -1;
@@ -143,6 +210,11 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	if (smooth_path && (replan_filename || mav_ip)) {
+		fprintf(stderr, "ERROR: a smooth path can't be replanned, -p doesn't go with -r or -m\n");
+		return -1;
+	}
+
 	if (rc_kill_existing_process(2.0) < -2) return -1;
 
 	// start signal handler, so can exit cleanly
@@ -157,8 +229,8 @@ int main(int argc, char *argv[]) {
 		return -1;
 	}
 
-	// initialize encoders
-	if (rc_encoder_init() == -1) {
+	// initialize encoders, eQEP channels are read straight from the registers
+	if (rc_encoder_init_mmap() == -1) {
 		fprintf(stderr, "ERROR: failed to initialize encoders\n");
 		return -1;
 	}
@@ -207,39 +279,47 @@ int main(int argc, char *argv[]) {
 	setpoint.arm_state = DISARMED;
 
 	// initialize all control loops
-	// D1 control loop for motor1
-	if (rc_filter_pid(&D1, D1_KP, D1_KI, D1_KD, 4 * DT, DT)) {
-		fprintf(stderr, "ERROR in jb_main, failed to make filter D1\n");
-		return -1;
-	}
-	if (rc_filter_pid(&D4, D4_KP, D4_KI, D4_KD, 4 * DT, DT)) {
-		fprintf(stderr, "ERROR in jb_main, failed to make filter D4\n");
-		return -1;
-	}
-	if (rc_filter_pid(&D2, D2_KP, D2_KI, D2_KD, 4 * DT, DT)) {
-		fprintf(stderr, "ERROR in jb_main, failed to make filter D2\n");
-		return -1;
-	}
-	if (rc_filter_pid(&D3, D3_KP, D3_KI, D3_KD, 4 * DT, DT)) {
-		fprintf(stderr, "ERROR in jb_main, failed to make filter D3\n");
-		return -1;
+	// each is designed as a normal filter, printed, then copied into its
+	// channel of the motor bank which is sized for the highest order
+	{
+		const double kp[N_MOTOR_CH] = {D1_KP, D4_KP, D2_KP, D3_KP, D5_KP};
+		const double ki[N_MOTOR_CH] = {D1_KI, D4_KI, D2_KI, D3_KI, D5_KI};
+		const double kd[N_MOTOR_CH] = {D1_KD, D4_KD, D2_KD, D3_KD, D5_KD};
+		const char* name[N_MOTOR_CH] = {"Motor1 controller D1",
+			"Motor4 controller D4", "Motor2 controller D2",
+			"Motor3 controller D3", "Motor5 controller D5"};
+		rc_filter_t D[N_MOTOR_CH];
+		int ch, order = 0;
+		for (ch = 0; ch < N_MOTOR_CH; ch++) {
+			D[ch] = rc_filter_empty();
+			if (rc_filter_pid(&D[ch], kp[ch], ki[ch], kd[ch], 4 * DT, DT)) {
+				fprintf(stderr, "ERROR in jb_main, failed to make filter for %s\n", name[ch]);
+				return -1;
+			}
+			printf("%s:\n", name[ch]);
+			rc_filter_print(D[ch]);
+			if (D[ch].order > order) order = D[ch].order;
+		}
+		if (rc_filter_bank_alloc(&motor_bank, N_MOTOR_CH, order, DT)) {
+			fprintf(stderr, "ERROR in jb_main, failed to allocate motor filter bank\n");
+			return -1;
+		}
+		for (ch = 0; ch < N_MOTOR_CH; ch++) {
+			if (rc_filter_bank_set_channel(&motor_bank, ch, D[ch])) {
+				fprintf(stderr, "ERROR in jb_main, failed to load %s\n", name[ch]);
+				return -1;
+			}
+			rc_filter_free(&D[ch]);
+		}
 	}
-	if (rc_filter_pid(&D5, D5_KP, D5_KI, D5_KD, 4 * DT, DT)) {
-		fprintf(stderr, "ERROR in jb_main, failed to make filter D3\n");
+
+	if (rc_seqlock_alloc(&imu_slot, sizeof(imu_sample_t)) ||
+		rc_seqlock_alloc(&batt_slot, sizeof(double)) ||
+		rc_seqlock_alloc(&print_slot, sizeof(print_snapshot_t))) {
+		fprintf(stderr, "ERROR in jb_main, failed to allocate shared slots\n");
 		return -1;
 	}
 
-	printf("Motor1 controller D1:\n");
-	rc_filter_print(D1);
-	printf("Motor4 controller D4:\n");
-	rc_filter_print(D4);
-	printf("Motor2 controller D2:\n");
-	rc_filter_print(D2);
-	printf("Motor3 controller D3:\n");
-	rc_filter_print(D3);
-	printf("Motor5 controller D3:\n");
-	rc_filter_print(D5);
-
 	// start a thread to slowly sample battery
 	if (adc_ok) {
 		if (rc_pthread_create(&battery_thread, __battery_checker, (void*)NULL, SCHED_OTHER, 0)) {
@@ -248,11 +328,13 @@ int main(int argc, char *argv[]) {
 		}
 	}
 	else { // If we can't get the battery voltage
-		cstate.vBatt = V_NOMINAL; // Set to a nominal value
+		double v_nominal = V_NOMINAL; // Set to a nominal value
+		rc_seqlock_write(&batt_slot, &v_nominal);
 	}
 
 	// wait for the battery thread to make the first read
-	while (cstate.vBatt < 1.0 && rc_get_state() != EXITING) rc_usleep(10000);
+	while (rc_seqlock_version(batt_slot) == 0 && rc_get_state() != EXITING) rc_usleep(10000);
+	rc_seqlock_read(&batt_slot, &cstate.vBatt);
 
 	// Start rc_read_thread to sample RC signals
 	if (rc_pthread_create(&rc_read_thread, __estop_reader, (void*)NULL, SCHED_OTHER, 0)) {
@@ -276,50 +358,76 @@ int main(int argc, char *argv[]) {
 		return -1;
 	}
 
-	// read in trajectory
-	fin = fopen(FILEIN, "r");
-	int rows;
-	fscanf(fin, "%*s %d", &rows);
-	// allocate memory then save trajectories to matrix	
-	trajec_mat = rc_matrix_empty();
-	if (rc_matrix_zeros(&trajec_mat, rows, 4)) {
-		fprintf(stderr, "ERROR: can't free memory for matrix");
-		return -1;
+	jb_plan_limits_t lim = jb_plan_default_limits();
+	if (smooth_path) {
+		// the whole path is fitted up front
+		if (jb_smooth_open(&smooth, FILEIN, &lim) < 0) {
+			fprintf(stderr, "ERROR: failed to plan a smooth path through %s\n", FILEIN);
+			return -1;
+		}
+		cstate.t_1 = smooth.s.t.d[0]; // assign first times
+		cstate.t_2 = smooth.s.t.d[1];
 	}
-	double pt; // storage variable for below
-	double pt2;
-	fscanf(fin, "%*s %*s %*s %*s"); // skip column headers
-
-	for (int i = 0; i < rows; ++i) {
-		// save trajectories to matrix
-		// & convert from m to radians
-		
-		fscanf(fin, "%lf", &(pt));
-		trajec_mat.d[i][0] = pt; // t
-		fscanf(fin, "%lf", &(pt));
-		fscanf(fin, "%lf", &(pt2));
-		trajec_mat.d[i][1] = (pt * cos(ANGLE_GLOBAL2OMNI) 
-			+ pt2 * sin(ANGLE_GLOBAL2OMNI))/WHEEL_RADIUS_XY; // x_r
-		trajec_mat.d[i][2] = (-pt * sin(ANGLE_GLOBAL2OMNI) 
-			+ pt2 * cos(ANGLE_GLOBAL2OMNI))/WHEEL_RADIUS_XY; // y_r
-		
-		fscanf(fin, "%lf", &(pt));
-		trajec_mat.d[i][3] = pt/WHEEL_RADIUS_Z; // z
-
-		if (trajec_mat.d[i][3]>(1/WHEEL_RADIUS_Z)) {
-			fprintf(stderr, "ERROR: Z height above 1 m limit");
+	else {
+		// check the whole trajectory file and plan the first few segments,
+		// the loader thread plans the rest while we go
+		if (jb_traj_stream_open(&traj, FILEIN, &lim) < 0) {
+			fprintf(stderr, "ERROR: failed to load trajectory from %s\n", FILEIN);
+			return -1;
+		}
+		if (traj.late > 0) {
+			printf("WARNING: %d waypoints in %s can't be reached on time within the\n", traj.late, FILEIN);
+			printf("velocity, acceleration and jerk limits, they will be late, see coord2trajec\n");
+		}
+		if (rc_pthread_create(&loader_thread, __traj_loader, (void*)NULL, SCHED_OTHER, 0)) {
+			fprintf(stderr, "failed to start trajectory loader thread\n");
 			return -1;
 		}
+		if ((replan_filename || mav_ip) && jb_replan_init(&traj, replan_filename, mav_ip)) {
+			fprintf(stderr, "ERROR: failed to start replanning\n");
+			return -1;
+		}
+		cstate.t_1 = traj.seg.t0; // assign first times
+		cstate.t_2 = traj.seg.t1;
 	}
 
-	// declare time (ms)
-	cstate.t_1 = trajec_mat.d[0][0]; // assign first times
-	cstate.t_2 = trajec_mat.d[1][0];
+	// start the telemetry writer before the controller produces records
+	if (log_filename && jb_telemetry_init(log_filename)) {
+		fprintf(stderr, "ERROR: failed to start telemetry log\n");
+		return -1;
+	}
+
+	// register trace probes, these cost one branch each when not tracing
+	trace_controller = rc_trace_register("controller");
+	trace_trajectory = rc_trace_register("trajectory");
+	trace_encoders = rc_trace_register("encoders");
+	trace_imu = rc_trace_register("imu");
+	trace_filters = rc_trace_register("filters");
+	trace_motors = rc_trace_register("motors");
+
+	// the DMP interrupt only samples the IMU, the controller runs from its
+	// own fixed-rate executor so its timing doesn't depend on the FIFO
+	rc_mpu_set_dmp_callback(&__imu_sample);
+	if (rc_periodic_init(&control_loop, SAMPLE_RATE_HZ, SCHED_FIFO, CONTROL_LOOP_PRIORITY)) {
+		fprintf(stderr, "ERROR: failed to set up control loop\n");
+		return -1;
+	}
+	if (rc_periodic_set_thread_init(&control_loop, &__control_thread_init)) {
+		fprintf(stderr, "ERROR: failed to set up control loop\n");
+		return -1;
+	}
+	if (rc_periodic_add_task(&control_loop, &__position_controller, 1)) {
+		fprintf(stderr, "ERROR: failed to add position controller\n");
+		return -1;
+	}
 
 	// this should be the last step in initialization
 	// to make sure other setup functions don't interfere
-	rc_mpu_set_dmp_callback(&__position_controller);
-	test_start = rc_nanos_since_boot(); // in ns, used to check if first run
+	if (rc_periodic_start(&control_loop)) {
+		fprintf(stderr, "ERROR: failed to start control loop\n");
+		return -1;
+	}
+	test_start = rc_nanos_since_boot(); // in ns, reset when first armed
 	rc_led_set(RC_LED_RED, 0);
 	rc_led_set(RC_LED_GREEN, 1);
 
@@ -329,19 +437,39 @@ int main(int argc, char *argv[]) {
 		rc_usleep(200000);
 	}
 
+	// stop the controller first so nothing drives the motors during cleanup
+	rc_periodic_stop(&control_loop, 1.5);
+	printf("\ncontrol loop timing:\n");
+	rc_periodic_print_stats(&control_loop);
+	jb_telemetry_cleanup();
+
 	// join parallel threads
 	if (printf_thread) rc_pthread_timed_join(printf_thread, NULL, 1.5);
 	if (battery_thread) rc_pthread_timed_join(battery_thread, NULL, 1.5);
 	if (rc_read_thread) rc_pthread_timed_join(rc_read_thread, NULL, 1.5);
+	if (loader_thread) rc_pthread_timed_join(loader_thread, NULL, 1.5);
+	jb_replan_cleanup();
+	if (traj.replan_late > 0) {
+		printf("%d replanned waypoints couldn't be reached on time within the\n", traj.replan_late);
+		printf("velocity, acceleration and jerk limits\n");
+	}
+	if (traj.starved > 0) {
+		printf("waited %d control periods for the trajectory loader\n", traj.starved);
+	}
+	if (smooth.stretch > 1.0) {
+		printf("the smooth path took %.2f times as long as %s asks to stay within\n", smooth.stretch, FILEIN);
+		printf("the velocity, acceleration and jerk limits, see coord2trajec -p\n");
+	}
 
 	// final cleanup
-	rc_filter_free(&D1);
-	rc_filter_free(&D4);
-	rc_filter_free(&D2);
-	rc_filter_free(&D3);
-	rc_filter_free(&D5);
+	rc_filter_bank_free(&motor_bank);
 	jb_rc_motor_cleanup();
+	if (smooth_path) jb_smooth_free(&smooth);
+	else jb_traj_stream_close(&traj);
 	rc_mpu_power_off();
+	rc_seqlock_free(&imu_slot);
+	rc_seqlock_free(&batt_slot);
+	rc_seqlock_free(&print_slot);
 	rc_led_set(RC_LED_GREEN, 0);
 	rc_led_set(RC_LED_RED, 0);
 	rc_led_cleanup();
@@ -352,141 +480,67 @@ int main(int argc, char *argv[]) {
 }
 
 /**
-* helper function to update setpoint based on a trapezoidal
-* velocity model to reach specified destination
+* runs in the control loop thread before its first cycle so the trace
+* histograms aren't allocated in a traced cycle
 */
-static void __traject_new(void) {
-	// update current time, ms
-	cstate.t_curr = rc_nanos_since_boot() / 1000000;
-
-	// check if trajectory makes sense, more than just a start
-	if (trajec_mat.rows < 2) {
-		printf("ERROR: trajectory not filled");
-		__disarm_controller();
-	}
+static void __control_thread_init(void)
+{
+	rc_trace_thread_init();
+}
 
-	// desired state = step + 1
-	// current/prev state = step
-	if (cstate.step + 2 < trajec_mat.rows) {
-		// not yet aiming for final destination
-		// update desired destination and time if surpassed
-		if ((double)(cstate.t_curr - test_start) / 1000 >=
-			trajec_mat.d[cstate.step + 1][0]) {
-			++cstate.step;
-			cstate.t_1 = trajec_mat.d[cstate.step][0]; // previous time, s
-			cstate.t_2 = trajec_mat.d[cstate.step + 1][0]; // next time, s
-		}
-	}
-	else {
-		// aiming for final destination
-		if ((double)(cstate.t_curr - test_start) / 1000 >=
-			trajec_mat.d[cstate.step + 1][0]) {
-			__disarm_controller();
-			printf("Final destination reached. Thank you for choosing JerboBot Express.");
-			cstate.v_xr_des = 0;
-			cstate.v_yr_des = 0;
-			rc_set_state(EXITING);
-			return;
-		}
-	}
 
-	// check times make sense
-	if (cstate.t_1 > cstate.t_2) {
-		fprintf(stderr, "ERROR: can't travel backwards in time :(");
-		return;
-	}
+/**
+* helper function to update setpoint from the planned jerk limited
+* profile, see jb_traj_stream.h, or the smooth path, see jb_smooth.h
+*/
+static void __traject_new(void) {
+	int done;
+	double pos[JB_TRAJ_AXES], vel[JB_TRAJ_AXES];
+	const double* p_start;
+	uint64_t now = rc_nanos_since_boot();
+	double t = (double)(now - test_start) / 1e9;
 
-	// time since beginning of current maneuver
-	double t_test = (double)(cstate.t_curr - test_start) / 1000
-			- cstate.t_1;
+	// update current time, ms
+	cstate.t_curr = now / 1000000;
 
-	double xr_diff = trajec_mat.d[cstate.step + 1][1] -
-		trajec_mat.d[cstate.step][1];
-	int xr_sign = (xr_diff > 0) - (xr_diff < 0);
-	double yr_diff = trajec_mat.d[cstate.step + 1][2] -
-		trajec_mat.d[cstate.step][2];
-	int yr_sign = (yr_diff > 0) - (yr_diff < 0);
-	double z_diff = trajec_mat.d[cstate.step + 1][3] -
-		trajec_mat.d[cstate.step][3];
-	int z_sign = (z_diff > 0) - (z_diff < 0);
-		
-	// update differences to be magnitude only
-	xr_diff *= xr_sign;
-	yr_diff *= yr_sign;
-	z_diff *= z_sign;
-	// solutions for acceleration (and deacc) time for trapezoidal profile
-	double t_ax = ((cstate.t_2 - cstate.t_1 -
-			pow(pow((cstate.t_2 - cstate.t_1), 2) - 4 * xr_diff / ACCEL_MAX, .5)) / 2);
-	double t_ay = ((cstate.t_2 - cstate.t_1 -
-			pow(pow((cstate.t_2 - cstate.t_1), 2) - 4 * yr_diff / ACCEL_MAX, .5)) / 2);
-
-	// assign desired x_r velocity based on trapezoidal profile
-	if (t_test <= t_ax) {
-		// accelerating, trapezoid left
-		cstate.v_xr_des = xr_sign * ACCEL_MAX * t_test;
-	}
-	else if (t_test >= cstate.t_2 - cstate.t_1 - t_ax) {
-		// decelerating, trapezoid right
-		cstate.v_xr_des = xr_sign * ACCEL_MAX *
-			(cstate.t_2 - cstate.t_1 - t_test);
+	if (smooth_path) {
+		done = jb_smooth_eval(&smooth, t, pos, vel, NULL);
+		p_start = smooth.p_start;
 	}
 	else {
-		// constant velocity, trapezoid plateau
-		cstate.v_xr_des = xr_sign * ACCEL_MAX * t_ax;
+		done = jb_traj_stream_eval(&traj, t, pos, vel);
+		p_start = traj.p_start;
 	}
-
-	// similarly, for y_r
-	if (t_test <= t_ay) {
-		cstate.v_yr_des = yr_sign * ACCEL_MAX * t_test;
+	// when replanning, hold at the last waypoint until new ones come in
+	if (done && !replan_filename && !mav_ip) {
+		__disarm_controller();
+		printf("Final destination reached. Thank you for choosing JerboBot Express.");
+		cstate.v_xr_des = 0;
+		cstate.v_yr_des = 0;
+		cstate.v_z_des = 0;
+		rc_set_state(EXITING);
+		return;
 	}
-	else if (t_test >= cstate.t_2 - cstate.t_1 - t_ay) {
-		cstate.v_yr_des = yr_sign * ACCEL_MAX *
-			(cstate.t_2 - cstate.t_1 - t_test);
+	if (smooth_path) {
+		cstate.step = smooth.s.last;
+		cstate.t_1 = smooth.s.t.d[smooth.s.last]; // previous time, s
+		cstate.t_2 = smooth.s.t.d[smooth.s.last + 1]; // next time, s
 	}
 	else {
-		cstate.v_yr_des = yr_sign * ACCEL_MAX * t_ay;
-	}
-
-	// z actuation depends on direction due to weight of arm
-	if (z_sign > 0) {
-		// driving upwards
-		double t_az = ((cstate.t_2 - cstate.t_1 -
-			pow(pow((cstate.t_2 - cstate.t_1), 2) - 4 * z_diff / ACCEL_Z_U, .5)) / 2);
-		
-		if (t_test <= t_az) {
-			cstate.v_z_des = z_sign * ACCEL_Z_U * t_test;
-		}
-		else if (t_test >= cstate.t_2 - cstate.t_1 - t_az) {
-			cstate.v_z_des = z_sign * ACCEL_Z_U *
-				(cstate.t_2 - cstate.t_1 - t_test);
-		}
-		else {
-			cstate.v_z_des = z_sign * ACCEL_Z_U * t_az;
-		}
-	}
-	else {
-		// driving downwards
-		double t_az = ((cstate.t_2 - cstate.t_1 -
-			pow(pow((cstate.t_2 - cstate.t_1), 2) - 4 * z_diff / ACCEL_Z_D, .5)) / 2);
-		
-		if (t_test <= t_az) {
-			cstate.v_z_des = - ACCEL_Z_D * t_test;
-		}
-		else if (t_test >= cstate.t_2 - cstate.t_1 - t_az) {
-			cstate.v_z_des = - ACCEL_Z_D *
-				(cstate.t_2 - cstate.t_1 - t_test);
-		}
-		else {
-			cstate.v_z_des = - ACCEL_Z_D * t_az;
-		}
+		cstate.step = traj.index;
+		cstate.t_1 = traj.seg.t0 + traj.t_shift; // previous time, s
+		cstate.t_2 = traj.seg.t1 + traj.t_shift; // next time, s
 	}
-
-	// update desired state
-	setpoint.wheelAngle1 += (cstate.v_xr_des * DT); // /wheel_radius_xy
-	setpoint.wheelAngle4 += (cstate.v_xr_des * DT);
-	setpoint.wheelAngle2 += (cstate.v_yr_des * DT);
-	setpoint.wheelAngle3 += (cstate.v_yr_des * DT);
-	setpoint.wheelAngle5 += (cstate.v_z_des * DT);
+	cstate.v_xr_des = vel[0];
+	cstate.v_yr_des = vel[1];
+	cstate.v_z_des = vel[2];
+
+	// update desired state, wheels start at 0 at the first waypoint
+	setpoint.wheelAngle1 = pos[0] - p_start[0];
+	setpoint.wheelAngle4 = pos[0] - p_start[0];
+	setpoint.wheelAngle2 = pos[1] - p_start[1];
+	setpoint.wheelAngle3 = pos[1] - p_start[1];
+	setpoint.wheelAngle5 = pos[2] - p_start[2];
 }
 
 /**
@@ -498,18 +552,17 @@ static void __position_controller(void)
 	static int inner_saturation_counter = 0;
 	double duty1, duty4, duty2, duty3, duty5;
 
-	// if we got here the state is RUNNING, but controller is not
-	// necessarily armed. If DISARMED, wait for the user to pick MIP up
-	// which will we detected by wait_for_starting_condition()
-	while (setpoint.arm_state == DISARMED) {
-		// wait for arming by estop_reader
-		rc_usleep(50000); 
-	}
+	// nothing to do until the estop_reader arms the controller, return
+	// instead of sleeping so the executor keeps its schedule
+	if (setpoint.arm_state == DISARMED) return;
+	RC_TRACE_BEGIN(t_controller);
 
 	/**
 	* updating desired state
 	*/
+	RC_TRACE_BEGIN(t_trajectory);
 	__traject_new();
+	RC_TRACE_END(trace_trajectory, t_trajectory);
 
 	/******************************************************************
 	* STATE_ESTIMATION
@@ -522,15 +575,35 @@ static void __position_controller(void)
 	double wheel3_old = cstate.wheelAngle3;
 	double wheel5_old = cstate.wheelAngle5;
 
-	cstate.wheelAngle1 = (rc_encoder_read(ENCODER_CHANNEL_1) * 2.0 * M_PI) \
+	// all four wheels from one snapshot so odometry combines angles taken at
+	// the same instant. On a failed read keep the last one, dAngle becomes 0.
+	RC_TRACE_BEGIN(t_encoders);
+	rc_encoder_snapshot_t snap;
+	double enc_vel[RC_ENCODER_CHANNELS];
+	if (rc_encoder_snapshot(&snap) == 0) {
+		if (enc_snap.t_ns != 0 &&
+			rc_encoder_velocity(&enc_snap, &snap, enc_vel) == 0) {
+			cstate.wheelSpeed1 = (enc_vel[ENCODER_CHANNEL_1 - 1] * 2.0 * M_PI) \
+				/ (ENCODER_POLARITY_1 * GEARBOX_XY * ENCODER_RES);
+			cstate.wheelSpeed2 = (enc_vel[ENCODER_CHANNEL_2 - 1] * 2.0 * M_PI) \
+				/ (ENCODER_POLARITY_2 * GEARBOX_XY * ENCODER_RES);
+			cstate.wheelSpeed3 = (enc_vel[ENCODER_CHANNEL_3 - 1] * 2.0 * M_PI) \
+				/ (ENCODER_POLARITY_3 * GEARBOX_XY * ENCODER_RES);
+			cstate.wheelSpeed4 = (enc_vel[ENCODER_CHANNEL_4 - 1] * 2.0 * M_PI) \
+				/ (ENCODER_POLARITY_4 * GEARBOX_XY * ENCODER_RES);
+		}
+		enc_snap = snap;
+	}
+	cstate.wheelAngle1 = (enc_snap.counts[ENCODER_CHANNEL_1 - 1] * 2.0 * M_PI) \
 		/ (ENCODER_POLARITY_1 * GEARBOX_XY * ENCODER_RES);
-	cstate.wheelAngle2 = (rc_encoder_read(ENCODER_CHANNEL_2) * 2.0 * M_PI) \
+	cstate.wheelAngle2 = (enc_snap.counts[ENCODER_CHANNEL_2 - 1] * 2.0 * M_PI) \
 		/ (ENCODER_POLARITY_2 * GEARBOX_XY * ENCODER_RES);
-	cstate.wheelAngle3 = (rc_encoder_read(ENCODER_CHANNEL_3) * 2.0 * M_PI) \
+	cstate.wheelAngle3 = (enc_snap.counts[ENCODER_CHANNEL_3 - 1] * 2.0 * M_PI) \
 		/ (ENCODER_POLARITY_3 * GEARBOX_XY * ENCODER_RES);
-	cstate.wheelAngle4 = (rc_encoder_read(ENCODER_CHANNEL_4) * 2.0 * M_PI) \
+	cstate.wheelAngle4 = (enc_snap.counts[ENCODER_CHANNEL_4 - 1] * 2.0 * M_PI) \
 		/ (ENCODER_POLARITY_4 * GEARBOX_XY * ENCODER_RES);
-	
+	RC_TRACE_END(trace_encoders, t_encoders);
+
 	/*
 	* INPUT YOUR EXTERNALLY READ ENCODER COUNTS HERE vvv
 	*/
@@ -539,12 +612,15 @@ static void __position_controller(void)
 		/ (ENCODER_POLARITY_5 * GEARBOX_Z * ENCODER_RES);
 	
 
-	if (rc_mpu_read_accel(&mpu_data) < 0) {
-		printf("read accel data failed\n");
-	}
-	if (rc_mpu_read_gyro(&mpu_data) < 0) {
-		printf("read gyro data failed\n");
-	}
+	// latest IMU sample from the DMP thread, no blocking I2C reads here
+	RC_TRACE_BEGIN(t_imu);
+	imu_sample_t imu;
+	rc_seqlock_read(&imu_slot, &imu);
+	cstate.a_x = imu.accel[0];
+	cstate.a_y = imu.accel[1];
+	cstate.theta_dot = imu.gyro[2] * DEG_TO_RAD;
+	rc_seqlock_read(&batt_slot, &cstate.vBatt);
+	RC_TRACE_END(trace_imu, t_imu);
 
 	// find change in encoder position
 	double dAngle1 = cstate.wheelAngle1 - wheel1_old;
@@ -584,21 +660,25 @@ static void __position_controller(void)
 	* Input to D1 is theta error (setpoint-state). Then scale the
 	* output u to compensate for changing battery voltage.
 	*************************************************************/
-	D1.gain = D1_GAIN * V_NOMINAL / cstate.vBatt; // comp for batt voltage
-	D2.gain = D2_GAIN * V_NOMINAL / cstate.vBatt;
-	D3.gain = D3_GAIN * V_NOMINAL / cstate.vBatt;
-	D4.gain = D4_GAIN * V_NOMINAL / cstate.vBatt;
-	D5.gain = D5_GAIN * V_NOMINAL / cstate.vBatt;
-	cstate.d1_u = rc_filter_march(&D1, setpoint.wheelAngle1
-		- cstate.wheelAngle1);
-	cstate.d4_u = rc_filter_march(&D4, setpoint.wheelAngle4
-		- cstate.wheelAngle4);
-	cstate.d2_u = rc_filter_march(&D2, setpoint.wheelAngle2
-		- cstate.wheelAngle2);
-	cstate.d3_u = rc_filter_march(&D3, setpoint.wheelAngle3
-		- cstate.wheelAngle3);
-	cstate.d5_u = rc_filter_march(&D5, setpoint.wheelAngle5
-		- cstate.wheelAngle5);
+	RC_TRACE_BEGIN(t_filters);
+	double err[N_MOTOR_CH], u[N_MOTOR_CH];
+	motor_bank.gain[CH_D1] = D1_GAIN * V_NOMINAL / cstate.vBatt; // comp for batt voltage
+	motor_bank.gain[CH_D2] = D2_GAIN * V_NOMINAL / cstate.vBatt;
+	motor_bank.gain[CH_D3] = D3_GAIN * V_NOMINAL / cstate.vBatt;
+	motor_bank.gain[CH_D4] = D4_GAIN * V_NOMINAL / cstate.vBatt;
+	motor_bank.gain[CH_D5] = D5_GAIN * V_NOMINAL / cstate.vBatt;
+	err[CH_D1] = setpoint.wheelAngle1 - cstate.wheelAngle1;
+	err[CH_D4] = setpoint.wheelAngle4 - cstate.wheelAngle4;
+	err[CH_D2] = setpoint.wheelAngle2 - cstate.wheelAngle2;
+	err[CH_D3] = setpoint.wheelAngle3 - cstate.wheelAngle3;
+	err[CH_D5] = setpoint.wheelAngle5 - cstate.wheelAngle5;
+	rc_filter_bank_march(&motor_bank, err, u);
+	cstate.d1_u = u[CH_D1];
+	cstate.d4_u = u[CH_D4];
+	cstate.d2_u = u[CH_D2];
+	cstate.d3_u = u[CH_D3];
+	cstate.d5_u = u[CH_D5];
+	RC_TRACE_END(trace_filters, t_filters);
 
 	/*************************************************************
 	* Check if the inner loop saturated. If it saturates for over
@@ -626,15 +706,86 @@ static void __position_controller(void)
 	duty2 = cstate.d2_u;
 	duty3 = cstate.d3_u;
 	duty5 = cstate.d5_u;
-	jb_rc_motor_set(MOTOR_CHANNEL_1, MOTOR_POLARITY_1 * duty1);
-	jb_rc_motor_set(MOTOR_CHANNEL_4, MOTOR_POLARITY_4 * duty4);
-	jb_rc_motor_set(MOTOR_CHANNEL_2, MOTOR_POLARITY_2 * duty2);
-	jb_rc_motor_set(MOTOR_CHANNEL_3, MOTOR_POLARITY_3 * duty3);
-	jb_rc_motor_set(MOTOR_CHANNEL_5, MOTOR_POLARITY_5 * duty5);
-
+	RC_TRACE_BEGIN(t_motors);
+	double duty[5];	// indexed by motor channel, committed in one call
+	duty[MOTOR_CHANNEL_1 - 1] = MOTOR_POLARITY_1 * duty1;
+	duty[MOTOR_CHANNEL_4 - 1] = MOTOR_POLARITY_4 * duty4;
+	duty[MOTOR_CHANNEL_2 - 1] = MOTOR_POLARITY_2 * duty2;
+	duty[MOTOR_CHANNEL_3 - 1] = MOTOR_POLARITY_3 * duty3;
+	duty[MOTOR_CHANNEL_5 - 1] = MOTOR_POLARITY_5 * duty5;
+	jb_rc_motor_set_all(duty);
+	RC_TRACE_END(trace_motors, t_motors);
+
+	__log_cycle();
+	// hand the print loop a consistent copy instead of the live globals
+	print_snapshot_t shown = { .cstate = cstate, .setpoint = setpoint };
+	rc_seqlock_write(&print_slot, &shown);
+
+	RC_TRACE_END(trace_controller, t_controller);
 	return;
 }
 
+/**
+* queue a telemetry record for this control cycle, called at the end of the
+* controller so the record is a consistent snapshot. Never blocks.
+*/
+static void __log_cycle(void)
+{
+	jb_telemetry_record_t rec;
+	rec.t_ns = rc_nanos_since_boot() - test_start;
+	rec.step = cstate.step;
+	rec.armed = (setpoint.arm_state == ARMED);
+	rec.wheel[0] = cstate.wheelAngle1;
+	rec.wheel[1] = cstate.wheelAngle2;
+	rec.wheel[2] = cstate.wheelAngle3;
+	rec.wheel[3] = cstate.wheelAngle4;
+	rec.wheel[4] = cstate.wheelAngle5;
+	rec.wheel_sp[0] = setpoint.wheelAngle1;
+	rec.wheel_sp[1] = setpoint.wheelAngle2;
+	rec.wheel_sp[2] = setpoint.wheelAngle3;
+	rec.wheel_sp[3] = setpoint.wheelAngle4;
+	rec.wheel_sp[4] = setpoint.wheelAngle5;
+	rec.wheel_vel[0] = cstate.wheelSpeed1;
+	rec.wheel_vel[1] = cstate.wheelSpeed2;
+	rec.wheel_vel[2] = cstate.wheelSpeed3;
+	rec.wheel_vel[3] = cstate.wheelSpeed4;
+	rec.wheel_vel[4] = 0;
+	rec.u[0] = cstate.d1_u;
+	rec.u[1] = cstate.d2_u;
+	rec.u[2] = cstate.d3_u;
+	rec.u[3] = cstate.d4_u;
+	rec.u[4] = cstate.d5_u;
+	rec.v_des[0] = cstate.v_xr_des;
+	rec.v_des[1] = cstate.v_yr_des;
+	rec.v_des[2] = cstate.v_z_des;
+	rec.x = cstate.x;
+	rec.y = cstate.y;
+	rec.theta = cstate.theta;
+	rec.x_r = cstate.x_r;
+	rec.y_r = cstate.y_r;
+	rec.z = cstate.z;
+	rec.a_x = cstate.a_x;
+	rec.a_y = cstate.a_y;
+	rec.theta_dot = cstate.theta_dot;
+	rec.v_batt = cstate.vBatt;
+	jb_telemetry_push(&rec);
+}
+
+/**
+* called by the DMP thread for every new IMU sample, copies it out for the
+* controller so sensor acquisition and control run independently
+*/
+static void __imu_sample(void)
+{
+	imu_sample_t imu;
+	int i;
+	for (i = 0; i < 3; i++) {
+		imu.accel[i] = mpu_data.accel[i];
+		imu.gyro[i] = mpu_data.gyro[i];
+	}
+	rc_seqlock_write(&imu_slot, &imu);
+}
+
 /**
  * Clear the controller's memory and zero out setpoints.
  *
@@ -642,11 +793,7 @@ static void __position_controller(void)
  */
 static int __zero_out_controller(void)
 {
-	rc_filter_reset(&D1);
-	rc_filter_reset(&D4);
-	rc_filter_reset(&D2);
-	rc_filter_reset(&D3);
-	rc_filter_reset(&D5);
+	rc_filter_bank_reset(&motor_bank);
 	//setpoint.wheelAngle1 = 0.0;
 	jb_rc_motor_set(0, 0.0);
 	jb_rc_motor_set(4,0.0); // 0 has a bug, doesn't include motor4&5
@@ -688,18 +835,16 @@ static int __arm_controller(void)
 
 /**
  * prints diagnostics to console this only gets started if executing from
- * terminal
+ * terminal. Full-rate data goes to the telemetry log instead, see -f.
  *
  * @return     nothing, NULL pointer
  */
 static void* __print_loop(__attribute__((unused)) void* ptr)
 {
 	rc_state_t last_rc_state, new_rc_state; // keep track of last state
+	FILE* fout = stdout;
+	print_snapshot_t snap;
 	last_rc_state = rc_get_state();
-	if (!fout) {
-		printf("WARNING: Not saving output to file\n");
-		fout = stdout; // print to terminal if no filename
-	}
 	while (rc_get_state() != EXITING) {
 		new_rc_state = rc_get_state();
 		// check if this is the first time since being paused
@@ -737,35 +882,37 @@ static void* __print_loop(__attribute__((unused)) void* ptr)
 
 		// decide what to print or exit
 		if (new_rc_state == RUNNING && setpoint.arm_state==ARMED) {
-			double x_r = cstate.x * cos(ANGLE_GLOBAL2OMNI + cstate.theta)
-				+ cstate.y * sin(ANGLE_GLOBAL2OMNI + cstate.theta);
-			double y_r = -cstate.x * sin(ANGLE_GLOBAL2OMNI + cstate.theta)
-				+ cstate.y * cos(ANGLE_GLOBAL2OMNI + cstate.theta);
+			rc_seqlock_read(&print_slot, &snap);
+			double x_r = snap.cstate.x * cos(ANGLE_GLOBAL2OMNI + snap.cstate.theta)
+				+ snap.cstate.y * sin(ANGLE_GLOBAL2OMNI + snap.cstate.theta);
+			double y_r = -snap.cstate.x * sin(ANGLE_GLOBAL2OMNI + snap.cstate.theta)
+				+ snap.cstate.y * cos(ANGLE_GLOBAL2OMNI + snap.cstate.theta);
 
 			fprintf(fout, "\r");
-			fprintf(fout, "%7.3f  ", (double)(cstate.t_curr - test_start) / 1000);
-			fprintf(fout, "%7.3f  ", cstate.wheelAngle1);
-			fprintf(fout, "%7.3f  ", setpoint.wheelAngle1);
-			fprintf(fout, "%7.3f  ", cstate.wheelAngle2);
-			fprintf(fout, "%7.3f  ", setpoint.wheelAngle2);
-			fprintf(fout, "%7.3f  ", cstate.wheelAngle3);
-			fprintf(fout, "%7.3f  ", setpoint.wheelAngle3);
-			fprintf(fout, "%7.3f  ", cstate.wheelAngle4);
-			fprintf(fout, "%7.3f  ", setpoint.wheelAngle4);
-			fprintf(fout, "%7.3f  ", cstate.v_xr_des);
-			fprintf(fout, "%7.3f  ", cstate.v_yr_des);
-			fprintf(fout, "%7.3f  ", cstate.x);
-			fprintf(fout, "%7.3f  ", cstate.y);
+			// t_curr is in ms, test_start in ns
+			fprintf(fout, "%7.3f  ", (double)(snap.cstate.t_curr - test_start / 1000000) / 1000);
+			fprintf(fout, "%7.3f  ", snap.cstate.wheelAngle1);
+			fprintf(fout, "%7.3f  ", snap.setpoint.wheelAngle1);
+			fprintf(fout, "%7.3f  ", snap.cstate.wheelAngle2);
+			fprintf(fout, "%7.3f  ", snap.setpoint.wheelAngle2);
+			fprintf(fout, "%7.3f  ", snap.cstate.wheelAngle3);
+			fprintf(fout, "%7.3f  ", snap.setpoint.wheelAngle3);
+			fprintf(fout, "%7.3f  ", snap.cstate.wheelAngle4);
+			fprintf(fout, "%7.3f  ", snap.setpoint.wheelAngle4);
+			fprintf(fout, "%7.3f  ", snap.cstate.v_xr_des);
+			fprintf(fout, "%7.3f  ", snap.cstate.v_yr_des);
+			fprintf(fout, "%7.3f  ", snap.cstate.x);
+			fprintf(fout, "%7.3f  ", snap.cstate.y);
 			fprintf(fout, "%7.3f  ", x_r);
 			fprintf(fout, "%7.3f  ", y_r);
-			fprintf(fout, "%7.5f  ", cstate.theta);
-			fprintf(fout, "%7.3f  ", cstate.d1_u);
-			fprintf(fout, "%7.3f  ", cstate.d2_u);
-			fprintf(fout, "%7.3f  ", cstate.d3_u);
-			fprintf(fout, "%7.3f  ", cstate.d4_u);
-			fprintf(fout, "%7.5f  ", mpu_data.accel[0]);
-			fprintf(fout, "%7.5f  ", mpu_data.accel[1]);
-			fprintf(fout, "%7.5f  ", mpu_data.gyro[2] * DEG_TO_RAD);
+			fprintf(fout, "%7.5f  ", snap.cstate.theta);
+			fprintf(fout, "%7.3f  ", snap.cstate.d1_u);
+			fprintf(fout, "%7.3f  ", snap.cstate.d2_u);
+			fprintf(fout, "%7.3f  ", snap.cstate.d3_u);
+			fprintf(fout, "%7.3f  ", snap.cstate.d4_u);
+			fprintf(fout, "%7.5f  ", snap.cstate.a_x);
+			fprintf(fout, "%7.5f  ", snap.cstate.a_y);
+			fprintf(fout, "%7.5f  ", snap.cstate.theta_dot);
 			//fprintf(fout, "\n");
 		}
 		rc_usleep(1000000 / PRINTF_HZ);
@@ -786,12 +933,29 @@ static void* __battery_checker(__attribute__((unused)) void* ptr)
 		new_v = rc_adc_batt();
 		// if the value doesn't make sense, use nominal voltage
 		if (new_v > 13 || new_v < 10.0) new_v = V_NOMINAL;
-		cstate.vBatt = new_v;
+		rc_seqlock_write(&batt_slot, &new_v);
 		rc_usleep(1000000 / BATTERY_CHECK_HZ);
 	}
 	return NULL;
 }
 
+/**
+* Plans the trajectory file a window ahead of the control loop until it has
+* all been planned, see jb_traj_stream.h.
+*
+* @return     nothing, NULL poitner
+*/
+static void* __traj_loader(__attribute__((unused)) void* ptr)
+{
+	int ret = 0;
+	while (rc_get_state() != EXITING && ret == 0) {
+		ret = jb_traj_stream_fill(&traj);
+		if (ret < 0) fprintf(stderr, "ERROR: trajectory ends early, can't read %s\n", FILEIN);
+		rc_usleep(1000000 / TRAJ_LOADER_HZ);
+	}
+	return NULL;
+}
+
 static void* __estop_reader(__attribute__((unused)) void* ptr)
 {
 	double FB_drive_stick, LR_drive_stick, arm_drive_stick; // for input sticks
@@ -829,10 +993,11 @@ static void* __estop_reader(__attribute__((unused)) void* ptr)
 				fprintf(stderr, "ERROR: Saturated switch\n");
 			}
 
-			if (test_start > 999999999 && e_stop_switch >= 1100) {
+			if (!test_armed && e_stop_switch >= 1100) {
 				// first time initializing test_start 
 				// wait for armed controller
-				test_start = rc_nanos_since_boot() / 1000000; // ms
+				test_start = rc_nanos_since_boot(); // ns, like the trajectory and log times
+				test_armed = 1;
 				__arm_controller();
 			}
 		}
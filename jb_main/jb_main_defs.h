@@ -8,6 +8,8 @@
 #define RC_BALANCE_CONFIG
 
 #define FILEIN			"trajectory.txt" // update this depending on input filename
+#define Z_HEIGHT_MAX		1.0 // highest z allowed in a trajectory file (m)
+#define MAV_SYSTEM_ID		1 // MAVLink system id, see jb_main -m
 
  // Structural properties of JerboBot
 #define GEARBOX_XY			26.851
@@ -22,6 +24,10 @@
 							// ^^^ was 10 for earlier, testing limits
 #define ACCEL_Z_U			30
 #define ACCEL_Z_D			30 // may need to tune down to ~10
+#define VEL_MAX			35	// rad/s, leaves headroom below SIM_FREE_SPEED_XY
+#define JERK_MAX			500	// rad/s3, ramps ACCEL_MAX in 0.1 s
+#define VEL_Z_MAX			100	// rad/s, leaves headroom below SIM_FREE_SPEED_Z
+#define JERK_Z_MAX			300	// rad/s3
 
 // inner test loop controller, 100 hz?
 #define D1_KP				10
@@ -82,7 +88,9 @@
 #define PRINTF_HZ		50
 #define SAMPLE_RATE_HZ		200
 #define RC_READER_HZ	20
+#define TRAJ_LOADER_HZ		20	// plans JB_TRAJ_WINDOW segments ahead, see jb_traj_stream.h
 #define DT					0.005
+#define CONTROL_LOOP_PRIORITY	80	// SCHED_FIFO priority of the controller
 
 // other
 #define TIP_ANGLE		0.85
@@ -92,4 +100,12 @@
 #define ENABLE_POSITION_HOLD	1
 #define SOFT_START_SEC		0.2
 
+// simulation model, only used when built with make sim
+#define SIM_SPEEDUP		0	// x real time, 0 runs as fast as possible
+#define SIM_SUBSTEPS		10	// physics steps per controller tick
+#define SIM_FREE_SPEED_XY	40.0	// wheel speed at full duty, V_NOMINAL (rad/s)
+#define SIM_FREE_SPEED_Z	150.0	// arm roller speed at full duty (rad/s)
+#define SIM_MOTOR_TAU		0.05	// motor mechanical time constant (s)
+#define SIM_V_BATT		11.1	// simulated battery voltage
+
 #endif	// endif RC_BALANCE_CONFIG
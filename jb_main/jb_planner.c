@@ -0,0 +1,192 @@
+/**
+ * jb_planner.c
+ *
+ * S-curve planning of straight line segments, see jb_planner.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jb_main_defs.h"
+#include "jb_planner.h"
+
+
+jb_plan_limits_t jb_plan_default_limits(void)
+{
+	jb_plan_limits_t lim = {
+		.v_max = {VEL_MAX, VEL_MAX, VEL_Z_MAX},
+		.a_pos = {ACCEL_MAX, ACCEL_MAX, ACCEL_Z_U},
+		.a_neg = {ACCEL_MAX, ACCEL_MAX, ACCEL_Z_D},
+		.j_max = {JERK_MAX, JERK_MAX, JERK_Z_MAX}
+	};
+	return lim;
+}
+
+
+void jb_plan_global_to_axes(const jb_waypoint_t* in, jb_waypoint_t* out, int n)
+{
+	int i;
+	double x, y;
+	for (i = 0; i < n; i++) {
+		x = in[i].p[0];
+		y = in[i].p[1];
+		out[i].t = in[i].t;
+		out[i].p[0] = (x * cos(ANGLE_GLOBAL2OMNI) + y * sin(ANGLE_GLOBAL2OMNI)) / WHEEL_RADIUS_XY;
+		out[i].p[1] = (-x * sin(ANGLE_GLOBAL2OMNI) + y * cos(ANGLE_GLOBAL2OMNI)) / WHEEL_RADIUS_XY;
+		out[i].p[2] = in[i].p[2] / WHEEL_RADIUS_Z;
+	}
+}
+
+
+/**
+ * fastest rest to rest S-curve covering progress 0 to 1 within velocity V,
+ * acceleration A and jerk J, returns its duration
+ */
+static double __scurve(jb_traj_profile_t* p, double V, double A, double J)
+{
+	int k;
+	double tj, ta, tv, vpeak, dt[JB_TRAJ_PHASES];
+
+	// time to ramp the acceleration up, and to hold it, on the way to V
+	if (V * J >= A * A) {
+		tj = A / J;
+		ta = V / A - tj;
+	}
+	else {
+		tj = sqrt(V / J);
+		ta = 0.0;
+	}
+	// speeding up to vpeak and slowing down again covers vpeak*(2*tj+ta)
+	vpeak = J * tj * (tj + ta);
+	if (vpeak * (2.0 * tj + ta) <= 1.0) {
+		tv = (1.0 - vpeak * (2.0 * tj + ta)) / vpeak;
+	}
+	else {
+		// too short to reach V, 2*A^3/J^2 is the distance that just reaches A
+		tv = 0.0;
+		if (2.0 * A * A * A <= J * J) {
+			tj = A / J;
+			ta = 0.5 * (sqrt(tj * tj + 4.0 / A) - 3.0 * tj);
+		}
+		else {
+			tj = cbrt(0.5 / J);
+			ta = 0.0;
+		}
+	}
+
+	dt[0] = tj;	p->j[0] = J;	// acceleration ramps up
+	dt[1] = ta;	p->j[1] = 0.0;	// constant acceleration
+	dt[2] = tj;	p->j[2] = -J;	// acceleration ramps down
+	dt[3] = tv;	p->j[3] = 0.0;	// cruise
+	dt[4] = tj;	p->j[4] = -J;	// deceleration ramps up
+	dt[5] = ta;	p->j[5] = 0.0;	// constant deceleration
+	dt[6] = tj;	p->j[6] = J;	// deceleration ramps down
+
+	// integrate each phase exactly to get the state at the next one
+	p->t[0] = 0.0;
+	p->s[0] = 0.0;
+	p->v[0] = 0.0;
+	p->a[0] = 0.0;
+	for (k = 0; k < JB_TRAJ_PHASES; k++) {
+		p->t[k + 1] = p->t[k] + dt[k];
+		if (k + 1 == JB_TRAJ_PHASES) break;
+		p->s[k + 1] = p->s[k] + dt[k] * (p->v[k] + dt[k] * (0.5 * p->a[k] + dt[k] * p->j[k] / 6.0));
+		p->v[k + 1] = p->v[k] + dt[k] * (p->a[k] + 0.5 * dt[k] * p->j[k]);
+		p->a[k + 1] = p->a[k] + dt[k] * p->j[k];
+	}
+	return p->t[JB_TRAJ_PHASES];
+}
+
+
+int jb_plan_check_limits(const jb_plan_limits_t* lim)
+{
+	int i;
+	if (lim == NULL) {
+		fprintf(stderr, "ERROR in jb_plan_check_limits, received NULL pointer\n");
+		return -1;
+	}
+	for (i = 0; i < JB_TRAJ_AXES; i++) {
+		if (!(lim->v_max[i] > 0.0 && lim->a_pos[i] > 0.0 &&
+				lim->a_neg[i] > 0.0 && lim->j_max[i] > 0.0)) {
+			fprintf(stderr, "ERROR in jb_plan_check_limits, limits must be positive\n");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+double jb_plan_segment(jb_traj_segment_t* seg, const jb_waypoint_t* from,
+		const jb_waypoint_t* to, double t0, const jb_plan_limits_t* lim)
+{
+	int i;
+	double d, V = HUGE_VAL, A = HUGE_VAL, J = HUGE_VAL, T, k;
+	double t_req = to->t;
+
+	seg->t0 = t0;
+	for (i = 0; i < JB_TRAJ_AXES; i++) {
+		d = to->p[i] - from->p[i];
+		seg->p0[i] = from->p[i];
+		seg->d[i] = d;
+		if (d > 0.0 || d < 0.0) {
+			// limits on progress along the line from the limits of this axis
+			V = fmin(V, lim->v_max[i] / fabs(d));
+			A = fmin(A, ((d > 0.0) ? lim->a_pos[i] : lim->a_neg[i]) / fabs(d));
+			J = fmin(J, lim->j_max[i] / fabs(d));
+		}
+	}
+	// not moving, just wait until it's time to go on
+	if (isinf(V)) {
+		memset(&seg->prof, 0, sizeof(seg->prof));
+		seg->prof.t[JB_TRAJ_PHASES] = fmax(t_req - t0, 0.0);
+		seg->t1 = t0 + seg->prof.t[JB_TRAJ_PHASES];
+		return seg->t1;
+	}
+	T = __scurve(&seg->prof, V, A, J);
+	// time to spare, the same S-curve stretched by k in time has its
+	// velocity, acceleration and jerk scaled by 1/k, 1/k^2 and 1/k^3
+	if (t_req - t0 > T) {
+		k = (t_req - t0) / T;
+		T = __scurve(&seg->prof, V / k, A / (k * k), J / (k * k * k));
+	}
+	seg->t1 = t0 + T;
+	return seg->t1;
+}
+
+
+int jb_plan_trajectory(jb_traj_t* tr, const jb_waypoint_t* wp, int n, const jb_plan_limits_t* lim)
+{
+	int i, late = 0;
+	double t;
+	jb_traj_segment_t* seg;
+
+	if (tr == NULL || wp == NULL || lim == NULL) {
+		fprintf(stderr, "ERROR in jb_plan_trajectory, received NULL pointer\n");
+		return -1;
+	}
+	if (n < 2) {
+		fprintf(stderr, "ERROR in jb_plan_trajectory, need at least 2 waypoints\n");
+		return -1;
+	}
+	if (jb_plan_check_limits(lim)) return -1;
+	seg = malloc((n - 1) * sizeof(jb_traj_segment_t));
+	if (seg == NULL) {
+		fprintf(stderr, "ERROR in jb_plan_trajectory, failed to allocate segments\n");
+		return -1;
+	}
+
+	t = wp[0].t;
+	for (i = 0; i < n - 1; i++) {
+		t = jb_plan_segment(&seg[i], &wp[i], &wp[i + 1], t, lim);
+		// allow for rounding in the stretched duration
+		if (t > wp[i + 1].t + 1e-9) late++;
+	}
+
+	jb_traj_free(tr);
+	tr->seg = seg;
+	tr->n = n - 1;
+	tr->cur = 0;
+	return late;
+}
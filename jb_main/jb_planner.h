@@ -0,0 +1,118 @@
+/**
+ * jb_planner.h
+ *
+ * @brief      Jerk limited, time synchronized trajectory planner.
+ *
+ * Turns a list of waypoints into a jb_traj_t. Between each pair of waypoints
+ * all three axes move together along the straight line joining them so they
+ * start and arrive at the same moment. Progress along the line follows the
+ * fastest S-curve that keeps every axis within its own velocity, acceleration
+ * and jerk limits, so the axis closest to its limits sets the pace and the
+ * others scale down with it. Limiting jerk ramps the wheel torque instead of
+ * stepping it, which is what lets the acceleration limits go up without
+ * kicking the omni wheels or saturating D1-D5.
+ *
+ * Waypoint times are when the robot should arrive at the latest. A segment
+ * that could go faster is stretched to arrive on time, one that can't is
+ * planned as fast as the limits allow and the rest of the trajectory shifts
+ * later. jb_plan_trajectory returns how many waypoints will be late.
+ *
+ * The planner has no hardware dependencies so coord2trajec can run it offline
+ * to check a trajectory file before it goes on the robot.
+ */
+
+#ifndef JB_PLANNER_H
+#define JB_PLANNER_H
+
+#include "jb_trajectory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief      A waypoint as read from a trajectory file (see jb_traj_io.h), in
+ * global coordinates (m) or converted to axis coordinates (wheel rad) with
+ * jb_plan_global_to_axes.
+ */
+typedef struct jb_waypoint_t {
+	double t;			///< latest arrival time since the start (s)
+	double p[JB_TRAJ_AXES];		///< x y z, or x_r y_r z once converted
+} jb_waypoint_t;
+
+/**
+ * @brief      Limits of each axis in axis units, rad, rad/s and so on.
+ */
+typedef struct jb_plan_limits_t {
+	double v_max[JB_TRAJ_AXES];	///< velocity
+	double a_pos[JB_TRAJ_AXES];	///< acceleration while moving in the + direction
+	double a_neg[JB_TRAJ_AXES];	///< acceleration while moving in the - direction
+	double j_max[JB_TRAJ_AXES];	///< jerk
+} jb_plan_limits_t;
+
+/**
+ * @brief      Limits from jb_main_defs.h: VEL_MAX, ACCEL_MAX and JERK_MAX for
+ * x_r and y_r, VEL_Z_MAX, ACCEL_Z_U, ACCEL_Z_D and JERK_Z_MAX for z.
+ *
+ * @return     the default limits
+ */
+jb_plan_limits_t jb_plan_default_limits(void);
+
+/**
+ * @brief      Converts waypoints from global coordinates in m to the rotated
+ * omni frame in wheel radians that the planner and controller work in.
+ *
+ * @param[in]  in    waypoints in global coordinates
+ * @param[out] out   converted waypoints, may be the same array as in
+ * @param[in]  n     number of waypoints
+ */
+void jb_plan_global_to_axes(const jb_waypoint_t* in, jb_waypoint_t* out, int n);
+
+/**
+ * @brief      Checks every limit is positive.
+ *
+ * @param[in]  lim   limits to check
+ *
+ * @return     0 if they can be planned with, -1 otherwise
+ */
+int jb_plan_check_limits(const jb_plan_limits_t* lim);
+
+/**
+ * @brief      Plans the segment from one waypoint to the next.
+ *
+ * This is the step jb_plan_trajectory repeats for each pair of waypoints,
+ * for planning a few segments at a time as waypoints are streamed in. The
+ * limits are not checked here, see jb_plan_check_limits.
+ *
+ * @param[out] seg   segment to fill
+ * @param[in]  from  waypoint to start from, its time is not used
+ * @param[in]  to    waypoint to go to, to arrive by its time if possible
+ * @param[in]  t0    start time, the arrival time of the previous segment
+ * @param[in]  lim   limits of each axis
+ *
+ * @return     arrival time, later than to->t if it couldn't be reached on time
+ */
+double jb_plan_segment(jb_traj_segment_t* seg, const jb_waypoint_t* from,
+		const jb_waypoint_t* to, double t0, const jb_plan_limits_t* lim);
+
+/**
+ * @brief      Plans a trajectory through the waypoints.
+ *
+ * The first segment starts at the first waypoint's time. A waypoint that
+ * repeats the previous position is a pause until its time. tr is left
+ * untouched on failure.
+ *
+ * @param      tr    trajectory to fill, freed first if already planned
+ * @param[in]  wp    waypoints in axis coordinates
+ * @param[in]  n     number of waypoints, at least 2
+ * @param[in]  lim   limits of each axis, all must be positive
+ *
+ * @return     number of waypoints reached later than their time, -1 on error
+ */
+int jb_plan_trajectory(jb_traj_t* tr, const jb_waypoint_t* wp, int n, const jb_plan_limits_t* lim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JB_PLANNER_H
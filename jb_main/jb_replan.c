@@ -0,0 +1,185 @@
+/**
+ * jb_replan.c
+ *
+ * Runtime waypoint sources and the replanning thread, see jb_replan.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <rc/mavlink_udp.h>
+#include <rc/mavlink_udp_helpers.h>
+#include <rc/pthread.h>
+#include <rc/time.h>
+
+#include "jb_main_defs.h"
+#include "jb_replan.h"
+
+static jb_traj_stream_t* stream = NULL;
+static const char* watch_name = NULL;
+static struct stat watch_last;		// when the watched file last changed
+static int mav_running = 0;
+static pthread_t replan_thread = 0;
+static atomic_int running = 0;
+static atomic_int mav_new = 0;		// set by the MAVLink thread
+
+// latest request, from whichever thread submitted it
+static pthread_mutex_t req_lock = PTHREAD_MUTEX_INITIALIZER;
+static jb_waypoint_t req[JB_REPLAN_MAX];
+static int req_n = 0;
+static int req_new = 0;
+
+
+static void __mav_target_received(void)
+{
+	atomic_store(&mav_new, 1);
+}
+
+
+/**
+ * submits the watched file if it changed since last time
+ */
+static void __check_file(void)
+{
+	int n;
+	struct stat s;
+	jb_waypoint_t* wp;
+
+	if (stat(watch_name, &s)) return;
+	if (s.st_mtim.tv_sec == watch_last.st_mtim.tv_sec &&
+			s.st_mtim.tv_nsec == watch_last.st_mtim.tv_nsec &&
+			s.st_size == watch_last.st_size && s.st_ino == watch_last.st_ino) return;
+	watch_last = s;
+
+	n = jb_wp_load(watch_name, &wp);
+	if (n < 0) {
+		fprintf(stderr, "ERROR: ignoring %s\n", watch_name);
+		return;
+	}
+	if (jb_replan_submit(wp, n) == 0) printf("\nreplanning through %d waypoints from %s\n", n, watch_name);
+	free(wp);
+}
+
+
+/**
+ * submits the latest MAVLink position target if there's a new one
+ */
+static void __check_mavlink(void)
+{
+	mavlink_set_position_target_local_ned_t msg;
+	jb_waypoint_t wp;
+
+	if (!atomic_exchange(&mav_new, 0)) return;
+	if (rc_mav_get_set_position_target_local_ned(&msg)) return;
+	// bits 0-2 set means x, y and z are to be ignored
+	if (msg.coordinate_frame != MAV_FRAME_LOCAL_NED || (msg.type_mask & 0x7) == 0x7) {
+		fprintf(stderr, "ERROR: ignoring MAVLink position target, need MAV_FRAME_LOCAL_NED positions\n");
+		return;
+	}
+	wp.t = 0.0;
+	wp.p[0] = msg.x;
+	wp.p[1] = msg.y;
+	wp.p[2] = -msg.z;
+	jb_replan_submit(&wp, 1);
+}
+
+
+static void* __replan_loop(__attribute__((unused)) void* ptr)
+{
+	int n = 0, fresh;
+	jb_waypoint_t wp[JB_REPLAN_MAX];	// axis coordinates
+
+	while (atomic_load(&running)) {
+		if (watch_name != NULL) __check_file();
+		if (mav_running) __check_mavlink();
+
+		pthread_mutex_lock(&req_lock);
+		fresh = req_new;
+		if (fresh) {
+			n = req_n;
+			jb_plan_global_to_axes(req, wp, n);
+			req_new = 0;
+		}
+		pthread_mutex_unlock(&req_lock);
+
+		// plan again if the robot moved on to another segment before the
+		// control loop could take the last plan
+		if (fresh || (n > 0 && jb_traj_stream_plan_stale(stream))) {
+			if (jb_traj_stream_replan(stream, wp, n)) n = 0;
+		}
+		rc_usleep(1000000 / JB_REPLAN_HZ);
+	}
+	return NULL;
+}
+
+
+int jb_replan_init(jb_traj_stream_t* st, const char* watch_file, const char* mav_ip)
+{
+	if (st == NULL) {
+		fprintf(stderr, "ERROR in jb_replan_init, received NULL pointer\n");
+		return -1;
+	}
+	if (atomic_load(&running)) {
+		fprintf(stderr, "ERROR in jb_replan_init, already running\n");
+		return -1;
+	}
+	stream = st;
+	watch_name = watch_file;
+	// only changes from now on count, not whatever was there before
+	memset(&watch_last, 0, sizeof(watch_last));
+	if (watch_name != NULL) stat(watch_name, &watch_last);
+
+	if (mav_ip != NULL) {
+		if (rc_mav_init(MAV_SYSTEM_ID, mav_ip, RC_MAV_DEFAULT_UDP_PORT, RC_MAV_DEFAULT_CONNECTION_TIMEOUT_US)) {
+			fprintf(stderr, "ERROR in jb_replan_init, failed to start MAVLink\n");
+			return -1;
+		}
+		rc_mav_set_callback(MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED, __mav_target_received);
+		mav_running = 1;
+	}
+
+	atomic_store(&running, 1);
+	if (rc_pthread_create(&replan_thread, __replan_loop, NULL, SCHED_OTHER, 0)) {
+		fprintf(stderr, "ERROR in jb_replan_init, failed to start replanning thread\n");
+		atomic_store(&running, 0);
+		if (mav_running) rc_mav_cleanup();
+		mav_running = 0;
+		return -1;
+	}
+	return 0;
+}
+
+
+int jb_replan_submit(const jb_waypoint_t* wp, int n)
+{
+	if (wp == NULL) {
+		fprintf(stderr, "ERROR in jb_replan_submit, received NULL pointer\n");
+		return -1;
+	}
+	if (n < 1 || n > JB_REPLAN_MAX) {
+		fprintf(stderr, "ERROR in jb_replan_submit, need 1 to %d waypoints\n", JB_REPLAN_MAX);
+		return -1;
+	}
+	pthread_mutex_lock(&req_lock);
+	memcpy(req, wp, n * sizeof(jb_waypoint_t));
+	req_n = n;
+	req_new = 1;
+	pthread_mutex_unlock(&req_lock);
+	return 0;
+}
+
+
+int jb_replan_cleanup(void)
+{
+	int ret = 0;
+	if (!atomic_load(&running)) return 0;
+	atomic_store(&running, 0);
+	if (replan_thread && rc_pthread_timed_join(replan_thread, NULL, 1.5)) ret = -1;
+	replan_thread = 0;
+	if (mav_running && rc_mav_cleanup()) ret = -1;
+	mav_running = 0;
+	return ret;
+}
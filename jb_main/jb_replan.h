@@ -0,0 +1,71 @@
+/**
+ * jb_replan.h
+ *
+ * @brief      Accepts new waypoints while jb_main is running and plans them
+ * on a background thread.
+ *
+ * Waypoints can come from three places:
+ *
+ * - a watched file, in any format jb_traj_io.h reads. Each time it changes
+ *   it is loaded and replaces the trajectory. Write it to a temporary name
+ *   and rename it over the watched one so a half written file is never read.
+ * - MAVLink SET_POSITION_TARGET_LOCAL_NED messages in MAV_FRAME_LOCAL_NED,
+ *   each one a single waypoint to go to as soon as the limits allow. NED z
+ *   points down so it is negated to get the arm height.
+ * - jb_replan_submit, from any other thread.
+ *
+ * Positions are global (m) like a trajectory file and times count from when
+ * the control loop takes the plan. The planning itself and the handover to
+ * the control loop are done by jb_traj_stream_replan, see jb_traj_stream.h,
+ * so the control loop never waits on any of this.
+ */
+
+#ifndef JB_REPLAN_H
+#define JB_REPLAN_H
+
+#include "jb_traj_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JB_REPLAN_HZ	20	///< rate sources are checked and stale plans redone
+
+/**
+ * @brief      Starts the replanning thread.
+ *
+ * @param      st          stream the control loop is following, must be open
+ * @param[in]  watch_file  file to watch for new waypoints, NULL for none
+ * @param[in]  mav_ip      address to send MAVLink heartbeats to, NULL to not
+ * listen for MAVLink position targets
+ *
+ * @return     0 on success, -1 on failure
+ */
+int jb_replan_init(jb_traj_stream_t* st, const char* watch_file, const char* mav_ip);
+
+/**
+ * @brief      Asks for the rest of the trajectory to be replaced.
+ *
+ * Copies the waypoints and returns, they are planned on the replanning
+ * thread. A later call before then replaces this one. Not for the control
+ * loop, it takes a mutex.
+ *
+ * @param[in]  wp    waypoints in global coordinates (m)
+ * @param[in]  n     number of waypoints, 1 to JB_REPLAN_MAX
+ *
+ * @return     0 on success, -1 on failure
+ */
+int jb_replan_submit(const jb_waypoint_t* wp, int n);
+
+/**
+ * @brief      Stops the replanning thread and MAVLink if it was started.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int jb_replan_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JB_REPLAN_H
@@ -0,0 +1,497 @@
+/**
+ * jb_sim.c
+ *
+ * Physical model of the JerboBot standing in for the hardware when jb_main is
+ * built with JB_SIM defined. See jb_sim.h for an overview.
+ */
+
+#define JB_SIM_IMPL
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <robotcontrol.h>
+
+#include "jb_sim.h"
+#include "jb_main_defs.h"
+
+#define WHEELS		5
+
+// wheel numbering follows jb_main, index = wheel number - 1
+static const int enc_ch[WHEELS] = {ENCODER_CHANNEL_1, ENCODER_CHANNEL_2,
+	ENCODER_CHANNEL_3, ENCODER_CHANNEL_4, ENCODER_CHANNEL_5};
+static const int enc_pol[WHEELS] = {ENCODER_POLARITY_1, ENCODER_POLARITY_2,
+	ENCODER_POLARITY_3, ENCODER_POLARITY_4, ENCODER_POLARITY_5};
+static const int mot_ch[WHEELS] = {MOTOR_CHANNEL_1, MOTOR_CHANNEL_2,
+	MOTOR_CHANNEL_3, MOTOR_CHANNEL_4, MOTOR_CHANNEL_5};
+static const int mot_pol[WHEELS] = {MOTOR_POLARITY_1, MOTOR_POLARITY_2,
+	MOTOR_POLARITY_3, MOTOR_POLARITY_4, MOTOR_POLARITY_5};
+static const double gearbox[WHEELS] = {GEARBOX_XY, GEARBOX_XY, GEARBOX_XY,
+	GEARBOX_XY, GEARBOX_Z};
+static const double free_speed[WHEELS] = {SIM_FREE_SPEED_XY, SIM_FREE_SPEED_XY,
+	SIM_FREE_SPEED_XY, SIM_FREE_SPEED_XY, SIM_FREE_SPEED_Z};
+
+static pthread_mutex_t sim_mutex = PTHREAD_MUTEX_INITIALIZER;
+static jb_sim_state_t sim;
+static double enc_offset[WHEELS];	// counts subtracted after rc_encoder_write
+static double v_global_old[2];		// for differentiating body acceleration
+static double accel_body[2];
+static double theta_dot;
+static int standby = 1;
+static int init_flag = 0;
+
+// imu/dmp emulation
+static rc_mpu_data_t* mpu_data_ptr = NULL;
+static void (*dmp_callback)(void) = NULL;
+static pthread_t sim_thread = 0;
+static rc_periodic_t* executor = NULL;
+
+
+static void __sim_init(void)
+{
+	if(init_flag) return;
+	memset(&sim, 0, sizeof(sim));
+	memset(enc_offset, 0, sizeof(enc_offset));
+	// start the virtual clock at real time so timestamps look familiar
+	sim.t_ns = rc_nanos_since_boot();
+	init_flag = 1;
+}
+
+
+static int __wheel_from_enc_ch(int ch)
+{
+	int i;
+	for(i=0;i<WHEELS;i++) if(enc_ch[i]==ch) return i;
+	return -1;
+}
+
+
+static int __wheel_from_mot_ch(int ch)
+{
+	int i;
+	for(i=0;i<WHEELS;i++) if(mot_ch[i]==ch) return i;
+	return -1;
+}
+
+
+static double __counts(int w)
+{
+	return enc_pol[w] * sim.wheel_angle[w] * gearbox[w] * ENCODER_RES / (2.0*M_PI);
+}
+
+
+uint64_t jb_sim_nanos_since_boot(void)
+{
+	uint64_t t;
+	__sim_init();
+	pthread_mutex_lock(&sim_mutex);
+	t = sim.t_ns;
+	pthread_mutex_unlock(&sim_mutex);
+	return t;
+}
+
+
+int jb_sim_get_state(jb_sim_state_t* state)
+{
+	if(state==NULL){
+		fprintf(stderr,"ERROR in jb_sim_get_state, received NULL pointer\n");
+		return -1;
+	}
+	pthread_mutex_lock(&sim_mutex);
+	*state = sim;
+	pthread_mutex_unlock(&sim_mutex);
+	return 0;
+}
+
+
+int jb_sim_step(double dt)
+{
+	int i;
+	double d[WHEELS], v_ss, v_g[2];
+	double dX_r, dY_r, dtheta, c, s;
+
+	if(dt<=0.0){
+		fprintf(stderr,"ERROR in jb_sim_step, dt must be positive\n");
+		return -1;
+	}
+	__sim_init();
+	pthread_mutex_lock(&sim_mutex);
+
+	// first order motor response toward duty-proportional speed
+	for(i=0;i<WHEELS;i++){
+		v_ss = standby ? 0.0 : sim.duty[i] * free_speed[i] * jb_sim_adc_batt() / V_NOMINAL;
+		sim.wheel_vel[i] += (v_ss - sim.wheel_vel[i]) * dt / (SIM_MOTOR_TAU + dt);
+		d[i] = sim.wheel_vel[i] * dt;
+		sim.wheel_angle[i] += d[i];
+	}
+
+	// same rigid omni kinematics as the odometry in jb_main
+	dX_r = 0.5 * WHEEL_RADIUS_XY * (d[0] + d[3]);
+	dY_r = 0.5 * WHEEL_RADIUS_XY * (d[1] + d[2]);
+	dtheta = (2 * WHEEL_RADIUS_XY / (4 * TRACK_WIDTH)) * (d[3] - d[0] + d[1] - d[2]);
+	c = cos(ANGLE_GLOBAL2OMNI + sim.theta);
+	s = sin(ANGLE_GLOBAL2OMNI + sim.theta);
+	sim.x += dX_r * c - dY_r * s;
+	sim.y += dX_r * s + dY_r * c;
+	sim.z += WHEEL_RADIUS_Z * d[4];
+	sim.theta += dtheta;
+	theta_dot = dtheta / dt;
+
+	// body frame acceleration for the imu
+	v_g[0] = (dX_r * c - dY_r * s) / dt;
+	v_g[1] = (dX_r * s + dY_r * c) / dt;
+	c = cos(sim.theta);
+	s = sin(sim.theta);
+	accel_body[0] = ( c*(v_g[0]-v_global_old[0]) + s*(v_g[1]-v_global_old[1])) / dt;
+	accel_body[1] = (-s*(v_g[0]-v_global_old[0]) + c*(v_g[1]-v_global_old[1])) / dt;
+	v_global_old[0] = v_g[0];
+	v_global_old[1] = v_g[1];
+
+	sim.t_ns += (uint64_t)(dt * 1000000000.0);
+	pthread_mutex_unlock(&sim_mutex);
+	return 0;
+}
+
+
+/**
+ * stands in for both the DMP interrupt thread and the periodic executor.
+ * Steps the model by one executor period, calls the DMP callback just like
+ * the real DMP would, then runs the executor's tasks that are due.
+ */
+static void* __sim_loop(__attribute__((unused)) void* ptr)
+{
+	int i;
+	uint64_t start, end, exec, next_wake = 0;
+	uint64_t cycle = 0;
+	rc_periodic_t* ex;
+	rc_periodic_t* started = NULL;
+
+	while(rc_get_state()!=EXITING){
+		ex = executor;
+		if(ex==NULL || !ex->running){
+			rc_usleep(1000);
+			continue;
+		}
+		// this thread is the executor thread, so it runs the setup hook
+		if(ex!=started){
+			if(ex->thread_init!=NULL) ex->thread_init();
+			started = ex;
+		}
+		for(i=0;i<SIM_SUBSTEPS;i++) jb_sim_step(ex->period_ns / (1e9 * SIM_SUBSTEPS));
+		if(mpu_data_ptr!=NULL){
+			jb_sim_mpu_read_accel(mpu_data_ptr);
+			jb_sim_mpu_read_gyro(mpu_data_ptr);
+			if(dmp_callback!=NULL) dmp_callback();
+		}
+		pthread_mutex_lock(&sim_mutex);
+		sim.steps++;
+		pthread_mutex_unlock(&sim_mutex);
+
+		// run due tasks, timing them against the real clock
+		start = rc_nanos_since_boot();
+		for(i=0;i<ex->ntasks;i++){
+			if(cycle % ex->tasks[i].divider) continue;
+			end = rc_nanos_since_boot();
+			ex->tasks[i].func();
+			exec = rc_nanos_since_boot() - end;
+			if(exec>ex->tasks[i].exec_max_ns) ex->tasks[i].exec_max_ns = exec;
+		}
+		end = rc_nanos_since_boot();
+		exec = end - start;
+		cycle++;
+
+		// virtual time has no wakeup jitter, only execution time
+		pthread_mutex_lock(&ex->stats_mutex);
+		ex->stats.cycles++;
+		ex->stats.hist[0]++;
+		if(exec>ex->stats.exec_max_ns) ex->stats.exec_max_ns = exec;
+		ex->stats.exec_mean_ns += ((double)exec - ex->stats.exec_mean_ns)/ex->stats.cycles;
+		pthread_mutex_unlock(&ex->stats_mutex);
+
+		// pace the virtual clock against real time if requested
+		if(SIM_SPEEDUP > 0){
+			if(next_wake < end) next_wake = end;
+			next_wake += (uint64_t)(ex->period_ns / (double)SIM_SPEEDUP);
+			if(next_wake > end) rc_nanosleep(next_wake - end);
+		}
+	}
+	return NULL;
+}
+
+
+int jb_sim_encoder_init(void)
+{
+	__sim_init();
+	return 0;
+}
+
+int jb_sim_encoder_cleanup(void)
+{
+	return 0;
+}
+
+int jb_sim_encoder_read(int ch)
+{
+	int w, ret;
+	w = __wheel_from_enc_ch(ch);
+	if(w<0){
+		fprintf(stderr,"ERROR in jb_sim_encoder_read, no wheel on channel %d\n", ch);
+		return -1;
+	}
+	pthread_mutex_lock(&sim_mutex);
+	ret = (int)(__counts(w) - enc_offset[w]);
+	pthread_mutex_unlock(&sim_mutex);
+	return ret;
+}
+
+int jb_sim_encoder_write(int ch, int pos)
+{
+	int w;
+	w = __wheel_from_enc_ch(ch);
+	if(w<0){
+		fprintf(stderr,"ERROR in jb_sim_encoder_write, no wheel on channel %d\n", ch);
+		return -1;
+	}
+	pthread_mutex_lock(&sim_mutex);
+	enc_offset[w] = __counts(w) - pos;
+	pthread_mutex_unlock(&sim_mutex);
+	return 0;
+}
+
+int jb_sim_encoder_snapshot(rc_encoder_snapshot_t* snap)
+{
+	int ch, w;
+	if(snap==NULL){
+		fprintf(stderr,"ERROR in jb_sim_encoder_snapshot, received NULL pointer\n");
+		return -1;
+	}
+	// the model only moves between ticks so every channel shares one instant
+	pthread_mutex_lock(&sim_mutex);
+	for(ch=1;ch<=RC_ENCODER_CHANNELS;ch++){
+		w = __wheel_from_enc_ch(ch);
+		snap->counts[ch-1] = (w<0) ? 0 : (int32_t)(__counts(w) - enc_offset[w]);
+		snap->ch_t_ns[ch-1] = sim.t_ns;
+	}
+	snap->t_ns = sim.t_ns;
+	pthread_mutex_unlock(&sim_mutex);
+	return 0;
+}
+
+
+int jb_sim_motor_init(void)
+{
+	__sim_init();
+	return 0;
+}
+
+int jb_sim_motor_cleanup(void)
+{
+	jb_sim_motor_free_spin(0);
+	return 0;
+}
+
+int jb_sim_motor_standby(int standby_en)
+{
+	pthread_mutex_lock(&sim_mutex);
+	standby = standby_en;
+	pthread_mutex_unlock(&sim_mutex);
+	if(standby_en) jb_sim_motor_free_spin(0);
+	return 0;
+}
+
+int jb_sim_motor_set(int ch, double duty)
+{
+	int w;
+	if(ch<0 || ch>WHEELS){
+		fprintf(stderr,"ERROR in jb_sim_motor_set, motor argument must be between 0 & %d\n", WHEELS);
+		return -1;
+	}
+	if	(duty > 1.0)	duty = 1.0;
+	else if	(duty <-1.0)	duty =-1.0;
+
+	if(ch==0){
+		for(w=1;w<=WHEELS;w++) jb_sim_motor_set(w, duty);
+		return 0;
+	}
+	w = __wheel_from_mot_ch(ch);
+	if(w<0) return 0; // unconnected channel
+	pthread_mutex_lock(&sim_mutex);
+	// undo the wiring polarity jb_main applies so +duty drives +angle
+	sim.duty[w] = mot_pol[w] * duty;
+	pthread_mutex_unlock(&sim_mutex);
+	return 0;
+}
+
+int jb_sim_motor_set_all(const double duty[5])
+{
+	int ch;
+	if(duty==NULL){
+		fprintf(stderr,"ERROR in jb_sim_motor_set_all, received NULL pointer\n");
+		return -1;
+	}
+	for(ch=1;ch<=WHEELS;ch++) jb_sim_motor_set(ch, duty[ch-1]);
+	return 0;
+}
+
+int jb_sim_motor_free_spin(int ch)
+{
+	return jb_sim_motor_set(ch, 0.0);
+}
+
+
+int jb_sim_adc_init(void)
+{
+	return 0;
+}
+
+int jb_sim_adc_cleanup(void)
+{
+	return 0;
+}
+
+double jb_sim_adc_batt(void)
+{
+	return SIM_V_BATT;
+}
+
+
+int jb_sim_dsm_init(void)
+{
+	return 0;
+}
+
+int jb_sim_dsm_cleanup(void)
+{
+	return 0;
+}
+
+int jb_sim_dsm_ch_raw(int ch)
+{
+	// e-stop switch on channel 5 is always released, sticks centered
+	if(ch==5) return 2000;
+	return 1500;
+}
+
+int jb_sim_dsm_is_new_data(void)
+{
+	return 1;
+}
+
+int jb_sim_dsm_is_connection_active(void)
+{
+	return 1;
+}
+
+
+int jb_sim_led_set(__attribute__((unused)) rc_led_t led, __attribute__((unused)) int value)
+{
+	return 0;
+}
+
+int jb_sim_led_blink(__attribute__((unused)) rc_led_t led, __attribute__((unused)) float hz,
+			__attribute__((unused)) float duration)
+{
+	return 0;
+}
+
+void jb_sim_led_cleanup(void)
+{
+	return;
+}
+
+
+int jb_sim_mpu_initialize_dmp(rc_mpu_data_t* data, __attribute__((unused)) rc_mpu_config_t conf)
+{
+	if(data==NULL){
+		fprintf(stderr,"ERROR in jb_sim_mpu_initialize_dmp, received NULL pointer\n");
+		return -1;
+	}
+	__sim_init();
+	mpu_data_ptr = data;
+	if(rc_pthread_create(&sim_thread, __sim_loop, NULL, SCHED_OTHER, 0)){
+		fprintf(stderr,"ERROR in jb_sim_mpu_initialize_dmp, failed to start sim thread\n");
+		return -1;
+	}
+	return 0;
+}
+
+int jb_sim_mpu_set_dmp_callback(void (*func)(void))
+{
+	if(func==NULL){
+		fprintf(stderr,"ERROR in jb_sim_mpu_set_dmp_callback, received NULL pointer\n");
+		return -1;
+	}
+	dmp_callback = func;
+	return 0;
+}
+
+int jb_sim_mpu_read_accel(rc_mpu_data_t* data)
+{
+	pthread_mutex_lock(&sim_mutex);
+	data->accel[0] = accel_body[0];
+	data->accel[1] = accel_body[1];
+	data->accel[2] = 9.80665;
+	pthread_mutex_unlock(&sim_mutex);
+	return 0;
+}
+
+int jb_sim_mpu_read_gyro(rc_mpu_data_t* data)
+{
+	pthread_mutex_lock(&sim_mutex);
+	data->gyro[0] = 0.0;
+	data->gyro[1] = 0.0;
+	data->gyro[2] = theta_dot * RAD_TO_DEG;
+	pthread_mutex_unlock(&sim_mutex);
+	return 0;
+}
+
+int jb_sim_mpu_is_gyro_calibrated(void)
+{
+	return 1;
+}
+
+int jb_sim_mpu_calibrate_gyro_routine(__attribute__((unused)) rc_mpu_config_t conf)
+{
+	return 0;
+}
+
+int jb_sim_mpu_power_off(void)
+{
+	if(sim_thread) rc_pthread_timed_join(sim_thread, NULL, 1.5);
+	sim_thread = 0;
+	dmp_callback = NULL;
+	// report where the model ended up
+	printf("\nsim: %llu ticks\n", (unsigned long long)sim.steps);
+	printf("sim: truth x=%7.3f y=%7.3f z=%7.3f theta=%7.4f\n",
+		sim.x, sim.y, sim.z, sim.theta);
+	return 0;
+}
+
+
+int jb_sim_periodic_init(rc_periodic_t* ex, double rate_hz,
+			__attribute__((unused)) int policy, __attribute__((unused)) int priority)
+{
+	// no real-time thread is needed, virtual time is never late
+	return rc_periodic_init(ex, rate_hz, SCHED_OTHER, 0);
+}
+
+int jb_sim_periodic_start(rc_periodic_t* ex)
+{
+	if(ex==NULL || !ex->initialized){
+		fprintf(stderr,"ERROR in jb_sim_periodic_start, executor not initialized\n");
+		return -1;
+	}
+	__sim_init();
+	ex->running = 1;
+	executor = ex;
+	return 0;
+}
+
+int jb_sim_periodic_stop(rc_periodic_t* ex, __attribute__((unused)) float timeout_sec)
+{
+	if(ex==NULL) return -1;
+	ex->running = 0;
+	executor = NULL;
+	return 0;
+}
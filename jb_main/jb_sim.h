@@ -0,0 +1,164 @@
+/**
+ * jb_sim.h
+ *
+ * @brief      Hardware-free simulation backend for jb_main
+ *
+ * When jb_main is built with JB_SIM defined (make sim) the hardware calls made
+ * by jb_main.c are redirected to the jb_sim_* functions below. Instead of
+ * talking to the eQEP/PRU encoders, PWM, GPIO, ADC, DSM receiver and the MPU,
+ * they drive a physical model of the 5-motor omni base built from the
+ * structural constants in jb_main_defs.h.
+ *
+ * The model runs on a virtual clock. A simulation thread takes the place of
+ * both the MPU DMP interrupt and the rc_periodic executor thread. Once per
+ * executor period of virtual time it steps the model, calls the DMP callback
+ * and runs the due executor tasks, SIM_SPEEDUP times faster than real time
+ * or as fast as possible when SIM_SPEEDUP is 0. jb_sim_nanos_since_boot
+ * returns virtual time so the trajectory follower sees a consistent clock.
+ *
+ * Each motor is modelled as a first-order DC motor whose steady-state wheel
+ * speed is proportional to duty cycle and battery voltage. Encoder counts are
+ * the wheel angles scaled by the gearbox and encoder resolution. The body pose
+ * is integrated from the same rigid omni kinematics jb_main uses for odometry
+ * and fed back to the simulated IMU.
+ */
+
+#ifndef JB_SIM_H
+#define JB_SIM_H
+
+#include <stdint.h>
+#include <rc/mpu.h>
+#include <rc/led.h>
+#include <rc/periodic.h>
+#include <rc/encoder.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief      Truth state of the simulated robot, for reporting and tests.
+ */
+typedef struct jb_sim_state_t {
+	double wheel_angle[5];	///< wheel angles (rad), indexed by wheel number-1
+	double wheel_vel[5];	///< wheel speeds (rad/s)
+	double duty[5];		///< last commanded duty per wheel after polarity
+	double x;		///< global position (m)
+	double y;
+	double z;		///< telescoping arm height (m)
+	double theta;		///< body yaw (rad)
+	uint64_t t_ns;		///< virtual time (ns)
+	uint64_t steps;		///< number of controller ticks simulated
+} jb_sim_state_t;
+
+/**
+ * @brief      Virtual time since boot in nanoseconds.
+ *
+ * Starts at the real rc_nanos_since_boot() value when the simulation is
+ * initialized and only advances as the model is stepped.
+ *
+ * @return     virtual nanoseconds since boot
+ */
+uint64_t jb_sim_nanos_since_boot(void);
+
+/**
+ * @brief      Copies the current truth state of the model.
+ *
+ * @param[out] state  Pointer to user's state struct
+ *
+ * @return     0 on success, -1 on failure
+ */
+int jb_sim_get_state(jb_sim_state_t* state);
+
+/**
+ * @brief      Advances the physical model by dt seconds of virtual time.
+ *
+ * Normally called by the simulation thread, exposed so offline tools can step
+ * the model without the thread.
+ *
+ * @param[in]  dt    time step in seconds
+ *
+ * @return     0 on success, -1 on failure
+ */
+int jb_sim_step(double dt);
+
+// simulated replacements for the hardware interface used by jb_main
+int jb_sim_encoder_init(void);
+int jb_sim_encoder_cleanup(void);
+int jb_sim_encoder_read(int ch);
+int jb_sim_encoder_write(int ch, int pos);
+int jb_sim_encoder_snapshot(rc_encoder_snapshot_t* snap);
+int jb_sim_motor_init(void);
+int jb_sim_motor_cleanup(void);
+int jb_sim_motor_standby(int standby_en);
+int jb_sim_motor_set(int ch, double duty);
+int jb_sim_motor_set_all(const double duty[5]);
+int jb_sim_motor_free_spin(int ch);
+int jb_sim_adc_init(void);
+int jb_sim_adc_cleanup(void);
+double jb_sim_adc_batt(void);
+int jb_sim_dsm_init(void);
+int jb_sim_dsm_cleanup(void);
+int jb_sim_dsm_ch_raw(int ch);
+int jb_sim_dsm_is_new_data(void);
+int jb_sim_dsm_is_connection_active(void);
+int jb_sim_led_set(rc_led_t led, int value);
+int jb_sim_led_blink(rc_led_t led, float hz, float duration);
+void jb_sim_led_cleanup(void);
+int jb_sim_mpu_initialize_dmp(rc_mpu_data_t* data, rc_mpu_config_t conf);
+int jb_sim_mpu_set_dmp_callback(void (*func)(void));
+int jb_sim_mpu_read_accel(rc_mpu_data_t* data);
+int jb_sim_mpu_read_gyro(rc_mpu_data_t* data);
+int jb_sim_mpu_is_gyro_calibrated(void);
+int jb_sim_mpu_calibrate_gyro_routine(rc_mpu_config_t conf);
+int jb_sim_mpu_power_off(void);
+int jb_sim_periodic_init(rc_periodic_t* ex, double rate_hz, int policy, int priority);
+int jb_sim_periodic_start(rc_periodic_t* ex);
+int jb_sim_periodic_stop(rc_periodic_t* ex, float timeout_sec);
+
+/*
+ * Redirect the hardware interface to the simulation. jb_sim.c defines
+ * JB_SIM_IMPL so it can still reach the real time and thread functions.
+ */
+#if defined(JB_SIM) && !defined(JB_SIM_IMPL)
+#define rc_nanos_since_boot		jb_sim_nanos_since_boot
+#define rc_encoder_init			jb_sim_encoder_init
+#define rc_encoder_init_mmap		jb_sim_encoder_init
+#define rc_encoder_cleanup		jb_sim_encoder_cleanup
+#define rc_encoder_read			jb_sim_encoder_read
+#define rc_encoder_write		jb_sim_encoder_write
+#define rc_encoder_snapshot		jb_sim_encoder_snapshot
+#define jb_rc_motor_init		jb_sim_motor_init
+#define jb_rc_motor_cleanup		jb_sim_motor_cleanup
+#define jb_rc_motor_standby		jb_sim_motor_standby
+#define jb_rc_motor_set			jb_sim_motor_set
+#define jb_rc_motor_set_all		jb_sim_motor_set_all
+#define jb_rc_motor_free_spin		jb_sim_motor_free_spin
+#define rc_adc_init			jb_sim_adc_init
+#define rc_adc_cleanup			jb_sim_adc_cleanup
+#define rc_adc_batt			jb_sim_adc_batt
+#define rc_dsm_init			jb_sim_dsm_init
+#define rc_dsm_cleanup			jb_sim_dsm_cleanup
+#define rc_dsm_ch_raw			jb_sim_dsm_ch_raw
+#define rc_dsm_is_new_data		jb_sim_dsm_is_new_data
+#define rc_dsm_is_connection_active	jb_sim_dsm_is_connection_active
+#define rc_led_set			jb_sim_led_set
+#define rc_led_blink			jb_sim_led_blink
+#define rc_led_cleanup			jb_sim_led_cleanup
+#define rc_mpu_initialize_dmp		jb_sim_mpu_initialize_dmp
+#define rc_mpu_set_dmp_callback		jb_sim_mpu_set_dmp_callback
+#define rc_mpu_read_accel		jb_sim_mpu_read_accel
+#define rc_mpu_read_gyro		jb_sim_mpu_read_gyro
+#define rc_mpu_is_gyro_calibrated	jb_sim_mpu_is_gyro_calibrated
+#define rc_mpu_calibrate_gyro_routine	jb_sim_mpu_calibrate_gyro_routine
+#define rc_mpu_power_off		jb_sim_mpu_power_off
+#define rc_periodic_init		jb_sim_periodic_init
+#define rc_periodic_start		jb_sim_periodic_start
+#define rc_periodic_stop		jb_sim_periodic_stop
+#endif // JB_SIM
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JB_SIM_H
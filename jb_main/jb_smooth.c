@@ -0,0 +1,195 @@
+/**
+ * jb_smooth.c
+ *
+ * Smooth path through every waypoint, see jb_smooth.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jb_traj_io.h"
+#include "jb_smooth.h"
+
+// samples per segment for the peak speed and acceleration, which are then
+// within about 0.3%, and the margin left for that
+#define PEAK_SAMPLES	32
+#define PEAK_MARGIN	1.01
+// rounds of giving segments more time before slowing the rest down evenly
+#define MAX_ROUNDS	20
+#define SETTLED		1.01
+
+
+/**
+ * peak speed, acceleration and jerk of each axis on segment i. Jerk
+ * 6c3 + 24c4 tau + 60c5 tau^2 is a parabola so its peak is exact, speed and
+ * acceleration are sampled.
+ */
+static void __segment_peaks(const rc_spline_t* s, int i, double v[JB_TRAJ_AXES],
+		double a[JB_TRAJ_AXES], double j[JB_TRAJ_AXES])
+{
+	int k, m;
+	double h, tau, x;
+	const double* c;
+
+	h = s->t.d[i + 1] - s->t.d[i];
+	for (k = 0; k < JB_TRAJ_AXES; k++) {
+		c = s->c.d[i * s->dim + k];
+		v[k] = a[k] = 0.0;
+		for (m = 0; m < PEAK_SAMPLES; m++) {
+			tau = h * m / (PEAK_SAMPLES - 1);
+			x = c[1] + tau * (2.0 * c[2] + tau * (3.0 * c[3] + tau * (4.0 * c[4] + tau * 5.0 * c[5])));
+			v[k] = fmax(v[k], fabs(x));
+			x = 2.0 * c[2] + tau * (6.0 * c[3] + tau * (12.0 * c[4] + tau * 20.0 * c[5]));
+			a[k] = fmax(a[k], fabs(x));
+		}
+		j[k] = fmax(fabs(6.0 * c[3]), fabs(6.0 * c[3] + h * (24.0 * c[4] + h * 60.0 * c[5])));
+		if (fabs(c[5]) > 0.0) {
+			tau = -c[4] / (5.0 * c[5]);
+			if (tau > 0.0 && tau < h) {
+				j[k] = fmax(j[k], fabs(6.0 * c[3] + tau * (24.0 * c[4] + tau * 60.0 * c[5])));
+			}
+		}
+	}
+}
+
+
+/**
+ * how many times too fast segment i is for the limits, at most 1 if it's
+ * within them
+ */
+static double __segment_excess(const rc_spline_t* s, int i, const jb_plan_limits_t* lim)
+{
+	int k;
+	double f = 0.0, v[JB_TRAJ_AXES], a[JB_TRAJ_AXES], j[JB_TRAJ_AXES];
+
+	// stretching time by f scales speed by 1/f, acceleration by 1/f^2 and
+	// jerk by 1/f^3
+	__segment_peaks(s, i, v, a, j);
+	for (k = 0; k < JB_TRAJ_AXES; k++) {
+		f = fmax(f, PEAK_MARGIN * v[k] / lim->v_max[k]);
+		f = fmax(f, sqrt(PEAK_MARGIN * a[k] / fmin(lim->a_pos[k], lim->a_neg[k])));
+		f = fmax(f, cbrt(j[k] / lim->j_max[k]));
+	}
+	return f;
+}
+
+
+int jb_smooth_plan(jb_smooth_t* sm, const jb_waypoint_t* wp, int n, const jb_plan_limits_t* lim)
+{
+	int i, k, iter, ret = -1;
+	double f, f_max, t_orig;
+	rc_vector_t t = RC_VECTOR_INITIALIZER;
+	rc_vector_t h = RC_VECTOR_INITIALIZER;
+	rc_matrix_t p = RC_MATRIX_INITIALIZER;
+
+	if (sm == NULL || wp == NULL || lim == NULL) {
+		fprintf(stderr, "ERROR in jb_smooth_plan, received NULL pointer\n");
+		return -1;
+	}
+	if (n < 2) {
+		fprintf(stderr, "ERROR in jb_smooth_plan, need at least 2 waypoints\n");
+		return -1;
+	}
+	if (jb_plan_check_limits(lim)) return -1;
+	for (i = 1; i < n; i++) {
+		if (!(wp[i].t > wp[i - 1].t)) {
+			fprintf(stderr, "ERROR in jb_smooth_plan, waypoint %d has the same time as the one before,\n", i);
+			fprintf(stderr, "a smooth path can't wait at a waypoint\n");
+			return -1;
+		}
+	}
+	if (rc_vector_alloc(&t, n) || rc_vector_alloc(&h, n - 1) ||
+			rc_matrix_alloc(&p, n, JB_TRAJ_AXES)) {
+		fprintf(stderr, "ERROR in jb_smooth_plan, failed to allocate memory\n");
+		goto out;
+	}
+	for (i = 0; i < n; i++) {
+		t.d[i] = wp[i].t;
+		for (k = 0; k < JB_TRAJ_AXES; k++) p.d[i][k] = wp[i].p[k];
+	}
+	for (i = 0; i < n - 1; i++) h.d[i] = wp[i + 1].t - wp[i].t;
+
+	// give each segment that is too fast more time and fit again. Changing
+	// one segment moves its neighbours a little so this takes a few rounds,
+	// whatever is left over is taken out by slowing the whole path down
+	for (iter = 0; ; iter++) {
+		if (rc_spline_quintic(&sm->s, t, p, RC_SPLINE_REST)) goto out;
+		f_max = 1.0;
+		for (i = 0; i < n - 1; i++) {
+			f = __segment_excess(&sm->s, i, lim);
+			f_max = fmax(f_max, f);
+			if (f > 1.0) h.d[i] *= f;
+		}
+		if (f_max <= SETTLED || iter == MAX_ROUNDS) break;
+		for (i = 0; i < n - 1; i++) t.d[i + 1] = t.d[i] + h.d[i];
+	}
+	if (f_max > 1.0 && rc_spline_scale_time(&sm->s, f_max)) goto out;
+
+	t_orig = wp[n - 1].t - wp[0].t;
+	sm->t0 = wp[0].t;
+	sm->t_end = sm->s.t.d[n - 1];
+	sm->stretch = (sm->t_end - sm->t0) / t_orig;
+	memcpy(sm->p_start, wp[0].p, sizeof(sm->p_start));
+	ret = 0;
+
+out:
+	rc_vector_free(&t);
+	rc_vector_free(&h);
+	rc_matrix_free(&p);
+	return ret;
+}
+
+
+int jb_smooth_open(jb_smooth_t* sm, const char* filename, const jb_plan_limits_t* lim)
+{
+	int n;
+	jb_waypoint_t* wp;
+
+	n = jb_wp_load(filename, &wp);
+	if (n < 0) return -1;
+	jb_plan_global_to_axes(wp, wp, n);
+	if (jb_smooth_plan(sm, wp, n, lim)) {
+		free(wp);
+		return -1;
+	}
+	free(wp);
+	return n;
+}
+
+
+int jb_smooth_eval(jb_smooth_t* sm, double t, double pos[JB_TRAJ_AXES],
+		double vel[JB_TRAJ_AXES], double acc[JB_TRAJ_AXES])
+{
+	// past the end the spline holds the last waypoint at rest
+	rc_spline_eval(&sm->s, t, pos, vel, acc);
+	return t >= sm->t_end;
+}
+
+
+void jb_smooth_peaks(const jb_smooth_t* sm, double v[JB_TRAJ_AXES],
+		double a[JB_TRAJ_AXES], double j[JB_TRAJ_AXES])
+{
+	int i, k;
+	double vs[JB_TRAJ_AXES], as[JB_TRAJ_AXES], js[JB_TRAJ_AXES];
+
+	for (k = 0; k < JB_TRAJ_AXES; k++) v[k] = a[k] = j[k] = 0.0;
+	for (i = 0; i < sm->s.knots - 1; i++) {
+		__segment_peaks(&sm->s, i, vs, as, js);
+		for (k = 0; k < JB_TRAJ_AXES; k++) {
+			v[k] = fmax(v[k], vs[k]);
+			a[k] = fmax(a[k], as[k]);
+			j[k] = fmax(j[k], js[k]);
+		}
+	}
+}
+
+
+void jb_smooth_free(jb_smooth_t* sm)
+{
+	jb_smooth_t empty = JB_SMOOTH_INITIALIZER;
+	if (sm == NULL) return;
+	rc_spline_free(&sm->s);
+	*sm = empty;
+}
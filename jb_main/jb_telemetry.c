@@ -0,0 +1,177 @@
+/**
+ * jb_telemetry.c
+ *
+ * Lock-free telemetry ring and background file writer, see jb_telemetry.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <rc/math/spsc_queue.h>
+#include <rc/pthread.h>
+#include <rc/time.h>
+
+#include "jb_telemetry.h"
+
+#define WRITE_BATCH	64	// records handed to fwrite at once
+
+// filled by the controller, emptied by the writer thread
+static rc_spsc_queue_t queue = RC_SPSC_QUEUE_INITIALIZER;
+
+static FILE* log_file = NULL;
+static pthread_t writer_thread = 0;
+static atomic_int running = 0;
+static unsigned long written = 0;	// only touched by the writer
+
+
+/**
+ * writes everything currently in the ring to the file
+ */
+static void __drain(void)
+{
+	int n;
+	jb_telemetry_record_t* run;
+	// hand contiguous runs straight from the queue to fwrite
+	while((run = rc_spsc_queue_peek(&queue, &n)) != NULL){
+		if(n > WRITE_BATCH) n = WRITE_BATCH;
+		if(fwrite(run, sizeof(jb_telemetry_record_t), n, log_file) != (size_t)n){
+			perror("ERROR in jb_telemetry, failed to write log");
+		}
+		written += n;
+		// hand the slots back to the producer
+		rc_spsc_queue_release(&queue, n);
+	}
+	fflush(log_file);
+}
+
+
+static void* __writer_loop(__attribute__((unused)) void* ptr)
+{
+	while(atomic_load(&running)){
+		__drain();
+		rc_usleep(1000000 / JB_TELEMETRY_WRITE_HZ);
+	}
+	__drain();
+	return NULL;
+}
+
+
+int jb_telemetry_init(const char* filename)
+{
+	jb_telemetry_header_t header;
+
+	if(filename==NULL){
+		fprintf(stderr,"ERROR in jb_telemetry_init, received NULL pointer\n");
+		return -1;
+	}
+	if(log_file!=NULL){
+		fprintf(stderr,"ERROR in jb_telemetry_init, already logging\n");
+		return -1;
+	}
+	log_file = fopen(filename, "wb");
+	if(log_file==NULL){
+		perror("ERROR in jb_telemetry_init, failed to open log file");
+		return -1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, JB_TELEMETRY_MAGIC, sizeof(header.magic));
+	header.version = JB_TELEMETRY_VERSION;
+	header.record_size = sizeof(jb_telemetry_record_t);
+	header.start_ns = rc_nanos_since_boot();
+	if(fwrite(&header, sizeof(header), 1, log_file) != 1){
+		perror("ERROR in jb_telemetry_init, failed to write header");
+		fclose(log_file);
+		log_file = NULL;
+		return -1;
+	}
+
+	if(rc_spsc_queue_alloc(&queue, JB_TELEMETRY_RING_SIZE, sizeof(jb_telemetry_record_t))){
+		fprintf(stderr,"ERROR in jb_telemetry_init, failed to allocate queue\n");
+		fclose(log_file);
+		log_file = NULL;
+		return -1;
+	}
+	written = 0;
+	atomic_store(&running, 1);
+	// low priority on purpose, the ring absorbs any delay in writing
+	if(rc_pthread_create(&writer_thread, __writer_loop, NULL, SCHED_OTHER, 0)){
+		fprintf(stderr,"ERROR in jb_telemetry_init, failed to start writer thread\n");
+		atomic_store(&running, 0);
+		fclose(log_file);
+		log_file = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+
+int jb_telemetry_push(const jb_telemetry_record_t* rec)
+{
+	if(!atomic_load_explicit(&running, memory_order_relaxed)) return -1;
+	return rc_spsc_queue_push(&queue, rec);
+}
+
+
+int jb_telemetry_cleanup(void)
+{
+	if(log_file==NULL) return 0;
+	atomic_store(&running, 0);
+	if(writer_thread) rc_pthread_timed_join(writer_thread, NULL, 2.0);
+	writer_thread = 0;
+	fclose(log_file);
+	log_file = NULL;
+	printf("telemetry: %lu records written, %lu dropped\n", written, rc_spsc_queue_dropped(queue));
+	rc_spsc_queue_free(&queue);
+	return 0;
+}
+
+
+int jb_telemetry_to_csv(const char* filename, FILE* out)
+{
+	FILE* in;
+	jb_telemetry_header_t header;
+	jb_telemetry_record_t r;
+	int i, n = 0;
+
+	if(filename==NULL || out==NULL){
+		fprintf(stderr,"ERROR in jb_telemetry_to_csv, received NULL pointer\n");
+		return -1;
+	}
+	in = fopen(filename, "rb");
+	if(in==NULL){
+		perror("ERROR in jb_telemetry_to_csv, failed to open log");
+		return -1;
+	}
+	if(fread(&header, sizeof(header), 1, in) != 1 ||
+			strncmp(header.magic, JB_TELEMETRY_MAGIC, sizeof(header.magic))){
+		fprintf(stderr,"ERROR in jb_telemetry_to_csv, %s is not a telemetry log\n", filename);
+		fclose(in);
+		return -1;
+	}
+	if(header.version != JB_TELEMETRY_VERSION ||
+			header.record_size != sizeof(jb_telemetry_record_t)){
+		fprintf(stderr,"ERROR in jb_telemetry_to_csv, log version %u record size %u not supported\n",
+			header.version, header.record_size);
+		fclose(in);
+		return -1;
+	}
+
+	fprintf(out, "t,step,armed");
+	for(i=1;i<=5;i++) fprintf(out, ",wh_%d,wh_%ds", i, i);
+	for(i=1;i<=5;i++) fprintf(out, ",wh_%dv", i);
+	for(i=1;i<=5;i++) fprintf(out, ",d%d_u", i);
+	fprintf(out, ",v_xr_des,v_yr_des,v_z_des,x,y,theta,x_r,y_r,z,a_x,a_y,theta_dot,v_batt\n");
+	while(fread(&r, sizeof(r), 1, in) == 1){
+		fprintf(out, "%.6f,%d,%d", r.t_ns/1e9, r.step, r.armed);
+		for(i=0;i<5;i++) fprintf(out, ",%.6f,%.6f", r.wheel[i], r.wheel_sp[i]);
+		for(i=0;i<5;i++) fprintf(out, ",%.6f", r.wheel_vel[i]);
+		for(i=0;i<5;i++) fprintf(out, ",%.6f", r.u[i]);
+		fprintf(out, ",%.6f,%.6f,%.6f", r.v_des[0], r.v_des[1], r.v_des[2]);
+		fprintf(out, ",%.6f,%.6f,%.6f,%.6f,%.6f,%.6f", r.x, r.y, r.theta, r.x_r, r.y_r, r.z);
+		fprintf(out, ",%.6f,%.6f,%.6f,%.4f\n", r.a_x, r.a_y, r.theta_dot, r.v_batt);
+		n++;
+	}
+	fclose(in);
+	return n;
+}
@@ -0,0 +1,108 @@
+/**
+ * jb_telemetry.h
+ *
+ * @brief      Full-rate binary telemetry logging for jb_main
+ *
+ * The control loop pushes one fixed-size record per cycle into a bounded
+ * single-producer/single-consumer ring. Pushing never blocks, allocates or does
+ * I/O; if the ring is full the record is dropped and counted. A low-priority
+ * writer thread drains the ring to a binary file made of a small versioned
+ * header followed by the raw records.
+ *
+ * jb_telemetry_to_csv converts a log back to CSV offline, which is what
+ * jb_main -c does.
+ */
+
+#ifndef JB_TELEMETRY_H
+#define JB_TELEMETRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JB_TELEMETRY_MAGIC	"JBLOG"
+#define JB_TELEMETRY_VERSION	2
+#define JB_TELEMETRY_RING_SIZE	1024	///< records, must be a power of two
+#define JB_TELEMETRY_WRITE_HZ	20	///< rate the writer thread drains the ring
+
+/**
+ * @brief      One control cycle. Angles in rad, positions in m, wheel order
+ * 1 2 3 4 5 as numbered in jb_main.
+ */
+typedef struct jb_telemetry_record_t {
+	uint64_t t_ns;		///< time since the trajectory started (ns)
+	int32_t step;		///< trajectory row being pursued
+	int32_t armed;		///< 1 if the controller was armed
+	double wheel[5];	///< measured wheel angles
+	double wheel_sp[5];	///< wheel angle setpoints
+	double wheel_vel[5];	///< wheel speeds from encoder snapshots (rad/s)
+	double u[5];		///< controller outputs D1 D2 D3 D4 D5
+	double v_des[3];	///< desired x_r, y_r, z velocities
+	double x;		///< odometry, global coordinates
+	double y;
+	double theta;
+	double x_r;		///< odometry, omni coordinates
+	double y_r;
+	double z;
+	double a_x;		///< IMU body acceleration
+	double a_y;
+	double theta_dot;	///< IMU yaw rate
+	double v_batt;		///< battery voltage
+} jb_telemetry_record_t;
+
+/**
+ * @brief      File header written once at the start of a log.
+ */
+typedef struct jb_telemetry_header_t {
+	char magic[8];		///< JB_TELEMETRY_MAGIC, zero padded
+	uint32_t version;	///< JB_TELEMETRY_VERSION
+	uint32_t record_size;	///< sizeof(jb_telemetry_record_t)
+	uint64_t start_ns;	///< rc_nanos_since_boot when the log was opened
+} jb_telemetry_header_t;
+
+/**
+ * @brief      Opens the log file, writes the header and starts the writer
+ * thread.
+ *
+ * @param[in]  filename  file to log to
+ *
+ * @return     0 on success, -1 on failure
+ */
+int jb_telemetry_init(const char* filename);
+
+/**
+ * @brief      Queues one record. Safe to call from the control loop, only one
+ * thread may push.
+ *
+ * @param[in]  rec   record to copy into the ring
+ *
+ * @return     0 on success, -1 if logging is off or the ring was full
+ */
+int jb_telemetry_push(const jb_telemetry_record_t* rec);
+
+/**
+ * @brief      Stops the writer thread after draining the ring and closes the
+ * file.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int jb_telemetry_cleanup(void);
+
+/**
+ * @brief      Converts a binary log to CSV.
+ *
+ * @param[in]  filename  binary log to read
+ * @param      out       stream to write CSV to
+ *
+ * @return     number of records converted, -1 on failure
+ */
+int jb_telemetry_to_csv(const char* filename, FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JB_TELEMETRY_H
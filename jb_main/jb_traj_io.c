@@ -0,0 +1,360 @@
+/**
+ * jb_traj_io.c
+ *
+ * Text and binary trajectory files, see jb_traj_io.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "jb_main_defs.h"
+#include "jb_traj_io.h"
+
+#define HEADER_BYTES	16
+#define RECORD_BYTES	(4 * sizeof(double))
+#define LINE_LEN	256
+
+
+/**
+ * prints the first problem found in a file, with where it is
+ */
+static void __bad(const jb_wp_reader_t* r, const char* msg)
+{
+	if (r->f) fprintf(stderr, "ERROR in jb_wp_open, %s line %d: %s\n", r->name, r->line, msg);
+	else fprintf(stderr, "ERROR in jb_wp_open, %s record %d: %s\n", r->name, r->next + 1, msg);
+}
+
+
+/**
+ * checks one waypoint against the one before it, prev is NULL for the first
+ */
+static int __check(const jb_wp_reader_t* r, const jb_waypoint_t* wp, const jb_waypoint_t* prev)
+{
+	int i;
+	if (!isfinite(wp->t)) {
+		__bad(r, "time is not a finite number");
+		return -1;
+	}
+	for (i = 0; i < JB_TRAJ_AXES; i++) {
+		if (!isfinite(wp->p[i])) {
+			__bad(r, "position is not a finite number");
+			return -1;
+		}
+	}
+	if (prev != NULL && wp->t < prev->t) {
+		__bad(r, "time goes backwards");
+		return -1;
+	}
+	if (wp->p[2] > Z_HEIGHT_MAX) {
+		__bad(r, "z above Z_HEIGHT_MAX");
+		return -1;
+	}
+	return 0;
+}
+
+
+/**
+ * reads the next waypoint from a text file. A Rows line sets *rows if rows
+ * isn't NULL. Returns 1 if a waypoint was read, 0 at the end, -1 on error.
+ */
+static int __text_next(jb_wp_reader_t* r, jb_waypoint_t* wp, int* rows)
+{
+	int i;
+	size_t len;
+	char line[LINE_LEN];
+	char *p, *end;
+	double x[1 + JB_TRAJ_AXES];
+
+	while (fgets(line, sizeof(line), r->f) != NULL) {
+		r->line++;
+		len = strlen(line);
+		if (len == sizeof(line) - 1 && line[len - 1] != '\n' && !feof(r->f)) {
+			__bad(r, "line too long");
+			return -1;
+		}
+		for (p = line; isspace((unsigned char)*p); p++);
+		if (*p == '\0' || *p == '#') continue;
+		if (strncmp(p, "Rows:", 5) == 0) {
+			if (r->next > 0) {
+				__bad(r, "Rows line after the first waypoint");
+				return -1;
+			}
+			if (rows != NULL) {
+				*rows = (int)strtol(p + 5, &end, 10);
+				if (end == p + 5 || *rows < 0) {
+					__bad(r, "bad Rows count");
+					return -1;
+				}
+			}
+			continue;
+		}
+		for (i = 0; i < 1 + JB_TRAJ_AXES; i++) {
+			x[i] = strtod(p, &end);
+			if (end == p) break;
+			p = end;
+		}
+		// a line of column names before the first waypoint
+		if (i == 0 && r->next == 0) continue;
+		for (; isspace((unsigned char)*p); p++);
+		if (i < 1 + JB_TRAJ_AXES || *p != '\0') {
+			__bad(r, "expected t x y z");
+			return -1;
+		}
+		wp->t = x[0];
+		for (i = 0; i < JB_TRAJ_AXES; i++) wp->p[i] = x[i + 1];
+		return 1;
+	}
+	if (ferror(r->f)) {
+		__bad(r, "read failed");
+		return -1;
+	}
+	return 0;
+}
+
+
+static void __bin_record(const jb_wp_reader_t* r, int i, jb_waypoint_t* wp)
+{
+	double x[4];
+	memcpy(x, r->map + HEADER_BYTES + (size_t)i * RECORD_BYTES, RECORD_BYTES);
+	wp->t = x[0];
+	wp->p[0] = x[1];
+	wp->p[1] = x[2];
+	wp->p[2] = x[3];
+}
+
+
+static int __open_text(jb_wp_reader_t* r)
+{
+	int ret, rows = -1;
+	jb_waypoint_t wp, prev;
+
+	// check every line now, then go back to the start for jb_wp_read
+	while ((ret = __text_next(r, &wp, &rows)) == 1) {
+		if (__check(r, &wp, r->next ? &prev : NULL)) return -1;
+		prev = wp;
+		r->next++;
+	}
+	if (ret < 0) return -1;
+	if (rows >= 0 && rows != r->next) {
+		fprintf(stderr, "ERROR in jb_wp_open, %s says Rows: %d but has %d waypoints\n",
+								r->name, rows, r->next);
+		return -1;
+	}
+	r->n = r->next;
+	if (jb_wp_rewind(r)) return -1;
+	return r->n;
+}
+
+
+static int __open_binary(jb_wp_reader_t* r, int fd)
+{
+	struct stat st;
+	uint32_t head[4];
+	jb_waypoint_t wp, prev;
+
+	if (fstat(fd, &st) || st.st_size < HEADER_BYTES) {
+		fprintf(stderr, "ERROR in jb_wp_open, %s is too short\n", r->name);
+		return -1;
+	}
+	if ((uint64_t)st.st_size > SIZE_MAX) {
+		fprintf(stderr, "ERROR in jb_wp_open, %s is too large to map\n", r->name);
+		return -1;
+	}
+	r->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (r->map == MAP_FAILED) {
+		r->map = NULL;
+		perror("ERROR in jb_wp_open, failed to map trajectory file");
+		return -1;
+	}
+	r->map_len = st.st_size;
+	madvise((void*)r->map, r->map_len, MADV_SEQUENTIAL);
+
+	memcpy(head, r->map, sizeof(head));
+	if (head[1] != JB_WP_VERSION) {
+		fprintf(stderr, "ERROR in jb_wp_open, %s is version %u, expected %d\n",
+							r->name, head[1], JB_WP_VERSION);
+		return -1;
+	}
+	// size in 64 bits, size_t is only 32 bits on the BeagleBone and a
+	// wrapped product could match a short file
+	if (head[2] > INT32_MAX ||
+			(uint64_t)r->map_len != HEADER_BYTES + (uint64_t)head[2] * RECORD_BYTES) {
+		fprintf(stderr, "ERROR in jb_wp_open, %s has %zu bytes, expected %u waypoints\n",
+							r->name, r->map_len, head[2]);
+		return -1;
+	}
+	r->n = head[2];
+	for (r->next = 0; r->next < r->n; r->next++) {
+		__bin_record(r, r->next, &wp);
+		if (__check(r, &wp, r->next ? &prev : NULL)) return -1;
+		prev = wp;
+	}
+	r->next = 0;
+	return r->n;
+}
+
+
+int jb_wp_open(jb_wp_reader_t* r, const char* filename)
+{
+	int fd, ret;
+	char magic[4];
+	jb_wp_reader_t empty = JB_WP_READER_INITIALIZER;
+
+	if (r == NULL || filename == NULL) {
+		fprintf(stderr, "ERROR in jb_wp_open, received NULL pointer\n");
+		return -1;
+	}
+	*r = empty;
+	r->name = filename;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		perror("ERROR in jb_wp_open, failed to open trajectory file");
+		return -1;
+	}
+	if (read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+			memcmp(magic, JB_WP_MAGIC, sizeof(magic)) == 0) {
+		ret = __open_binary(r, fd);
+		close(fd);
+	}
+	else {
+		lseek(fd, 0, SEEK_SET);
+		r->f = fdopen(fd, "r");
+		if (r->f == NULL) {
+			perror("ERROR in jb_wp_open, failed to open trajectory file");
+			close(fd);
+			return -1;
+		}
+		ret = __open_text(r);
+	}
+	if (ret < 0) jb_wp_close(r);
+	return ret;
+}
+
+
+int jb_wp_read(jb_wp_reader_t* r, jb_waypoint_t* wp, int max)
+{
+	int i, ret;
+
+	if (r == NULL || wp == NULL) {
+		fprintf(stderr, "ERROR in jb_wp_read, received NULL pointer\n");
+		return -1;
+	}
+	if (r->f == NULL && r->map == NULL) {
+		fprintf(stderr, "ERROR in jb_wp_read, file not open\n");
+		return -1;
+	}
+	for (i = 0; i < max && r->next < r->n; i++) {
+		if (r->map != NULL) __bin_record(r, r->next, &wp[i]);
+		else {
+			// already checked, only fails if the file changed underneath us
+			ret = __text_next(r, &wp[i], NULL);
+			if (ret <= 0) {
+				fprintf(stderr, "ERROR in jb_wp_read, %s changed while reading\n", r->name);
+				return -1;
+			}
+		}
+		r->next++;
+	}
+	return i;
+}
+
+
+int jb_wp_rewind(jb_wp_reader_t* r)
+{
+	if (r == NULL) {
+		fprintf(stderr, "ERROR in jb_wp_rewind, received NULL pointer\n");
+		return -1;
+	}
+	if (r->f == NULL && r->map == NULL) {
+		fprintf(stderr, "ERROR in jb_wp_rewind, file not open\n");
+		return -1;
+	}
+	r->next = 0;
+	if (r->f != NULL) {
+		r->line = 0;
+		rewind(r->f);
+	}
+	return 0;
+}
+
+
+void jb_wp_close(jb_wp_reader_t* r)
+{
+	jb_wp_reader_t empty = JB_WP_READER_INITIALIZER;
+	if (r == NULL) return;
+	if (r->f != NULL) fclose(r->f);
+	if (r->map != NULL) munmap((void*)r->map, r->map_len);
+	*r = empty;
+}
+
+
+int jb_wp_load(const char* filename, jb_waypoint_t** wp)
+{
+	int n;
+	jb_wp_reader_t r;
+	jb_waypoint_t* out;
+
+	if (wp == NULL) {
+		fprintf(stderr, "ERROR in jb_wp_load, received NULL pointer\n");
+		return -1;
+	}
+	n = jb_wp_open(&r, filename);
+	if (n < 0) return -1;
+	out = malloc((n ? n : 1) * sizeof(jb_waypoint_t));
+	if (out == NULL) {
+		fprintf(stderr, "ERROR in jb_wp_load, failed to allocate waypoints\n");
+		jb_wp_close(&r);
+		return -1;
+	}
+	if (jb_wp_read(&r, out, n) != n) {
+		free(out);
+		jb_wp_close(&r);
+		return -1;
+	}
+	jb_wp_close(&r);
+	*wp = out;
+	return n;
+}
+
+
+int jb_wp_write_binary(const char* filename, const jb_waypoint_t* wp, int n)
+{
+	int i;
+	FILE* f;
+	uint32_t head[3] = {JB_WP_VERSION, 0, 0};
+	double x[4];
+
+	if (filename == NULL || wp == NULL || n < 0) {
+		fprintf(stderr, "ERROR in jb_wp_write_binary, invalid arguments\n");
+		return -1;
+	}
+	f = fopen(filename, "wb");
+	if (f == NULL) {
+		perror("ERROR in jb_wp_write_binary, failed to open file");
+		return -1;
+	}
+	head[1] = n;
+	fwrite(JB_WP_MAGIC, 1, 4, f);
+	fwrite(head, sizeof(head), 1, f);
+	for (i = 0; i < n; i++) {
+		x[0] = wp[i].t;
+		x[1] = wp[i].p[0];
+		x[2] = wp[i].p[1];
+		x[3] = wp[i].p[2];
+		fwrite(x, sizeof(x), 1, f);
+	}
+	if (ferror(f) | fclose(f)) {
+		fprintf(stderr, "ERROR in jb_wp_write_binary, failed to write %s\n", filename);
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * jb_traj_io.h
+ *
+ * @brief      Reading and writing trajectory files, one chunk of waypoints
+ * at a time.
+ *
+ * Two formats are read, told apart by the first four bytes:
+ *
+ * Text, as written by hand or by trajec_check.m. An optional "Rows: n" line,
+ * an optional column header line such as "t x y z", then one waypoint per
+ * line: time (s) and global x, y, z (m) separated by spaces. Blank lines and
+ * lines starting with # are skipped.
+ *
+ * Binary, for long generated paths. A 16 byte header of the magic "JBWP", then
+ * uint32 version, waypoint count and a reserved word, followed by count
+ * records of four doubles t, x, y, z, all in the byte order of the machine
+ * that wrote them (little endian on the BeagleBone and a PC). The file is
+ * mapped rather than read so waypoints come straight out of the page cache.
+ * jb_wp_write_binary or "coord2trajec -b" writes one.
+ *
+ * jb_wp_open checks the whole file before anything moves: every number must
+ * parse and be finite, times may not go backwards, z must be within
+ * Z_HEIGHT_MAX and a Rows line must match the number of waypoints. The first
+ * problem is reported with its line (or record) number. That pass reads the
+ * file once without keeping it, so memory use doesn't depend on its length.
+ */
+
+#ifndef JB_TRAJ_IO_H
+#define JB_TRAJ_IO_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "jb_planner.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JB_WP_MAGIC	"JBWP"	///< first four bytes of a binary trajectory file
+#define JB_WP_VERSION	1	///< binary format version written and accepted
+
+/**
+ * @brief      An open trajectory file, text or binary.
+ */
+typedef struct jb_wp_reader_t {
+	FILE* f;			///< text file, NULL when binary
+	const unsigned char* map;	///< mapped binary file, NULL when text
+	size_t map_len;			///< size of the mapping in bytes
+	const char* name;		///< file name for messages, not copied
+	int n;				///< number of waypoints in the file
+	int next;			///< index of the next waypoint jb_wp_read returns
+	int line;			///< text line last read, for messages
+} jb_wp_reader_t;
+
+#define JB_WP_READER_INITIALIZER {\
+	.f		= NULL,\
+	.map		= NULL,\
+	.map_len	= 0,\
+	.name		= NULL,\
+	.n		= 0,\
+	.next		= 0,\
+	.line		= 0}
+
+/**
+ * @brief      Opens and checks a trajectory file.
+ *
+ * @param      r         reader to open
+ * @param[in]  filename  file to read, must stay valid until jb_wp_close
+ *
+ * @return     number of waypoints, -1 if the file can't be read or fails
+ * the checks, in which case the problem is printed
+ */
+int jb_wp_open(jb_wp_reader_t* r, const char* filename);
+
+/**
+ * @brief      Reads the next waypoints in global coordinates.
+ *
+ * @param      r     open reader
+ * @param[out] wp    array of at least max waypoints to fill
+ * @param[in]  max   most waypoints to read
+ *
+ * @return     number read, 0 at the end of the file, -1 on error
+ */
+int jb_wp_read(jb_wp_reader_t* r, jb_waypoint_t* wp, int max);
+
+/**
+ * @brief      Goes back to the first waypoint, so the next jb_wp_read starts
+ * from the beginning of the file again.
+ *
+ * @param      r     open reader
+ *
+ * @return     0 on success, -1 on error
+ */
+int jb_wp_rewind(jb_wp_reader_t* r);
+
+/**
+ * @brief      Closes the file and resets r like JB_WP_READER_INITIALIZER.
+ *
+ * @param      r     reader to close
+ */
+void jb_wp_close(jb_wp_reader_t* r);
+
+/**
+ * @brief      Reads a whole trajectory file into memory, for tools that
+ * need every waypoint at once. jb_main streams instead, see jb_traj_stream.h.
+ *
+ * @param[in]  filename  file to read
+ * @param[out] wp        set to a malloc'd array of waypoints, free when done
+ *
+ * @return     number of waypoints read, -1 on failure
+ */
+int jb_wp_load(const char* filename, jb_waypoint_t** wp);
+
+/**
+ * @brief      Writes waypoints in global coordinates as a binary trajectory
+ * file.
+ *
+ * @param[in]  filename  file to write, replaced if it exists
+ * @param[in]  wp        waypoints
+ * @param[in]  n         number of waypoints
+ *
+ * @return     0 on success, -1 on failure
+ */
+int jb_wp_write_binary(const char* filename, const jb_waypoint_t* wp, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JB_TRAJ_IO_H
@@ -0,0 +1,351 @@
+/**
+ * jb_traj_stream.c
+ *
+ * Plans a trajectory file a window at a time, see jb_traj_stream.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "jb_traj_stream.h"
+
+// allow for rounding in a segment stretched to arrive on time
+#define LATE_TOL	1e-9
+
+/**
+ * what goes through the queue, the end of the trajectory is a record of its
+ * own so the control loop can tell it apart from the loader falling behind
+ */
+typedef struct stream_rec_t {
+	jb_traj_segment_t seg;
+	int last;
+} stream_rec_t;
+
+
+/**
+ * tells the planner where the segment just started ends, control loop only
+ */
+static void __publish_anchor(jb_traj_stream_t* st)
+{
+	int i;
+	jb_traj_anchor_t a;
+	a.index = st->index;
+	a.t1 = st->seg.t1;
+	for (i = 0; i < JB_TRAJ_AXES; i++) a.p[i] = st->seg.p0[i] + st->seg.d[i];
+	rc_seqlock_write(&st->anchor_slot, &a);
+}
+
+
+/**
+ * next segment to follow, from the plan that replaced the file if there is
+ * one. Returns 1 if there was one, 0 at the end, -1 if the loader is behind.
+ */
+static int __next_segment(jb_traj_stream_t* st, jb_traj_segment_t* seg)
+{
+	stream_rec_t rec;
+	if (st->active != NULL) {
+		if (st->active_i == st->active->n) return 0;
+		*seg = st->active->seg[st->active_i++];
+		return 1;
+	}
+	if (rc_spsc_queue_pop(&st->q, &rec) != 1) return -1;
+	if (rec.last) return 0;
+	*seg = rec.seg;
+	return 1;
+}
+
+
+/**
+ * takes the pending plan if it continues from the segment just finished,
+ * control loop only. Returns 1 if it did.
+ */
+static int __take_plan(jb_traj_stream_t* st)
+{
+	jb_traj_plan_t* p = atomic_load_explicit(&st->pending, memory_order_acquire);
+
+	if (p == NULL || atomic_load_explicit(&p->anchor, memory_order_relaxed) != st->index) return 0;
+	// fails if the planner took it back to replace it since we looked
+	if (!atomic_compare_exchange_strong(&st->pending, &p, NULL)) return 0;
+	// the planner may have reused the same buffer in between, look again now
+	// that it's ours
+	if (atomic_load_explicit(&p->anchor, memory_order_relaxed) != st->index) {
+		atomic_store_explicit(&st->returned, p, memory_order_release);
+		return 0;
+	}
+	st->active = p;
+	st->active_i = 0;
+	st->replan_late += p->late;
+	atomic_store_explicit(&st->replaced, 1, memory_order_relaxed);
+	return 1;
+}
+
+
+/**
+ * next waypoint in axis coordinates, reading another chunk when needed.
+ * Returns 1 if there was one, 0 at the end of the file, -1 on error.
+ */
+static int __next_waypoint(jb_traj_stream_t* st, jb_waypoint_t* wp)
+{
+	int n;
+	if (st->buf_i == st->buf_n) {
+		n = jb_wp_read(&st->rd, st->buf, JB_WP_CHUNK);
+		if (n <= 0) return n;
+		jb_plan_global_to_axes(st->buf, st->buf, n);
+		st->buf_n = n;
+		st->buf_i = 0;
+	}
+	*wp = st->buf[st->buf_i++];
+	return 1;
+}
+
+
+/**
+ * plans the whole file one segment at a time into a scratch segment and
+ * counts the waypoints that will be late, then goes back to the start.
+ * Plans exactly as jb_traj_stream_fill will, so the count matches.
+ */
+static int __count_late(jb_traj_stream_t* st)
+{
+	int i, n;
+	double t;
+	jb_waypoint_t prev;
+	jb_traj_segment_t seg;
+
+	if (jb_wp_read(&st->rd, &prev, 1) != 1) return -1;
+	jb_plan_global_to_axes(&prev, &prev, 1);
+	t = prev.t;
+	while ((n = jb_wp_read(&st->rd, st->buf, JB_WP_CHUNK)) > 0) {
+		jb_plan_global_to_axes(st->buf, st->buf, n);
+		for (i = 0; i < n; i++) {
+			t = jb_plan_segment(&seg, &prev, &st->buf[i], t, &st->lim);
+			if (t > st->buf[i].t + LATE_TOL) st->late++;
+			prev = st->buf[i];
+		}
+	}
+	if (n < 0) return -1;
+	return jb_wp_rewind(&st->rd);
+}
+
+
+int jb_traj_stream_open(jb_traj_stream_t* st, const char* filename, const jb_plan_limits_t* lim)
+{
+	int n;
+	stream_rec_t rec;
+
+	if (st == NULL || lim == NULL) {
+		fprintf(stderr, "ERROR in jb_traj_stream_open, received NULL pointer\n");
+		return -1;
+	}
+	if (jb_plan_check_limits(lim)) return -1;
+	memset(st, 0, sizeof(jb_traj_stream_t));
+	st->q = rc_spsc_queue_empty();
+	st->anchor_slot = rc_seqlock_empty();
+	st->lim = *lim;
+	atomic_init(&st->pending, NULL);
+	atomic_init(&st->returned, NULL);
+	atomic_init(&st->replaced, 0);
+
+	n = jb_wp_open(&st->rd, filename);
+	if (n < 0) return -1;
+	if (n < 2) {
+		fprintf(stderr, "ERROR in jb_traj_stream_open, %s needs at least 2 waypoints\n", filename);
+		jb_wp_close(&st->rd);
+		return -1;
+	}
+	if (rc_spsc_queue_alloc(&st->q, JB_TRAJ_WINDOW, sizeof(stream_rec_t)) ||
+			rc_seqlock_alloc(&st->anchor_slot, sizeof(jb_traj_anchor_t))) {
+		fprintf(stderr, "ERROR in jb_traj_stream_open, failed to allocate queue\n");
+		jb_traj_stream_close(st);
+		return -1;
+	}
+
+	// infeasible segments are reported now, not found mid-run
+	if (__count_late(st)) {
+		fprintf(stderr, "ERROR in jb_traj_stream_open, failed to read %s\n", filename);
+		jb_traj_stream_close(st);
+		return -1;
+	}
+
+	// the first waypoint is where we start, the first segment leaves it
+	if (__next_waypoint(st, &st->prev) != 1) {
+		fprintf(stderr, "ERROR in jb_traj_stream_open, failed to read %s\n", filename);
+		jb_traj_stream_close(st);
+		return -1;
+	}
+	st->t_plan = st->prev.t;
+	memcpy(st->p_start, st->prev.p, sizeof(st->p_start));
+	if (jb_traj_stream_fill(st) < 0 || rc_spsc_queue_pop(&st->q, &rec) != 1 || rec.last) {
+		fprintf(stderr, "ERROR in jb_traj_stream_open, failed to plan %s\n", filename);
+		jb_traj_stream_close(st);
+		return -1;
+	}
+	st->seg = rec.seg;
+	__publish_anchor(st);
+	return n;
+}
+
+
+int jb_traj_stream_fill(jb_traj_stream_t* st)
+{
+	int ret;
+	double t;
+	jb_waypoint_t wp;
+	stream_rec_t rec;
+
+	if (st->loaded) return 1;
+	// nothing more of the file will be followed
+	if (atomic_load_explicit(&st->replaced, memory_order_relaxed)) {
+		st->loaded = 1;
+		return 1;
+	}
+	// only this thread pushes, so the count can only go down under us
+	while (rc_spsc_queue_count(st->q) < (int)st->q.capacity) {
+		ret = __next_waypoint(st, &wp);
+		if (ret <= 0) {
+			memset(&rec, 0, sizeof(rec));
+			rec.last = 1;
+			rc_spsc_queue_push(&st->q, &rec);
+			st->loaded = 1;
+			return ret < 0 ? -1 : 1;
+		}
+		rec.last = 0;
+		t = jb_plan_segment(&rec.seg, &st->prev, &wp, st->t_plan, &st->lim);
+		st->t_plan = t;
+		st->prev = wp;
+		st->planned++;
+		rc_spsc_queue_push(&st->q, &rec);
+	}
+	return 0;
+}
+
+
+int jb_traj_stream_eval(jb_traj_stream_t* st, double t, double pos[JB_TRAJ_AXES], double vel[JB_TRAJ_AXES])
+{
+	int ret;
+	jb_traj_segment_t seg;
+
+	t -= st->t_shift;
+	while (t >= st->seg.t1) {
+		// a new plan continuing from here replaces whatever was next, and
+		// starts now even if the robot has been holding for a while
+		if (__take_plan(st)) {
+			st->done = 0;
+			st->waiting = 1;
+		}
+		else if (st->done) break;
+		ret = __next_segment(st, &seg);
+		if (ret < 0) {
+			// hold at the end of this segment, it ends at rest
+			st->waiting = 1;
+			st->starved++;
+			break;
+		}
+		if (ret == 0) {
+			st->done = 1;
+			break;
+		}
+		// after waiting, start the next segment from its beginning
+		if (st->waiting && t > seg.t0) {
+			st->t_shift += t - seg.t0;
+			t = seg.t0;
+		}
+		st->waiting = 0;
+		st->seg = seg;
+		st->index++;
+		__publish_anchor(st);
+	}
+	jb_traj_segment_eval(&st->seg, t, pos, vel);
+	return st->done;
+}
+
+
+/**
+ * a plan buffer the control loop isn't using, planner only
+ */
+static jb_traj_plan_t* __free_plan(jb_traj_stream_t* st)
+{
+	jb_traj_plan_t* p;
+	// not taken yet, take it back to replace it
+	p = atomic_exchange_explicit(&st->pending, NULL, memory_order_acquire);
+	if (p != NULL) return p;
+	// taken but found stale
+	p = atomic_exchange_explicit(&st->returned, NULL, memory_order_acquire);
+	if (p != NULL) return p;
+	// the last one was taken and is being followed, the other is free since
+	// the control loop let go of it when it took the last one
+	if (st->last_pub == &st->plans[0]) return &st->plans[1];
+	return &st->plans[0];
+}
+
+
+int jb_traj_stream_replan(jb_traj_stream_t* st, const jb_waypoint_t* wp, int n)
+{
+	int i, late = 0;
+	double t, t0;
+	jb_waypoint_t from;
+	jb_traj_anchor_t a;
+	jb_traj_plan_t* p;
+
+	if (st == NULL || wp == NULL) {
+		fprintf(stderr, "ERROR in jb_traj_stream_replan, received NULL pointer\n");
+		return -1;
+	}
+	if (n < 1 || n > JB_REPLAN_MAX) {
+		fprintf(stderr, "ERROR in jb_traj_stream_replan, need 1 to %d waypoints\n", JB_REPLAN_MAX);
+		return -1;
+	}
+	for (i = 0; i < n; i++) {
+		if (!isfinite(wp[i].t) || !isfinite(wp[i].p[0]) ||
+				!isfinite(wp[i].p[1]) || !isfinite(wp[i].p[2])) {
+			fprintf(stderr, "ERROR in jb_traj_stream_replan, waypoint %d is not finite\n", i);
+			return -1;
+		}
+	}
+
+	p = __free_plan(st);
+	rc_seqlock_read(&st->anchor_slot, &a);
+	from.t = 0.0;
+	memcpy(from.p, a.p, sizeof(from.p));
+	t = t0 = a.t1;
+	for (i = 0; i < n; i++) {
+		jb_waypoint_t to = wp[i];
+		to.t += t0;
+		t = jb_plan_segment(&p->seg[i], &from, &to, t, &st->lim);
+		if (t > to.t + LATE_TOL) late++;
+		from = to;
+	}
+	p->n = n;
+	p->late = late;
+	atomic_store_explicit(&p->anchor, a.index, memory_order_relaxed);
+	st->last_pub = p;
+	atomic_store_explicit(&st->pending, p, memory_order_release);
+	return 0;
+}
+
+
+int jb_traj_stream_plan_stale(jb_traj_stream_t* st)
+{
+	int index;
+	jb_traj_anchor_t a;
+	jb_traj_plan_t* p = atomic_load_explicit(&st->pending, memory_order_acquire);
+
+	if (p == NULL) {
+		// taken, but possibly handed back
+		if (atomic_load_explicit(&st->returned, memory_order_acquire) == NULL) return 0;
+		return 1;
+	}
+	// only the planner writes the anchor of a pending plan
+	index = atomic_load_explicit(&p->anchor, memory_order_relaxed);
+	rc_seqlock_read(&st->anchor_slot, &a);
+	return a.index != index;
+}
+
+
+void jb_traj_stream_close(jb_traj_stream_t* st)
+{
+	if (st == NULL) return;
+	jb_wp_close(&st->rd);
+	rc_spsc_queue_free(&st->q);
+	rc_seqlock_free(&st->anchor_slot);
+}
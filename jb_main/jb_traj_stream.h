@@ -0,0 +1,200 @@
+/**
+ * jb_traj_stream.h
+ *
+ * @brief      Plans a trajectory file a few segments ahead of the control
+ * loop instead of all at once.
+ *
+ * jb_traj_stream_open checks the file and plans every segment once into a
+ * scratch segment to count the waypoints that can't be reached on time, so
+ * they are known before anything moves. It then plans the first
+ * JB_TRAJ_WINDOW segments and returns, without ever holding more than a
+ * window of the path. From then on a background thread calls jb_traj_stream_fill,
+ * which reads waypoints in chunks of JB_WP_CHUNK and plans segments into a
+ * lock-free queue (rc_spsc_queue_t) until the queue is full, and the control
+ * loop calls jb_traj_stream_eval, which takes segments off the queue as it
+ * reaches them. Neither side ever waits for the other and memory use is the
+ * same whatever the length of the file.
+ *
+ * Every segment ends at rest, so if the loader ever falls behind the robot
+ * simply waits at the last waypoint it has, and the rest of the trajectory
+ * runs that much later rather than jumping ahead to catch up.
+ *
+ * The rest of the trajectory can also be replaced while moving, see
+ * jb_traj_stream_replan. The new plan is worked out on the caller's thread in
+ * one of two preallocated jb_traj_plan_t buffers and published by storing
+ * its address in an atomic pointer. It continues from the end of the segment
+ * being followed when it was planned, so the control loop takes it with a
+ * compare and swap when it reaches that segment boundary, where the robot is
+ * at rest, and from then on follows the new plan instead of the file. If the
+ * robot got past that boundary first the plan is left alone and
+ * jb_traj_stream_plan_stale tells the planner to plan it again. The control
+ * loop never waits for the planner, never allocates and never copies more
+ * than one segment.
+ */
+
+#ifndef JB_TRAJ_STREAM_H
+#define JB_TRAJ_STREAM_H
+
+#include <stdatomic.h>
+#include <rc/math/spsc_queue.h>
+
+#include "jb_planner.h"
+#include "jb_traj_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JB_TRAJ_WINDOW	64	///< planned segments queued ahead of the control loop
+#define JB_WP_CHUNK	32	///< waypoints read from the file at a time
+#define JB_REPLAN_MAX	64	///< most waypoints in a plan replacing the file
+
+/**
+ * @brief      A plan replacing the rest of the trajectory.
+ */
+typedef struct jb_traj_plan_t {
+	jb_traj_segment_t seg[JB_REPLAN_MAX];	///< segments in time order
+	int n;					///< number of segments
+	int late;				///< waypoints planned later than their time
+	atomic_int anchor;			///< stream index of the segment it continues from
+} jb_traj_plan_t;
+
+/**
+ * @brief      Where a new plan has to start from: the end of the segment
+ * being followed. Published by the control loop each time it starts a new
+ * segment.
+ */
+typedef struct jb_traj_anchor_t {
+	int index;			///< stream index of the segment
+	double t1;			///< its end time, in the time of its own plan (s)
+	double p[JB_TRAJ_AXES];		///< its end position, axis coordinates
+} jb_traj_anchor_t;
+
+/**
+ * @brief      A trajectory file being planned and followed.
+ *
+ * The loader fields belong to the thread calling jb_traj_stream_fill, the
+ * control loop fields to the thread calling jb_traj_stream_eval.
+ */
+typedef struct jb_traj_stream_t {
+	rc_spsc_queue_t q;		///< planned segments waiting for the control loop
+	jb_plan_limits_t lim;		///< limits segments are planned with
+
+	// replanning, the plans are owned by whoever the pointers say
+	jb_traj_plan_t plans[2];	///< double buffer for jb_traj_stream_replan
+	_Atomic(jb_traj_plan_t*) pending;	///< published plan the control loop hasn't taken
+	_Atomic(jb_traj_plan_t*) returned;	///< plan the control loop found stale after taking it
+	rc_seqlock_t anchor_slot;	///< jb_traj_anchor_t of the current segment
+	atomic_int replaced;		///< 1 once a plan has replaced the file
+	jb_traj_plan_t* last_pub;	///< last plan published, planner only
+
+	// loader
+	jb_wp_reader_t rd;		///< open trajectory file
+	jb_waypoint_t buf[JB_WP_CHUNK];	///< waypoints read but not yet planned, axis coordinates
+	int buf_n;			///< number of waypoints in buf
+	int buf_i;			///< next waypoint in buf to plan to
+	jb_waypoint_t prev;		///< waypoint the last planned segment ends at
+	double t_plan;			///< time the last planned segment ends
+	int planned;			///< segments planned so far
+	int late;			///< waypoints in the file that will be late, set when opened
+	int loaded;			///< 1 once the end of the file has been queued
+
+	// control loop
+	jb_traj_plan_t* active;		///< plan being followed, NULL while following the file
+	int active_i;			///< next segment of active
+	jb_traj_segment_t seg;		///< segment being followed
+	double p_start[JB_TRAJ_AXES];	///< first waypoint, axis coordinates
+	double t_shift;			///< time lost waiting for the loader or a new plan (s)
+	int index;			///< number of seg counting from 0
+	int starved;			///< control ticks spent waiting for the loader
+	int replan_late;		///< waypoints planned later than their time in plans taken
+	int waiting;			///< 1 while waiting for the loader
+	int done;			///< 1 once the last segment has finished, until replanned
+} jb_traj_stream_t;
+
+/**
+ * @brief      Opens and checks a trajectory file and plans the first
+ * segments, before the control loop starts.
+ *
+ * st->late is set to the number of waypoints in the file that can't be
+ * reached on time within the limits.
+ *
+ * @param      st        stream to open
+ * @param[in]  filename  trajectory file, text or binary, see jb_traj_io.h
+ * @param[in]  lim       limits of each axis
+ *
+ * @return     number of waypoints in the file, -1 on failure
+ */
+int jb_traj_stream_open(jb_traj_stream_t* st, const char* filename, const jb_plan_limits_t* lim);
+
+/**
+ * @brief      Plans segments until the queue is full or the file has been
+ * read to the end, loader thread only. Call every few control periods.
+ *
+ * If the file can't be read any more the trajectory is ended at the last
+ * segment planned, so the robot stops there.
+ *
+ * @param      st    open stream
+ *
+ * @return     0 if there is more to plan, 1 once the whole file has been
+ * planned, -1 on error
+ */
+int jb_traj_stream_fill(jb_traj_stream_t* st);
+
+/**
+ * @brief      Position and velocity of every axis at time t, control loop
+ * only. Never waits or allocates.
+ *
+ * Once the last waypoint has been reached the robot holds there, and a plan
+ * from jb_traj_stream_replan still starts it moving again.
+ *
+ * @param      st    open stream
+ * @param[in]  t     time since the start (s), must not go backwards
+ * @param[out] pos   position of each axis
+ * @param[out] vel   velocity of each axis
+ *
+ * @return     0 while moving, 1 while holding at the last waypoint
+ */
+int jb_traj_stream_eval(jb_traj_stream_t* st, double t, double pos[JB_TRAJ_AXES], double vel[JB_TRAJ_AXES]);
+
+/**
+ * @brief      Replaces the rest of the trajectory with a plan through new
+ * waypoints, from one planner thread. Never waits for the control loop.
+ *
+ * The plan starts at the end of the segment being followed now, which is
+ * where the robot will be at rest when it takes the plan, and is planned
+ * with the stream's limits. Waypoint times count from that moment. Calling
+ * again before the control loop has taken the last plan replaces it.
+ *
+ * @param      st    open stream
+ * @param[in]  wp    waypoints in axis coordinates
+ * @param[in]  n     number of waypoints, 1 to JB_REPLAN_MAX
+ *
+ * @return     0 on success, -1 on error
+ */
+int jb_traj_stream_replan(jb_traj_stream_t* st, const jb_waypoint_t* wp, int n);
+
+/**
+ * @brief      Whether the plan last published by jb_traj_stream_replan can no
+ * longer be taken because the robot moved on to another segment first,
+ * planner thread only. Plan it again if so.
+ *
+ * @param      st    open stream
+ *
+ * @return     1 if stale, 0 if it was taken or can still be
+ */
+int jb_traj_stream_plan_stale(jb_traj_stream_t* st);
+
+/**
+ * @brief      Closes the file and frees the queue, once neither thread is
+ * using the stream.
+ *
+ * @param      st    stream to close
+ */
+void jb_traj_stream_close(jb_traj_stream_t* st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JB_TRAJ_STREAM_H
@@ -0,0 +1,63 @@
+/**
+ * jb_trajectory.c
+ *
+ * Closed form evaluation of a planned trajectory, see jb_trajectory.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "jb_trajectory.h"
+
+
+int jb_traj_segment_eval(const jb_traj_segment_t* seg, double t,
+		double pos[JB_TRAJ_AXES], double vel[JB_TRAJ_AXES])
+{
+	int i, k;
+	double tau, s, v;
+	const jb_traj_profile_t* p;
+
+	if (t >= seg->t1) {
+		for (i = 0; i < JB_TRAJ_AXES; i++) {
+			pos[i] = seg->p0[i] + seg->d[i];
+			vel[i] = 0.0;
+		}
+		return 1;
+	}
+
+	// find the phase, there are only 7 so a scan is as fast as anything
+	p = &seg->prof;
+	tau = (t > seg->t0) ? t - seg->t0 : 0.0;
+	for (k = JB_TRAJ_PHASES - 1; k > 0 && tau < p->t[k]; k--);
+	tau -= p->t[k];
+	s = p->s[k] + tau * (p->v[k] + tau * (0.5 * p->a[k] + tau * p->j[k] / 6.0));
+	v = p->v[k] + tau * (p->a[k] + 0.5 * tau * p->j[k]);
+
+	for (i = 0; i < JB_TRAJ_AXES; i++) {
+		pos[i] = seg->p0[i] + seg->d[i] * s;
+		vel[i] = seg->d[i] * v;
+	}
+	return 0;
+}
+
+
+int jb_traj_eval(jb_traj_t* tr, double t, double pos[JB_TRAJ_AXES], double vel[JB_TRAJ_AXES])
+{
+	if (tr == NULL || tr->seg == NULL) {
+		fprintf(stderr, "ERROR in jb_traj_eval, trajectory not planned\n");
+		return -1;
+	}
+	// usually the same segment as last time or the next one
+	while (tr->cur > 0 && t < tr->seg[tr->cur].t0) tr->cur--;
+	while (tr->cur < tr->n - 1 && t >= tr->seg[tr->cur].t1) tr->cur++;
+	return jb_traj_segment_eval(&tr->seg[tr->cur], t, pos, vel);
+}
+
+
+void jb_traj_free(jb_traj_t* tr)
+{
+	jb_traj_t empty = JB_TRAJ_INITIALIZER;
+	if (tr == NULL) return;
+	free(tr->seg);
+	*tr = empty;
+}
@@ -0,0 +1,113 @@
+/**
+ * jb_trajectory.h
+ *
+ * @brief      Planned trajectory, evaluated in closed form every control
+ * tick.
+ *
+ * A trajectory is a list of segments, one per pair of consecutive waypoints.
+ * Each segment moves all axes together along the straight line between its
+ * waypoints, starting and stopping at rest. How far along the line it is at
+ * any moment follows a jerk limited S-curve: seven phases of constant jerk
+ * (ramp acceleration up, hold, ramp down, cruise, and the mirror image to
+ * stop). The phase boundaries and the state at each of them are worked out
+ * once by the planner, see jb_planner.h.
+ *
+ * jb_traj_eval then only finds the current segment, starting from the one it
+ * found last time, finds the phase and evaluates one cubic. The position
+ * comes straight from the profile so setpoints don't drift the way summing
+ * v*DT every tick does.
+ */
+
+#ifndef JB_TRAJECTORY_H
+#define JB_TRAJECTORY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JB_TRAJ_AXES	3	///< x_r, y_r and z, in wheel radians
+#define JB_TRAJ_PHASES	7	///< constant jerk phases of an S-curve
+
+/**
+ * @brief      Progress s from 0 to 1 along a segment over time, made of
+ * JB_TRAJ_PHASES pieces of constant jerk.
+ */
+typedef struct jb_traj_profile_t {
+	double t[JB_TRAJ_PHASES + 1];	///< phase start times from the segment start, t[7] is the duration
+	double s[JB_TRAJ_PHASES];	///< progress at the start of each phase
+	double v[JB_TRAJ_PHASES];	///< ds/dt at the start of each phase
+	double a[JB_TRAJ_PHASES];	///< d2s/dt2 at the start of each phase
+	double j[JB_TRAJ_PHASES];	///< jerk during each phase
+} jb_traj_profile_t;
+
+/**
+ * @brief      Motion between two consecutive waypoints.
+ */
+typedef struct jb_traj_segment_t {
+	double t0;			///< start time since the trajectory began (s)
+	double t1;			///< end time since the trajectory began (s)
+	double p0[JB_TRAJ_AXES];	///< position at the start
+	double d[JB_TRAJ_AXES];		///< distance moved along each axis, signed
+	jb_traj_profile_t prof;		///< progress along d over the segment
+} jb_traj_segment_t;
+
+/**
+ * @brief      A planned trajectory.
+ */
+typedef struct jb_traj_t {
+	jb_traj_segment_t* seg;	///< segments in time order
+	int n;			///< number of segments, one less than waypoints
+	int cur;		///< segment found by the last jb_traj_eval
+} jb_traj_t;
+
+#define JB_TRAJ_INITIALIZER {\
+	.seg	= NULL,\
+	.n	= 0,\
+	.cur	= 0}
+
+/**
+ * @brief      Position and velocity of every axis at time t within one
+ * segment.
+ *
+ * Before t0 the start is held, from t1 on the end.
+ *
+ * @param[in]  seg   planned segment
+ * @param[in]  t     time since the start (s)
+ * @param[out] pos   position of each axis
+ * @param[out] vel   velocity of each axis
+ *
+ * @return     0 before t1, 1 from t1 on
+ */
+int jb_traj_segment_eval(const jb_traj_segment_t* seg, double t,
+		double pos[JB_TRAJ_AXES], double vel[JB_TRAJ_AXES]);
+
+/**
+ * @brief      Position and velocity of every axis at time t.
+ *
+ * Constant time as long as t only moves forward by less than a segment
+ * between calls, which is what the control loop does. Going back in time
+ * works too, it only searches further. Before the first waypoint the start
+ * position is held.
+ *
+ * @param      tr    planned trajectory
+ * @param[in]  t     time since the start (s)
+ * @param[out] pos   position of each axis
+ * @param[out] vel   velocity of each axis
+ *
+ * @return     0 while moving, 1 once t reaches the last waypoint in which case
+ * pos is the last waypoint and vel is 0, -1 on error
+ */
+int jb_traj_eval(jb_traj_t* tr, double t, double pos[JB_TRAJ_AXES], double vel[JB_TRAJ_AXES]);
+
+/**
+ * @brief      Frees the segments and resets tr like JB_TRAJ_INITIALIZER.
+ *
+ * @param      tr    trajectory to free
+ */
+void jb_traj_free(jb_traj_t* tr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JB_TRAJECTORY_H
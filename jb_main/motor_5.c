@@ -50,6 +50,7 @@
 #define MOT_STBY		0,20	//gpio0.20	P9.41
 
 #define CHANNELS		5
+#define DIR_CHIPS		3	// direction pins are on gpiochip0-2
 
 
 // polarity of the motor connections
@@ -63,9 +64,55 @@ static int dirB_chip[CHANNELS];
 static int dirB_pin[CHANNELS];
 static int pwmss[CHANNELS];
 static int pwmch[CHANNELS];
+static int dirA_idx[CHANNELS];	// position of each direction pin in its group
+static int dirB_idx[CHANNELS];
+// direction pins of each chip are one gpio handle, written with one ioctl
+static rc_gpio_group_t dir_group[DIR_CHIPS];
+static int dir_val[DIR_CHIPS][RC_GPIO_GROUP_MAX_LINES];	// staged pin values
+static int dir_dirty[DIR_CHIPS];	// staged values not written yet
 
 
 
+/**
+ * @brief      stages new values for the direction pins of one motor, nothing
+ * is written until __commit_dir
+ *
+ * @param[in]  i     motor index 0-4
+ * @param[in]  a     value for pin A
+ * @param[in]  b     value for pin B
+ */
+static void __stage_dir(int i, int a, int b)
+{
+	if(dir_val[dirA_chip[i]][dirA_idx[i]]!=a){
+		dir_val[dirA_chip[i]][dirA_idx[i]] = a;
+		dir_dirty[dirA_chip[i]] = 1;
+	}
+	if(dir_val[dirB_chip[i]][dirB_idx[i]]!=b){
+		dir_val[dirB_chip[i]][dirB_idx[i]] = b;
+		dir_dirty[dirB_chip[i]] = 1;
+	}
+}
+
+
+/**
+ * @brief      writes staged direction pins, one ioctl per chip that changed
+ *
+ * @return     0 on success, -1 on failure
+ */
+static int __commit_dir(void)
+{
+	int c;
+	for(c=0;c<DIR_CHIPS;c++){
+		if(!dir_dirty[c]) continue;
+		if(unlikely(rc_gpio_group_set_values(&dir_group[c], dir_val[c]))){
+			fprintf(stderr,"ERROR in rc_motor, failed to write direction pins on gpio chip %d\n", c);
+			return -1;
+		}
+		dir_dirty[c] = 0;
+	}
+	return 0;
+}
+
 
 int jb_rc_motor_init(void)
 {
@@ -75,7 +122,9 @@ int jb_rc_motor_init(void)
 
 int jb_rc_motor_init_freq(int pwm_frequency_hz)
 {
-	int i;
+	int i, c;
+	int pins[DIR_CHIPS][2*CHANNELS];
+	int lines[DIR_CHIPS] = {0};
 
 	// set pins for motor 1
 	// assign gpio pins for blue/black
@@ -169,20 +218,33 @@ int jb_rc_motor_init_freq(int pwm_frequency_hz)
 		return -1;
 	}
 
+	// write duty cycles straight to the compare registers, sysfs still works
+	// if that isn't possible, just with more overhead per update
+	if(rc_pwm_init_mmap(NULL, 0)){
+		fprintf(stderr,"WARNING in rc_motor_init, falling back to sysfs pwm\n");
+	}
+
 	// set up gpio pins
 	if(unlikely(rc_gpio_init(MOT_STBY, GPIOHANDLE_REQUEST_OUTPUT))){
 		fprintf(stderr,"ERROR in rc_motor_init, failed to set up gpio %d,%d\n", MOT_STBY);
 		return -1;
 	}
+	// group the direction pins by chip
 	for(i=0;i<CHANNELS;i++){
-		if(unlikely(rc_gpio_init(dirA_chip[i],dirA_pin[i], GPIOHANDLE_REQUEST_OUTPUT))){
-			fprintf(stderr,"ERROR in rc_motor_init, failed to set up gpio %d,%d\n", dirA_chip[i],dirA_pin[i]);
-			return -1;
-		}
-		if(unlikely(rc_gpio_init(dirB_chip[i],dirB_pin[i], GPIOHANDLE_REQUEST_OUTPUT))){
-			fprintf(stderr,"ERROR in rc_motor_init, failed to set up gpio %d,%d\n", dirB_chip[i],dirB_pin[i]);
+		dirA_idx[i] = lines[dirA_chip[i]];
+		pins[dirA_chip[i]][lines[dirA_chip[i]]++] = dirA_pin[i];
+		dirB_idx[i] = lines[dirB_chip[i]];
+		pins[dirB_chip[i]][lines[dirB_chip[i]]++] = dirB_pin[i];
+	}
+	for(c=0;c<DIR_CHIPS;c++){
+		dir_group[c] = rc_gpio_group_empty();
+		if(lines[c]==0) continue;
+		if(unlikely(rc_gpio_group_init(&dir_group[c], c, pins[c], lines[c], GPIOHANDLE_REQUEST_OUTPUT))){
+			fprintf(stderr,"ERROR in rc_motor_init, failed to set up direction pins on gpio chip %d\n", c);
 			return -1;
 		}
+		for(i=0;i<lines[c];i++) dir_val[c][i] = 0;
+		dir_dirty[c] = 1;
 	}
 
 	// now set all the gpio pins and pwm to something predictable
@@ -215,9 +277,8 @@ int jb_rc_motor_cleanup(void)
 	rc_pwm_cleanup(1);
 	rc_pwm_cleanup(2);
 	rc_gpio_cleanup(MOT_STBY);
-	for(i=0;i<CHANNELS;i++){
-		rc_gpio_cleanup(dirA_chip[i],dirA_pin[i]);
-		rc_gpio_cleanup(dirB_chip[i],dirB_pin[i]);
+	for(i=0;i<DIR_CHIPS;i++){
+		rc_gpio_group_cleanup(&dir_group[i]);
 	}
 	return 0;
 }
@@ -280,19 +341,52 @@ int jb_rc_motor_set(int motor, double duty)
 	if(duty>=0.0){	a=1; b=0;}
 	else{		a=0; b=1; duty=-duty;}
 
-	// set gpio and pwm for that motor
-	if(unlikely(rc_gpio_set_value(dirA_chip[motor-1],dirA_pin[motor-1], a))){
-		fprintf(stderr,"ERROR in rc_motor_set, failed to write to gpio pin %d,%d\n",dirA_chip[motor-1],dirA_pin[motor-1]);
+	// set gpio and pwm for that motor, gpio only if the direction changed
+	__stage_dir(motor-1, a, b);
+	if(unlikely(__commit_dir())) return -1;
+	if(unlikely(rc_pwm_set_duty(pwmss[motor-1], pwmch[motor-1], duty))){
+		fprintf(stderr,"ERROR in rc_motor_set, failed to write to pwm %d%c\n",pwmss[motor-1], pwmch[motor-1]);
 		return -1;
 	}
-	if(unlikely(rc_gpio_set_value(dirB_chip[motor-1],dirB_pin[motor-1], b))){
-		fprintf(stderr,"ERROR in rc_motor_set, failed to write to gpio pin %d,%d\n",dirB_chip[motor-1],dirB_pin[motor-1]);
+	return 0;
+}
+
+
+int jb_rc_motor_set_all(const double duty[5])
+{
+	int a[CHANNELS], b[CHANNELS], i;
+	double d[CHANNELS];
+
+	// sanity checks
+	if(unlikely(duty==NULL)){
+		fprintf(stderr,"ERROR in rc_motor_set_all, received NULL pointer\n");
 		return -1;
 	}
-	if(unlikely(rc_pwm_set_duty(pwmss[motor-1], pwmch[motor-1], duty))){
-		fprintf(stderr,"ERROR in rc_motor_set, failed to write to pwm %d%c\n",pwmss[motor-1], pwmch[motor-1]);
+	if(unlikely(init_flag==0)){
+		fprintf(stderr, "ERROR in rc_motor_set_all, call rc_motor_init first\n");
 		return -1;
 	}
+
+	for(i=0;i<CHANNELS;i++){
+		d[i] = duty[i];
+		if	(d[i] > 1.0)	d[i] = 1.0;
+		else if	(d[i] <-1.0)	d[i] =-1.0;
+		d[i] = d[i]*polarity[i];
+		if(d[i]>=0.0){	a[i]=1; b[i]=0;}
+		else{		a[i]=0; b[i]=1; d[i]=-d[i];}
+	}
+
+	// directions first, at most one ioctl per chip, then the duty cycles back
+	// to back. With the pwm registers mapped those are five stores that land
+	// in the same period.
+	for(i=0;i<CHANNELS;i++) __stage_dir(i, a[i], b[i]);
+	if(unlikely(__commit_dir())) return -1;
+	for(i=0;i<CHANNELS;i++){
+		if(unlikely(rc_pwm_set_duty(pwmss[i], pwmch[i], d[i]))){
+			fprintf(stderr,"ERROR in rc_motor_set_all, failed to write to pwm %d%c\n",pwmss[i], pwmch[i]);
+			return -1;
+		}
+	}
 	return 0;
 }
 
@@ -320,12 +414,9 @@ int jb_rc_motor_free_spin(int motor)
 	}
 
 	// set gpio and pwm for that motor
-	if(unlikely(rc_gpio_set_value(dirA_chip[motor-1],dirA_pin[motor-1], 0))){
-		fprintf(stderr,"ERROR in rc_motor_free_spin, failed to write to gpio pin %d,%d\n",dirA_chip[motor-1],dirA_pin[motor-1]);
-		return -1;
-	}
-	if(unlikely(rc_gpio_set_value(dirB_chip[motor-1],dirB_pin[motor-1], 0))){
-		fprintf(stderr,"ERROR in rc_motor_free_spin, failed to write to gpio pin %d,%d\n",dirB_chip[motor-1],dirB_pin[motor-1]);
+	__stage_dir(motor-1, 0, 0);
+	if(unlikely(__commit_dir())){
+		fprintf(stderr,"ERROR in rc_motor_free_spin, failed to write direction pins of motor %d\n",motor);
 		return -1;
 	}
 	if(unlikely(rc_pwm_set_duty(pwmss[motor-1], pwmch[motor-1], 0.0))){
@@ -359,12 +450,9 @@ int jb_rc_motor_brake(int motor)
 	}
 
 	// set gpio and pwm for that motor
-	if(unlikely(rc_gpio_set_value(dirA_chip[motor-1],dirA_pin[motor-1], 1))){
-		fprintf(stderr,"ERROR in rc_motor_brake, failed to write to gpio pin %d,%d\n",dirA_chip[motor-1],dirA_pin[motor-1]);
-		return -1;
-	}
-	if(unlikely(rc_gpio_set_value(dirB_chip[motor-1],dirB_pin[motor-1], 1))){
-		fprintf(stderr,"ERROR in rc_motor_brake, failed to write to gpio pin %d,%d\n",dirB_chip[motor-1],dirB_pin[motor-1]);
+	__stage_dir(motor-1, 1, 1);
+	if(unlikely(__commit_dir())){
+		fprintf(stderr,"ERROR in rc_motor_brake, failed to write direction pins of motor %d\n",motor);
 		return -1;
 	}
 	if(unlikely(rc_pwm_set_duty(pwmss[motor-1], pwmch[motor-1], 0.0))){
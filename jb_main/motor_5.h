@@ -103,6 +103,20 @@ int jb_rc_motor_standby(int standby_en);
 int jb_rc_motor_set(int ch, double duty);
 
 
+/**
+ * @brief      Sets the duty cycle of all 5 motors in one call.
+ *
+ * Direction pins are only written for motors whose direction changed, and the
+ * five duty cycles are written back to back so they take effect together.
+ *
+ * @param[in]  duty  Duty cycles for motors 1-5, duty[0] is motor 1, each -1.0
+ * for full reverse to 1.0 for full forward
+ *
+ * @return     0 on success, -1 on failure
+ */
+int jb_rc_motor_set_all(const double duty[5]);
+
+
 /**
  * @brief      Puts a motor into a zero-throttle state allowing it to spin
  * freely.
@@ -24,6 +24,22 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+
+#define RC_ENCODER_CHANNELS	4	///< number of channels, 1-3 eQEP and 4 PRU
+
+/**
+ * @brief      Positions of every channel captured in one pass.
+ *
+ * counts[0] is channel 1. Channels 1-3 are captured together so they share a
+ * capture time, channel 4 is captured right after them.
+ */
+typedef struct rc_encoder_snapshot_t {
+	int32_t counts[RC_ENCODER_CHANNELS];	///< positions of channels 1-4
+	uint64_t t_ns;				///< middle of the whole capture, rc_nanos_since_boot
+	uint64_t ch_t_ns[RC_ENCODER_CHANNELS];	///< capture time of each channel
+} rc_encoder_snapshot_t;
+
 
 /**
  * @brief      Initializes counters for channels 1-4
@@ -35,6 +51,16 @@ extern "C" {
  */
 int rc_encoder_init(void);
 
+/**
+ * @brief      Initializes counters for channels 1-4, reading channels 1-3
+ * through memory-mapped eQEP registers instead of sysfs.
+ *
+ * Needs root. See rc_encoder_eqep_init_mmap.
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_encoder_init_mmap(void);
+
 /**
  * @brief      Stops the encoder counters and closes file descriptors. This is
  * not strictly necessary but is recommended that the user calls this function
@@ -68,6 +94,52 @@ int rc_encoder_read(int ch);
  */
 int rc_encoder_write(int ch, int pos);
 
+/**
+ * @brief      Reads all 4 channels in one pass with a single timestamp.
+ *
+ * Much cheaper than four calls to rc_encoder_read once the eQEP registers
+ * are mapped with rc_encoder_init_mmap, and the positions are close to
+ * simultaneous. Needs rc_encoder_init or rc_encoder_init_mmap. Unlike
+ * rc_encoder_read, a failed read of any channel fails the whole call rather
+ * than returning -1 as a position.
+ *
+ * @param[out] counts  array of RC_ENCODER_CHANNELS positions, counts[0] is
+ * channel 1
+ * @param[out] t_ns    capture time, may be NULL
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_encoder_read_all(int32_t counts[RC_ENCODER_CHANNELS], uint64_t* t_ns);
+
+/**
+ * @brief      Like rc_encoder_read_all but also records when each channel was
+ * captured.
+ *
+ * On failure the snapshot is left unchanged, so a caller can keep using the
+ * last good one as the prev argument of rc_encoder_velocity.
+ *
+ * @param[out] snap  pointer to user's snapshot struct
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_encoder_snapshot(rc_encoder_snapshot_t* snap);
+
+/**
+ * @brief      Estimates the speed of every channel from two snapshots.
+ *
+ * Each channel's count difference is divided by the time between its own
+ * capture times, so speeds stay correct if channels are read at different
+ * instants. Counter wrap-around between the snapshots is handled.
+ *
+ * @param[in]  prev  older snapshot
+ * @param[in]  curr  newer snapshot
+ * @param[out] vel   array of RC_ENCODER_CHANNELS speeds in counts per second
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_encoder_velocity(const rc_encoder_snapshot_t* prev,
+	const rc_encoder_snapshot_t* curr, double vel[RC_ENCODER_CHANNELS]);
+
 
 #ifdef __cplusplus
 }
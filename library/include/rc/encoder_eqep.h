@@ -8,6 +8,12 @@
  * Cape and BeagleBone Blue. Channel 4 is counted with the PRU, see
  * <rc/encoder_pru.h> to use the 4th channel.
  *
+ * By default the counters are read through the kernel driver's sysfs files,
+ * which costs a seek, a read and a string conversion per sample. After
+ * rc_encoder_eqep_init_mmap the eQEP register blocks are mapped into the
+ * process instead and every read is a single load from the QPOSCNT register.
+ * The rest of the API, and rc_encoder_read, stay the same.
+ *
  *
  * @author     James Strawson
  * @date       1/31/2018
@@ -24,6 +30,11 @@
 extern "C" {
 #endif
 
+#include <sys/types.h> // for off_t
+
+#define RC_ENCODER_EQEP_MMAP_ADDR	0x48300000	///< physical address of PWMSS0
+#define RC_ENCODER_EQEP_MMAP_LEN	0x6000		///< bytes mapped, covers PWMSS0-2
+
 
 /**
  * @brief      Initializes the eQEP encoder counters for channels 1-3
@@ -36,6 +47,24 @@ extern "C" {
  */
 int rc_encoder_eqep_init(void);
 
+/**
+ * @brief      Initializes the eQEP counters for direct register access.
+ *
+ * With path NULL this enables the counters through the kernel driver like
+ * rc_encoder_eqep_init and then maps the registers from /dev/mem, which needs
+ * root. Otherwise the RC_ENCODER_EQEP_MMAP_LEN bytes at offset in path are
+ * mapped and used as the register window as-is, without touching the driver.
+ * That is how a UIO device is used, or a plain file standing in for the
+ * hardware in tests, in which case the position counter of channel ch is the
+ * 32-bit word at byte (ch-1)*0x2000 + 0x180 of the file.
+ *
+ * @param[in]  path    register file to map or NULL for the real hardware
+ * @param[in]  offset  page-aligned offset into path, ignored if path is NULL
+ *
+ * @return     0 on success or -1 on failure
+ */
+int rc_encoder_eqep_init_mmap(const char* path, off_t offset);
+
 /**
  * @brief      Stops the eQEP encoder counters and closes file descriptors. This
  * is not strictly necessary but is recommended that the user calls this
@@ -69,6 +98,19 @@ int rc_encoder_eqep_read(int ch);
  */
 int rc_encoder_eqep_write(int ch, int pos);
 
+/**
+ * @brief      Reads channels 1-3 at once.
+ *
+ * With the registers mapped this is three consecutive loads so the positions
+ * form a consistent snapshot. Through sysfs it is equivalent to three calls to
+ * rc_encoder_eqep_read.
+ *
+ * @param[out] pos   array of 3 positions, pos[0] is channel 1
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_encoder_eqep_read_all(int pos[3]);
+
 
 #ifdef __cplusplus
 }
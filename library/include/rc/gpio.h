@@ -32,6 +32,8 @@ extern "C" {
 #define GPIOHANDLE_REQUEST_OPEN_SOURCE	(1UL << 4)
 #endif
 
+#define RC_GPIO_GROUP_MAX_LINES	64	///< lines per group, kernel GPIOHANDLES_MAX
+
 
 /**
  * @brief      Configures a gpio pin as input or output
@@ -139,6 +141,83 @@ int rc_gpio_init_event(int chip, int pin, int handle_flags, int event_flags);
 int rc_gpio_poll(int chip, int pin, int timeout_ms, uint64_t* event_time_ns);
 
 
+/**
+ * @brief      A set of lines on one gpio chip requested as a single handle.
+ *
+ * All lines in a group are set or read together with one ioctl, so outputs
+ * change at the same time instead of passing through intermediate states.
+ * Initialize with RC_GPIO_GROUP_INITIALIZER or rc_gpio_group_empty().
+ */
+typedef struct rc_gpio_group_t {
+	int chip;				///< chip number, /dev/gpiochipX
+	int lines;				///< number of lines in the group
+	int pins[RC_GPIO_GROUP_MAX_LINES];	///< line offsets, in request order
+	int fd;					///< handle file descriptor
+	int initialized;			///< set to 1 by rc_gpio_group_init
+} rc_gpio_group_t;
+
+#define RC_GPIO_GROUP_INITIALIZER {\
+	.chip = 0,\
+	.lines = 0,\
+	.pins = {0},\
+	.fd = -1,\
+	.initialized = 0}
+
+/**
+ * @brief      Returns an rc_gpio_group_t with no lines requested.
+ *
+ * @return     empty group
+ */
+rc_gpio_group_t rc_gpio_group_empty(void);
+
+/**
+ * @brief      Requests several lines of one chip as a single handle.
+ *
+ * Takes the same handle flags as rc_gpio_init and they apply to every line.
+ * A line can't be in a group and also be requested with rc_gpio_init.
+ *
+ * @param      group         pointer to user's group struct
+ * @param[in]  chip          The chip number, /dev/gpiochipX
+ * @param[in]  pins          array of line offsets
+ * @param[in]  lines         number of lines, 1 to RC_GPIO_GROUP_MAX_LINES
+ * @param[in]  handle_flags  The handle flags
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_gpio_group_init(rc_gpio_group_t* group, int chip, const int* pins, int lines, int handle_flags);
+
+/**
+ * @brief      Sets every output line of a group with one ioctl.
+ *
+ * @param      group   pointer to an initialized group
+ * @param[in]  values  one value per line in the order given to
+ * rc_gpio_group_init, nonzero for high
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_gpio_group_set_values(rc_gpio_group_t* group, const int* values);
+
+/**
+ * @brief      Reads every line of a group with one ioctl.
+ *
+ * @param      group   pointer to an initialized group
+ * @param[out] values  one value per line, 0 or 1
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_gpio_group_get_values(rc_gpio_group_t* group, int* values);
+
+/**
+ * @brief      Releases the lines of a group.
+ *
+ * @param      group  pointer to user's group struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_gpio_group_cleanup(rc_gpio_group_t* group);
+
+
+
 /**
  * @brief      closes the file descriptor for a pin
  *
@@ -16,12 +16,20 @@
 
 #include <rc/math/algebra.h>
 #include <rc/math/filter.h>
+#include <rc/math/filter_bank.h>
 #include <rc/math/kalman.h>
 #include <rc/math/matrix.h>
 #include <rc/math/other.h>
 #include <rc/math/polynomial.h>
 #include <rc/math/quaternion.h>
 #include <rc/math/ring_buffer.h>
+#include <rc/math/single_precision.h>
+#include <rc/math/sos.h>
+#include <rc/math/spline.h>
+#include <rc/math/small_matrix.h>
+#include <rc/math/spsc_queue.h>
+#include <rc/math/ukf.h>
 #include <rc/math/vector.h>
+#include <rc/math/workspace.h>
 
 #endif // RC_MATH_H
@@ -16,6 +16,33 @@ extern "C" {
 #endif
 
 #include <rc/math/matrix.h>
+#include <rc/math/small_matrix.h>
+
+/**
+ * @brief      Running sums for fitting an ellipsoid one point at a time, see
+ * rc_algebra_ellipsoid_fit_add.
+ *
+ * Holds the normal equations of the same least squares problem
+ * rc_algebra_fit_ellipsoid solves, so memory stays constant no matter how
+ * many points are added. Set decay below 1.0 to weight old points less, for
+ * example 0.999 keeps roughly the last 1000 points, so a fit left running in
+ * the background follows slow changes. The user can read and modify values
+ * directly from this struct.
+ */
+typedef struct rc_ellipsoid_fit_t{
+	rc_mat6_t ata;		///< sum of r*r' for rows r, upper triangle only
+	double atb[6];		///< sum of rows r
+	double weight;		///< sum of point weights, the number of points without decay
+	double decay;		///< weight kept by old points each time one is added, usually 1.0
+	int points;		///< number of points added since reset
+} rc_ellipsoid_fit_t;
+
+#define RC_ELLIPSOID_FIT_INITIALIZER {\
+	.ata		= {{{0.0}}},\
+	.atb		= {0.0},\
+	.weight		= 0.0,\
+	.decay		= 1.0,\
+	.points		= 0}
 
 /**
  * @brief      Performs LUP decomposition on matrix A with partial pivoting.
@@ -99,7 +126,8 @@ int rc_algebra_lin_system_solve(rc_matrix_t A, rc_vector_t b, rc_vector_t* x);
  * with unusually small or large floating point values.
  *
  * This only effects the operation of rc_algebra_invert_matrix,
- * rc_algebra_invert_matrix_inplace, and rc_algebra_lin_system_solve.
+ * rc_algebra_invert_matrix_inplace, rc_algebra_lin_system_solve and the
+ * Cholesky, LDL' and triangular solve functions.
  *
  * @param[in]  tol   The zero-tolerance
  */
@@ -119,6 +147,192 @@ void rc_algebra_set_zero_tolerance(double tol);
  */
 int rc_algebra_lin_system_solve_qr(rc_matrix_t A, rc_vector_t b, rc_vector_t* x);
 
+/**
+ * @brief      Cholesky decomposition of a symmetric positive definite matrix.
+ *
+ * Finds lower triangular L with A = L*L'. Only the lower triangle of A is read.
+ * Takes about half the work of rc_algebra_lup_decomp and needs no pivoting,
+ * which makes it the natural choice for covariance matrices. L is resized if
+ * necessary and its upper triangle is zeroed.
+ *
+ * @param[in]  A     symmetric positive definite matrix
+ * @param[out] L     lower triangular factor
+ *
+ * @return     Returns 0 on success or -1 on failure, including when A is not
+ * positive definite to within the zero tolerance.
+ */
+int rc_algebra_cholesky_decomp(rc_matrix_t A, rc_matrix_t* L);
+
+/**
+ * @brief      Cholesky decomposition of A in place, A is replaced with L.
+ *
+ * Same as rc_algebra_cholesky_decomp without allocating. On failure the
+ * contents of A are lost.
+ *
+ * @param      A     symmetric positive definite matrix, becomes L
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_cholesky_decomp_inplace(rc_matrix_t* A);
+
+/**
+ * @brief      Solves A*x=b given the Cholesky factor L of A.
+ *
+ * Costs two triangular solves. x is resized if necessary and may be the same
+ * vector as b.
+ *
+ * @param[in]  L     lower triangular factor from rc_algebra_cholesky_decomp
+ * @param[in]  b     column vector b
+ * @param[out] x     solution column vector
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_cholesky_solve(rc_matrix_t L, rc_vector_t b, rc_vector_t* x);
+
+/**
+ * @brief      Solves A*X=B in place for a matrix of right hand sides given the
+ * Cholesky factor L of A.
+ *
+ * Each column of B is replaced with the solution for that column. This is how
+ * a Kalman gain is found without inverting the innovation covariance.
+ *
+ * @param[in]  L     lower triangular factor from rc_algebra_cholesky_decomp
+ * @param      B     right hand sides, replaced with the solutions
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_cholesky_solve_matrix_inplace(rc_matrix_t L, rc_matrix_t* B);
+
+/**
+ * @brief      Replaces Cholesky factor L of A with the factor of A + x*x'.
+ *
+ * O(n^2) instead of the O(n^3) of decomposing the updated matrix again.
+ *
+ * @param      L     lower triangular factor, updated in place
+ * @param[in]  x     update vector, not modified
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_cholesky_update(rc_matrix_t* L, rc_vector_t x);
+
+/**
+ * @brief      Replaces Cholesky factor L of A with the factor of A - x*x'.
+ *
+ * Checks first that A - x*x' stays positive definite and leaves L untouched if
+ * it wouldn't.
+ *
+ * @param      L     lower triangular factor, downdated in place
+ * @param[in]  x     downdate vector, not modified
+ *
+ * @return     Returns 0 on success or -1 on failure, including when the result
+ * would not be positive definite.
+ */
+int rc_algebra_cholesky_downdate(rc_matrix_t* L, rc_vector_t x);
+
+/**
+ * @brief      Solves L*x=b by forward substitution for lower triangular L.
+ *
+ * Only the lower triangle of L is read. x is resized if necessary and may be
+ * the same vector as b.
+ *
+ * @param[in]  L     lower triangular matrix
+ * @param[in]  b     column vector b
+ * @param[out] x     solution column vector
+ *
+ * @return     Returns 0 on success or -1 on failure, including a zero on the
+ * diagonal.
+ */
+int rc_algebra_forward_substitute(rc_matrix_t L, rc_vector_t b, rc_vector_t* x);
+
+/**
+ * @brief      Solves U*x=b by back substitution for upper triangular U.
+ *
+ * Only the upper triangle of U is read. x is resized if necessary and may be
+ * the same vector as b.
+ *
+ * @param[in]  U     upper triangular matrix
+ * @param[in]  b     column vector b
+ * @param[out] x     solution column vector
+ *
+ * @return     Returns 0 on success or -1 on failure, including a zero on the
+ * diagonal.
+ */
+int rc_algebra_backward_substitute(rc_matrix_t U, rc_vector_t b, rc_vector_t* x);
+
+/**
+ * @brief      LDL' decomposition of a symmetric matrix.
+ *
+ * Finds unit lower triangular L and diagonal D with A = L*diag(D)*L'. Unlike
+ * Cholesky it takes no square roots and also works for symmetric indefinite
+ * matrices as long as no pivot is zero. Only the lower triangle of A is read.
+ *
+ * @param[in]  A     symmetric matrix
+ * @param[out] L     unit lower triangular factor
+ * @param[out] D     diagonal of the middle factor
+ *
+ * @return     Returns 0 on success or -1 on failure, including a pivot smaller
+ * than the zero tolerance.
+ */
+int rc_algebra_ldl_decomp(rc_matrix_t A, rc_matrix_t* L, rc_vector_t* D);
+
+/**
+ * @brief      Solves A*x=b given the LDL' factors of A.
+ *
+ * x is resized if necessary and may be the same vector as b.
+ *
+ * @param[in]  L     unit lower triangular factor from rc_algebra_ldl_decomp
+ * @param[in]  D     diagonal from rc_algebra_ldl_decomp
+ * @param[in]  b     column vector b
+ * @param[out] x     solution column vector
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_ldl_solve(rc_matrix_t L, rc_vector_t D, rc_vector_t b, rc_vector_t* x);
+
+/**
+ * @brief      Solves A*x=b for tridiagonal A in O(n) with the Thomas
+ * algorithm.
+ *
+ * A is given by its three diagonals: sub[i]=A(i+1,i), diag[i]=A(i,i) and
+ * sup[i]=A(i,i+1), so sub and sup have one entry fewer than diag. There is no
+ * pivoting, which is safe for diagonally dominant or symmetric positive
+ * definite A such as the systems of spline fitting. None of the diagonals are
+ * modified. x is resized if necessary and may be the same vector as b.
+ *
+ * @param[in]  sub   subdiagonal, length n-1
+ * @param[in]  diag  main diagonal, length n
+ * @param[in]  sup   superdiagonal, length n-1
+ * @param[in]  b     column vector b, length n
+ * @param[out] x     solution column vector
+ *
+ * @return     Returns 0 on success or -1 on failure, including a pivot smaller
+ * than the zero tolerance.
+ */
+int rc_algebra_tridiag_solve(rc_vector_t sub, rc_vector_t diag, rc_vector_t sup, rc_vector_t b, rc_vector_t* x);
+
+/**
+ * @brief      Solves A*x=b for banded A with kl subdiagonals and ku
+ * superdiagonals by Gaussian elimination with partial pivoting.
+ *
+ * Takes O(n*kl*(kl+ku)) time instead of the O(n^3) of
+ * rc_algebra_lin_system_solve, for the systems of spline fitting and other
+ * problems where each unknown only couples to a few neighbours. Ab holds A in
+ * band storage, n rows and kl+ku+1 columns with Ab.d[i][j-i+kl] = A(i,j), so
+ * column kl is the main diagonal. Entries of Ab that fall outside A are
+ * ignored. Ab isn't modified, the elimination works on a copy. x is resized if
+ * necessary and may be the same vector as b.
+ *
+ * @param[in]  Ab    A in band storage
+ * @param[in]  kl    number of subdiagonals
+ * @param[in]  ku    number of superdiagonals
+ * @param[in]  b     column vector b
+ * @param[out] x     solution column vector
+ *
+ * @return     Returns 0 on success or -1 on failure, including a singular
+ * matrix.
+ */
+int rc_algebra_band_solve(rc_matrix_t Ab, int kl, int ku, rc_vector_t b, rc_vector_t* x);
+
 /**
  * @brief      Fits an ellipsoid to a set of points in 3D space.
  *
@@ -144,6 +358,56 @@ int rc_algebra_lin_system_solve_qr(rc_matrix_t A, rc_vector_t b, rc_vector_t* x)
  */
 int rc_algebra_fit_ellipsoid(rc_matrix_t points, rc_vector_t* center, rc_vector_t* lengths);
 
+/**
+ * @brief      Forgets all points added to a streaming ellipsoid fit.
+ *
+ * The decay setting is kept.
+ *
+ * @param      e     Pointer to user's rc_ellipsoid_fit_t struct
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_ellipsoid_fit_reset(rc_ellipsoid_fit_t* e);
+
+/**
+ * @brief      Adds one point to a streaming ellipsoid fit.
+ *
+ * Constant time and no memory is allocated, so this can be called from a
+ * sensor callback. Points should cover as much of the ellipsoid as possible
+ * before solving, just like for rc_algebra_fit_ellipsoid.
+ *
+ * @param      e     Pointer to user's rc_ellipsoid_fit_t struct
+ * @param[in]  p     x,y,z coordinates of the point
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_algebra_ellipsoid_fit_add(rc_ellipsoid_fit_t* e, const double p[3]);
+
+/**
+ * @brief      Solves for the ellipsoid that best fits the points added so
+ * far.
+ *
+ * Gives the same result as rc_algebra_fit_ellipsoid on the same points, to
+ * within rounding, and can be called as often as needed while points are
+ * still being added, for instance to stop collecting once the center and
+ * lengths stop changing. The struct isn't modified.
+ *
+ * The residual is the RMS over all points of a*x^2+b*x+c*y^2+d*y+e*z^2+f*z-1
+ * for the fitted coefficients. For points close to the surface this is
+ * roughly twice the RMS distance from the surface relative to the length in
+ * that direction, so 0.02 means the points scatter about 1% of the radius.
+ *
+ * @param[in]  e         Pointer to user's rc_ellipsoid_fit_t struct
+ * @param[out] center    x,y,z of the center
+ * @param[out] lengths   lengths from the center to the surface along x,y,z
+ * @param[out] residual  RMS residual of the fit, may be NULL
+ *
+ * @return     Returns 0 on success or -1 if there are fewer than 6 points or
+ * they don't determine an ellipsoid yet, in which case the outputs are untouched
+ * and nothing is printed so it can be polled while collecting.
+ */
+int rc_algebra_ellipsoid_fit_solve(const rc_ellipsoid_fit_t* e, double center[3], double lengths[3], double* residual);
+
 
 #ifdef  __cplusplus
 }
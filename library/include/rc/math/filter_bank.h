@@ -0,0 +1,236 @@
+/**
+ * <rc/math/filter_bank.h>
+ *
+ * @brief      Banks of discrete SISO filters of the same order marched
+ * together.
+ *
+ * Running one rc_filter_t per motor means a separate pair of heap ring
+ * buffers and coefficient vectors per channel and a walk through each of
+ * them in turn every step. A filter bank keeps N filters in structure of
+ * arrays form instead: row k of each array holds coefficient or history
+ * element k for every channel side by side in one block of memory. A march
+ * then runs the difference equation for all channels at once with the
+ * channel as the innermost, contiguous loop, which the compiler vectorizes.
+ *
+ * Every channel has the order of the bank. Lower order filters are loaded
+ * with rc_filter_bank_set_channel() by padding with zero coefficients, which
+ * changes nothing about their response. The usual approach is to design
+ * each channel with the rc_filter_t functions and copy it in:
+ *
+ * @code{.c}
+ * rc_filter_bank_t bank = RC_FILTER_BANK_INITIALIZER;
+ * rc_filter_t D = RC_FILTER_INITIALIZER;
+ * rc_filter_bank_alloc(&bank, 5, 2, DT);
+ * for(i=0;i<5;i++){
+ *	rc_filter_pid(&D, kp[i], ki[i], kd[i], 4*DT, DT);
+ *	rc_filter_enable_saturation(&D, -1.0, 1.0);
+ *	rc_filter_bank_set_channel(&bank, i, D);
+ * }
+ * rc_filter_free(&D);
+ * while(running){
+ *	bank.gain[0] = ...;	// gains may be changed at any time
+ *	rc_filter_bank_march(&bank, errors, u);
+ * }
+ * @endcode
+ *
+ * @addtogroup Filter_Bank
+ * @ingroup    Math
+ * @{
+ */
+
+#ifndef RC_FILTER_BANK_H
+#define RC_FILTER_BANK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <rc/math/filter.h>
+
+/**
+ * @brief      Struct containing the configuration and state of a bank of
+ * filters.
+ *
+ * The arrays all live in one allocation and are padded to stride channels so
+ * each row starts aligned. Rows past the number of channels stay zero. The
+ * user may read the arrays and write gain directly, use the functions below
+ * for everything else.
+ */
+typedef struct rc_filter_bank_t{
+	/** @name dimensions */
+	///@{
+	int channels;		///< number of filters in the bank
+	int order;		///< transfer function order of every channel
+	int stride;		///< distance between rows of the arrays
+	double dt;		///< timestep in seconds
+	///@}
+
+	/** @name coefficients, normalized so every denominator leads with 1 */
+	///@{
+	double* num;		///< row k multiplies the input from k steps ago
+	double* den;		///< row k multiplies the output from k steps ago, row 0 unused
+	double* gain;		///< additional gain multiplier per channel, usually 1.0
+	///@}
+
+	/** @name saturation and soft start per channel */
+	///@{
+	double* sat_min;	///< lower saturation limit
+	double* sat_max;	///< upper saturation limit
+	double* ss_steps;	///< steps before full output allowed, 0 if soft start is off
+	int* sat_flag;		///< 1 if the channel saturated on the last step
+	///@}
+
+	/** @name history */
+	///@{
+	double* in;		///< order+1 rows of past inputs, used as a ring
+	double* out;		///< order+1 rows of past outputs, used as a ring
+	int head;		///< row of in and out holding the newest step
+	uint64_t step;		///< steps since last reset
+	///@}
+
+	/** @name other */
+	///@{
+	void* mem;		///< the one allocation behind all arrays
+	int borrowed;		///< 1 if mem belongs to an rc_workspace_t
+	int initialized;	///< initialization flag
+	///@}
+} rc_filter_bank_t;
+
+#define RC_FILTER_BANK_INITIALIZER {\
+	.channels	= 0,\
+	.order		= 0,\
+	.stride		= 0,\
+	.dt		= 0.0,\
+	.num		= NULL,\
+	.den		= NULL,\
+	.gain		= NULL,\
+	.sat_min	= NULL,\
+	.sat_max	= NULL,\
+	.ss_steps	= NULL,\
+	.sat_flag	= NULL,\
+	.in		= NULL,\
+	.out		= NULL,\
+	.head		= 0,\
+	.step		= 0,\
+	.mem		= NULL,\
+	.borrowed	= 0,\
+	.initialized	= 0}
+
+/**
+ * @brief      Returns an rc_filter_bank_t with no memory allocated, see
+ * rc_filter_empty for why this matters.
+ *
+ * @return     Empty zero-filled rc_filter_bank_t struct
+ */
+rc_filter_bank_t rc_filter_bank_empty(void);
+
+/**
+ * @brief      Allocates a bank of filters.
+ *
+ * Every channel starts as a unity gain pass-through with saturation and soft
+ * start off until it is set with rc_filter_bank_set_channel. If the bank was
+ * already allocated its old memory is freed first.
+ *
+ * @param[out] bank      Pointer to user's rc_filter_bank_t struct
+ * @param[in]  channels  number of filters, >=1
+ * @param[in]  order     order shared by all filters, >=0
+ * @param[in]  dt        Timestep in seconds
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_filter_bank_alloc(rc_filter_bank_t* bank, int channels, int order, double dt);
+
+/**
+ * @brief      Frees the memory of a bank and resets it like
+ * rc_filter_bank_empty.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_filter_bank_free(rc_filter_bank_t* bank);
+
+/**
+ * @brief      Copies the transfer function, gain, saturation and soft start
+ * settings of a filter into one channel of the bank.
+ *
+ * The filter's order must not exceed the bank's and its timestep must match.
+ * The channel's history is left alone, reset the bank to clear it.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ * @param[in]  ch    channel to set
+ * @param[in]  f     filter to copy
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_filter_bank_set_channel(rc_filter_bank_t* bank, int ch, rc_filter_t f);
+
+/**
+ * @brief      Enables saturation of one channel, like
+ * rc_filter_enable_saturation.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ * @param[in]  ch    channel
+ * @param[in]  min   The lower limit
+ * @param[in]  max   The upper limit
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_filter_bank_enable_saturation(rc_filter_bank_t* bank, int ch, double min, double max);
+
+/**
+ * @brief      Enables soft start of one channel, like
+ * rc_filter_enable_soft_start. Saturation of the channel must be enabled
+ * first.
+ *
+ * @param      bank     Pointer to user's rc_filter_bank_t struct
+ * @param[in]  ch       channel
+ * @param[in]  seconds  Time in seconds
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_filter_bank_enable_soft_start(rc_filter_bank_t* bank, int ch, double seconds);
+
+/**
+ * @brief      Marches every channel forward one step.
+ *
+ * Gives each channel the same output rc_filter_march would, including gain,
+ * soft start and saturation, and sets the saturation flags.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ * @param[in]  in    one new input per channel
+ * @param[out] out   one new output per channel, may be the same array as in
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_filter_bank_march(rc_filter_bank_t* bank, const double* in, double* out);
+
+/**
+ * @brief      Zeros the history of every channel and the step counter, the
+ * configuration is kept.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_filter_bank_reset(rc_filter_bank_t* bank);
+
+/**
+ * @brief      Checks if a channel saturated on the last step.
+ *
+ * @param      bank  Pointer to user's rc_filter_bank_t struct
+ * @param[in]  ch    channel
+ *
+ * @return     1 if saturated, 0 if not, -1 on error.
+ */
+int rc_filter_bank_get_saturation_flag(rc_filter_bank_t* bank, int ch);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_FILTER_BANK_H
+
+/** @} end group math*/
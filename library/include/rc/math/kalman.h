@@ -55,6 +55,11 @@
  * return;
  * ```
  *
+ * All the memory a filter needs, including the working memory of the update
+ * step, is allocated by rc_kalman_alloc_lin() or rc_kalman_alloc_ekf() so the
+ * update functions never touch the heap. When R is diagonal the measurements
+ * can be processed one at a time instead, see rc_kalman_set_sequential().
+ *
  * @date       April 2018
  * @author     Eric Nauli Sihite & James Strawson
  *
@@ -101,8 +106,19 @@ typedef struct rc_kalman_t {
 	rc_vector_t x_pre;	///< Predicted state x[k|k-1] = f(x[k-1],u[k])
 	///@}
 
+	/** @name Working memory sized by rc_kalman_alloc, not for the user */
+	///@{
+	rc_matrix_t FP;		///< F*P during the prediction
+	rc_matrix_t HP;		///< H*P
+	rc_matrix_t LT;		///< transpose of the Kalman gain L
+	rc_matrix_t S;		///< innovation covariance, then its Cholesky factor
+	rc_vector_t z;		///< innovation y-h
+	rc_vector_t Ph;		///< P*h' for one row h of H in the sequential update
+	///@}
+
 	/** @name other */
 	///@{
+	int sequential;		///< set with rc_kalman_set_sequential
 	int initialized;	///< set to 1 once initialized with rc_kalman_alloc
 	uint64_t step;		///< counts times rc_kalman_measurement_update has been called
 	///@}
@@ -118,6 +134,13 @@ typedef struct rc_kalman_t {
 	.Pi = RC_MATRIX_INITIALIZER,\
 	.x_est = RC_VECTOR_INITIALIZER,\
 	.x_pre = RC_VECTOR_INITIALIZER,\
+	.FP = RC_MATRIX_INITIALIZER,\
+	.HP = RC_MATRIX_INITIALIZER,\
+	.LT = RC_MATRIX_INITIALIZER,\
+	.S = RC_MATRIX_INITIALIZER,\
+	.z = RC_VECTOR_INITIALIZER,\
+	.Ph = RC_VECTOR_INITIALIZER,\
+	.sequential = 0,\
 	.initialized = 0,\
 	.step = 0}
 
@@ -188,6 +211,25 @@ int rc_kalman_free(rc_kalman_t* kf);
 int rc_kalman_reset(rc_kalman_t* kf);
 
 
+/**
+ * @brief      Selects the sequential measurement update.
+ *
+ * When the measurement noise covariance R is diagonal the elements of y are
+ * independent and can be applied one at a time as scalar updates. That gives
+ * the same result as the full update without factoring the innovation
+ * covariance S, which is cheaper when there are several measurements. Only the
+ * diagonal of R is used once this is enabled so R must stay diagonal if it is
+ * changed later.
+ *
+ * @param      kf      pointer to initialized filter
+ * @param[in]  enable  1 for the sequential update, 0 for the full update
+ *
+ * @return     0 on success, -1 on failure including enabling it when R is not
+ * diagonal.
+ */
+int rc_kalman_set_sequential(rc_kalman_t* kf, int enable);
+
+
 /**
  * @brief      Kalman Filter state prediction step based on physical model.
  *
@@ -206,6 +248,9 @@ int rc_kalman_reset(rc_kalman_t* kf);
  *   - x_est[k|k] = x[k|k-1] + L*(y[k]-h[k])
  *   - P[k|k] = (I - L*H)*P[k|k-1]
  *
+ * L is found by solving with the Cholesky factor of S rather than inverting it.
+ * Nothing is allocated.
+ *
  * @param      kf    pointer to struct to be updated
  * @param      u     control input
  * @param[in]  y     sensor measurement
@@ -230,7 +275,9 @@ int rc_kalman_update_lin(rc_kalman_t* kf, rc_vector_t u, rc_vector_t y);
  * - x[k|k] = x[k|k-1] + L*y
  * - P[k|k] = (I - L*H)*P
  *
- * Also updates the step counter in the rc_kalman_t struct
+ * F and H are copied into the filter so must keep the dimensions given to
+ * rc_kalman_alloc_ekf through Q and R. Nothing is allocated. Also updates the
+ * step counter in the rc_kalman_t struct
  *
  * @param      kf     pointer to struct to be updated
  * @param[in]  F      Jacobian of state transition matrix linearized at x_pre
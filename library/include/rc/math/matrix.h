@@ -33,6 +33,7 @@ typedef struct rc_matrix_t{
 	int rows;	///< number of rows in the matrix
 	int cols;	///< number of columns in the matrix
 	double** d;	///< pointer to allocated 2d array
+	int borrowed;	///< 1 if the memory belongs to an rc_workspace_t
 	int initialized;///< set to 1 once memory has been allocated
 } rc_matrix_t;
 
@@ -40,6 +41,7 @@ typedef struct rc_matrix_t{
 	.rows = 0,\
 	.cols = 0,\
 	.d = NULL,\
+	.borrowed = 0,\
 	.initialized = 0}
 
 /**
@@ -220,6 +222,11 @@ int rc_matrix_times_scalar(rc_matrix_t* A, double s);
  * C is resized and its original contents are freed if necessary to avoid memory
  * leaks.
  *
+ * C may be the same matrix as A or B, but then the product is computed into a
+ * temporary which is allocated and freed on every call, so use a separate C in
+ * loops. When any dimension is 16 or more the product is computed in blocks
+ * using about 64kB of the calling thread's stack.
+ *
  * @param[in]  A     first input
  * @param[in]  B     second input
  * @param[out] C     result
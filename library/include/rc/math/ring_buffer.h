@@ -10,6 +10,20 @@
  * The user creates their own instance of a buffer and passes a pointer to the
  * these ring_buf functions to perform normal operations.
  *
+ * Internally the capacity is rounded up to a power of two and every value is
+ * written twice, once in each half of a backing array of twice the capacity.
+ * Wrapping the index is then a mask instead of a branch, and any run of
+ * recent values is contiguous in memory somewhere in the array.
+ * rc_ringbuf_get_window() hands out a pointer to such a run so a filter can
+ * evaluate its difference equation as a plain dot product. The buffer also
+ * keeps a running mean and variance of its values so rc_ringbuf_mean() and
+ * rc_ringbuf_std_dev() take constant time.
+ *
+ * The capacity, mean and m2 members were added for this in library version
+ * 2.0.0. They change the size of rc_ringbuf_t, and of rc_filter_t which holds
+ * two of them, so programs built against librobotcontrol.so.1 must be rebuilt
+ * against librobotcontrol.so.2 rather than run with the new library.
+ *
  * @author     James Strawson
  * @date       2016
  *
@@ -32,16 +46,22 @@ extern "C" {
  * dynamically allocated memory.
  */
 typedef struct rc_ringbuf_t {
-	double* d;	///< pointer to dynamically allocated data
+	double* d;	///< pointer to dynamically allocated data, 2*capacity long
 	int size;	///< number of elements the buffer can hold
-	int index;	///< index of the most recently added value
+	int capacity;	///< size rounded up to a power of two
+	int index;	///< index of the most recently added value, <capacity
+	double mean;	///< running mean of the last size values
+	double m2;	///< running sum of squared deviations from the mean
 	int initialized;///< flag indicating if memory has been allocated for the buffer
 } rc_ringbuf_t;
 
 #define RC_RINGBUF_INITIALIZER {\
 	.d = NULL,\
 	.size = 0,\
+	.capacity = 0,\
 	.index = 0,\
+	.mean = 0.0,\
+	.m2 = 0.0,\
 	.initialized = 0}
 
 /**
@@ -123,12 +143,41 @@ int   rc_ringbuf_insert(rc_ringbuf_t* buf, double val);
  */
 double rc_ringbuf_get_value(rc_ringbuf_t* buf, int position);
 
+/**
+ * @brief      Returns a pointer to the last n values added to the buffer,
+ * oldest first.
+ *
+ * The values are contiguous, so with p the returned pointer p[n-1] is the
+ * most recent value and p[n-1-i] is the same as rc_ringbuf_get_value(buf,i).
+ * The pointer is valid until the next insert or reset.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  n     number of values, from 1 to the buffer size
+ *
+ * @return     pointer to the oldest of the n values, NULL on error
+ */
+const double* rc_ringbuf_get_window(rc_ringbuf_t* buf, int n);
+
+/**
+ * @brief      Returns the mean of all values in the ring buffer.
+ *
+ * Kept up to date on every insert so this takes constant time. As with
+ * rc_ringbuf_std_dev the starting values of 0.0 count until the buffer has
+ * been filled.
+ *
+ * @param[in]  buf   Pointer to user's buffer
+ *
+ * @return     Returns the mean of all values in the ring buffer.
+ */
+double rc_ringbuf_mean(rc_ringbuf_t buf);
+
 /**
  * @brief      Returns the standard deviation of all values in the ring buffer.
  *
  * Note that if the buffer has not yet been filled completely before calling
  * this, then the starting values of 0.0f in the unfilled portion of the buffer
- * will still be part of the calculation.
+ * will still be part of the calculation. Kept up to date on every insert so
+ * this takes constant time.
  *
  * @param[in]  buf   Pointer to user's buffer
  *
@@ -0,0 +1,340 @@
+/**
+ * <rc/math/single_precision.h>
+ *
+ * @brief      Single precision (float) versions of the vector, matrix, filter
+ * and small matrix APIs.
+ *
+ * Everything else in the math library works in double. The Cortex-A8 in the
+ * BeagleBone has no double precision SIMD at all, and even where there is,
+ * float halves the memory traffic and doubles the lanes per instruction. For
+ * control loops whose sensors give far fewer than 7 significant digits that
+ * is speed left on the table.
+ *
+ * The float functions are compiled from the same source as the double ones,
+ * so they behave identically: same arguments, same checks, same error
+ * messages with an f after the type name. Each is named like its double
+ * counterpart with an f added to the type, rc_vector_norm becomes
+ * rc_vectorf_norm, rc_matrix_multiply becomes rc_matrixf_multiply,
+ * rc_filter_march becomes rc_filterf_march and rc_mat3_invert becomes
+ * rc_mat3f_invert. See the double versions for their documentation.
+ *
+ * Filter design stays in double where the coefficient math needs the range,
+ * a pole close to the unit circle loses a lot in float. Design with the
+ * rc_filter_* functions as usual, then convert with rc_filterf_from_filter
+ * and march the float copy in the loop:
+ *
+ * @code{.c}
+ * rc_filter_t design = RC_FILTER_INITIALIZER;
+ * rc_filterf_t lp = RC_FILTERF_INITIALIZER;
+ * rc_filter_butterworth_lowpass(&design, 2, DT, 2.0*M_PI*10.0);
+ * rc_filterf_from_filter(&lp, design);
+ * rc_filter_free(&design);
+ * ...
+ * y = rc_filterf_march(&lp, x);
+ * @endcode
+ *
+ * @addtogroup Single_Precision
+ * @ingroup    Math
+ * @{
+ */
+
+#ifndef RC_SINGLE_PRECISION_H
+#define RC_SINGLE_PRECISION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <rc/math/vector.h>
+#include <rc/math/matrix.h>
+#include <rc/math/filter.h>
+
+/**
+ * @brief      Float version of rc_vector_t.
+ */
+typedef struct rc_vectorf_t{
+	int len;		///< number of elements in the vector
+	float* d;		///< pointer to dynamically allocated data
+	int borrowed;		///< 1 if d came from a workspace, see rc_vector_t
+	int initialized;	///< initialization flag
+} rc_vectorf_t;
+
+#define RC_VECTORF_INITIALIZER {\
+	.len = 0,\
+	.d = NULL,\
+	.borrowed = 0,\
+	.initialized = 0}
+
+/**
+ * @brief      Float version of rc_matrix_t.
+ */
+typedef struct rc_matrixf_t{
+	int rows;		///< number of rows in the matrix
+	int cols;		///< number of columns in the matrix
+	float** d;		///< pointer to allocated 2d array
+	int borrowed;		///< 1 if d came from a workspace, see rc_matrix_t
+	int initialized;	///< set to 1 once memory has been allocated
+} rc_matrixf_t;
+
+#define RC_MATRIXF_INITIALIZER {\
+	.rows = 0,\
+	.cols = 0,\
+	.d = NULL,\
+	.borrowed = 0,\
+	.initialized = 0}
+
+/**
+ * @brief      Float input and output history of an rc_filterf_t.
+ *
+ * Same mirrored layout as rc_ringbuf_t without the running statistics, the
+ * filter only ever needs the values. Only used inside rc_filterf_t.
+ */
+typedef struct rc_ringbuff_t{
+	float* d;		///< two mirrored copies of capacity values
+	int size;		///< number of values kept
+	int capacity;		///< size rounded up to a power of two
+	int index;		///< index of the most recent value
+	int initialized;	///< flag indicating if memory has been allocated
+} rc_ringbuff_t;
+
+#define RC_RINGBUFF_INITIALIZER {\
+	.d = NULL,\
+	.size = 0,\
+	.capacity = 0,\
+	.index = 0,\
+	.initialized = 0}
+
+/**
+ * @brief      Float version of rc_filter_t.
+ */
+typedef struct rc_filterf_t{
+	/** @name transfer function properties */
+	///@{
+	int order;		///< transfer function order
+	float dt;		///< timestep in seconds
+	float gain;		///< Additional gain multiplier, usually 1.0
+	rc_vectorf_t num;	///< numerator coefficients
+	rc_vectorf_t den;	///< denominator coefficients
+	///@}
+
+	/** @name saturation settings */
+	///@{
+	int sat_en;		///< set to 1 by enable_saturation()
+	float sat_min;		///< lower saturation limit
+	float sat_max;		///< upper saturation limit
+	int sat_flag;		///< 1 if saturated on the last step
+	///@}
+
+	/** @name soft start settings */
+	///@{
+	int ss_en;		///< set to 1 by enbale_soft_start()
+	float ss_steps;		///< steps before full output allowed
+	///@}
+
+	/** @name dynamically allocated ring buffers */
+	///@{
+	rc_ringbuff_t in_buf;
+	rc_ringbuff_t out_buf;
+	///@}
+
+	/** @name other */
+	///@{
+	float newest_input;	///< shortcut for the most recent input
+	float newest_output;	///< shortcut for the most recent output
+	uint64_t step;		///< steps since last reset
+	int initialized;	///< initialization flag
+	///@}
+} rc_filterf_t;
+
+#define RC_FILTERF_INITIALIZER {\
+	.order		= 0,\
+	.dt		= 0.0f,\
+	.gain		= 1.0f,\
+	.num		= RC_VECTORF_INITIALIZER,\
+	.den		= RC_VECTORF_INITIALIZER,\
+	.sat_en		= 0,\
+	.sat_min	= 0.0f,\
+	.sat_max	= 0.0f,\
+	.sat_flag	= 0,\
+	.ss_en		= 0,\
+	.ss_steps	= 0,\
+	.in_buf		= RC_RINGBUFF_INITIALIZER,\
+	.out_buf	= RC_RINGBUFF_INITIALIZER,\
+	.newest_input	= 0.0f,\
+	.newest_output	= 0.0f,\
+	.step		= 0,\
+	.initialized	= 0}
+
+/** @name vectors, see <rc/math/vector.h> */
+///@{
+rc_vectorf_t rc_vectorf_empty(void);
+int   rc_vectorf_alloc(rc_vectorf_t* v, int length);
+int   rc_vectorf_free(rc_vectorf_t* v);
+int   rc_vectorf_zeros(rc_vectorf_t* v, int length);
+int   rc_vectorf_ones(rc_vectorf_t* v, int length);
+int   rc_vectorf_from_array(rc_vectorf_t* v, float* ptr, int length);
+int   rc_vectorf_duplicate(rc_vectorf_t a, rc_vectorf_t* b);
+int   rc_vectorf_print(rc_vectorf_t v);
+int   rc_vectorf_print_sci(rc_vectorf_t v);
+int   rc_vectorf_zero_out(rc_vectorf_t* v);
+int   rc_vectorf_times_scalar(rc_vectorf_t* v, float s);
+float rc_vectorf_norm(rc_vectorf_t v, float p);
+int   rc_vectorf_max(rc_vectorf_t v);
+int   rc_vectorf_min(rc_vectorf_t v);
+float rc_vectorf_std_dev(rc_vectorf_t v);
+float rc_vectorf_mean(rc_vectorf_t v);
+int   rc_vectorf_projection(rc_vectorf_t v, rc_vectorf_t e, rc_vectorf_t* p);
+float rc_vectorf_dot_product(rc_vectorf_t v1, rc_vectorf_t v2);
+int   rc_vectorf_cross_product(rc_vectorf_t v1, rc_vectorf_t v2, rc_vectorf_t* p);
+int   rc_vectorf_sum(rc_vectorf_t v1, rc_vectorf_t v2, rc_vectorf_t* s);
+int   rc_vectorf_sum_inplace(rc_vectorf_t* v1, rc_vectorf_t v2);
+int   rc_vectorf_subtract(rc_vectorf_t v1, rc_vectorf_t v2, rc_vectorf_t* s);
+///@}
+
+/** @name matrices, see <rc/math/matrix.h> */
+///@{
+rc_matrixf_t rc_matrixf_empty(void);
+int   rc_matrixf_alloc(rc_matrixf_t* A, int rows, int cols);
+int   rc_matrixf_free(rc_matrixf_t* A);
+int   rc_matrixf_zeros(rc_matrixf_t* A, int rows, int cols);
+int   rc_matrixf_identity(rc_matrixf_t* A, int dim);
+int   rc_matrixf_diagonal(rc_matrixf_t* A, rc_vectorf_t v);
+int   rc_matrixf_duplicate(rc_matrixf_t A, rc_matrixf_t* B);
+int   rc_matrixf_print(rc_matrixf_t A);
+int   rc_matrixf_print_sci(rc_matrixf_t A);
+int   rc_matrixf_zero_out(rc_matrixf_t* A);
+int   rc_matrixf_times_scalar(rc_matrixf_t* A, float s);
+int   rc_matrixf_multiply(rc_matrixf_t A, rc_matrixf_t B, rc_matrixf_t* C);
+int   rc_matrixf_left_multiply_inplace(rc_matrixf_t A, rc_matrixf_t* B);
+int   rc_matrixf_right_multiply_inplace(rc_matrixf_t* A, rc_matrixf_t B);
+int   rc_matrixf_add(rc_matrixf_t A, rc_matrixf_t B, rc_matrixf_t* C);
+int   rc_matrixf_add_inplace(rc_matrixf_t* A, rc_matrixf_t B);
+int   rc_matrixf_subtract_inplace(rc_matrixf_t* A, rc_matrixf_t B);
+int   rc_matrixf_transpose(rc_matrixf_t A, rc_matrixf_t* T);
+int   rc_matrixf_transpose_inplace(rc_matrixf_t* A);
+int   rc_matrixf_times_col_vec(rc_matrixf_t A, rc_vectorf_t v, rc_vectorf_t* c);
+int   rc_matrixf_row_vec_times_matrix(rc_vectorf_t v, rc_matrixf_t A, rc_vectorf_t* c);
+int   rc_matrixf_outer_product(rc_vectorf_t v1, rc_vectorf_t v2, rc_matrixf_t* A);
+float rc_matrixf_determinant(rc_matrixf_t A);
+int   rc_matrixf_symmetrize(rc_matrixf_t* P);
+///@}
+
+/** @name filters, see <rc/math/filter.h> */
+///@{
+rc_filterf_t rc_filterf_empty(void);
+int   rc_filterf_alloc(rc_filterf_t* f, rc_vectorf_t num, rc_vectorf_t den, float dt);
+int   rc_filterf_alloc_from_arrays(rc_filterf_t* f, float dt, float* num, int numlen, float* den, int denlen);
+int   rc_filterf_duplicate(rc_filterf_t* f, rc_filterf_t old);
+int   rc_filterf_free(rc_filterf_t* f);
+float rc_filterf_march(rc_filterf_t* f, float new_input);
+int   rc_filterf_reset(rc_filterf_t* f);
+int   rc_filterf_enable_saturation(rc_filterf_t* f, float min, float max);
+int   rc_filterf_get_saturation_flag(rc_filterf_t* f);
+int   rc_filterf_enable_soft_start(rc_filterf_t* f, float seconds);
+float rc_filterf_previous_input(rc_filterf_t* f, int steps);
+float rc_filterf_previous_output(rc_filterf_t* f, int steps);
+int   rc_filterf_prefill_inputs(rc_filterf_t* f, float in);
+int   rc_filterf_prefill_outputs(rc_filterf_t* f, float out);
+///@}
+
+/**
+ * @brief      Float versions of rc_mat2_t through rc_mat6_t, see
+ * <rc/math/small_matrix.h>.
+ */
+typedef struct rc_mat2f_t{ float d[2][2]; } rc_mat2f_t;
+typedef struct rc_mat3f_t{ float d[3][3]; } rc_mat3f_t; ///< 3x3, see rc_mat2f_t
+typedef struct rc_mat4f_t{ float d[4][4]; } rc_mat4f_t; ///< 4x4, see rc_mat2f_t
+typedef struct rc_mat5f_t{ float d[5][5]; } rc_mat5f_t; ///< 5x5, see rc_mat2f_t
+typedef struct rc_mat6f_t{ float d[6][6]; } rc_mat6f_t; ///< 6x6, see rc_mat2f_t
+
+#define RC_SMALL_MATRIXF_DECLARE(N)\
+void rc_mat##N##f_identity(rc_mat##N##f_t* A);\
+void rc_mat##N##f_multiply(const rc_mat##N##f_t* A, const rc_mat##N##f_t* B, rc_mat##N##f_t* C);\
+void rc_mat##N##f_multiply_bt(const rc_mat##N##f_t* A, const rc_mat##N##f_t* B, rc_mat##N##f_t* C);\
+void rc_mat##N##f_transpose(const rc_mat##N##f_t* A, rc_mat##N##f_t* T);\
+void rc_mat##N##f_add(const rc_mat##N##f_t* A, const rc_mat##N##f_t* B, rc_mat##N##f_t* C);\
+void rc_mat##N##f_times_vec(const rc_mat##N##f_t* A, const float x[N], float y[N]);\
+int rc_mat##N##f_invert(const rc_mat##N##f_t* A, rc_mat##N##f_t* Ainv);\
+int rc_mat##N##f_invert_spd(const rc_mat##N##f_t* A, rc_mat##N##f_t* Ainv);\
+int rc_mat##N##f_from_matrix(rc_mat##N##f_t* out, rc_matrixf_t A);\
+int rc_mat##N##f_to_matrix(const rc_mat##N##f_t* A, rc_matrixf_t* out);
+
+RC_SMALL_MATRIXF_DECLARE(2)
+RC_SMALL_MATRIXF_DECLARE(3)
+RC_SMALL_MATRIXF_DECLARE(4)
+RC_SMALL_MATRIXF_DECLARE(5)
+RC_SMALL_MATRIXF_DECLARE(6)
+
+void rc_mat3f_from_quaternion(const float q[4], rc_mat3f_t* R);
+void rc_mat3f_rotate_quaternion(const float q[4], const float v[3], float out[3]);
+
+/** @name conversions between precisions */
+///@{
+
+/**
+ * @brief      Copies a double vector into a float vector, allocating it with
+ * rc_vectorf_alloc if needed.
+ *
+ * @param      out   Pointer to user's float vector
+ * @param[in]  v     double vector to copy
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_vectorf_from_vector(rc_vectorf_t* out, rc_vector_t v);
+
+/**
+ * @brief      Copies a float vector into a double vector, allocating it with
+ * rc_vector_alloc if needed.
+ *
+ * @param      out   Pointer to user's double vector
+ * @param[in]  v     float vector to copy
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_vectorf_to_vector(rc_vector_t* out, rc_vectorf_t v);
+
+/**
+ * @brief      Copies a double matrix into a float matrix, allocating it with
+ * rc_matrixf_alloc if needed.
+ *
+ * @param      out   Pointer to user's float matrix
+ * @param[in]  A     double matrix to copy
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_matrixf_from_matrix(rc_matrixf_t* out, rc_matrix_t A);
+
+/**
+ * @brief      Copies a float matrix into a double matrix, allocating it with
+ * rc_matrix_alloc if needed.
+ *
+ * @param      out   Pointer to user's double matrix
+ * @param[in]  A     float matrix to copy
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_matrixf_to_matrix(rc_matrix_t* out, rc_matrixf_t A);
+
+/**
+ * @brief      Builds a float filter from one designed in double.
+ *
+ * Copies the coefficients, gain, saturation and soft start settings. The
+ * history starts out zeroed like after rc_filterf_reset, not copied from f.
+ *
+ * @param      out   Pointer to user's float filter
+ * @param[in]  f     initialized double filter
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_filterf_from_filter(rc_filterf_t* out, rc_filter_t f);
+///@}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_SINGLE_PRECISION_H
+
+/** @} end group math*/
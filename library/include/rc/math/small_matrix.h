@@ -0,0 +1,143 @@
+/**
+ * <rc/math/small_matrix.h>
+ *
+ * @brief      Fixed-size 2x2 through 6x6 matrices and their kernels.
+ *
+ * rc_matrix_t keeps any size of matrix behind row pointers on the heap, which
+ * costs a pointer chase per row and generic loops on every call. Estimators
+ * mostly work with 3 to 6 states, so for those sizes this module provides
+ * plain value types rc_mat2_t through rc_mat6_t that live on the stack or
+ * inside other structs. Every kernel is compiled once per size with constant
+ * loop bounds so the compiler unrolls it completely.
+ *
+ * The functions are named rc_matN_<operation> with N from 2 to 6, for example
+ * rc_mat3_multiply or rc_mat6_invert_spd. They are documented once below with
+ * N standing for the size. Vectors are plain double arrays of length N.
+ *
+ * The kernels that can't fail don't check their arguments, pointers must be
+ * valid. Outputs may alias inputs. Use rc_matN_from_matrix and
+ * rc_matN_to_matrix to move data to and from the rc_matrix_t API.
+ *
+ * @code{.c}
+ * rc_mat3_t R, P;
+ * rc_mat3_from_quaternion(q, &R);
+ * rc_mat3_multiply(&R, &cov, &P);	// P = R*cov
+ * rc_mat3_multiply_bt(&P, &R, &P);	// P = R*cov*R'
+ * @endcode
+ *
+ * @addtogroup Small_Matrix
+ * @ingroup    Math
+ * @{
+ */
+
+
+#ifndef RC_SMALL_MATRIX_H
+#define RC_SMALL_MATRIX_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <rc/math/matrix.h>
+
+/**
+ * @brief      Fixed-size square matrices, read and write elements with
+ * A.d[row][col] like an rc_matrix_t.
+ */
+typedef struct rc_mat2_t{ double d[2][2]; } rc_mat2_t;
+typedef struct rc_mat3_t{ double d[3][3]; } rc_mat3_t; ///< 3x3, see rc_mat2_t
+typedef struct rc_mat4_t{ double d[4][4]; } rc_mat4_t; ///< 4x4, see rc_mat2_t
+typedef struct rc_mat5_t{ double d[5][5]; } rc_mat5_t; ///< 5x5, see rc_mat2_t
+typedef struct rc_mat6_t{ double d[6][6]; } rc_mat6_t; ///< 6x6, see rc_mat2_t
+
+/**
+ * @fn void rc_matN_identity(rc_matN_t* A)
+ * @brief      Sets A to the identity matrix.
+ *
+ * @fn void rc_matN_multiply(const rc_matN_t* A, const rc_matN_t* B, rc_matN_t* C)
+ * @brief      C = A*B
+ *
+ * @fn void rc_matN_multiply_bt(const rc_matN_t* A, const rc_matN_t* B, rc_matN_t* C)
+ * @brief      C = A*B', the common F*P*F' step without forming F' first.
+ *
+ * @fn void rc_matN_transpose(const rc_matN_t* A, rc_matN_t* T)
+ * @brief      T = A'
+ *
+ * @fn void rc_matN_add(const rc_matN_t* A, const rc_matN_t* B, rc_matN_t* C)
+ * @brief      C = A+B
+ *
+ * @fn void rc_matN_times_vec(const rc_matN_t* A, const double x[N], double y[N])
+ * @brief      y = A*x
+ *
+ * @fn int rc_matN_invert(const rc_matN_t* A, rc_matN_t* Ainv)
+ * @brief      Inverts A. Closed form for 2x2 and 3x3, LU decomposition with
+ * partial pivoting above that.
+ * @return     0 on success, -1 if A is singular to within the tolerance set by
+ * rc_algebra_set_zero_tolerance. Ainv is untouched on failure.
+ *
+ * @fn int rc_matN_invert_spd(const rc_matN_t* A, rc_matN_t* Ainv)
+ * @brief      Inverts a symmetric positive definite matrix such as a
+ * covariance with a Cholesky decomposition. About half the work of
+ * rc_matN_invert and the result is exactly symmetric.
+ * @return     0 on success, -1 if A is not positive definite. Ainv is
+ * untouched on failure.
+ *
+ * @fn int rc_matN_from_matrix(rc_matN_t* out, rc_matrix_t A)
+ * @brief      Copies an NxN rc_matrix_t into a fixed-size matrix.
+ * @return     0 on success, -1 if A is uninitialized or not NxN.
+ *
+ * @fn int rc_matN_to_matrix(const rc_matN_t* A, rc_matrix_t* out)
+ * @brief      Copies a fixed-size matrix into an rc_matrix_t, allocating it
+ * as NxN with rc_matrix_alloc if needed.
+ * @return     0 on success, -1 on failure.
+ */
+#define RC_SMALL_MATRIX_DECLARE(N)\
+void rc_mat##N##_identity(rc_mat##N##_t* A);\
+void rc_mat##N##_multiply(const rc_mat##N##_t* A, const rc_mat##N##_t* B, rc_mat##N##_t* C);\
+void rc_mat##N##_multiply_bt(const rc_mat##N##_t* A, const rc_mat##N##_t* B, rc_mat##N##_t* C);\
+void rc_mat##N##_transpose(const rc_mat##N##_t* A, rc_mat##N##_t* T);\
+void rc_mat##N##_add(const rc_mat##N##_t* A, const rc_mat##N##_t* B, rc_mat##N##_t* C);\
+void rc_mat##N##_times_vec(const rc_mat##N##_t* A, const double x[N], double y[N]);\
+int rc_mat##N##_invert(const rc_mat##N##_t* A, rc_mat##N##_t* Ainv);\
+int rc_mat##N##_invert_spd(const rc_mat##N##_t* A, rc_mat##N##_t* Ainv);\
+int rc_mat##N##_from_matrix(rc_mat##N##_t* out, rc_matrix_t A);\
+int rc_mat##N##_to_matrix(const rc_mat##N##_t* A, rc_matrix_t* out);
+
+RC_SMALL_MATRIX_DECLARE(2)
+RC_SMALL_MATRIX_DECLARE(3)
+RC_SMALL_MATRIX_DECLARE(4)
+RC_SMALL_MATRIX_DECLARE(5)
+RC_SMALL_MATRIX_DECLARE(6)
+
+/**
+ * @brief      Rotation matrix of a unit quaternion, same convention as
+ * rc_quaternion_to_rotation_matrix.
+ *
+ * @param[in]  q     unit quaternion, real part first
+ * @param[out] R     rotation matrix
+ */
+void rc_mat3_from_quaternion(const double q[4], rc_mat3_t* R);
+
+/**
+ * @brief      Rotates vector v by unit quaternion q, same result as
+ * rc_quaternion_rotate_vector_array without going through two quaternion
+ * products.
+ *
+ * Uses v' = v + 2w(r x v) + 2r x (r x v) where w is the real and r the
+ * imaginary part of q. For rotating many vectors by the same q it is cheaper
+ * to build the matrix once with rc_mat3_from_quaternion.
+ *
+ * @param[in]  q     unit quaternion, real part first
+ * @param[in]  v     vector to rotate
+ * @param[out] out   rotated vector, may be the same array as v
+ */
+void rc_mat3_rotate_quaternion(const double q[4], const double v[3], double out[3]);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_SMALL_MATRIX_H
+
+/** @} end group math*/
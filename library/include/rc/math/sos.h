@@ -0,0 +1,227 @@
+/**
+ * <rc/math/sos.h>
+ *
+ * @brief      Discrete SISO filters as cascades of second order sections.
+ *
+ * An rc_filter_t keeps one high order transfer function. Its coefficients
+ * grow very sensitive to rounding as the order goes up or the cutoff drops
+ * towards 0 Hz, a 6th order lowpass at a few Hz sampled at 1kHz can already
+ * have poles pushed outside the unit circle. Splitting the same filter into
+ * a cascade of biquads, each with at most two poles and two zeros, keeps
+ * every pole within a well conditioned quadratic.
+ *
+ * Each section is run in transposed direct form II, two state values per
+ * section and no ring buffer lookups. rc_sos_process() filters a block of
+ * samples one section at a time so each section's coefficients and state
+ * stay in registers for the whole block, which suits kHz IMU and encoder
+ * data read in batches.
+ *
+ * Filters can be designed directly as sections with
+ * rc_sos_butterworth_lowpass() and rc_sos_butterworth_highpass(), which
+ * discretize each quadratic factor of rc_poly_butter on its own, or
+ * converted from an existing rc_filter_t with rc_sos_from_filter().
+ *
+ * @addtogroup SOS_Filter
+ * @ingroup    Math
+ * @{
+ */
+
+#ifndef RC_SOS_H
+#define RC_SOS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <rc/math/matrix.h>
+#include <rc/math/filter.h>
+
+/**
+ * @brief      Struct containing configuration and state of a cascade of second
+ * order sections.
+ *
+ * Row i of sos holds section i as [b0 b1 b2 1 a1 a2], the transfer function
+ * (b0 + b1 z^-1 + b2 z^-2)/(1 + a1 z^-1 + a2 z^-2). Sections run in order of
+ * their rows.
+ */
+typedef struct rc_sos_t{
+	/** @name transfer function properties */
+	///@{
+	int sections;		///< number of second order sections
+	double dt;		///< timestep in seconds
+	double gain;		///< Additional gain multiplier on the output, usually 1.0
+	rc_matrix_t sos;	///< sections x 6 coefficients, one section per row
+	///@}
+
+	/** @name state */
+	///@{
+	rc_matrix_t state;	///< sections x 2 transposed direct form II state
+	double newest_input;	///< shortcut for the most recent input
+	double newest_output;	///< shortcut for the most recent output
+	uint64_t step;		///< steps since last reset
+	int initialized;	///< initialization flag
+	///@}
+} rc_sos_t;
+
+#define RC_SOS_INITIALIZER {\
+	.sections	= 0,\
+	.dt		= 0.0,\
+	.gain		= 1.0,\
+	.sos		= RC_MATRIX_INITIALIZER,\
+	.state		= RC_MATRIX_INITIALIZER,\
+	.newest_input	= 0.0,\
+	.newest_output	= 0.0,\
+	.step		= 0,\
+	.initialized	= 0}
+
+/**
+ * @brief      Returns an rc_sos_t with no memory allocated, see
+ * rc_filter_empty for why this matters.
+ *
+ * @return     Empty zero-filled rc_sos_t struct
+ */
+rc_sos_t rc_sos_empty(void);
+
+/**
+ * @brief      Allocates a cascade from a matrix of sections.
+ *
+ * sos must have 6 columns laid out as in rc_sos_t. Each row is divided by its
+ * a0 so it doesn't have to be 1 already. The memory in sos is duplicated.
+ *
+ * @param[out] s     Pointer to user's rc_sos_t struct
+ * @param[in]  sos   sections, one per row
+ * @param[in]  dt    Timestep in seconds
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_sos_alloc(rc_sos_t* s, rc_matrix_t sos, double dt);
+
+/**
+ * @brief      Frees the memory of a cascade and resets it like rc_sos_empty.
+ *
+ * @param      s     Pointer to user's rc_sos_t struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_sos_free(rc_sos_t* s);
+
+/**
+ * @brief      Prints the coefficients of each section.
+ *
+ * @param[in]  s     the cascade
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_sos_print(rc_sos_t s);
+
+/**
+ * @brief      Zeros the state of every section and the step counter.
+ *
+ * @param      s     Pointer to user's rc_sos_t struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_sos_reset(rc_sos_t* s);
+
+/**
+ * @brief      Sets the state as if the input had been held at in forever.
+ *
+ * The cascade then starts at its steady state output instead of ringing up
+ * from 0, useful for a lowpass on a sensor that doesn't read 0 at start.
+ * Fails for a section with a pole at z=1 such as an integrator, which has no
+ * steady state.
+ *
+ * @param      s     Pointer to user's rc_sos_t struct
+ * @param[in]  in    The constant input
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_sos_prefill(rc_sos_t* s, double in);
+
+/**
+ * @brief      Marches the cascade forward one step.
+ *
+ * @param      s      Pointer to user's rc_sos_t struct
+ * @param[in]  in     new input
+ *
+ * @return     new output
+ */
+double rc_sos_march(rc_sos_t* s, double in);
+
+/**
+ * @brief      Filters a block of n samples, the same as n calls to
+ * rc_sos_march but faster.
+ *
+ * @param      s     Pointer to user's rc_sos_t struct
+ * @param[in]  in    n input samples, oldest first
+ * @param[out] out   n output samples, may be the same array as in
+ * @param[in]  n     number of samples
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_sos_process(rc_sos_t* s, const double* in, double* out, int n);
+
+/**
+ * @brief      Factors the transfer function of an rc_filter_t into second
+ * order sections.
+ *
+ * The poles and zeros are found numerically, complex pairs kept together in
+ * one section. Each pole pair is matched with the zeros nearest to it and the
+ * sections are ordered with poles closest to the unit circle last, the usual
+ * arrangement for keeping intermediate signals small. The gain multiplier of
+ * f is carried over, saturation and soft start are not.
+ *
+ * Roots at exactly z=0, -1 and 1, where Tustin discretization puts the zeros
+ * of lowpass, highpass and PID filters, are divided out exactly. Other
+ * repeated roots can only be found to a fraction of double precision, so
+ * prefer rc_sos_butterworth_lowpass and friends when designing from scratch.
+ *
+ * @param[out] s     Pointer to user's rc_sos_t struct
+ * @param[in]  f     the filter to convert
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_sos_from_filter(rc_sos_t* s, rc_filter_t f);
+
+/**
+ * @brief      Creates a Butterworth lowpass as second order sections.
+ *
+ * Same response as rc_filter_butterworth_lowpass. Each quadratic factor of
+ * rc_poly_butter is discretized on its own with the prewarped Tustin
+ * transform of rc_filter_c2d_tustin, so the coefficients never come from a
+ * high order polynomial.
+ *
+ * @param[out] s      Pointer to user's rc_sos_t struct
+ * @param[in]  order  The order (>=1)
+ * @param[in]  dt     The timestep
+ * @param[in]  wc     cutoff frequency in rad/s
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_sos_butterworth_lowpass(rc_sos_t* s, int order, double dt, double wc);
+
+/**
+ * @brief      Creates a Butterworth highpass as second order sections, see
+ * rc_sos_butterworth_lowpass.
+ *
+ * The gain in the passband is 1. rc_filter_butterworth_highpass has the same
+ * poles and zeros but a passband gain of wc^order.
+ *
+ * @param[out] s      Pointer to user's rc_sos_t struct
+ * @param[in]  order  The order (>=1)
+ * @param[in]  dt     The timestep
+ * @param[in]  wc     cutoff frequency in rad/s
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_sos_butterworth_highpass(rc_sos_t* s, int order, double dt, double wc);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_SOS_H
+
+/** @} end group math*/
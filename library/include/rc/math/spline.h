@@ -0,0 +1,184 @@
+/**
+ * <rc/math/spline.h>
+ *
+ * @brief      Cubic and quintic splines through a list of waypoints.
+ *
+ * A spline passes through every waypoint at its given time without stopping
+ * there, with velocity and acceleration continuous all the way along: cubic
+ * splines are C2 and quintic splines C4, so jerk is continuous as well. The
+ * whole path is fitted at once by solving one banded linear system per
+ * dimension, tridiagonal for cubics (rc_algebra_tridiag_solve) and with 3
+ * diagonals either side for quintics (rc_algebra_band_solve), so fitting
+ * takes time proportional to the number of waypoints.
+ *
+ * Each segment is stored as a polynomial in the time since its first knot.
+ * rc_spline_eval gives position, velocity and acceleration at any time, the
+ * latter two being what a controller wants as feedforward, and remembers the
+ * segment it used last so stepping forward through time doesn't search.
+ * rc_spline_eval_batch does the same for a whole vector of times.
+ *
+ * Two end conditions are offered. RC_SPLINE_REST starts and ends at rest,
+ * zero velocity (and for quintics zero acceleration) at the first and last
+ * knot, which is what a robot starting and stopping on the path needs.
+ * RC_SPLINE_NATURAL leaves the end velocities free and sets the highest
+ * derivatives that are continuous to zero there instead, which gives the
+ * smoothest curve through the points.
+ *
+ * @addtogroup Spline
+ * @ingroup    Math
+ * @{
+ */
+
+#ifndef RC_SPLINE_H
+#define RC_SPLINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <rc/math/vector.h>
+#include <rc/math/matrix.h>
+
+/**
+ * @brief      End conditions for rc_spline_cubic and rc_spline_quintic.
+ */
+typedef enum rc_spline_end_t{
+	RC_SPLINE_NATURAL,	///< free end velocity, zero 2nd (cubic) or 3rd and 4th (quintic) derivative
+	RC_SPLINE_REST		///< zero velocity, and for quintics zero acceleration, at both ends
+} rc_spline_end_t;
+
+/**
+ * @brief      Struct containing a fitted spline.
+ *
+ * Segment i runs from t.d[i] to t.d[i+1]. Row i*dim+k of c holds the
+ * coefficients of dimension k on that segment in ascending powers of the time
+ * since t.d[i], so position is c[0] + c[1]*tau + c[2]*tau^2 + ...
+ */
+typedef struct rc_spline_t{
+	int order;		///< 3 for cubic, 5 for quintic
+	int knots;		///< number of waypoints, one more than the segments
+	int dim;		///< number of dimensions of each waypoint
+	rc_vector_t t;		///< time of each knot, strictly increasing
+	rc_matrix_t c;		///< (knots-1)*dim rows of order+1 coefficients
+	int last;		///< segment evaluated last, where the next search starts
+	int initialized;	///< initialization flag
+} rc_spline_t;
+
+#define RC_SPLINE_INITIALIZER {\
+	.order		= 0,\
+	.knots		= 0,\
+	.dim		= 0,\
+	.t		= RC_VECTOR_INITIALIZER,\
+	.c		= RC_MATRIX_INITIALIZER,\
+	.last		= 0,\
+	.initialized	= 0}
+
+/**
+ * @brief      Returns an rc_spline_t with no memory allocated, see
+ * rc_filter_empty for why this matters.
+ *
+ * @return     Empty zero-filled rc_spline_t struct
+ */
+rc_spline_t rc_spline_empty(void);
+
+/**
+ * @brief      Frees the memory of a spline and resets it like
+ * rc_spline_empty.
+ *
+ * @param      s     Pointer to user's rc_spline_t struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_spline_free(rc_spline_t* s);
+
+/**
+ * @brief      Fits a C2 cubic spline through waypoints.
+ *
+ * Row i of p is the waypoint reached at time t.d[i], with one column per
+ * dimension. Any memory already allocated in s is reused or replaced.
+ *
+ * @param      s     Pointer to user's rc_spline_t struct
+ * @param[in]  t     knot times, strictly increasing, at least 2
+ * @param[in]  p     waypoints, one row per knot
+ * @param[in]  end   end condition
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_spline_cubic(rc_spline_t* s, rc_vector_t t, rc_matrix_t p, rc_spline_end_t end);
+
+/**
+ * @brief      Fits a C4 quintic spline through waypoints.
+ *
+ * Same arguments as rc_spline_cubic. Jerk is continuous too, and with
+ * RC_SPLINE_REST acceleration starts and ends at zero as well as velocity,
+ * so there is no step in the acceleration feedforward at either end.
+ * RC_SPLINE_NATURAL needs at least 3 knots.
+ *
+ * @param      s     Pointer to user's rc_spline_t struct
+ * @param[in]  t     knot times, strictly increasing, at least 2
+ * @param[in]  p     waypoints, one row per knot
+ * @param[in]  end   end condition
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_spline_quintic(rc_spline_t* s, rc_vector_t t, rc_matrix_t p, rc_spline_end_t end);
+
+/**
+ * @brief      Position, velocity and acceleration of every dimension at time
+ * t.
+ *
+ * Before the first knot and after the last the spline holds its end position
+ * with zero velocity and acceleration. Looking up the segment starts from the
+ * one used last, so evaluating at increasing times is O(1) per call. Any of
+ * the outputs may be NULL.
+ *
+ * @param      s     Pointer to user's rc_spline_t struct
+ * @param[in]  t     time
+ * @param[out] p     position, array of dim
+ * @param[out] v     velocity, array of dim
+ * @param[out] a     acceleration, array of dim
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_spline_eval(rc_spline_t* s, double t, double* p, double* v, double* a);
+
+/**
+ * @brief      Evaluates a spline at a vector of times.
+ *
+ * Row i of each output is the result of rc_spline_eval at t.d[i]. Outputs are
+ * resized to t.len rows and dim columns if necessary, v and a may be NULL.
+ * Times in increasing order are fastest.
+ *
+ * @param      s     Pointer to user's rc_spline_t struct
+ * @param[in]  t     times to evaluate at
+ * @param[out] p     positions
+ * @param[out] v     velocities, may be NULL
+ * @param[out] a     accelerations, may be NULL
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_spline_eval_batch(rc_spline_t* s, rc_vector_t t, rc_matrix_t* p, rc_matrix_t* v, rc_matrix_t* a);
+
+/**
+ * @brief      Stretches a spline in time by a factor k about its first knot.
+ *
+ * The path stays the same, every knot after the first is reached k times
+ * later and velocity, acceleration, jerk... are scaled by 1/k, 1/k^2,
+ * 1/k^3... This is how a spline fitted to requested times is slowed down
+ * until it respects velocity and acceleration limits.
+ *
+ * @param      s     Pointer to user's rc_spline_t struct
+ * @param[in]  k     factor, greater than 0
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_spline_scale_time(rc_spline_t* s, double k);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_SPLINE_H
+
+/** @} end group math*/
@@ -0,0 +1,260 @@
+/**
+ * <rc/math/spsc_queue.h>
+ *
+ * @brief      Lock-free queues and latest value slots for passing data between
+ * two threads.
+ *
+ * rc_ringbuf_t keeps the history of one signal inside one thread. When a
+ * control loop hands data to a logger, or a sensor thread hands samples to the
+ * control loop, a mutex around shared globals lets the slower thread stall the
+ * faster one. The two types here never block either side.
+ *
+ * rc_spsc_queue_t is a bounded FIFO of fixed size records for exactly one
+ * producer thread and one consumer thread. The producer only writes the head
+ * index and the consumer only writes the tail, each on its own cache line, and
+ * each side keeps a private copy of the other's index so it only reads the
+ * shared one when its copy says the queue looks full or empty. A push onto a
+ * full queue is refused and counted rather than waiting. The consumer can also
+ * peek at a contiguous run of records and release them after it's done, which
+ * lets a logger hand them straight to fwrite without copying.
+ *
+ * rc_seqlock_t holds a single value where only the latest one matters, such as
+ * the newest IMU sample or a snapshot of the controller state for a print
+ * loop. One writer updates it without ever waiting, any number of readers copy
+ * it out and retry in the rare case a write finished during the copy, so a
+ * reader never sees half of one write and half of another. The value is kept
+ * twice and readers always copy the one the writer isn't touching, so a
+ * reader never spins on a writer that was preempted part way through. On a
+ * single core like the BeagleBone's, where the reader is often the higher
+ * priority thread, that spin would never end.
+ *
+ * Both keep their shared indices in memory allocated with the struct, aligned
+ * to a cache line, so the structs themselves can be copied around and used
+ * from C++ like the rest of the library.
+ *
+ * @addtogroup SPSC_Queue
+ * @ingroup    Math
+ * @{
+ */
+
+#ifndef RC_SPSC_QUEUE_H
+#define RC_SPSC_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * @brief      Struct containing the configuration of a single producer single
+ * consumer queue. The indices live in mem.
+ */
+typedef struct rc_spsc_queue_t{
+	void* mem;		///< cache line aligned block holding indices and records
+	char* data;		///< start of the first record inside mem
+	unsigned int capacity;	///< number of records, a power of two
+	size_t record_size;	///< size of one record in bytes
+	size_t stride;		///< distance between records, record_size rounded up to 8
+	int initialized;	///< initialization flag
+} rc_spsc_queue_t;
+
+#define RC_SPSC_QUEUE_INITIALIZER {\
+	.mem		= NULL,\
+	.data		= NULL,\
+	.capacity	= 0,\
+	.record_size	= 0,\
+	.stride		= 0,\
+	.initialized	= 0}
+
+/**
+ * @brief      Struct containing a value protected by a sequence lock. The
+ * sequence counter lives in mem.
+ */
+typedef struct rc_seqlock_t{
+	void* mem;		///< cache line aligned block holding counter and both copies
+	size_t size;		///< size of the value in bytes
+	size_t stride;		///< distance between the two copies in bytes
+	int initialized;	///< initialization flag
+} rc_seqlock_t;
+
+#define RC_SEQLOCK_INITIALIZER {\
+	.mem		= NULL,\
+	.size		= 0,\
+	.stride		= 0,\
+	.initialized	= 0}
+
+/**
+ * @brief      Returns an rc_spsc_queue_t with no memory allocated, see
+ * rc_filter_empty for why this matters.
+ *
+ * @return     Empty zero-filled rc_spsc_queue_t struct
+ */
+rc_spsc_queue_t rc_spsc_queue_empty(void);
+
+/**
+ * @brief      Allocates memory for a queue and empties it.
+ *
+ * Must not be called while another thread is using the queue.
+ *
+ * @param      q            Pointer to user's rc_spsc_queue_t struct
+ * @param[in]  capacity     Number of records, rounded up to a power of two
+ * @param[in]  record_size  Size of one record in bytes
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_spsc_queue_alloc(rc_spsc_queue_t* q, int capacity, size_t record_size);
+
+/**
+ * @brief      Frees the memory of a queue and resets it like
+ * rc_spsc_queue_empty.
+ *
+ * @param      q     Pointer to user's rc_spsc_queue_t struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_spsc_queue_free(rc_spsc_queue_t* q);
+
+/**
+ * @brief      Copies a record onto the queue, producer thread only.
+ *
+ * Never waits. If the queue is full the record is thrown away and counted,
+ * see rc_spsc_queue_dropped.
+ *
+ * @param      q     Pointer to user's rc_spsc_queue_t struct
+ * @param[in]  rec   Pointer to record_size bytes
+ *
+ * @return     0 on success, -1 if the queue was full or on error.
+ */
+int rc_spsc_queue_push(rc_spsc_queue_t* q, const void* rec);
+
+/**
+ * @brief      Copies the oldest record off the queue, consumer thread only.
+ *
+ * @param      q     Pointer to user's rc_spsc_queue_t struct
+ * @param[out] rec   Pointer to record_size bytes to fill
+ *
+ * @return     1 if a record was popped, 0 if the queue was empty, -1 on error.
+ */
+int rc_spsc_queue_pop(rc_spsc_queue_t* q, void* rec);
+
+/**
+ * @brief      Gives the consumer direct access to the oldest records without
+ * copying them, consumer thread only.
+ *
+ * The records stay owned by the consumer until they are handed back with
+ * rc_spsc_queue_release. Only records up to the end of the underlying array
+ * are returned at once, call again after releasing to get the rest.
+ *
+ * @param      q     Pointer to user's rc_spsc_queue_t struct
+ * @param[out] n     Number of contiguous records available, 0 if empty
+ *
+ * @return     Pointer to the oldest record, NULL if empty or on error.
+ */
+void* rc_spsc_queue_peek(rc_spsc_queue_t* q, int* n);
+
+/**
+ * @brief      Hands the oldest n records back to the producer after
+ * rc_spsc_queue_peek, consumer thread only.
+ *
+ * @param      q     Pointer to user's rc_spsc_queue_t struct
+ * @param[in]  n     Number of records, at most what peek returned
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_spsc_queue_release(rc_spsc_queue_t* q, int n);
+
+/**
+ * @brief      Number of records currently in the queue.
+ *
+ * Safe from either thread, though the answer may already be out of date.
+ *
+ * @param[in]  q     the queue
+ *
+ * @return     number of records or -1 on error.
+ */
+int rc_spsc_queue_count(rc_spsc_queue_t q);
+
+/**
+ * @brief      Number of records refused by rc_spsc_queue_push because the
+ * queue was full since it was allocated.
+ *
+ * @param[in]  q     the queue
+ *
+ * @return     number of dropped records.
+ */
+unsigned long rc_spsc_queue_dropped(rc_spsc_queue_t q);
+
+/**
+ * @brief      Returns an rc_seqlock_t with no memory allocated, see
+ * rc_filter_empty for why this matters.
+ *
+ * @return     Empty zero-filled rc_seqlock_t struct
+ */
+rc_seqlock_t rc_seqlock_empty(void);
+
+/**
+ * @brief      Allocates a slot for a value of size bytes, zero filled.
+ *
+ * Must not be called while another thread is using the slot.
+ *
+ * @param      s     Pointer to user's rc_seqlock_t struct
+ * @param[in]  size  Size of the value in bytes
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_seqlock_alloc(rc_seqlock_t* s, size_t size);
+
+/**
+ * @brief      Frees the memory of a slot and resets it like rc_seqlock_empty.
+ *
+ * @param      s     Pointer to user's rc_seqlock_t struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_seqlock_free(rc_seqlock_t* s);
+
+/**
+ * @brief      Replaces the value, never waits.
+ *
+ * Only one thread may write to a slot.
+ *
+ * @param      s     Pointer to user's rc_seqlock_t struct
+ * @param[in]  val   Pointer to size bytes
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_seqlock_write(rc_seqlock_t* s, const void* val);
+
+/**
+ * @brief      Copies out the latest complete value, from any thread.
+ *
+ * Retries the copy if the writer changed the value part way through.
+ *
+ * @param      s     Pointer to user's rc_seqlock_t struct
+ * @param[out] val   Pointer to size bytes to fill
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_seqlock_read(rc_seqlock_t* s, void* val);
+
+/**
+ * @brief      Number of completed writes since the slot was allocated.
+ *
+ * A reader can compare this with the number it saw last time to tell if there
+ * is a new value without copying it.
+ *
+ * @param[in]  s     the slot
+ *
+ * @return     number of writes.
+ */
+unsigned int rc_seqlock_version(rc_seqlock_t s);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_SPSC_QUEUE_H
+
+/** @} end group math*/
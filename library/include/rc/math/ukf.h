@@ -0,0 +1,322 @@
+/**
+ * <rc/math/ukf.h>
+ *
+ * @brief      Unscented Kalman filter
+ *
+ * An alternative to the EKF in <rc/math/kalman.h> for systems where working
+ * out Jacobians is awkward or the linearization is poor, such as a mobile
+ * base whose odometry turns through cos and sin of its heading. The user
+ * supplies the non-linear process model f and measurement model h as
+ * callbacks. Each step the filter pushes 2n+1 sigma points through them and
+ * takes the mean and covariance of the results, so no derivatives are needed.
+ *
+ * All memory, including the sigma points, is allocated by rc_ukf_alloc() and
+ * neither rc_ukf_predict() nor rc_ukf_update() touches the heap. The two are
+ * separate so the prediction can run at the control rate and the update only
+ * when a measurement arrives.
+ *
+ * rc_ukf_set_sqrt() switches to the square root form which keeps the
+ * lower Cholesky factor of P instead of P itself and maintains it with rank
+ * one updates. P then stays positive definite by construction and the
+ * factorization of P at the start of each step is skipped.
+ *
+ * Basic loop structure:
+ *
+ * ```C
+ * rc_ukf_t ukf = rc_ukf_empty();
+ * rc_ukf_alloc(&ukf, Nu, Q, R, Pi, process_fn, measure_fn, NULL);
+ * rc_ukf_set_state_angle(&ukf, 2);	// heading wraps around
+ * while(running){
+ *      read odometry into u;
+ *      rc_ukf_predict(&ukf, u);
+ *      if(new measurement) rc_ukf_update(&ukf, y);
+ *      use ukf.x_est;
+ * }
+ * rc_ukf_free(&ukf);
+ * ```
+ *
+ * @addtogroup UKF
+ * @ingroup    Math
+ * @{
+ */
+
+
+#ifndef RC_UKF_H
+#define RC_UKF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <rc/math/vector.h>
+#include <rc/math/matrix.h>
+
+/**
+ * @brief      Process model, writes f(x,u) to x_new.
+ *
+ * x has the length of the state, u the length given to rc_ukf_alloc and is
+ * NULL if that was 0. x_new never aliases x or u. arg is the pointer given to
+ * rc_ukf_alloc.
+ */
+typedef void (*rc_ukf_process_t)(const double* x, const double* u, double* x_new, void* arg);
+
+/**
+ * @brief      Measurement model, writes the expected measurement h(x) to y.
+ */
+typedef void (*rc_ukf_measure_t)(const double* x, double* y, void* arg);
+
+/**
+ * @brief      Struct to contain full state of an unscented Kalman filter
+ */
+typedef struct rc_ukf_t {
+	/** @name Model set by user */
+	///@{
+	rc_ukf_process_t f;	///< process model
+	rc_ukf_measure_t h;	///< measurement model
+	void* arg;		///< passed to f and h
+	int nx;			///< number of states
+	int nu;			///< number of inputs, may be 0
+	int ny;			///< number of measurements
+	///@}
+
+	/** @name Covariance Matrices */
+	///@{
+	rc_matrix_t Q;		///< Process noise covariance set by user
+	rc_matrix_t R;		///< Measurement noise covariance set by user
+	rc_matrix_t P;		///< State error covariance, or its lower Cholesky factor in square root form
+	rc_matrix_t Pi;		///< Initial P matrix set by user
+	///@}
+
+	/** @name State estimates */
+	///@{
+	rc_vector_t x_est;	///< Current estimate, predicted by rc_ukf_predict then corrected by rc_ukf_update
+	rc_vector_t x_pre;	///< Prediction from the last rc_ukf_predict
+	///@}
+
+	/** @name Sigma point weights */
+	///@{
+	double lambda;		///< alpha^2*(n+kappa)-n
+	rc_vector_t Wm;		///< weights of the mean
+	rc_vector_t Wc;		///< weights of the covariance
+	///@}
+
+	/** @name Working memory sized by rc_ukf_alloc, not for the user */
+	///@{
+	rc_matrix_t X;		///< sigma points, one per row
+	rc_matrix_t Xf;		///< sigma points through f
+	rc_matrix_t Y;		///< sigma points through h
+	rc_matrix_t L;		///< Cholesky factor of P or Q
+	rc_matrix_t Syy;	///< innovation covariance, then its Cholesky factor
+	rc_matrix_t PxyT;	///< transpose of the state-measurement cross covariance
+	rc_matrix_t KT;		///< transpose of the gain
+	rc_vector_t y_pre;	///< mean of Y
+	rc_vector_t dx;		///< deviation of one sigma point from the state mean
+	rc_vector_t dy;		///< deviation of one sigma point from the measurement mean
+	///@}
+
+	/** @name other */
+	///@{
+	uint32_t x_angles;	///< bit i set when state i is an angle
+	uint32_t y_angles;	///< bit i set when measurement i is an angle
+	int sqrt_form;		///< set with rc_ukf_set_sqrt
+	int initialized;	///< set to 1 once initialized with rc_ukf_alloc
+	uint64_t step;		///< counts times rc_ukf_update has been called
+	///@}
+} rc_ukf_t;
+
+#define RC_UKF_INITIALIZER {\
+	.f = NULL,\
+	.h = NULL,\
+	.arg = NULL,\
+	.nx = 0,\
+	.nu = 0,\
+	.ny = 0,\
+	.Q = RC_MATRIX_INITIALIZER,\
+	.R = RC_MATRIX_INITIALIZER,\
+	.P = RC_MATRIX_INITIALIZER,\
+	.Pi = RC_MATRIX_INITIALIZER,\
+	.x_est = RC_VECTOR_INITIALIZER,\
+	.x_pre = RC_VECTOR_INITIALIZER,\
+	.lambda = 0.0,\
+	.Wm = RC_VECTOR_INITIALIZER,\
+	.Wc = RC_VECTOR_INITIALIZER,\
+	.X = RC_MATRIX_INITIALIZER,\
+	.Xf = RC_MATRIX_INITIALIZER,\
+	.Y = RC_MATRIX_INITIALIZER,\
+	.L = RC_MATRIX_INITIALIZER,\
+	.Syy = RC_MATRIX_INITIALIZER,\
+	.PxyT = RC_MATRIX_INITIALIZER,\
+	.KT = RC_MATRIX_INITIALIZER,\
+	.y_pre = RC_VECTOR_INITIALIZER,\
+	.dx = RC_VECTOR_INITIALIZER,\
+	.dy = RC_VECTOR_INITIALIZER,\
+	.x_angles = 0,\
+	.y_angles = 0,\
+	.sqrt_form = 0,\
+	.initialized = 0,\
+	.step = 0}
+
+/**
+ * @brief      Returns an rc_ukf_t with no memory allocated, see
+ * rc_kalman_empty for why this matters.
+ *
+ * @return     Empty zero-filled rc_ukf_t struct
+ */
+rc_ukf_t rc_ukf_empty(void);
+
+/**
+ * @brief      Allocates memory for an unscented Kalman filter.
+ *
+ * The number of states comes from Q and the number of measurements from R.
+ * The sigma points are spread with the default scaling alpha=1, beta=2,
+ * kappa=0, see rc_ukf_set_scaling.
+ *
+ * @param      ukf   pointer to struct to be allocated
+ * @param[in]  nu    number of inputs, may be 0
+ * @param[in]  Q     Process noise covariance, can be updated later
+ * @param[in]  R     Measurement noise covariance, can be updated later
+ * @param[in]  Pi    Initial P matrix
+ * @param[in]  f     process model
+ * @param[in]  h     measurement model
+ * @param[in]  arg   passed to f and h, may be NULL
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_ukf_alloc(rc_ukf_t* ukf, int nu, rc_matrix_t Q, rc_matrix_t R, rc_matrix_t Pi,
+			rc_ukf_process_t f, rc_ukf_measure_t h, void* arg);
+
+/**
+ * @brief      Frees the memory allocated by a filter and resets it like
+ * rc_ukf_empty().
+ *
+ * @param      ukf   pointer to user's rc_ukf_t struct
+ *
+ * @return     0 on success or -1 on failure.
+ */
+int rc_ukf_free(rc_ukf_t* ukf);
+
+/**
+ * @brief      Sets the state to 0 and P back to Pi. Q, R and the form of the
+ * filter are kept.
+ *
+ * @param      ukf   pointer to struct to be reset
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_ukf_reset(rc_ukf_t* ukf);
+
+/**
+ * @brief      Changes how far the sigma points spread from the mean.
+ *
+ * alpha sets the spread, beta=2 is optimal for Gaussian noise and kappa is a
+ * secondary spread usually left at 0. Small alpha makes the central weights
+ * large and of opposite sign which costs precision, particularly in square
+ * root form, so keep alpha near 1 for small states.
+ *
+ * @param      ukf    pointer to initialized filter
+ * @param[in]  alpha  spread of the sigma points, >0
+ * @param[in]  beta   prior knowledge of the distribution
+ * @param[in]  kappa  secondary scaling
+ *
+ * @return     0 on success, -1 if the combination gives n+lambda<=0
+ */
+int rc_ukf_set_scaling(rc_ukf_t* ukf, double alpha, double beta, double kappa);
+
+/**
+ * @brief      Marks state i as an angle in radians.
+ *
+ * Its mean is taken on the circle and its deviations are wrapped to within
+ * +-pi, so a heading near pi doesn't average out to 0. Only the first 32
+ * states can be marked.
+ *
+ * @param      ukf   pointer to initialized filter
+ * @param[in]  i     index of the state
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_ukf_set_state_angle(rc_ukf_t* ukf, int i);
+
+/**
+ * @brief      Marks measurement i as an angle in radians, see
+ * rc_ukf_set_state_angle.
+ *
+ * @param      ukf   pointer to initialized filter
+ * @param[in]  i     index of the measurement
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_ukf_set_measurement_angle(rc_ukf_t* ukf, int i);
+
+/**
+ * @brief      Selects the square root form of the filter.
+ *
+ * Converts P to its lower Cholesky factor or back. In square root form Q and
+ * R must be positive definite rather than semidefinite since their factors
+ * seed the covariances each step.
+ *
+ * @param      ukf     pointer to initialized filter
+ * @param[in]  enable  1 for the square root form, 0 for the standard form
+ *
+ * @return     0 on success, -1 on failure including P not being positive
+ * definite when enabling.
+ */
+int rc_ukf_set_sqrt(rc_ukf_t* ukf, int enable);
+
+/**
+ * @brief      Prediction step, moves x_est and P forward through the process
+ * model.
+ *
+ * - sigma points X from x_est and P
+ * - x_pre = sum Wm_i f(X_i,u)
+ * - P = Q + sum Wc_i (f(X_i,u)-x_pre)(f(X_i,u)-x_pre)^T
+ *
+ * x_est is set to x_pre. Nothing is allocated.
+ *
+ * @param      ukf   pointer to struct to be updated
+ * @param[in]  u     control input, ignored when the filter has no inputs
+ *
+ * @return     0 on success, -1 on failure. If a covariance stopped being
+ * positive definite the filter has to be reset before it is used again.
+ */
+int rc_ukf_predict(rc_ukf_t* ukf, rc_vector_t u);
+
+/**
+ * @brief      Measurement update, corrects x_est and P with measurement y.
+ *
+ * - sigma points X from x_est and P
+ * - y_pre = sum Wm_i h(X_i)
+ * - Pyy = R + sum Wc_i (h(X_i)-y_pre)(h(X_i)-y_pre)^T
+ * - Pxy = sum Wc_i (X_i-x_est)(h(X_i)-y_pre)^T
+ * - K = Pxy*Pyy^-1, found with a Cholesky solve
+ * - x_est = x_est + K*(y-y_pre)
+ * - P = P - K*Pyy*K^T
+ *
+ * Nothing is allocated. Also updates the step counter.
+ *
+ * @param      ukf   pointer to struct to be updated
+ * @param[in]  y     new sensor data
+ *
+ * @return     0 on success, -1 on failure, see rc_ukf_predict.
+ */
+int rc_ukf_update(rc_ukf_t* ukf, rc_vector_t y);
+
+/**
+ * @brief      Copies the state covariance into P, multiplying out the factor
+ * in square root form.
+ *
+ * @param[in]  ukf   pointer to initialized filter
+ * @param[out] P     covariance, allocated if needed
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_ukf_covariance(rc_ukf_t* ukf, rc_matrix_t* P);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_UKF_H
+
+/** @}  end group math*/
@@ -41,6 +41,7 @@ extern double zero_tolerance;
 typedef struct rc_vector_t{
 	int len;	///< number of elements in the vector
 	double* d;	///< pointer to dynamically allocated data
+	int borrowed;	///< 1 if the memory belongs to an rc_workspace_t
 	int initialized;///< initialization flag
 } rc_vector_t;
 
@@ -48,6 +49,7 @@ typedef struct rc_vector_t{
 #define RC_VECTOR_INITIALIZER {\
 	.len = 0,\
 	.d = NULL,\
+	.borrowed = 0,\
 	.initialized = 0}
 
 
@@ -0,0 +1,276 @@
+/**
+ * <rc/math/workspace.h>
+ *
+ * @brief      Preallocated scratch memory for the matrix and vector functions.
+ *
+ * Most rc_matrix_* and rc_vector_* functions that produce a result allocate
+ * memory for it with rc_matrix_alloc or rc_vector_alloc, and functions such as
+ * rc_algebra_invert_matrix and rc_kalman_update_lin create and free several
+ * temporaries on every call. That is fine at startup but not inside a real-time
+ * loop.
+ *
+ * An rc_workspace_t is one block of memory allocated once, up front. Matrices
+ * and vectors can be carved out of it two ways:
+ *
+ * - explicitly with rc_workspace_matrix and rc_workspace_vector, for buffers
+ *   that live as long as the workspace
+ * - implicitly between rc_workspace_begin and rc_workspace_end. While a
+ *   workspace is active on the calling thread every rc_matrix_alloc,
+ *   rc_matrix_zeros, rc_vector_alloc and rc_vector_zeros takes its memory from
+ *   the workspace instead of the heap, so existing functions run unchanged.
+ *   rc_workspace_end gives everything taken since rc_workspace_begin back in
+ *   one step.
+ *
+ * Memory taken from a workspace is marked as borrowed. rc_matrix_free and
+ * rc_vector_free on a borrowed matrix or vector only reset the struct, the
+ * memory itself is only reclaimed by rc_workspace_end or rc_workspace_reset.
+ * Taking memory is a pointer bump so freeing and reallocating inside a scope
+ * keeps consuming space; size the workspace with some margin and check
+ * rc_workspace_t.high_water after a representative run.
+ *
+ * Matrices and vectors that must outlive the scope, like the state of an
+ * rc_kalman_t, have to be allocated at their final size before
+ * rc_workspace_begin. Functions that are handed an output of the right size
+ * reuse it and never reallocate it. Anything that is resized inside the scope
+ * points into the workspace and is invalid after rc_workspace_end.
+ *
+ * To prove a loop doesn't touch the heap, turn on the heap guard with
+ * rc_workspace_heap_guard. Every heap allocation or free made by the math
+ * library on that thread is then counted, or aborts the program in
+ * RC_HEAP_GUARD_ABORT mode so a debugger or core dump shows the culprit.
+ *
+ * @code{.c}
+ * rc_workspace_t ws = RC_WORKSPACE_INITIALIZER;
+ * rc_workspace_alloc(&ws, 64*1024);
+ * rc_workspace_heap_guard(RC_HEAP_GUARD_ABORT);
+ * while(running){
+ * 	rc_workspace_begin(&ws);
+ * 	rc_kalman_update_lin(&kf, u, y);
+ * 	rc_workspace_end(&ws);
+ * }
+ * rc_workspace_heap_guard(RC_HEAP_GUARD_OFF);
+ * rc_workspace_free(&ws);
+ * @endcode
+ *
+ * @addtogroup Workspace
+ * @ingroup    Math
+ * @{
+ */
+
+
+#ifndef RC_WORKSPACE_H
+#define RC_WORKSPACE_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <rc/math/matrix.h>
+#include <rc/math/vector.h>
+
+/**
+ * Every block taken from a workspace starts on a multiple of this many bytes.
+ */
+#define RC_WORKSPACE_ALIGN	16
+
+/**
+ * Heap guard modes, see rc_workspace_heap_guard.
+ */
+#define RC_HEAP_GUARD_OFF	0 ///< heap use is not checked
+#define RC_HEAP_GUARD_COUNT	1 ///< heap use is counted
+#define RC_HEAP_GUARD_ABORT	2 ///< heap use prints an error and calls abort()
+
+/**
+ * @brief      Struct containing the state of a workspace.
+ */
+typedef struct rc_workspace_t{
+	char* mem;		///< start of the memory block
+	size_t size;		///< size of the block in bytes
+	size_t used;		///< bytes currently taken
+	size_t high_water;	///< most bytes ever taken at once
+	size_t mark;		///< used at the last rc_workspace_begin
+	int owns_mem;		///< 1 if mem was allocated by rc_workspace_alloc
+	int active;		///< 1 between rc_workspace_begin and rc_workspace_end
+	struct rc_workspace_t* prev; ///< workspace that was active before this one
+	int initialized;	///< set to 1 once memory has been assigned
+} rc_workspace_t;
+
+#define RC_WORKSPACE_INITIALIZER {\
+	.mem = NULL,\
+	.size = 0,\
+	.used = 0,\
+	.high_water = 0,\
+	.mark = 0,\
+	.owns_mem = 0,\
+	.active = 0,\
+	.prev = NULL,\
+	.initialized = 0}
+
+/**
+ * @brief      Returns an rc_workspace_t with no memory and the initialized flag
+ * set to 0.
+ *
+ * @return     empty rc_workspace_t
+ */
+rc_workspace_t rc_workspace_empty(void);
+
+/**
+ * @brief      Allocates a block of bytes for the workspace from the heap.
+ *
+ * Any memory the workspace already owned is freed first. Call this during
+ * initialization, not in the loop the workspace is meant to serve.
+ *
+ * @param      ws     Pointer to user's workspace struct
+ * @param[in]  bytes  size of the block, see rc_workspace_matrix_bytes and
+ * rc_workspace_vector_bytes
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_workspace_alloc(rc_workspace_t* ws, size_t bytes);
+
+/**
+ * @brief      Uses a caller-provided buffer, such as a static array, as the
+ * workspace memory.
+ *
+ * The buffer is never freed by the workspace and must outlive it. If it is not
+ * aligned to RC_WORKSPACE_ALIGN the first few bytes are skipped.
+ *
+ * @param      ws     Pointer to user's workspace struct
+ * @param      buf    The buffer
+ * @param[in]  bytes  size of the buffer in bytes
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_workspace_from_buffer(rc_workspace_t* ws, void* buf, size_t bytes);
+
+/**
+ * @brief      Frees the workspace memory if it owns it and resets the struct.
+ *
+ * Everything carved from the workspace is invalid afterwards. The workspace
+ * must not be active.
+ *
+ * @param      ws    Pointer to user's workspace struct
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_workspace_free(rc_workspace_t* ws);
+
+/**
+ * @brief      Gives back everything taken from the workspace, keeping the
+ * memory block itself.
+ *
+ * @param      ws    Pointer to user's workspace struct
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_workspace_reset(rc_workspace_t* ws);
+
+/**
+ * @brief      Bytes of workspace a rows x cols matrix takes, including its row
+ * pointers and alignment padding.
+ *
+ * @param[in]  rows  number of rows
+ * @param[in]  cols  number of columns
+ *
+ * @return     size in bytes
+ */
+size_t rc_workspace_matrix_bytes(int rows, int cols);
+
+/**
+ * @brief      Bytes of workspace a vector of given length takes, including
+ * alignment padding.
+ *
+ * @param[in]  length  vector length
+ *
+ * @return     size in bytes
+ */
+size_t rc_workspace_vector_bytes(int length);
+
+/**
+ * @brief      Points matrix A at rows x cols of memory taken from the
+ * workspace.
+ *
+ * Works whether or not the workspace is active. Any memory A previously held is
+ * freed first. The contents are not zeroed.
+ *
+ * @param      ws    Pointer to user's workspace struct
+ * @param      A     Pointer to user's matrix struct
+ * @param[in]  rows  number of rows
+ * @param[in]  cols  number of columns
+ *
+ * @return     0 on success, -1 on failure or if the workspace is full
+ */
+int rc_workspace_matrix(rc_workspace_t* ws, rc_matrix_t* A, int rows, int cols);
+
+/**
+ * @brief      Points vector v at length doubles taken from the workspace.
+ *
+ * Works whether or not the workspace is active. Any memory v previously held is
+ * freed first. The contents are not zeroed.
+ *
+ * @param      ws      Pointer to user's workspace struct
+ * @param      v       Pointer to user's vector struct
+ * @param[in]  length  vector length
+ *
+ * @return     0 on success, -1 on failure or if the workspace is full
+ */
+int rc_workspace_vector(rc_workspace_t* ws, rc_vector_t* v, int length);
+
+/**
+ * @brief      Makes ws the workspace that rc_matrix_alloc, rc_matrix_zeros,
+ * rc_vector_alloc and rc_vector_zeros take memory from on the calling thread.
+ *
+ * Scopes nest: beginning a second workspace inside the first makes the second
+ * one active until it ends. A workspace can only be active once at a time.
+ *
+ * @param      ws    Pointer to user's workspace struct
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_workspace_begin(rc_workspace_t* ws);
+
+/**
+ * @brief      Ends the scope started by rc_workspace_begin and gives back all
+ * memory taken from ws since then.
+ *
+ * ws must be the innermost active workspace of the calling thread. The
+ * previously active workspace, if any, becomes active again.
+ *
+ * @param      ws    Pointer to user's workspace struct
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_workspace_end(rc_workspace_t* ws);
+
+/**
+ * @brief      Sets the heap guard mode for the calling thread and zeros its
+ * heap counter.
+ *
+ * While the guard is on every malloc, calloc and free made by the matrix and
+ * vector functions of this thread is counted. Memory taken from an active
+ * workspace is not heap use and is not counted.
+ *
+ * @param[in]  mode  RC_HEAP_GUARD_OFF, RC_HEAP_GUARD_COUNT or
+ * RC_HEAP_GUARD_ABORT
+ *
+ * @return     0 on success, -1 on invalid mode
+ */
+int rc_workspace_heap_guard(int mode);
+
+/**
+ * @brief      Number of heap allocations and frees seen by the heap guard of
+ * the calling thread since it was last set.
+ *
+ * @return     count
+ */
+unsigned long rc_workspace_heap_count(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_WORKSPACE_H
+
+/** @} end group math*/
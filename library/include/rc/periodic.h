@@ -0,0 +1,195 @@
+/**
+ * <rc/periodic.h>
+ *
+ * @brief      Fixed-rate periodic executor for control loops
+ *
+ * An executor owns one thread which wakes on an absolute CLOCK_MONOTONIC
+ * deadline with clock_nanosleep(TIMER_ABSTIME), so the loop rate does not
+ * drift with the execution time of the tasks or depend on sensor interrupts.
+ * Tasks are registered with a divider and run every divider-th cycle, letting
+ * several rates share one thread in a fixed order.
+ *
+ * Every cycle the executor records the wakeup latency (jitter) and whether the
+ * tasks finished before the next deadline. When a cycle overruns, the missed
+ * deadlines are skipped rather than run back to back. Jitter is also binned
+ * into a power-of-two histogram in microseconds so it can be collected on
+ * stock Linux as well as on the BeagleBone.
+ *
+ * The thread is started with rc_pthread_create so SCHED_FIFO is used when the
+ * process has permission and falls back to the inherited policy otherwise.
+ * Per-thread setup that would otherwise happen in the first cycle, such as
+ * rc_trace_thread_init, can be run before it with rc_periodic_set_thread_init.
+ *
+ * @addtogroup periodic
+ * @{
+ */
+
+#ifndef RC_PERIODIC_H
+#define RC_PERIODIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define RC_PERIODIC_MAX_TASKS	8	///< tasks one executor can hold
+#define RC_PERIODIC_HIST_BINS	24	///< jitter bins, bin i holds [2^(i-1),2^i) us
+
+/**
+ * @brief      one registered task
+ */
+typedef struct rc_periodic_task_t {
+	void (*func)(void);	///< function to call
+	int divider;		///< run every divider-th cycle
+	uint64_t exec_max_ns;	///< longest execution time seen
+} rc_periodic_task_t;
+
+/**
+ * @brief      timing statistics collected by the executor thread
+ */
+typedef struct rc_periodic_stats_t {
+	uint64_t cycles;		///< cycles executed
+	uint64_t overruns;		///< cycles which ran past the next deadline
+	uint64_t skipped;		///< deadlines skipped due to overruns
+	uint64_t jitter_max_ns;		///< worst wakeup latency
+	double jitter_mean_ns;		///< mean wakeup latency
+	uint64_t exec_max_ns;		///< longest time spent running all tasks
+	double exec_mean_ns;		///< mean time spent running all tasks
+	uint64_t hist[RC_PERIODIC_HIST_BINS];	///< wakeup latency histogram
+} rc_periodic_stats_t;
+
+/**
+ * @brief      state of one executor
+ */
+typedef struct rc_periodic_t {
+	uint64_t period_ns;		///< base period of the executor
+	int policy;			///< scheduler policy for the thread
+	int priority;			///< scheduler priority for the thread
+	int ntasks;			///< number of registered tasks
+	rc_periodic_task_t tasks[RC_PERIODIC_MAX_TASKS]; ///< registered tasks
+	void (*thread_init)(void);	///< run once in the thread before the first cycle
+	rc_periodic_stats_t stats;	///< collected statistics
+	pthread_mutex_t stats_mutex;	///< protects stats for readers
+	pthread_t thread;		///< executor thread
+	volatile int running;		///< flag telling the thread to keep going
+	int initialized;		///< set by rc_periodic_init
+} rc_periodic_t;
+
+#define RC_PERIODIC_INITIALIZER {\
+	.period_ns = 0,\
+	.policy = 0,\
+	.priority = 0,\
+	.ntasks = 0,\
+	.tasks = {{0}},\
+	.thread_init = NULL,\
+	.stats = {0},\
+	.stats_mutex = PTHREAD_MUTEX_INITIALIZER,\
+	.thread = 0,\
+	.running = 0,\
+	.initialized = 0}
+
+/**
+ * @brief      Returns an rc_periodic_t struct which is completely zero'd out.
+ *
+ * @return     empty rc_periodic_t ready for rc_periodic_init
+ */
+rc_periodic_t rc_periodic_empty(void);
+
+/**
+ * @brief      Sets up an executor with a base rate and scheduling policy.
+ *
+ * @param      ex        pointer to user's executor
+ * @param[in]  rate_hz   base rate of the executor in Hz
+ * @param[in]  policy    SCHED_FIFO SCHED_RR or SCHED_OTHER
+ * @param[in]  priority  between 1-99 for FIFO and RR, 0 for SCHED_OTHER
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_periodic_init(rc_periodic_t* ex, double rate_hz, int policy, int priority);
+
+/**
+ * @brief      Registers a task to run every divider-th cycle.
+ *
+ * Tasks run in the order they were added. Must be called before
+ * rc_periodic_start.
+ *
+ * @param      ex       pointer to user's executor
+ * @param[in]  func     function to call
+ * @param[in]  divider  1 to run every cycle, 2 for every other cycle, etc.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_periodic_add_task(rc_periodic_t* ex, void (*func)(void), int divider);
+
+/**
+ * @brief      Sets a function the executor thread calls once before its first
+ * cycle.
+ *
+ * Use it for setup which must happen in the executor thread itself but
+ * shouldn't cost the first cycle its deadline, like allocating thread-local
+ * trace buffers. Must be called before rc_periodic_start.
+ *
+ * @param      ex    pointer to user's executor
+ * @param[in]  func  function to call, NULL for none
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_periodic_set_thread_init(rc_periodic_t* ex, void (*func)(void));
+
+/**
+ * @brief      Starts the executor thread.
+ *
+ * @param      ex    pointer to user's executor
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_periodic_start(rc_periodic_t* ex);
+
+/**
+ * @brief      Stops the executor thread and waits for it to join.
+ *
+ * @param      ex           pointer to user's executor
+ * @param[in]  timeout_sec  how long to wait for the current cycle to finish
+ *
+ * @return     0 on success, 1 if the thread timed out, -1 on failure
+ */
+int rc_periodic_stop(rc_periodic_t* ex, float timeout_sec);
+
+/**
+ * @brief      Copies the current statistics without tearing.
+ *
+ * @param      ex    pointer to user's executor
+ * @param[out] stats  pointer to user's stats struct
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_periodic_get_stats(rc_periodic_t* ex, rc_periodic_stats_t* stats);
+
+/**
+ * @brief      Zeros the statistics, for example after startup transients.
+ *
+ * @param      ex    pointer to user's executor
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_periodic_reset_stats(rc_periodic_t* ex);
+
+/**
+ * @brief      Prints a human-readable summary and jitter histogram.
+ *
+ * @param      ex    pointer to user's executor
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_periodic_print_stats(rc_periodic_t* ex);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_PERIODIC_H
+
+/** @} end group periodic */
@@ -10,6 +10,11 @@
  * 0 channels A and B can be accessed on the GPS header if set up with the
  * Pinmux API to do so. The user may have exclusive use of that subsystem.
  *
+ * Duty cycles normally go through the kernel driver's sysfs files, which costs
+ * a string conversion and a write() per call. After rc_pwm_init_mmap the EHRPWM
+ * compare registers are written directly instead and rc_pwm_set_duty becomes a
+ * single store. Frequency changes still go through rc_pwm_init.
+ *
  *
  * @author     James Strawson
  * @date       1/31/2018
@@ -26,6 +31,11 @@
 extern "C" {
 #endif
 
+#include <sys/types.h> // for off_t
+
+#define RC_PWM_MMAP_ADDR	0x48300000	///< physical address of PWMSS0
+#define RC_PWM_MMAP_LEN		0x6000		///< bytes mapped, covers PWMSS0-2
+
 
 /**
  * @brief      Configures subsystem 0, 1, or 2 to operate at a particular
@@ -41,6 +51,26 @@ extern "C" {
  */
 int rc_pwm_init(int ss, int frequency);
 
+/**
+ * @brief      Switches duty cycle updates to direct register writes.
+ *
+ * With path NULL the EHRPWM registers are mapped from /dev/mem, which needs
+ * root, and only subsystems already set up with rc_pwm_init are switched over.
+ * Otherwise the RC_PWM_MMAP_LEN bytes at offset in path are mapped as-is and
+ * all three subsystems are driven through it, which is meant for UIO devices
+ * and for tests with a plain file standing in for the hardware. The EHRPWM
+ * block of subsystem ss then starts at byte ss*0x2000 + 0x200 of the file and
+ * the period is taken from its TBPRD and TBCTL registers.
+ *
+ * Subsystems not switched over keep using sysfs.
+ *
+ * @param[in]  path    register file to map or NULL for the real hardware
+ * @param[in]  offset  page-aligned offset into path, ignored if path is NULL
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+int rc_pwm_init_mmap(const char* path, off_t offset);
+
 /**
  * @brief      Stops a subsystem and puts it into a low-power state.
  *
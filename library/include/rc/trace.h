@@ -0,0 +1,181 @@
+/**
+ * <rc/trace.h>
+ *
+ * @brief      Lightweight latency tracing with log-linear histograms
+ *
+ * Code sections are timed by surrounding them with RC_TRACE_BEGIN and
+ * RC_TRACE_END using a probe id obtained once from rc_trace_register. Each
+ * thread records into its own histogram block, allocated by
+ * rc_trace_thread_init or else on the thread's first record, so recording
+ * takes no locks and never contends with other threads. Blocks are merged
+ * when the results are printed or dumped.
+ *
+ * Histograms are HDR-style: values below 8ns get their own bucket and every
+ * power of two above that is split into 8 linear sub-buckets, so percentiles
+ * are accurate to within 12.5% from nanoseconds up to minutes.
+ *
+ * Tracing starts disabled. In that state RC_TRACE_BEGIN is one predictable
+ * branch on a global flag and RC_TRACE_END is another, so the probes can
+ * stay in production builds. Defining RC_TRACE_DISABLE before including this
+ * header compiles them out entirely.
+ *
+ * @addtogroup trace
+ * @{
+ */
+
+#ifndef RC_TRACE_H
+#define RC_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define RC_TRACE_MAX_PROBES	16	///< number of probes that can be registered
+#define RC_TRACE_SUB_BITS	3	///< 2^SUB_BITS linear buckets per power of two
+#define RC_TRACE_MAX_EXP	40	///< largest power of two tracked, ~18 minutes
+#define RC_TRACE_BUCKETS	((RC_TRACE_MAX_EXP-RC_TRACE_SUB_BITS+2)<<RC_TRACE_SUB_BITS)
+
+/**
+ * global enable flag, read by the RC_TRACE macros. Use rc_trace_enable to
+ * change it.
+ */
+extern volatile int rc_trace_enabled;
+
+#ifdef RC_TRACE_DISABLE
+#define RC_TRACE_BEGIN(t)	uint64_t t = 0
+#define RC_TRACE_END(id,t)	((void)(t))
+#else
+/**
+ * declares variable t and stores the start time in it if tracing is enabled
+ */
+#define RC_TRACE_BEGIN(t)	uint64_t t = (__builtin_expect(rc_trace_enabled,0) ? rc_trace_now() : 0)
+/**
+ * records the time since the matching RC_TRACE_BEGIN against probe id
+ */
+#define RC_TRACE_END(id,t)	do{ if(__builtin_expect(t!=0,0)) rc_trace_record((id), rc_trace_now()-(t)); }while(0)
+#endif
+
+/**
+ * @brief      merged statistics for one probe
+ */
+typedef struct rc_trace_summary_t {
+	const char* name;	///< name given to rc_trace_register
+	uint64_t count;		///< number of samples
+	uint64_t min_ns;	///< shortest sample
+	uint64_t max_ns;	///< longest sample
+	double mean_ns;		///< mean of all samples
+	uint64_t p50_ns;	///< median
+	uint64_t p90_ns;	///< 90th percentile
+	uint64_t p99_ns;	///< 99th percentile
+	uint64_t p999_ns;	///< 99.9th percentile
+} rc_trace_summary_t;
+
+/**
+ * @brief      Registers a named probe, or finds an existing one by name.
+ *
+ * Call during initialization, not from the traced code path.
+ *
+ * @param[in]  name  probe name, must stay valid for the life of the program
+ *
+ * @return     probe id on success, -1 on failure
+ */
+int rc_trace_register(const char* name);
+
+/**
+ * @brief      Turns recording on or off at runtime.
+ *
+ * @param[in]  en    1 to enable, 0 to disable
+ */
+void rc_trace_enable(int en);
+
+/**
+ * @brief      Timestamp used by the trace macros, same clock as
+ * rc_nanos_since_boot.
+ *
+ * @return     nanoseconds since boot
+ */
+uint64_t rc_trace_now(void);
+
+/**
+ * @brief      Adds one duration sample to a probe's histogram.
+ *
+ * Normally called through RC_TRACE_END. Lock-free once the calling thread has
+ * its histogram block. Without rc_trace_thread_init the first record takes a
+ * mutex and allocates the block, about 40kB, so real-time threads must call
+ * rc_trace_thread_init before their first traced cycle.
+ *
+ * @param[in]  id    probe id from rc_trace_register
+ * @param[in]  ns    duration in nanoseconds
+ */
+void rc_trace_record(int id, uint64_t ns);
+
+/**
+ * @brief      Allocates the calling thread's histogram block ahead of time.
+ *
+ * Call from the thread that will record, before its time-critical work. For
+ * an rc_periodic_t executor that is a function given to
+ * rc_periodic_set_thread_init.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_trace_thread_init(void);
+
+/**
+ * @brief      Merges all threads' histograms for one probe.
+ *
+ * Safe to call while other threads are recording. The result may miss samples
+ * recorded during the call.
+ *
+ * @param[in]  id       probe id
+ * @param[out] summary  pointer to user's summary struct
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_trace_get_summary(int id, rc_trace_summary_t* summary);
+
+/**
+ * @brief      Prints a summary table of every probe with samples to stdout.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_trace_print(void);
+
+/**
+ * @brief      Writes the merged histograms of every probe as CSV.
+ *
+ * Each row is probe name, bucket lower bound (ns), bucket upper bound (ns)
+ * and count. Empty buckets are skipped.
+ *
+ * @param[in]  filename  file to write
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_trace_dump(const char* filename);
+
+/**
+ * @brief      Prints the summary, and optionally dumps the histograms, when the
+ * process exits.
+ *
+ * @param[in]  filename  file for rc_trace_dump, or NULL to only print
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_trace_dump_on_exit(const char* filename);
+
+/**
+ * @brief      Zeros every histogram, keeping registered probes.
+ *
+ * @return     0 on success, -1 on failure
+ */
+int rc_trace_reset(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_TRACE_H
+
+/** @} end group trace */
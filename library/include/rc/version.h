@@ -18,9 +18,9 @@ extern "C" {
 #endif
 
 
-#define RC_LIB_VERSION_MAJOR	1
+#define RC_LIB_VERSION_MAJOR	2
 #define RC_LIB_VERSION_MINOR	0
-#define RC_LIB_VERSION_PATCH	4
+#define RC_LIB_VERSION_PATCH	0
 #define RC_LIB_VERSION_HEX	((RC_LIB_VERSION_MAJOR << 16) | \
 				 (RC_LIB_VERSION_MINOR <<  8) | \
 				 (RC_LIB_VERSION_PATCH))
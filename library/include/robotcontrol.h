@@ -41,6 +41,7 @@
 #include <rc/model.h>
 #include <rc/motor.h>
 #include <rc/mpu.h>
+#include <rc/periodic.h>
 #include <rc/pinmux.h>
 #include <rc/pru.h>
 #include <rc/pthread.h>
@@ -49,6 +50,7 @@
 #include <rc/spi.h>
 #include <rc/start_stop.h>
 #include <rc/time.h>
+#include <rc/trace.h>
 #include <rc/uart.h>
 #include <rc/version.h>
 
@@ -4,9 +4,12 @@
 
 #include <stdio.h>
 #include <rc/encoder.h>
+#include <rc/time.h>
 #include <rc/encoder_pru.h>
 #include <rc/encoder_eqep.h>
 
+// set once both backends are up, the PRU read can't report errors on its own
+static int init_flag = 0;
 
 int rc_encoder_init(void)
 {
@@ -18,11 +21,27 @@ int rc_encoder_init(void)
 		fprintf(stderr,"ERROR: failed to run rc_encoder_pru_init\n");
 		return -1;
 	}
+	init_flag = 1;
+	return 0;
+}
+
+int rc_encoder_init_mmap(void)
+{
+	if(rc_encoder_eqep_init_mmap(NULL, 0)){
+		fprintf(stderr,"ERROR: failed to run rc_encoder_eqep_init_mmap\n");
+		return -1;
+	}
+	if(rc_encoder_pru_init()){
+		fprintf(stderr,"ERROR: failed to run rc_encoder_pru_init\n");
+		return -1;
+	}
+	init_flag = 1;
 	return 0;
 }
 
 int rc_encoder_cleanup(void)
 {
+	init_flag = 0;
 	rc_encoder_eqep_cleanup();
 	rc_encoder_pru_cleanup();
 	return 0;
@@ -52,3 +71,70 @@ int rc_encoder_write(int ch, int value)
 	return rc_encoder_eqep_write(ch,value);
 }
 
+
+int rc_encoder_snapshot(rc_encoder_snapshot_t* snap)
+{
+	int eqep[3];
+	uint64_t t0, t1, t2;
+
+	if(snap==NULL){
+		fprintf(stderr, "ERROR in rc_encoder_snapshot, received NULL pointer\n");
+		return -1;
+	}
+	if(!init_flag){
+		fprintf(stderr, "ERROR in rc_encoder_snapshot, call rc_encoder_init or rc_encoder_init_mmap first\n");
+		return -1;
+	}
+	t0 = rc_nanos_since_boot();
+	if(rc_encoder_eqep_read_all(eqep)) return -1;
+	t1 = rc_nanos_since_boot();
+	snap->counts[3] = rc_encoder_pru_read();
+	t2 = rc_nanos_since_boot();
+
+	snap->counts[0] = eqep[0];
+	snap->counts[1] = eqep[1];
+	snap->counts[2] = eqep[2];
+	snap->ch_t_ns[0] = snap->ch_t_ns[1] = snap->ch_t_ns[2] = t0 + (t1-t0)/2;
+	snap->ch_t_ns[3] = t1 + (t2-t1)/2;
+	snap->t_ns = t0 + (t2-t0)/2;
+	return 0;
+}
+
+int rc_encoder_read_all(int32_t counts[RC_ENCODER_CHANNELS], uint64_t* t_ns)
+{
+	rc_encoder_snapshot_t snap;
+	int i;
+
+	if(counts==NULL){
+		fprintf(stderr, "ERROR in rc_encoder_read_all, received NULL pointer\n");
+		return -1;
+	}
+	if(rc_encoder_snapshot(&snap)) return -1;
+	for(i=0;i<RC_ENCODER_CHANNELS;i++) counts[i] = snap.counts[i];
+	if(t_ns!=NULL) *t_ns = snap.t_ns;
+	return 0;
+}
+
+int rc_encoder_velocity(const rc_encoder_snapshot_t* prev,
+	const rc_encoder_snapshot_t* curr, double vel[RC_ENCODER_CHANNELS])
+{
+	int i;
+	int32_t dcount;
+	uint64_t dt;
+
+	if(prev==NULL || curr==NULL || vel==NULL){
+		fprintf(stderr, "ERROR in rc_encoder_velocity, received NULL pointer\n");
+		return -1;
+	}
+	for(i=0;i<RC_ENCODER_CHANNELS;i++){
+		if(curr->ch_t_ns[i] <= prev->ch_t_ns[i]){
+			fprintf(stderr, "ERROR in rc_encoder_velocity, snapshots out of order\n");
+			return -1;
+		}
+		// unsigned difference wraps the same way the counters do
+		dcount = (int32_t)((uint32_t)curr->counts[i] - (uint32_t)prev->counts[i]);
+		dt = curr->ch_t_ns[i] - prev->ch_t_ns[i];
+		vel[i] = (double)dcount * 1e9 / (double)dt;
+	}
+	return 0;
+}
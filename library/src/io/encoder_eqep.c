@@ -8,9 +8,11 @@
 
 #include <stdio.h>
 #include <stdlib.h> // for atoi
+#include <stdint.h>
 #include <errno.h>
 #include <fcntl.h> // for open
 #include <unistd.h> // for close
+#include <sys/mman.h> // for mmap
 
 #include <rc/encoder_eqep.h>
 
@@ -24,8 +26,17 @@
 #define EQEP_BASE2 "/sys/devices/platform/ocp/48304000.epwmss/48304180.eqep"
 
 
+// register layout inside the mapped window, see AM335x TRM chapter 15.4
+#define EQEP_STRIDE	0x2000	// distance between the three PWMSS instances
+#define EQEP_OFFSET	0x180	// eQEP block inside each PWMSS
+#define QPOSCNT		0x00	// 32-bit position counter
+
+
 static int fd[3]; //store file descriptors for 3 position files
-static int init_flag = 0; // boolean to check if mem mapped
+static int init_flag = 0; // boolean to check if sysfs files are open
+static int mmap_flag = 0; // boolean to check if registers are mapped
+static void* map_base = NULL;
+static volatile uint32_t* qposcnt[3]; // position counter of each channel
 
 
 
@@ -113,23 +124,95 @@ int rc_encoder_eqep_init(void)
 	return 0;
 }
 
+int rc_encoder_eqep_init_mmap(const char* path, off_t offset)
+{
+	int i, mem_fd;
+	void* map;
+
+	if(mmap_flag) return 0;
+
+	// on real hardware let the kernel driver enable the clocks and counters
+	// first, then bypass it for reads
+	if(path==NULL){
+		if(rc_encoder_eqep_init()){
+			fprintf(stderr,"ERROR in rc_encoder_eqep_init_mmap, failed to enable eQEP driver\n");
+			return -1;
+		}
+		path = "/dev/mem";
+		offset = RC_ENCODER_EQEP_MMAP_ADDR;
+	}
+
+	mem_fd = open(path, O_RDWR | O_SYNC);
+	if(mem_fd==-1){
+		perror("ERROR in rc_encoder_eqep_init_mmap, could not open register file");
+		fprintf(stderr,"Need to be root to access /dev/mem\n");
+		return -1;
+	}
+	map = mmap(0, RC_ENCODER_EQEP_MMAP_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, offset);
+	close(mem_fd);
+	if(map==MAP_FAILED){
+		perror("ERROR in rc_encoder_eqep_init_mmap, failed to map registers");
+		return -1;
+	}
+
+	map_base = map;
+	for(i=0;i<3;i++){
+		qposcnt[i] = (volatile uint32_t*)((char*)map + i*EQEP_STRIDE + EQEP_OFFSET + QPOSCNT);
+	}
+	mmap_flag = 1;
+	return 0;
+}
+
+
 int rc_encoder_eqep_cleanup(void)
 {
 	int i;
-	for(i=0;i<3;i++){
-		close(fd[i]);
+	if(mmap_flag){
+		munmap(map_base, RC_ENCODER_EQEP_MMAP_LEN);
+		map_base = NULL;
+		mmap_flag = 0;
+	}
+	if(init_flag){
+		for(i=0;i<3;i++){
+			close(fd[i]);
+		}
 	}
 	init_flag = 0;
 	return 0;
 }
 
 
-int rc_encoder_eqep_read(int ch)
+/**
+ * reads the position of channel ch from its sysfs file
+ *
+ * @return     0 on success, -1 on failure
+ */
+static int __read_sysfs(int ch, int* pos)
 {
 	char buf[12];
+	ssize_t n;
+	// seek to beginning of file and read
+	if(unlikely(lseek(fd[ch-1],0,SEEK_SET)<0)){
+		perror("ERROR: in rc_encoder_eqep_read, failed to seek to beginning of fd");
+		return -1;
+	}
+	n = read(fd[ch-1], buf, sizeof(buf)-1);
+	if(unlikely(n<=0)){
+		perror("ERROR in rc_encoder_eqep_read, can't read position fd");
+		return -1;
+	}
+	buf[n] = 0;
+	*pos = atoi(buf);
+	return 0;
+}
+
+
+int rc_encoder_eqep_read(int ch)
+{
+	int pos;
 
 	//sanity checks
-	if(unlikely(!init_flag)){
+	if(unlikely(!init_flag && !mmap_flag)){
 		fprintf(stderr,"ERROR in rc_encoder_eqep_read, please initialize with rc_encoder_eqep_init() first\n");
 		return -1;
 	}
@@ -141,16 +224,9 @@ int rc_encoder_eqep_read(int ch)
 		fprintf(stderr,"ERROR: in rc_encoder_eqep_read, encoder channel must be between 1 & 3 inclusive\n");
 		return -1;
 	}
-	// seek to beginning of file and read
-	if(unlikely(lseek(fd[ch-1],0,SEEK_SET)<0)){
-		perror("ERROR: in rc_encoder_eqep_read, failed to seek to beginning of fd");
-		return -1;
-	}
-	if(unlikely(read(fd[ch-1], buf, sizeof(buf))==-1)){
-		perror("ERROR in rc_encoder_eqep_read, can't read position fd");
-		return -1;
-	}
-	return atoi(buf);
+	if(mmap_flag) return (int32_t)*qposcnt[ch-1];
+	if(__read_sysfs(ch, &pos)) return -1;
+	return pos;
 }
 
 
@@ -159,7 +235,7 @@ int rc_encoder_eqep_write(int ch, int pos)
 {
 	char buf[12];
 	//sanity checks
-	if(unlikely(!init_flag)){
+	if(unlikely(!init_flag && !mmap_flag)){
 		fprintf(stderr,"ERROR in rc_encoder_eqep_write, please initialize with rc_encoder_eqep_init() first\n");
 		return -1;
 	}
@@ -171,6 +247,10 @@ int rc_encoder_eqep_write(int ch, int pos)
 		fprintf(stderr,"ERROR: in rc_encoder_eqep_write, encoder channel must be between 1 & 3 inclusive\n");
 		return -1;
 	}
+	if(mmap_flag){
+		*qposcnt[ch-1] = (uint32_t)pos;
+		return 0;
+	}
 	if(unlikely(lseek(fd[ch-1],0,SEEK_SET)<0)){
 		perror("ERROR: in rc_encoder_eqep_write, failed to seek to beginning of fd");
 		return -1;
@@ -184,3 +264,29 @@ int rc_encoder_eqep_write(int ch, int pos)
 }
 
 
+int rc_encoder_eqep_read_all(int pos[3])
+{
+	int i;
+	if(unlikely(pos==NULL)){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_read_all, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!init_flag && !mmap_flag)){
+		fprintf(stderr,"ERROR in rc_encoder_eqep_read_all, please initialize with rc_encoder_eqep_init() first\n");
+		return -1;
+	}
+	if(mmap_flag){
+		// back to back loads, the counters are sampled within a few bus cycles
+		pos[0] = (int32_t)*qposcnt[0];
+		pos[1] = (int32_t)*qposcnt[1];
+		pos[2] = (int32_t)*qposcnt[2];
+		return 0;
+	}
+	// sysfs fallback, one syscall pair per channel so not a true snapshot.
+	// A failed read can't be told from a count of -1 by its value alone so
+	// it fails the whole call.
+	for(i=0;i<3;i++){
+		if(__read_sysfs(i+1, &pos[i])) return -1;
+	}
+	return 0;
+}
@@ -270,3 +270,138 @@ void rc_gpio_cleanup(int chip, int pin)
 	}
 	return;
 }
+
+
+rc_gpio_group_t rc_gpio_group_empty(void)
+{
+	rc_gpio_group_t out = RC_GPIO_GROUP_INITIALIZER;
+	return out;
+}
+
+
+int rc_gpio_group_init(rc_gpio_group_t* group, int chip, const int* pins, int lines, int handle_flags)
+{
+	int i, ret, fd;
+	char buf[MAX_BUF];
+	struct gpiohandle_request req;
+
+	// sanity checks
+	if(unlikely(group==NULL || pins==NULL)){
+		fprintf(stderr,"ERROR in rc_gpio_group_init, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(group->initialized)){
+		fprintf(stderr,"ERROR in rc_gpio_group_init, group already initialized\n");
+		return -1;
+	}
+	if(chip<0){
+		fprintf(stderr,"ERROR in rc_gpio_group_init, chip out of bounds\n");
+		return -1;
+	}
+	if(lines<1 || lines>GPIOHANDLES_MAX){
+		fprintf(stderr,"ERROR in rc_gpio_group_init, lines must be between 1 and %d\n", GPIOHANDLES_MAX);
+		return -1;
+	}
+
+	// use the shared chip fd where there is one, simulated chips such as
+	// gpio-sim may be numbered above CHIPS_MAX so open those just for this
+	if(chip<CHIPS_MAX){
+		if(chip_fd[chip]==0){
+			if(unlikely(__open_gpiochip(chip))) return -1;
+		}
+		fd = chip_fd[chip];
+	}
+	else{
+		snprintf(buf, sizeof(buf), DEVICE_BASE "%d", chip);
+		fd=open(buf,O_RDWR);
+		if(fd==-1){
+			perror("ERROR opening gpiochip");
+			return -1;
+		}
+	}
+
+	memset(&req,0,sizeof(req));
+	for(i=0;i<lines;i++) req.lineoffsets[i] = pins[i];
+	req.lines = lines;
+	req.flags = handle_flags;
+	strncpy(req.consumer_label, "rc_gpio_group", sizeof(req.consumer_label)-1);
+	ret = ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
+	if(chip>=CHIPS_MAX) close(fd);
+	if(unlikely(ret==-1)){
+		perror("ERROR in rc_gpio_group_init");
+		return -1;
+	}
+	if(req.fd<=0){
+		fprintf(stderr,"ERROR in rc_gpio_group_init, ioctl gave NULL fd\n");
+		return -1;
+	}
+
+	group->chip = chip;
+	group->lines = lines;
+	for(i=0;i<lines;i++) group->pins[i] = pins[i];
+	group->fd = req.fd;
+	group->initialized = 1;
+	return 0;
+}
+
+
+int rc_gpio_group_set_values(rc_gpio_group_t* group, const int* values)
+{
+	int i;
+	struct gpiohandle_data data;
+
+	// sanity checks
+	if(unlikely(group==NULL || values==NULL)){
+		fprintf(stderr,"ERROR in rc_gpio_group_set_values, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!group->initialized)){
+		fprintf(stderr,"ERROR in rc_gpio_group_set_values, group not initialized yet\n");
+		return -1;
+	}
+
+	memset(&data,0,sizeof(data));
+	for(i=0;i<group->lines;i++) data.values[i] = values[i] ? 1 : 0;
+	if(unlikely(ioctl(group->fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data)==-1)){
+		perror("ERROR in rc_gpio_group_set_values");
+		return -1;
+	}
+	return 0;
+}
+
+
+int rc_gpio_group_get_values(rc_gpio_group_t* group, int* values)
+{
+	int i;
+	struct gpiohandle_data data;
+
+	// sanity checks
+	if(unlikely(group==NULL || values==NULL)){
+		fprintf(stderr,"ERROR in rc_gpio_group_get_values, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!group->initialized)){
+		fprintf(stderr,"ERROR in rc_gpio_group_get_values, group not initialized yet\n");
+		return -1;
+	}
+
+	if(unlikely(ioctl(group->fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data)==-1)){
+		perror("ERROR in rc_gpio_group_get_values");
+		return -1;
+	}
+	for(i=0;i<group->lines;i++) values[i] = data.values[i];
+	return 0;
+}
+
+
+int rc_gpio_group_cleanup(rc_gpio_group_t* group)
+{
+	if(unlikely(group==NULL)){
+		fprintf(stderr,"ERROR in rc_gpio_group_cleanup, received NULL pointer\n");
+		return -1;
+	}
+	if(!group->initialized) return 0;
+	close(group->fd);
+	*group = rc_gpio_group_empty();
+	return 0;
+}
@@ -7,12 +7,14 @@
 
 #include <stdio.h>
 #include <stdlib.h> // for atoi
+#include <stdint.h>
 #include <dirent.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <glob.h>
+#include <sys/mman.h> // for mmap
 #include <rc/pwm.h>
 #include <rc/time.h>
 
@@ -29,6 +31,15 @@
 // preposessor macros
 #define unlikely(x)	__builtin_expect (!!(x), 0)
 
+// EHRPWM register layout inside the mapped window, see AM335x TRM 15.2.4
+#define PWM_STRIDE	0x2000	// distance between the three PWMSS instances
+#define PWM_OFFSET	0x200	// EHRPWM block inside each PWMSS
+#define TBCTL		0x00	// 16-bit registers from here on
+#define TBPRD		0x0A
+#define CMPA		0x12
+#define CMPB		0x14
+#define SYSCLK_HZ	100000000 // time-base input clock before dividers
+
 // variables
 static int dutyA_fd[3];			// pointers to duty cycle file descriptor
 static int dutyB_fd[3];			// pointers to duty cycle file descriptor
@@ -45,6 +56,54 @@ static int init_flag[3] = {0,0,0};
 static int mode; // 0 for "pwmx", 1 for "pwm-x:y" versions of driver
 static int ssindex[3]; // index given by the kernel to each pwm chip when in mode 1
 
+// direct register access, see rc_pwm_init_mmap
+static void* map_base = NULL;
+static int mapped[3] = {0,0,0};		// subsystems written through registers
+static volatile uint16_t* regs[3];	// EHRPWM block of each subsystem
+static unsigned int prd_counts[3];	// time-base counts per period, TBPRD+1
+
+
+/**
+ * @brief      caches the period of a mapped subsystem from its registers
+ *
+ * The kernel driver programs the period, the compare values are just that
+ * many counts scaled by duty.
+ *
+ * @param[in]  ss    subsystem
+ */
+static void __read_period(int ss)
+{
+	uint16_t tbctl;
+	unsigned int clkdiv, hspclkdiv;
+	prd_counts[ss] = (unsigned int)regs[ss][TBPRD/2] + 1;
+	// when only the registers are available derive the period from the
+	// clock dividers, TBCLK = SYSCLK/(HSPCLKDIV*CLKDIV)
+	if(!init_flag[ss]){
+		tbctl = regs[ss][TBCTL/2];
+		clkdiv = 1u << ((tbctl>>10) & 0x7);
+		hspclkdiv = (tbctl>>7) & 0x7;
+		hspclkdiv = hspclkdiv ? 2*hspclkdiv : 1;
+		period_ns[ss] = (unsigned int)((uint64_t)prd_counts[ss] * clkdiv
+				* hspclkdiv * 1000000000ull / SYSCLK_HZ);
+	}
+}
+
+
+/**
+ * @brief      compare register value for a number of time-base counts
+ *
+ * A full period is TBPRD+1 counts, which doesn't fit in 16 bits when TBPRD is
+ * 0xFFFF, so saturate rather than wrap to 0 duty.
+ *
+ * @param[in]  counts  counts the output stays high
+ *
+ * @return     value for CMPA or CMPB
+ */
+static inline uint16_t __cmp_counts(uint32_t counts)
+{
+	return counts>0xFFFF ? 0xFFFF : (uint16_t)counts;
+}
+
 
 /**
  * @brief      exports A and B pwm channels
@@ -355,6 +414,51 @@ int rc_pwm_init(int ss, int frequency)
 
 	// everything successful
 	init_flag[ss] = 1;
+	// pick up the new period if the registers are already mapped
+	if(map_base!=NULL){
+		mapped[ss] = 1;
+		__read_period(ss);
+	}
+	return 0;
+}
+
+
+int rc_pwm_init_mmap(const char* path, off_t offset)
+{
+	int ss, mem_fd, hardware = 0;
+	void* map;
+
+	if(map_base!=NULL) return 0;
+	if(path==NULL){
+		// the clocks are only running for subsystems the driver set up
+		if(!init_flag[0] && !init_flag[1] && !init_flag[2]){
+			fprintf(stderr,"ERROR in rc_pwm_init_mmap, call rc_pwm_init first\n");
+			return -1;
+		}
+		path = "/dev/mem";
+		offset = RC_PWM_MMAP_ADDR;
+		hardware = 1;
+	}
+
+	mem_fd = open(path, O_RDWR | O_SYNC);
+	if(mem_fd==-1){
+		perror("ERROR in rc_pwm_init_mmap, could not open register file");
+		fprintf(stderr,"Need to be root to access /dev/mem\n");
+		return -1;
+	}
+	map = mmap(0, RC_PWM_MMAP_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, offset);
+	close(mem_fd);
+	if(map==MAP_FAILED){
+		perror("ERROR in rc_pwm_init_mmap, failed to map registers");
+		return -1;
+	}
+
+	map_base = map;
+	for(ss=0;ss<3;ss++){
+		regs[ss] = (volatile uint16_t*)((char*)map + ss*PWM_STRIDE + PWM_OFFSET);
+		mapped[ss] = hardware ? init_flag[ss] : 1;
+		if(mapped[ss]) __read_period(ss);
+	}
 	return 0;
 }
 
@@ -369,6 +473,15 @@ int rc_pwm_cleanup(int ss)
 		fprintf(stderr,"ERROR in rc_pwm_close, subsystem must be between 0 and 2\n");
 		return -1;
 	}
+	if(mapped[ss]){
+		regs[ss][CMPA/2] = 0;
+		regs[ss][CMPB/2] = 0;
+		mapped[ss] = 0;
+		if(!mapped[0] && !mapped[1] && !mapped[2]){
+			munmap(map_base, RC_PWM_MMAP_LEN);
+			map_base = NULL;
+		}
+	}
 	if(init_flag[ss]==0){
 		return 0;
 	}
@@ -435,7 +548,7 @@ int rc_pwm_set_duty(int ss, char ch, double duty)
 		fprintf(stderr,"ERROR in rc_pwm_set_duty, PWM subsystem must be between 0 and 2\n");
 		return -1;
 	}
-	if(unlikely(init_flag[ss]==0)){
+	if(unlikely(init_flag[ss]==0 && mapped[ss]==0)){
 		fprintf(stderr, "ERROR in rc_pwm_set_duty, subsystem %d not initialized yet\n", ss);
 		return -1;
 	}
@@ -444,6 +557,22 @@ int rc_pwm_set_duty(int ss, char ch, double duty)
 		return -1;
 	}
 
+	// mapped: one store into the shadowed compare register, which the
+	// hardware loads at the start of the next period
+	if(mapped[ss]){
+		switch(ch){
+		case 'A':
+			regs[ss][CMPA/2] = __cmp_counts((uint32_t)(duty*prd_counts[ss] + 0.5));
+			return 0;
+		case 'B':
+			regs[ss][CMPB/2] = __cmp_counts((uint32_t)(duty*prd_counts[ss] + 0.5));
+			return 0;
+		default:
+			fprintf(stderr,"ERROR in rc_pwm_set_duty, pwm channel must be 'A' or 'B'\n");
+			return -1;
+		}
+	}
+
 	// set the duty
 	duty_ns = duty*period_ns[ss];
 	len = snprintf(buf, sizeof(buf), "%d", duty_ns);
@@ -478,7 +607,7 @@ int rc_pwm_set_duty_ns(int ss, char ch, unsigned int duty_ns)
 		fprintf(stderr,"ERROR in rc_pwm_set_duty_ns, PWM subsystem must be between 0 and 2\n");
 		return -1;
 	}
-	if(unlikely(init_flag[ss]==0)){
+	if(unlikely(init_flag[ss]==0 && mapped[ss]==0)){
 		fprintf(stderr, "ERROR in rc_pwm_set_duty_ns, subsystem %d not initialized yet\n", ss);
 		return -1;
 	}
@@ -487,6 +616,21 @@ int rc_pwm_set_duty_ns(int ss, char ch, unsigned int duty_ns)
 		return -1;
 	}
 
+	if(mapped[ss]){
+		uint16_t cmp = __cmp_counts((uint32_t)(((uint64_t)duty_ns*prd_counts[ss] + period_ns[ss]/2) / period_ns[ss]));
+		switch(ch){
+		case 'A':
+			regs[ss][CMPA/2] = cmp;
+			return 0;
+		case 'B':
+			regs[ss][CMPB/2] = cmp;
+			return 0;
+		default:
+			fprintf(stderr,"ERROR in rc_pwm_set_duty_ns, pwm channel must be 'A' or 'B'\n");
+			return -1;
+		}
+	}
+
 	// set the duty
 	len = snprintf(buf, sizeof(buf), "%d", duty_ns);
 	switch(ch){
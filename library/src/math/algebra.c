@@ -174,7 +174,7 @@ int rc_algebra_qr_decomp(rc_matrix_t A, rc_matrix_t* Q, rc_matrix_t* R)
 int rc_algebra_lup_decomp(rc_matrix_t A, rc_matrix_t* L, rc_matrix_t* U, rc_matrix_t* P)
 {
 	int i,j,k,m,index,tmpint;
-	double s1, s2;
+	double* row;
 	int* ptmp;
 	void* rowtmp;
 	rc_matrix_t Adup = RC_MATRIX_INITIALIZER;
@@ -245,16 +245,20 @@ int rc_algebra_lup_decomp(rc_matrix_t A, rc_matrix_t* L, rc_matrix_t* U, rc_matr
 	}
 	// construct P from ptmp
 	for(i=0;i<m;i++) P->d[i][ptmp[i]]=1.0;
-	// now do normal LU
+	// now do normal LU one row at a time. Eliminating row i with the finished
+	// rows of U above it leaves row i of L left of the diagonal and row i of
+	// U from the diagonal on, all in contiguous memory.
 	for(i=0;i<m;i++){
-		for(j=0;j<m;j++){
-			s1 = 0.0;
-			s2 = 0.0;
-			for(k=0;k<i;k++) s1 += U->d[k][j] * L->d[i][k];
-			for(k=0;k<j;k++) s2 += U->d[k][j] * L->d[i][k];
-			if(j>=i) U->d[i][j] = (Adup.d[i][j]-s1);
-			if(i>=j) L->d[i][j] = (Adup.d[i][j]-s2)/U->d[j][j];
+		row = Adup.d[i];
+		for(k=0;k<i;k++){
+			row[k] /= U->d[k][k];
+			__vectorized_axpy(-row[k], U->d[k]+k+1, row+k+1, m-k-1);
 		}
+		for(j=0;j<i;j++){
+			L->d[i][j] = row[j];
+			U->d[i][j] = 0.0;
+		}
+		memcpy(U->d[i]+i, row+i, (m-i)*sizeof(double));
 	}
 	rc_matrix_free(&Adup);
 	return 0;
@@ -262,7 +266,7 @@ int rc_algebra_lup_decomp(rc_matrix_t A, rc_matrix_t* L, rc_matrix_t* U, rc_matr
 
 int rc_algebra_invert_matrix(rc_matrix_t A, rc_matrix_t* Ainv)
 {
-	int i,j,k;
+	int i,j,k,n;
 	rc_matrix_t L = RC_MATRIX_INITIALIZER;
 	rc_matrix_t U = RC_MATRIX_INITIALIZER;
 	rc_matrix_t P = RC_MATRIX_INITIALIZER;
@@ -298,21 +302,16 @@ int rc_algebra_invert_matrix(rc_matrix_t A, rc_matrix_t* Ainv)
 		rc_matrix_free(&tmp);
 		return -1;
 	}
-	// solve for Inv
-	for(j=0;j<A.cols;j++){
-		for(i=0;i<A.cols;i++){
-			for(k=0;k<i;k++){
-				D.d[i][j] -= L.d[i][k] * D.d[k][j];
-			}
-		}
-		// backwards.. last to first
-		for(i=A.cols-1;i>=0;i--){
-			tmp.d[i][j] = D.d[i][j];
-			for(k=i+1;k<A.cols;k++){
-				tmp.d[i][j] -= U.d[i][k] * tmp.d[k][j];
-			}
-			tmp.d[i][j] = tmp.d[i][j] / U.d[i][i];
-		}
+	// solve for Inv, all columns at once so every update is a whole row
+	n = A.cols;
+	for(i=0;i<n;i++){
+		for(k=0;k<i;k++) __vectorized_axpy(-L.d[i][k], D.d[k], D.d[i], n);
+	}
+	// backwards.. last to first
+	for(i=n-1;i>=0;i--){
+		memcpy(tmp.d[i], D.d[i], n*sizeof(double));
+		for(k=i+1;k<n;k++) __vectorized_axpy(-U.d[i][k], tmp.d[k], tmp.d[i], n);
+		for(j=0;j<n;j++) tmp.d[i][j] = tmp.d[i][j] / U.d[i][i];
 	}
 	// free up some memory
 	rc_matrix_free(&L);
@@ -320,11 +319,19 @@ int rc_algebra_invert_matrix(rc_matrix_t A, rc_matrix_t* Ainv)
 	rc_matrix_free(&D);
 	// use i as new return value
 	i=0;
-	// multiply by permutation matrix
-	if(unlikely(rc_matrix_multiply(tmp, P, Ainv))){
-		fprintf(stderr,"ERROR in rc_matrix_inverse, failed to multiply matrix\n");
+	// multiply by permutation matrix, since P has a single 1 in each row this
+	// just moves column k of tmp to the column where row k of P has its 1
+	if(unlikely(rc_matrix_alloc(Ainv,n,n))){
+		fprintf(stderr,"ERROR in rc_matrix_inverse, failed to alloc matrix\n");
 		i=-1;
 	}
+	else{
+		for(k=0;k<n;k++){
+			for(j=0;j<n;j++) if(P.d[k][j]>0.5) break;
+			for(i=0;i<n;i++) Ainv->d[i][j] = tmp.d[i][k];
+		}
+		i=0;
+	}
 	// free allocation
 	rc_matrix_free(&tmp);
 	rc_matrix_free(&P);
@@ -389,7 +396,7 @@ int rc_algebra_lin_system_solve(rc_matrix_t A, rc_vector_t b, rc_vector_t* x)
 		m=k;
 		for(i=k+1;i<nDim;i++){
 			if(fMaxElem<fabs(Atemp.d[i][k])){
-				fMaxElem=Atemp.d[i][k];
+				fMaxElem=fabs(Atemp.d[i][k]);
 				m=i;
 			}
 		}
@@ -488,6 +495,456 @@ int rc_algebra_lin_system_solve_qr(rc_matrix_t A, rc_vector_t b, rc_vector_t* x)
 }
 
 
+/**
+ * Cholesky factor of A in place, only the lower triangle of A is read. fn is
+ * the public function name for error messages.
+ */
+static int __cholesky_inplace(rc_matrix_t* A, const char* fn)
+{
+	int i,j,n;
+	double t;
+	n = A->rows;
+	for(i=0;i<n;i++){
+		// row i only needs rows above it, which are already final
+		for(j=0;j<i;j++){
+			t = __vectorized_mult_accumulate(A->d[i],A->d[j],j);
+			A->d[i][j] = (A->d[i][j]-t)/A->d[j][j];
+		}
+		t = A->d[i][i] - __vectorized_square_accumulate(A->d[i],i);
+		if(unlikely(t<zero_tolerance)){
+			fprintf(stderr,"ERROR in %s, matrix is not positive definite\n",fn);
+			return -1;
+		}
+		A->d[i][i] = sqrt(t);
+		for(j=i+1;j<n;j++) A->d[i][j] = 0.0;
+	}
+	return 0;
+}
+
+
+/**
+ * checks L is a square factor, x has matching length and copies b into x
+ */
+static int __tri_solve_setup(rc_matrix_t L, rc_vector_t b, rc_vector_t* x, const char* fn)
+{
+	if(unlikely(!L.initialized || !b.initialized)){
+		fprintf(stderr,"ERROR in %s, matrix or vector uninitialized\n",fn);
+		return -1;
+	}
+	if(unlikely(x==NULL)){
+		fprintf(stderr,"ERROR in %s, received NULL pointer\n",fn);
+		return -1;
+	}
+	if(unlikely(L.rows!=L.cols || L.cols!=b.len)){
+		fprintf(stderr,"ERROR in %s, dimension mismatch\n",fn);
+		return -1;
+	}
+	if(unlikely(rc_vector_alloc(x,b.len))){
+		fprintf(stderr,"ERROR in %s, failed to alloc vector\n",fn);
+		return -1;
+	}
+	if(x->d!=b.d) memcpy(x->d,b.d,b.len*sizeof(double));
+	return 0;
+}
+
+
+int rc_algebra_cholesky_decomp(rc_matrix_t A, rc_matrix_t* L)
+{
+	int i;
+	if(unlikely(!A.initialized)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp, matrix uninitialized\n");
+		return -1;
+	}
+	if(unlikely(L==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(A.rows!=A.cols)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp, matrix is not square\n");
+		return -1;
+	}
+	if(unlikely(rc_matrix_alloc(L,A.rows,A.cols))){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp, failed to alloc matrix\n");
+		return -1;
+	}
+	// the lower triangle is all that's needed
+	if(L->d!=A.d){
+		for(i=0;i<A.rows;i++) memcpy(L->d[i],A.d[i],(i+1)*sizeof(double));
+	}
+	return __cholesky_inplace(L,"rc_algebra_cholesky_decomp");
+}
+
+
+int rc_algebra_cholesky_decomp_inplace(rc_matrix_t* A)
+{
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp_inplace, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!A->initialized)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp_inplace, matrix uninitialized\n");
+		return -1;
+	}
+	if(unlikely(A->rows!=A->cols)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_decomp_inplace, matrix is not square\n");
+		return -1;
+	}
+	return __cholesky_inplace(A,"rc_algebra_cholesky_decomp_inplace");
+}
+
+
+int rc_algebra_cholesky_solve(rc_matrix_t L, rc_vector_t b, rc_vector_t* x)
+{
+	int i,n;
+	if(unlikely(__tri_solve_setup(L,b,x,"rc_algebra_cholesky_solve"))) return -1;
+	n = L.rows;
+	// L*y=b
+	for(i=0;i<n;i++){
+		x->d[i] = (x->d[i]-__vectorized_mult_accumulate(L.d[i],x->d,i))/L.d[i][i];
+	}
+	// L'*x=y, row i of L is column i of L' so substitute column by column
+	for(i=n-1;i>=0;i--){
+		x->d[i] /= L.d[i][i];
+		__vectorized_axpy(-x->d[i],L.d[i],x->d,i);
+	}
+	return 0;
+}
+
+
+int rc_algebra_cholesky_solve_matrix_inplace(rc_matrix_t L, rc_matrix_t* B)
+{
+	int i,k,p;
+	double inv;
+	if(unlikely(B==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_solve_matrix_inplace, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!L.initialized || !B->initialized)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_solve_matrix_inplace, matrix uninitialized\n");
+		return -1;
+	}
+	if(unlikely(L.rows!=L.cols || L.cols!=B->rows)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_solve_matrix_inplace, dimension mismatch\n");
+		return -1;
+	}
+	// same as rc_algebra_cholesky_solve with whole rows of B for each element
+	p = B->cols;
+	for(i=0;i<L.rows;i++){
+		for(k=0;k<i;k++) __vectorized_axpy(-L.d[i][k],B->d[k],B->d[i],p);
+		inv = 1.0/L.d[i][i];
+		for(k=0;k<p;k++) B->d[i][k] *= inv;
+	}
+	for(i=L.rows-1;i>=0;i--){
+		inv = 1.0/L.d[i][i];
+		for(k=0;k<p;k++) B->d[i][k] *= inv;
+		for(k=0;k<i;k++) __vectorized_axpy(-L.d[i][k],B->d[i],B->d[k],p);
+	}
+	return 0;
+}
+
+
+/**
+ * rank one update (sign 1) or downdate (sign -1) of Cholesky factor L with
+ * w, which is used as scratch space
+ */
+static void __cholesky_rank1(rc_matrix_t* L, double* w, double sign)
+{
+	int i,k;
+	double r,c,s,lkk;
+	for(k=0;k<L->rows;k++){
+		lkk = L->d[k][k];
+		r = sqrt(lkk*lkk + sign*w[k]*w[k]);
+		c = r/lkk;
+		s = w[k]/lkk;
+		L->d[k][k] = r;
+		for(i=k+1;i<L->rows;i++){
+			L->d[i][k] = (L->d[i][k] + sign*s*w[i])/c;
+			w[i] = c*w[i] - s*L->d[i][k];
+		}
+	}
+}
+
+
+static int __cholesky_rank1_check(rc_matrix_t* L, rc_vector_t x, const char* fn)
+{
+	if(unlikely(L==NULL)){
+		fprintf(stderr,"ERROR in %s, received NULL pointer\n",fn);
+		return -1;
+	}
+	if(unlikely(!L->initialized || !x.initialized)){
+		fprintf(stderr,"ERROR in %s, matrix or vector uninitialized\n",fn);
+		return -1;
+	}
+	if(unlikely(L->rows!=L->cols || L->cols!=x.len)){
+		fprintf(stderr,"ERROR in %s, dimension mismatch\n",fn);
+		return -1;
+	}
+	return 0;
+}
+
+
+int rc_algebra_cholesky_update(rc_matrix_t* L, rc_vector_t x)
+{
+	double* w;
+	if(unlikely(__cholesky_rank1_check(L,x,"rc_algebra_cholesky_update"))) return -1;
+	// work on a copy so x is left alone
+	w = alloca(x.len*sizeof(double));
+	if(unlikely(w==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_update, alloca failed, stack overflow\n");
+		return -1;
+	}
+	memcpy(w,x.d,x.len*sizeof(double));
+	__cholesky_rank1(L,w,1.0);
+	return 0;
+}
+
+
+int rc_algebra_cholesky_downdate(rc_matrix_t* L, rc_vector_t x)
+{
+	int i;
+	double* w;
+	if(unlikely(__cholesky_rank1_check(L,x,"rc_algebra_cholesky_downdate"))) return -1;
+	w = alloca(x.len*sizeof(double));
+	if(unlikely(w==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_downdate, alloca failed, stack overflow\n");
+		return -1;
+	}
+	// L*L'-x*x' is positive definite exactly when p=L\x has |p|<1, check that
+	// before touching L
+	for(i=0;i<x.len;i++){
+		w[i] = (x.d[i]-__vectorized_mult_accumulate(L->d[i],w,i))/L->d[i][i];
+	}
+	if(unlikely(1.0-__vectorized_square_accumulate(w,x.len)<zero_tolerance)){
+		fprintf(stderr,"ERROR in rc_algebra_cholesky_downdate, result would not be positive definite\n");
+		return -1;
+	}
+	memcpy(w,x.d,x.len*sizeof(double));
+	__cholesky_rank1(L,w,-1.0);
+	return 0;
+}
+
+
+int rc_algebra_forward_substitute(rc_matrix_t L, rc_vector_t b, rc_vector_t* x)
+{
+	int i;
+	if(unlikely(__tri_solve_setup(L,b,x,"rc_algebra_forward_substitute"))) return -1;
+	for(i=0;i<L.rows;i++){
+		if(unlikely(fabs(L.d[i][i])<zero_tolerance)){
+			fprintf(stderr,"ERROR in rc_algebra_forward_substitute, zero on the diagonal\n");
+			return -1;
+		}
+	}
+	for(i=0;i<L.rows;i++){
+		x->d[i] = (x->d[i]-__vectorized_mult_accumulate(L.d[i],x->d,i))/L.d[i][i];
+	}
+	return 0;
+}
+
+
+int rc_algebra_backward_substitute(rc_matrix_t U, rc_vector_t b, rc_vector_t* x)
+{
+	int i,n;
+	if(unlikely(__tri_solve_setup(U,b,x,"rc_algebra_backward_substitute"))) return -1;
+	n = U.rows;
+	for(i=0;i<n;i++){
+		if(unlikely(fabs(U.d[i][i])<zero_tolerance)){
+			fprintf(stderr,"ERROR in rc_algebra_backward_substitute, zero on the diagonal\n");
+			return -1;
+		}
+	}
+	for(i=n-1;i>=0;i--){
+		x->d[i] -= __vectorized_mult_accumulate(U.d[i]+i+1,x->d+i+1,n-i-1);
+		x->d[i] /= U.d[i][i];
+	}
+	return 0;
+}
+
+
+int rc_algebra_ldl_decomp(rc_matrix_t A, rc_matrix_t* L, rc_vector_t* D)
+{
+	int i,j,n;
+	double* v;
+	if(unlikely(!A.initialized)){
+		fprintf(stderr,"ERROR in rc_algebra_ldl_decomp, matrix uninitialized\n");
+		return -1;
+	}
+	if(unlikely(L==NULL || D==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_ldl_decomp, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(A.rows!=A.cols)){
+		fprintf(stderr,"ERROR in rc_algebra_ldl_decomp, matrix is not square\n");
+		return -1;
+	}
+	n = A.rows;
+	if(unlikely(rc_matrix_alloc(L,n,n) || rc_vector_alloc(D,n))){
+		fprintf(stderr,"ERROR in rc_algebra_ldl_decomp, failed to allocate memory\n");
+		return -1;
+	}
+	// v holds row i of L times D so the inner sums are plain dot products
+	v = alloca(n*sizeof(double));
+	if(unlikely(v==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_ldl_decomp, alloca failed, stack overflow\n");
+		return -1;
+	}
+	for(i=0;i<n;i++){
+		for(j=0;j<i;j++){
+			L->d[i][j] = (A.d[i][j]-__vectorized_mult_accumulate(v,L->d[j],j))/D->d[j];
+			v[j] = L->d[i][j]*D->d[j];
+		}
+		D->d[i] = A.d[i][i]-__vectorized_mult_accumulate(L->d[i],v,i);
+		if(unlikely(fabs(D->d[i])<zero_tolerance)){
+			fprintf(stderr,"ERROR in rc_algebra_ldl_decomp, zero pivot, matrix is singular\n");
+			return -1;
+		}
+		L->d[i][i] = 1.0;
+		for(j=i+1;j<n;j++) L->d[i][j] = 0.0;
+	}
+	return 0;
+}
+
+
+int rc_algebra_ldl_solve(rc_matrix_t L, rc_vector_t D, rc_vector_t b, rc_vector_t* x)
+{
+	int i,n;
+	if(unlikely(__tri_solve_setup(L,b,x,"rc_algebra_ldl_solve"))) return -1;
+	if(unlikely(!D.initialized || D.len!=b.len)){
+		fprintf(stderr,"ERROR in rc_algebra_ldl_solve, D uninitialized or wrong length\n");
+		return -1;
+	}
+	n = L.rows;
+	// L*z=b, D*y=z, L'*x=y with the unit diagonal of L left implicit
+	for(i=0;i<n;i++) x->d[i] -= __vectorized_mult_accumulate(L.d[i],x->d,i);
+	for(i=0;i<n;i++) x->d[i] /= D.d[i];
+	for(i=n-1;i>=0;i--) __vectorized_axpy(-x->d[i],L.d[i],x->d,i);
+	return 0;
+}
+
+
+int rc_algebra_tridiag_solve(rc_vector_t sub, rc_vector_t diag, rc_vector_t sup, rc_vector_t b, rc_vector_t* x)
+{
+	int i,n;
+	double m;
+	rc_vector_t c = RC_VECTOR_INITIALIZER;
+	if(unlikely(!sub.initialized || !diag.initialized || !sup.initialized || !b.initialized)){
+		fprintf(stderr,"ERROR in rc_algebra_tridiag_solve, vector uninitialized\n");
+		return -1;
+	}
+	if(unlikely(x==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_tridiag_solve, received NULL pointer\n");
+		return -1;
+	}
+	n = diag.len;
+	if(unlikely(b.len!=n || sub.len!=n-1 || sup.len!=n-1)){
+		fprintf(stderr,"ERROR in rc_algebra_tridiag_solve, dimension mismatch\n");
+		return -1;
+	}
+	if(unlikely(rc_vector_alloc(x,n))){
+		fprintf(stderr,"ERROR in rc_algebra_tridiag_solve, failed to alloc vector\n");
+		return -1;
+	}
+	if(x->d!=b.d) memcpy(x->d,b.d,n*sizeof(double));
+	// c holds the superdiagonal after elimination, the diagonal becomes 1
+	if(unlikely(rc_vector_alloc(&c,n))){
+		fprintf(stderr,"ERROR in rc_algebra_tridiag_solve, failed to allocate memory\n");
+		return -1;
+	}
+	for(i=0;i<n;i++){
+		m = diag.d[i];
+		if(i>0){
+			m -= sub.d[i-1]*c.d[i-1];
+			x->d[i] -= sub.d[i-1]*x->d[i-1];
+		}
+		if(unlikely(fabs(m)<zero_tolerance)){
+			fprintf(stderr,"ERROR in rc_algebra_tridiag_solve, zero pivot\n");
+			rc_vector_free(&c);
+			return -1;
+		}
+		if(i<n-1) c.d[i] = sup.d[i]/m;
+		x->d[i] /= m;
+	}
+	for(i=n-2;i>=0;i--) x->d[i] -= c.d[i]*x->d[i+1];
+	rc_vector_free(&c);
+	return 0;
+}
+
+
+int rc_algebra_band_solve(rc_matrix_t Ab, int kl, int ku, rc_vector_t b, rc_vector_t* x)
+{
+	int i,j,k,n,w,p,last;
+	double m,tmp;
+	rc_matrix_t W = RC_MATRIX_INITIALIZER;
+	if(unlikely(!Ab.initialized || !b.initialized)){
+		fprintf(stderr,"ERROR in rc_algebra_band_solve, matrix or vector uninitialized\n");
+		return -1;
+	}
+	if(unlikely(x==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_band_solve, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(kl<0 || ku<0 || Ab.cols!=kl+ku+1 || Ab.rows!=b.len)){
+		fprintf(stderr,"ERROR in rc_algebra_band_solve, dimension mismatch\n");
+		return -1;
+	}
+	n = b.len;
+	// row swaps can fill in up to kl more superdiagonals, row i of W holds
+	// columns i-kl to i+ku+kl of A at W.d[i][j-i+kl]
+	w = 2*kl+ku+1;
+	if(unlikely(rc_matrix_zeros(&W,n,w))){
+		fprintf(stderr,"ERROR in rc_algebra_band_solve, failed to allocate memory\n");
+		return -1;
+	}
+	for(i=0;i<n;i++){
+		for(j=(i<kl?kl-i:0);j<=kl+ku && i+j-kl<n;j++) W.d[i][j] = Ab.d[i][j];
+	}
+	if(unlikely(rc_vector_alloc(x,n))){
+		fprintf(stderr,"ERROR in rc_algebra_band_solve, failed to alloc vector\n");
+		rc_matrix_free(&W);
+		return -1;
+	}
+	if(x->d!=b.d) memcpy(x->d,b.d,n*sizeof(double));
+
+	for(k=0;k<n;k++){
+		last = (k+kl<n) ? k+kl : n-1;	// last row with an entry in column k
+		// largest entry in column k on or below the diagonal
+		p = k;
+		for(i=k+1;i<=last;i++){
+			if(fabs(W.d[i][k-i+kl])>fabs(W.d[p][k-p+kl])) p = i;
+		}
+		if(unlikely(fabs(W.d[p][k-p+kl])<zero_tolerance)){
+			fprintf(stderr,"ERROR in rc_algebra_band_solve, matrix is singular\n");
+			rc_matrix_free(&W);
+			return -1;
+		}
+		// swap rows k and p over columns k to k+kl+ku, which is as far as
+		// either of them can reach
+		if(p!=k){
+			for(j=k;j<=k+kl+ku && j<n;j++){
+				tmp = W.d[k][j-k+kl];
+				W.d[k][j-k+kl] = W.d[p][j-p+kl];
+				W.d[p][j-p+kl] = tmp;
+			}
+			tmp = x->d[k];
+			x->d[k] = x->d[p];
+			x->d[p] = tmp;
+		}
+		for(i=k+1;i<=last;i++){
+			m = W.d[i][k-i+kl]/W.d[k][kl];
+			W.d[i][k-i+kl] = 0.0;
+			for(j=k+1;j<=k+kl+ku && j<n;j++) W.d[i][j-i+kl] -= m*W.d[k][j-k+kl];
+			x->d[i] -= m*x->d[k];
+		}
+	}
+	// back substitution through the upper band
+	for(i=n-1;i>=0;i--){
+		for(j=i+1;j<=i+kl+ku && j<n;j++) x->d[i] -= W.d[i][j-i+kl]*x->d[j];
+		x->d[i] /= W.d[i][kl];
+	}
+	rc_matrix_free(&W);
+	return 0;
+}
+
+
 int rc_algebra_fit_ellipsoid(rc_matrix_t pts, rc_vector_t* ctr, rc_vector_t* lens)
 {
 	int i,p;
@@ -590,3 +1047,104 @@ int rc_algebra_fit_ellipsoid(rc_matrix_t pts, rc_vector_t* ctr, rc_vector_t* len
 	rc_vector_free(&f);
 	return 0;
 }
+
+
+int rc_algebra_ellipsoid_fit_reset(rc_ellipsoid_fit_t* e)
+{
+	double decay;
+	rc_ellipsoid_fit_t new = RC_ELLIPSOID_FIT_INITIALIZER;
+	if(unlikely(e==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_ellipsoid_fit_reset, received NULL pointer\n");
+		return -1;
+	}
+	decay = e->decay;
+	*e = new;
+	e->decay = decay;
+	return 0;
+}
+
+
+int rc_algebra_ellipsoid_fit_add(rc_ellipsoid_fit_t* e, const double p[3])
+{
+	int i, j;
+	double r[6];
+	if(unlikely(e==NULL || p==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_ellipsoid_fit_add, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(e->decay<=0.0 || e->decay>1.0)){
+		fprintf(stderr,"ERROR in rc_algebra_ellipsoid_fit_add, decay must be >0 and <=1\n");
+		return -1;
+	}
+	// same row rc_algebra_fit_ellipsoid puts in its A matrix, with b=1
+	r[0] = p[0]*p[0];
+	r[1] = p[0];
+	r[2] = p[1]*p[1];
+	r[3] = p[1];
+	r[4] = p[2]*p[2];
+	r[5] = p[2];
+	if(e->decay<1.0){
+		for(i=0;i<6;i++){
+			for(j=i;j<6;j++) e->ata.d[i][j] *= e->decay;
+			e->atb[i] *= e->decay;
+		}
+		e->weight *= e->decay;
+	}
+	for(i=0;i<6;i++){
+		for(j=i;j<6;j++) e->ata.d[i][j] += r[i]*r[j];
+		e->atb[i] += r[i];
+	}
+	e->weight += 1.0;
+	e->points++;
+	return 0;
+}
+
+
+int rc_algebra_ellipsoid_fit_solve(const rc_ellipsoid_fit_t* e, double center[3], double lengths[3], double* residual)
+{
+	int i, j;
+	double s[6], g[6], f[6], k, r2;
+	rc_mat6_t M, Minv;
+	if(unlikely(e==NULL || center==NULL || lengths==NULL)){
+		fprintf(stderr,"ERROR in rc_algebra_ellipsoid_fit_solve, received NULL pointer\n");
+		return -1;
+	}
+	if(e->points<6) return -1;
+	// The squared and linear columns differ in scale by the size of the data,
+	// which squares again in the normal equations. Scaling them to a unit
+	// diagonal first keeps the Cholesky solve well conditioned.
+	for(i=0;i<6;i++){
+		if(e->ata.d[i][i]<=0.0) return -1;
+		s[i] = 1.0/sqrt(e->ata.d[i][i]);
+	}
+	for(i=0;i<6;i++){
+		for(j=i;j<6;j++){
+			M.d[i][j] = e->ata.d[i][j]*s[i]*s[j];
+			M.d[j][i] = M.d[i][j];
+		}
+		g[i] = e->atb[i]*s[i];
+	}
+	if(rc_mat6_invert_spd(&M,&Minv)) return -1;
+	rc_mat6_times_vec(&Minv,g,f);
+	for(i=0;i<6;i++) f[i] *= s[i];
+	// every squared term must be positive for an ellipsoid
+	if(f[0]<=0.0 || f[2]<=0.0 || f[4]<=0.0) return -1;
+
+	// a*x^2+b*x = a*(x+b/2a)^2 - b^2/4a so the surface is
+	// sum a*(x-c)^2 = 1 + sum a*c^2, which gives the lengths directly
+	for(i=0;i<3;i++) center[i] = -f[2*i+1]/(2.0*f[2*i]);
+	k = 1.0;
+	for(i=0;i<3;i++) k += f[2*i]*center[i]*center[i];
+	for(i=0;i<3;i++) lengths[i] = sqrt(k/f[2*i]);
+
+	// |A*f-1|^2 = f'A'A*f - 2*f'A'1 + n from the sums alone
+	if(residual!=NULL){
+		r2 = e->weight;
+		for(i=0;i<6;i++){
+			r2 += e->ata.d[i][i]*f[i]*f[i] - 2.0*e->atb[i]*f[i];
+			for(j=i+1;j<6;j++) r2 += 2.0*e->ata.d[i][j]*f[i]*f[j];
+		}
+		*residual = (r2>0.0) ? sqrt(r2/e->weight) : 0.0;
+	}
+	return 0;
+}
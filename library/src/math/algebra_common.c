@@ -2,27 +2,416 @@
  * @file algebra_common.c
  *
  * see algebra_common.h
+ *
+ * The kernels here have two implementations chosen at build time. On 64-bit
+ * ARM they use NEON intrinsics on pairs of doubles. Everywhere else, including
+ * the 32-bit Cortex-A8 whose NEON unit has no double precision, they use plain
+ * C written with independent accumulators so the compiler can pipeline or
+ * vectorize it. The single precision kernels use NEON on any ARM with it,
+ * 32-bit included, four floats at a time. Define RC_ALGEBRA_NO_NEON to force
+ * the portable version of both.
  **/
 
+#include <string.h>	// for memset
+
 #include "algebra_common.h"
 
+#if defined(__ARM_NEON) && !defined(RC_ALGEBRA_NO_NEON)
+#include <arm_neon.h>
+#define ALGEBRA_NEON_F32 1
+#else
+#define ALGEBRA_NEON_F32 0
+#endif
+
+#if ALGEBRA_NEON_F32 && defined(__aarch64__)
+#define ALGEBRA_NEON 1
+#else
+#define ALGEBRA_NEON 0
+#endif
+
+// blocking of the matrix multiply, a KC x NC panel of B is 64KB and stays in
+// L2 while 4 rows of A and one 4 column strip of the panel stream through L1
+#define GEMM_MR		4
+#define GEMM_NR		4
+#define GEMM_KC		128
+#define GEMM_NC		64
+// products with every dimension below this skip packing
+#define GEMM_SMALL	16
+
+// stands in for missing rows of A at the bottom edge of C
+static const double gemm_zeros[GEMM_KC];
+static const float gemm_zeros_f[GEMM_KC];
+
+
 double __vectorized_mult_accumulate(double * __restrict__ a, double * __restrict__ b, int n)
 {
-	int i;
-	double sum = 0.0;
-	for(i=0;i<n;i++){
-		sum+=a[i]*b[i];
+	int i = 0;
+	double sum;
+#if ALGEBRA_NEON
+	float64x2_t s0 = vdupq_n_f64(0.0);
+	float64x2_t s1 = vdupq_n_f64(0.0);
+	for(;i+4<=n;i+=4){
+		s0 = vfmaq_f64(s0, vld1q_f64(a+i), vld1q_f64(b+i));
+		s1 = vfmaq_f64(s1, vld1q_f64(a+i+2), vld1q_f64(b+i+2));
+	}
+	sum = vaddvq_f64(vaddq_f64(s0, s1));
+#else
+	double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	for(;i+4<=n;i+=4){
+		s0 += a[i]*b[i];
+		s1 += a[i+1]*b[i+1];
+		s2 += a[i+2]*b[i+2];
+		s3 += a[i+3]*b[i+3];
 	}
+	sum = (s0+s1)+(s2+s3);
+#endif
+	for(;i<n;i++) sum+=a[i]*b[i];
 	return sum;
 }
 
 
 double __vectorized_square_accumulate(double * __restrict__ a, int n)
 {
-	int i;
-	double sum = 0.0;
-	for(i=0;i<n;i++){
-		sum+=a[i]*a[i];
+	int i = 0;
+	double sum;
+#if ALGEBRA_NEON
+	float64x2_t s0 = vdupq_n_f64(0.0);
+	float64x2_t s1 = vdupq_n_f64(0.0);
+	float64x2_t v0, v1;
+	for(;i+4<=n;i+=4){
+		v0 = vld1q_f64(a+i);
+		v1 = vld1q_f64(a+i+2);
+		s0 = vfmaq_f64(s0, v0, v0);
+		s1 = vfmaq_f64(s1, v1, v1);
+	}
+	sum = vaddvq_f64(vaddq_f64(s0, s1));
+#else
+	double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	for(;i+4<=n;i+=4){
+		s0 += a[i]*a[i];
+		s1 += a[i+1]*a[i+1];
+		s2 += a[i+2]*a[i+2];
+		s3 += a[i+3]*a[i+3];
 	}
+	sum = (s0+s1)+(s2+s3);
+#endif
+	for(;i<n;i++) sum+=a[i]*a[i];
 	return sum;
-}
\ No newline at end of file
+}
+
+
+void __vectorized_axpy(double a, const double * __restrict__ x, double * __restrict__ y, int n)
+{
+	int i = 0;
+#if ALGEBRA_NEON
+	for(;i+4<=n;i+=4){
+		vst1q_f64(y+i, vfmaq_n_f64(vld1q_f64(y+i), vld1q_f64(x+i), a));
+		vst1q_f64(y+i+2, vfmaq_n_f64(vld1q_f64(y+i+2), vld1q_f64(x+i+2), a));
+	}
+#else
+	for(;i+4<=n;i+=4){
+		y[i]   += a*x[i];
+		y[i+1] += a*x[i+1];
+		y[i+2] += a*x[i+2];
+		y[i+3] += a*x[i+3];
+	}
+#endif
+	for(;i<n;i++) y[i] += a*x[i];
+}
+
+
+/*
+ * acc = a*b for a 4 row strip of A and one packed 4 column strip of B over kc
+ * values. a holds pointers to the 4 rows, bp holds the strip as kc rows of 4.
+ */
+static void __gemm_kernel_4x4(int kc, const double* a[GEMM_MR], const double* bp,
+						double acc[GEMM_MR][GEMM_NR])
+{
+	int k;
+#if ALGEBRA_NEON
+	float64x2_t c00 = vdupq_n_f64(0.0), c01 = vdupq_n_f64(0.0);
+	float64x2_t c10 = vdupq_n_f64(0.0), c11 = vdupq_n_f64(0.0);
+	float64x2_t c20 = vdupq_n_f64(0.0), c21 = vdupq_n_f64(0.0);
+	float64x2_t c30 = vdupq_n_f64(0.0), c31 = vdupq_n_f64(0.0);
+	float64x2_t b0, b1;
+	for(k=0;k<kc;k++){
+		b0 = vld1q_f64(bp);
+		b1 = vld1q_f64(bp+2);
+		bp += GEMM_NR;
+		c00 = vfmaq_n_f64(c00, b0, a[0][k]);
+		c01 = vfmaq_n_f64(c01, b1, a[0][k]);
+		c10 = vfmaq_n_f64(c10, b0, a[1][k]);
+		c11 = vfmaq_n_f64(c11, b1, a[1][k]);
+		c20 = vfmaq_n_f64(c20, b0, a[2][k]);
+		c21 = vfmaq_n_f64(c21, b1, a[2][k]);
+		c30 = vfmaq_n_f64(c30, b0, a[3][k]);
+		c31 = vfmaq_n_f64(c31, b1, a[3][k]);
+	}
+	vst1q_f64(&acc[0][0], c00);
+	vst1q_f64(&acc[0][2], c01);
+	vst1q_f64(&acc[1][0], c10);
+	vst1q_f64(&acc[1][2], c11);
+	vst1q_f64(&acc[2][0], c20);
+	vst1q_f64(&acc[2][2], c21);
+	vst1q_f64(&acc[3][0], c30);
+	vst1q_f64(&acc[3][2], c31);
+#else
+	int r, c;
+	double t[GEMM_MR][GEMM_NR] = {{0.0}};
+	for(k=0;k<kc;k++){
+		for(r=0;r<GEMM_MR;r++){
+			for(c=0;c<GEMM_NR;c++) t[r][c] += a[r][k]*bp[c];
+		}
+		bp += GEMM_NR;
+	}
+	for(r=0;r<GEMM_MR;r++){
+		for(c=0;c<GEMM_NR;c++) acc[r][c] = t[r][c];
+	}
+#endif
+}
+
+
+static void __gemm_blocked(int m, int n, int p, double** A, double** B, double** C)
+{
+	int i, j, k, r, c, jj, kk, nc, kc, mr, nr;
+	const double* a[GEMM_MR];
+	double acc[GEMM_MR][GEMM_NR];
+	double* strip;
+	// one packed KC x NC panel of B, as NC/NR strips of kc rows of NR. At
+	// 64KB this is most of what the multiply needs from the caller's stack,
+	// rc_matrix_multiply documents it
+	double bp[GEMM_KC*GEMM_NC];
+
+	for(i=0;i<m;i++) memset(C[i], 0, p*sizeof(double));
+	for(jj=0;jj<p;jj+=GEMM_NC){
+		nc = (p-jj < GEMM_NC) ? p-jj : GEMM_NC;
+		for(kk=0;kk<n;kk+=GEMM_KC){
+			kc = (n-kk < GEMM_KC) ? n-kk : GEMM_KC;
+			// pack the panel, zero padding the last strip
+			for(j=0;j<nc;j+=GEMM_NR){
+				strip = bp + j*kc;
+				nr = (nc-j < GEMM_NR) ? nc-j : GEMM_NR;
+				for(k=0;k<kc;k++){
+					for(c=0;c<nr;c++) strip[k*GEMM_NR+c] = B[kk+k][jj+j+c];
+					for(;c<GEMM_NR;c++) strip[k*GEMM_NR+c] = 0.0;
+				}
+			}
+			// run every 4 row strip of A across the panel
+			for(i=0;i<m;i+=GEMM_MR){
+				mr = (m-i < GEMM_MR) ? m-i : GEMM_MR;
+				for(r=0;r<GEMM_MR;r++) a[r] = (r<mr) ? A[i+r]+kk : gemm_zeros;
+				for(j=0;j<nc;j+=GEMM_NR){
+					nr = (nc-j < GEMM_NR) ? nc-j : GEMM_NR;
+					__gemm_kernel_4x4(kc, a, bp + j*kc, acc);
+					for(r=0;r<mr;r++){
+						for(c=0;c<nr;c++) C[i+r][jj+j+c] += acc[r][c];
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void __vectorized_gemm(int m, int n, int p, double** A, double** B, double** C)
+{
+	int i, k;
+	if(m>=GEMM_SMALL || n>=GEMM_SMALL || p>=GEMM_SMALL){
+		__gemm_blocked(m, n, p, A, B, C);
+		return;
+	}
+	// small enough that everything is in L1 already, accumulate each row of C
+	// from rows of B which keeps all access contiguous
+	for(i=0;i<m;i++){
+		memset(C[i], 0, p*sizeof(double));
+		for(k=0;k<n;k++) __vectorized_axpy(A[i][k], B[k], C[i], p);
+	}
+}
+
+
+#if ALGEBRA_NEON_F32
+// acc + a*b, fused where the FPU has it
+static inline float32x4_t __mla_f32(float32x4_t acc, float32x4_t a, float32x4_t b)
+{
+#ifdef __aarch64__
+	return vfmaq_f32(acc, a, b);
+#else
+	return vmlaq_f32(acc, a, b);
+#endif
+}
+
+static inline float __hsum_f32(float32x4_t v)
+{
+	float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+	return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+#endif
+
+
+float __vectorized_mult_accumulate_f(float * __restrict__ a, float * __restrict__ b, int n)
+{
+	int i = 0;
+	float sum;
+#if ALGEBRA_NEON_F32
+	float32x4_t s0 = vdupq_n_f32(0.0f);
+	float32x4_t s1 = vdupq_n_f32(0.0f);
+	for(;i+8<=n;i+=8){
+		s0 = __mla_f32(s0, vld1q_f32(a+i), vld1q_f32(b+i));
+		s1 = __mla_f32(s1, vld1q_f32(a+i+4), vld1q_f32(b+i+4));
+	}
+	sum = __hsum_f32(vaddq_f32(s0, s1));
+#else
+	float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+	for(;i+4<=n;i+=4){
+		s0 += a[i]*b[i];
+		s1 += a[i+1]*b[i+1];
+		s2 += a[i+2]*b[i+2];
+		s3 += a[i+3]*b[i+3];
+	}
+	sum = (s0+s1)+(s2+s3);
+#endif
+	for(;i<n;i++) sum+=a[i]*b[i];
+	return sum;
+}
+
+
+float __vectorized_square_accumulate_f(float * __restrict__ a, int n)
+{
+	int i = 0;
+	float sum;
+#if ALGEBRA_NEON_F32
+	float32x4_t s0 = vdupq_n_f32(0.0f);
+	float32x4_t s1 = vdupq_n_f32(0.0f);
+	float32x4_t v0, v1;
+	for(;i+8<=n;i+=8){
+		v0 = vld1q_f32(a+i);
+		v1 = vld1q_f32(a+i+4);
+		s0 = __mla_f32(s0, v0, v0);
+		s1 = __mla_f32(s1, v1, v1);
+	}
+	sum = __hsum_f32(vaddq_f32(s0, s1));
+#else
+	float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+	for(;i+4<=n;i+=4){
+		s0 += a[i]*a[i];
+		s1 += a[i+1]*a[i+1];
+		s2 += a[i+2]*a[i+2];
+		s3 += a[i+3]*a[i+3];
+	}
+	sum = (s0+s1)+(s2+s3);
+#endif
+	for(;i<n;i++) sum+=a[i]*a[i];
+	return sum;
+}
+
+
+void __vectorized_axpy_f(float a, const float * __restrict__ x, float * __restrict__ y, int n)
+{
+	int i = 0;
+#if ALGEBRA_NEON_F32
+	float32x4_t va = vdupq_n_f32(a);
+	for(;i+8<=n;i+=8){
+		vst1q_f32(y+i, __mla_f32(vld1q_f32(y+i), vld1q_f32(x+i), va));
+		vst1q_f32(y+i+4, __mla_f32(vld1q_f32(y+i+4), vld1q_f32(x+i+4), va));
+	}
+#else
+	for(;i+4<=n;i+=4){
+		y[i]   += a*x[i];
+		y[i+1] += a*x[i+1];
+		y[i+2] += a*x[i+2];
+		y[i+3] += a*x[i+3];
+	}
+#endif
+	for(;i<n;i++) y[i] += a*x[i];
+}
+
+
+/*
+ * float version of __gemm_kernel_4x4, one row of the block fits a float32x4
+ */
+static void __gemm_kernel_4x4_f(int kc, const float* a[GEMM_MR], const float* bp,
+						float acc[GEMM_MR][GEMM_NR])
+{
+	int k;
+#if ALGEBRA_NEON_F32
+	float32x4_t c0 = vdupq_n_f32(0.0f), c1 = vdupq_n_f32(0.0f);
+	float32x4_t c2 = vdupq_n_f32(0.0f), c3 = vdupq_n_f32(0.0f);
+	float32x4_t b;
+	for(k=0;k<kc;k++){
+		b = vld1q_f32(bp);
+		bp += GEMM_NR;
+		c0 = __mla_f32(c0, b, vdupq_n_f32(a[0][k]));
+		c1 = __mla_f32(c1, b, vdupq_n_f32(a[1][k]));
+		c2 = __mla_f32(c2, b, vdupq_n_f32(a[2][k]));
+		c3 = __mla_f32(c3, b, vdupq_n_f32(a[3][k]));
+	}
+	vst1q_f32(acc[0], c0);
+	vst1q_f32(acc[1], c1);
+	vst1q_f32(acc[2], c2);
+	vst1q_f32(acc[3], c3);
+#else
+	int r, c;
+	float t[GEMM_MR][GEMM_NR] = {{0.0f}};
+	for(k=0;k<kc;k++){
+		for(r=0;r<GEMM_MR;r++){
+			for(c=0;c<GEMM_NR;c++) t[r][c] += a[r][k]*bp[c];
+		}
+		bp += GEMM_NR;
+	}
+	for(r=0;r<GEMM_MR;r++){
+		for(c=0;c<GEMM_NR;c++) acc[r][c] = t[r][c];
+	}
+#endif
+}
+
+
+// same blocking as __gemm_blocked, the float panel takes 32KB of stack
+static void __gemm_blocked_f(int m, int n, int p, float** A, float** B, float** C)
+{
+	int i, j, k, r, c, jj, kk, nc, kc, mr, nr;
+	const float* a[GEMM_MR];
+	float acc[GEMM_MR][GEMM_NR];
+	float* strip;
+	float bp[GEMM_KC*GEMM_NC];
+
+	for(i=0;i<m;i++) memset(C[i], 0, p*sizeof(float));
+	for(jj=0;jj<p;jj+=GEMM_NC){
+		nc = (p-jj < GEMM_NC) ? p-jj : GEMM_NC;
+		for(kk=0;kk<n;kk+=GEMM_KC){
+			kc = (n-kk < GEMM_KC) ? n-kk : GEMM_KC;
+			for(j=0;j<nc;j+=GEMM_NR){
+				strip = bp + j*kc;
+				nr = (nc-j < GEMM_NR) ? nc-j : GEMM_NR;
+				for(k=0;k<kc;k++){
+					for(c=0;c<nr;c++) strip[k*GEMM_NR+c] = B[kk+k][jj+j+c];
+					for(;c<GEMM_NR;c++) strip[k*GEMM_NR+c] = 0.0f;
+				}
+			}
+			for(i=0;i<m;i+=GEMM_MR){
+				mr = (m-i < GEMM_MR) ? m-i : GEMM_MR;
+				for(r=0;r<GEMM_MR;r++) a[r] = (r<mr) ? A[i+r]+kk : gemm_zeros_f;
+				for(j=0;j<nc;j+=GEMM_NR){
+					nr = (nc-j < GEMM_NR) ? nc-j : GEMM_NR;
+					__gemm_kernel_4x4_f(kc, a, bp + j*kc, acc);
+					for(r=0;r<mr;r++){
+						for(c=0;c<nr;c++) C[i+r][jj+j+c] += acc[r][c];
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void __vectorized_gemm_f(int m, int n, int p, float** A, float** B, float** C)
+{
+	int i, k;
+	if(m>=GEMM_SMALL || n>=GEMM_SMALL || p>=GEMM_SMALL){
+		__gemm_blocked_f(m, n, p, A, B, C);
+		return;
+	}
+	for(i=0;i<m;i++){
+		memset(C[i], 0, p*sizeof(float));
+		for(k=0;k<n;k++) __vectorized_axpy_f(A[i][k], B[k], C[i], p);
+	}
+}
@@ -7,6 +7,8 @@
 #ifndef RC_ALGEBRA_COMMON_H
 #define RC_ALGEBRA_COMMON_H
 
+#include <stddef.h>	// for size_t
+
 #ifndef unlikely
 #define unlikely(x)	__builtin_expect (!!(x), 0)
 #endif
@@ -35,4 +37,43 @@ double __vectorized_mult_accumulate(double * __restrict__ a, double * __restrict
  */
 double __vectorized_square_accumulate(double * __restrict__ a, int n);
 
+/*
+ * y += a*x over n values, the inner loop of row oriented elimination.
+ */
+void __vectorized_axpy(double a, const double * __restrict__ x, double * __restrict__ y, int n);
+
+/*
+ * C = A*B where A is m x n, B is n x p and all three are row pointer arrays
+ * like rc_matrix_t.d with contiguous rows. C must already be allocated and
+ * must not overlap A or B. Small products are done row by row with
+ * __vectorized_axpy, larger ones are tiled with B packed into cache sized
+ * panels and multiplied by a register blocked 4x4 kernel.
+ */
+void __vectorized_gemm(int m, int n, int p, double** A, double** B, double** C);
+
+/*
+ * Single precision versions of the kernels above for rc_vectorf_t and
+ * rc_matrixf_t. These use NEON on 32-bit ARM too since the Cortex-A8 NEON
+ * unit does single precision. The float multiply is tiled like the double one,
+ * with a float32x4 NEON body in the 4x4 kernel.
+ */
+float __vectorized_mult_accumulate_f(float * __restrict__ a, float * __restrict__ b, int n);
+float __vectorized_square_accumulate_f(float * __restrict__ a, int n);
+void __vectorized_axpy_f(float a, const float * __restrict__ x, float * __restrict__ y, int n);
+void __vectorized_gemm_f(int m, int n, int p, float** A, float** B, float** C);
+
+/*
+ * Memory for the contents of matrices and vectors. Comes from the workspace
+ * active on the calling thread if there is one and *borrowed is set to 1.
+ * Otherwise it comes from the heap, zeroed if zero is nonzero, *borrowed is set
+ * to 0 and the heap guard is notified. Defined in workspace.c.
+ */
+void* __rc_math_alloc(size_t bytes, int zero, int* borrowed);
+
+/*
+ * Returns heap memory from __rc_math_alloc, never call it on borrowed memory.
+ * Does nothing for NULL.
+ */
+void __rc_math_free(void* ptr);
+
 #endif // RC_ALGEBRA_COMMON_H
@@ -3,6 +3,9 @@
  * @brief      This is a collection of functions for generating and implementing
  *             discrete SISO filters for arbitrary transfer functions.
  *
+ *             Setting up and marching a filter is written once in
+ *             filter_impl.h and shared with the single precision rc_filterf_t.
+ *
  * @author     James Strawson
  * @date       2016
  */
@@ -17,6 +20,7 @@
 #include <rc/math/polynomial.h>
 
 #include "algebra_common.h"
+#include "precision.h"
 
 // local function
 static int __print_poly_z(rc_vector_t v)
@@ -37,231 +41,7 @@ static int __print_poly_z(rc_vector_t v)
 }
 
 
-rc_filter_t rc_filter_empty(void)
-{
-	rc_filter_t f = RC_FILTER_INITIALIZER;
-	return f;
-}
-
-int rc_filter_alloc(rc_filter_t* f, rc_vector_t num, rc_vector_t den, double dt)
-{
-	// sanity checks
-	if(unlikely(dt<=0.0)){
-		fprintf(stderr,"ERROR in rc_filter_alloc, dt must be >0\n");
-		return -1;
-	}
-	if(unlikely(!num.initialized||!den.initialized)){
-		fprintf(stderr,"ERROR in rc_filter_alloc, vector uninitialized\n");
-		return -1;
-	}
-	if(unlikely(num.len>den.len)){
-		fprintf(stderr,"ERROR in rc_filter_alloc, improper transfer function\n");
-		return -1;
-	}
-	if(unlikely(fabs(den.d[0]) < zero_tolerance)){
-		fprintf(stderr,"ERROR in rc_filter_alloc, first coefficient in denominator is 0\n");
-		return -1;
-	}
-	// free existing memory, this also zeros out all fields
-	rc_filter_free(f);
-	// move in vectors
-	if(unlikely(rc_vector_duplicate(num,&f->num))){
-		fprintf(stderr,"ERROR in rc_filter_alloc, failed to duplicate numerator\n");
-		return -1;
-	}
-	if(unlikely(rc_vector_duplicate(den,&f->den))){
-		fprintf(stderr,"ERROR in rc_filter_alloc, failed to duplicate denominator\n");
-		rc_vector_free(&f->num);
-		return -1;
-	}
-	// allocate buffers making sure they are at least 2 in length
-	int buflen = den.len;
-	if(buflen<2) buflen=2;
-	if(unlikely(rc_ringbuf_alloc(&f->in_buf,buflen))){
-		fprintf(stderr,"ERROR in rc_filter_alloc, failed to allocate ring buffer\n");
-		rc_vector_free(&f->num);
-		rc_vector_free(&f->den);
-		return -1;
-	}
-	if(unlikely(rc_ringbuf_alloc(&f->out_buf,buflen))){
-		fprintf(stderr,"ERROR in rc_filter_alloc, failed to allocate ring buffer\n");
-		rc_vector_free(&f->num);
-		rc_vector_free(&f->den);
-		rc_ringbuf_free(&f->in_buf);
-		return -1;
-	}
-	// populate remaining values, everything else zero'd by rc_filter_free
-	f->dt=dt;
-	f->order=den.len-1;
-	f->initialized=1;
-	return 0;
-}
-
-int rc_filter_alloc_from_arrays(rc_filter_t* f,double dt,double* num,int numlen,\
-							double* den,int denlen)
-{
-	// sanity checks
-	if(unlikely(numlen<1 || denlen<1)){
-		fprintf(stderr,"ERROR in rc_filter_alloc_from_arrays, numlen & denlen must be >=1\n");
-		return -1;
-	}
-	if(unlikely(numlen>denlen)){
-		fprintf(stderr,"ERROR in rc_filter_alloc_from_arrays, improper transfer function\n");
-		return -1;
-	}
-	if(unlikely(num==NULL || den==NULL || f==NULL)){
-		fprintf(stderr,"ERROR in rc_filter_alloc_from_arrays, received null pointer\n");
-		return -1;
-	}
-	if(unlikely(dt<0.0)){
-		fprintf(stderr,"ERROR in rc_filter_alloc_from_arrays, dt must be >0\n");
-		return -1;
-	}
-	if(unlikely(fabs(den[0]) < zero_tolerance)){
-		fprintf(stderr,"ERROR in rc_filter_alloc_from_arrays, first coefficient in denominator is 0\n");
-		return -1;
-	}
-	// free existing memory, this also zeros out all fields
-	rc_filter_free(f);
-	// copy numerator and denominators over
-	if(unlikely(rc_vector_from_array(&f->num,num,numlen))){
-		fprintf(stderr,"ERROR in rc_filter_alloc_from_arrays, failed to alloc vector\n");
-		return -1;
-	}
-	if(unlikely(rc_vector_from_array(&f->den,den,denlen))){
-		fprintf(stderr,"ERROR in rc_filter_alloc_from_arrays, failed to alloc vector\n");
-		rc_vector_free(&f->num);
-		return -1;
-	}
-	// allocate buffers
-	if(unlikely(rc_ringbuf_alloc(&f->in_buf,denlen))){
-		fprintf(stderr,"ERROR in rc_filter_alloc, failed to allocate ring buffer\n");
-		rc_vector_free(&f->num);
-		rc_vector_free(&f->den);
-		return -1;
-	}
-	if(unlikely(rc_ringbuf_alloc(&f->out_buf,denlen))){
-		fprintf(stderr,"ERROR in rc_filter_alloc, failed to allocate ring buffer\n");
-		rc_vector_free(&f->num);
-		rc_vector_free(&f->den);
-		rc_ringbuf_free(&f->in_buf);
-		return -1;
-	}
-	// populate remaining values, everything else zero'd by rc_filter_free
-	f->dt=dt;
-	f->order=denlen-1;
-	f->initialized=1;
-	return 0;
-}
-
-
-int rc_filter_duplicate(rc_filter_t* f, rc_filter_t old)
-{
-	if(unlikely(!old.initialized)){
-		fprintf(stderr, "ERROR in rc_filter_duplicate, old filter not initialized\n");
-		return -1;
-	}
-	if(rc_filter_alloc(f, old.num, old.den, old.dt)){
-		fprintf(stderr, "ERROR in rc_filter_duplicate, failed to alloc memory\n");
-		return -1;
-	}
-	f->gain		= old.gain;
-	f->sat_en	= old.sat_en;
-	f->sat_min	= old.sat_min;
-	f->sat_max	= old.sat_max;
-	f->ss_en	= old.ss_en;
-	f->ss_steps	= old.ss_steps;
-	return 0;
-}
-
-
-int rc_filter_free(rc_filter_t* f)
-{
-	rc_filter_t new = RC_FILTER_INITIALIZER;
-	if(unlikely(f==NULL)){
-		fprintf(stderr, "ERROR in rc_filter_free, received NULL pointer\n");
-		return -1;
-	}
-	rc_ringbuf_free(&f->in_buf);
-	rc_ringbuf_free(&f->out_buf);
-	rc_vector_free(&f->num);
-	rc_vector_free(&f->den);
-	*f = new;
-	return 0;
-}
-
-
-double rc_filter_march(rc_filter_t* f, double new_input)
-{
-	int i, rel_deg;
-	double tmp1 = 0.0;
-	double tmp2 = 0.0;
-	double new_out;
-	// sanity checks
-	if(unlikely(!f->initialized)){
-		printf("ERROR in rc_filter_march, filter uninitialized\n");
-		return -1.0;
-	}
-	// log new input
-	rc_ringbuf_insert(&f->in_buf, new_input);
-	f->newest_input = new_input;
-	// relative degree should never be negative as rc_filter_alloc checks
-	// for improper transfer functions
-	rel_deg = f->den.len - f->num.len;
-	// evaluate the difference equation
-	for(i=0; i<(f->num.len); i++){
-		tmp1+=f->num.d[i]*rc_ringbuf_get_value(&f->in_buf, i+rel_deg);
-	}
-	if(fabs(f->gain - 1.0) > zero_tolerance) tmp1=tmp1*f->gain;
-	for(i=0; i<(f->order); i++){
-		tmp2-=f->den.d[i+1]*rc_ringbuf_get_value(&f->out_buf, i);
-	}
-	new_out=tmp2+tmp1;
-	// scale in case denominator doesn't have a leading 1
-	if(fabs(f->den.d[0] - 1.0) > zero_tolerance) new_out /= f->den.d[0];
-	// soft start limits
-	if(f->ss_en && f->step<f->ss_steps){
-		double a=f->sat_max*(f->step/f->ss_steps);
-		double b=f->sat_min*(f->step/f->ss_steps);
-		if(new_out>a) new_out=a;
-		if(new_out<b) new_out=b;
-	}
-	// saturate and set flag
-	if(f->sat_en){
-		if(new_out>f->sat_max){
-			new_out=f->sat_max;
-			f->sat_flag=1;
-		}
-		else if(new_out<f->sat_min){
-			new_out=f->sat_min;
-			f->sat_flag=1;
-		}
-		else f->sat_flag=0;
-	}
-	// record the output to filter struct and ring buffer
-	f->newest_output = new_out;
-	rc_ringbuf_insert(&f->out_buf, new_out);
-	// increment steps
-	f->step++;
-	return new_out;
-}
-
-
-int rc_filter_reset(rc_filter_t* f)
-{
-	if(unlikely(!f->initialized)){
-		fprintf(stderr,"ERROR in rc_filter_reset, filter uninitialized\n");
-		return -1;
-	}
-	rc_ringbuf_reset(&f->in_buf);
-	rc_ringbuf_reset(&f->out_buf);
-	f->newest_input	= 0.0;
-	f->newest_output = 0.0;
-	f->sat_flag = 0;
-	f->step = 0;
-	return 0;
-}
-
+#include "filter_impl.h"
 
 
 int rc_filter_print(rc_filter_t f)
@@ -290,104 +70,6 @@ int rc_filter_print(rc_filter_t f)
 }
 
 
-int rc_filter_enable_saturation(rc_filter_t* f, double min, double max)
-{
-	if(unlikely(!f->initialized)){
-		fprintf(stderr, "ERROR in rc_filter_enable_saturation, filter uninitialized\n");
-		return -1;
-	}
-	if(unlikely(min>max)){
-		fprintf(stderr, "ERORR in rc_filter_enable_saturation, max must be >= min\n");
-		return -1;
-	}
-	f->sat_en	= 1;
-	f->sat_min	= min;
-	f->sat_max	= max;
-	return 0;
-}
-
-
-int rc_filter_get_saturation_flag(rc_filter_t* f)
-{
-	if(unlikely(!f->initialized)){
-		fprintf(stderr,"ERROR in rc_filter_get_saturation_flag, filter uninitialized\n");
-		return -1;
-	}
-	return f->sat_flag;
-}
-
-
-int rc_filter_enable_soft_start(rc_filter_t* f, double seconds)
-{
-	if(unlikely(!f->initialized)){
-		fprintf(stderr,"ERROR in rc_filter_enable_soft_start, filter uninitialized\n");
-		return -1;
-	}
-	if(unlikely(seconds<=0.0)){
-		fprintf(stderr,"ERROR in rc_filter_enable_soft_start, seconds must be >=0\n");
-		return -1;
-	}
-	if(unlikely(!f->sat_en)){
-		fprintf(stderr,"ERROR in rc_filter_enable_soft_start, saturation must be enabled first\n");
-		return -1;
-	}
-	f->ss_en	= 1;
-	f->ss_steps	= seconds/f->dt;
-	return 0;
-}
-
-
-double rc_filter_previous_input(rc_filter_t* f, int steps)
-{
-	if(unlikely(!f->initialized)){
-		fprintf(stderr,"ERROR in rc_filter_previous_input, filter uninitialized\n");
-		return -1.0;
-	}
-	return rc_ringbuf_get_value(&f->in_buf, steps);
-}
-
-
-double rc_filter_previous_output(rc_filter_t* f, int steps)
-{
-	if(unlikely(!f->initialized)){
-		fprintf(stderr,"ERROR in rc_filter_previous_output, filter uninitialized\n");
-		return -1.0;
-	}
-	return rc_ringbuf_get_value(&f->out_buf, steps);
-}
-
-
-
-int rc_filter_prefill_inputs(rc_filter_t* f, double in)
-{
-	int i;
-	if(unlikely(!f->initialized)){
-		fprintf(stderr,"ERROR in rc_filter_prefill_inputs, filter uninitialized\n");
-		return -1;
-	}
-	for(i=0;i<=f->order;i++){
-		rc_ringbuf_insert(&f->in_buf, in);
-	}
-	f->newest_input = in;
-	return 0;
-}
-
-
-int rc_filter_prefill_outputs(rc_filter_t* f, double out)
-{
-	int i;
-	if(unlikely(!f->initialized)){
-		fprintf(stderr,"ERROR in rc_filter_prefill_outputs, filter uninitialized\n");
-		return -1;
-	}
-	for(i=0;i<=f->order;i++){
-		rc_ringbuf_insert(&(f->out_buf), out);
-	}
-	f->newest_output = out;
-	return 0;
-}
-
-
 int rc_filter_multiply(rc_filter_t f1, rc_filter_t f2, rc_filter_t* f3)
 {
 	rc_vector_t newnum = RC_VECTOR_INITIALIZER;
@@ -0,0 +1,303 @@
+/**
+ * @file math/filter_bank.c
+ *
+ * @brief      Banks of SISO filters in structure of arrays form, see
+ *             <rc/math/filter_bank.h>.
+ *
+ * The history of every channel moves together, so one head index serves the
+ * whole bank and the ring position of each row is worked out once per row
+ * rather than once per channel. Saturation and soft start are branch free
+ * with disabled limits set to +-DBL_MAX, which keeps the channel loops
+ * vectorizable. Infinity can't be used for that as the math library is
+ * built with -ffast-math.
+ */
+
+#include <stdio.h>
+#include <string.h>	// for memset
+#include <float.h>	// for DBL_MAX
+#include <math.h>	// for fabs, fmin, fmax
+
+#include <rc/math/filter_bank.h>
+#include "algebra_common.h"
+
+
+rc_filter_bank_t rc_filter_bank_empty(void)
+{
+	rc_filter_bank_t out = RC_FILTER_BANK_INITIALIZER;
+	return out;
+}
+
+
+int rc_filter_bank_alloc(rc_filter_bank_t* bank, int channels, int order, double dt)
+{
+	int i, stride, rows;
+	size_t doubles, bytes;
+	double* d;
+
+	// sanity checks
+	if(unlikely(bank==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_bank_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(channels<1 || order<0)){
+		fprintf(stderr,"ERROR in rc_filter_bank_alloc, need channels>=1 and order>=0\n");
+		return -1;
+	}
+	if(unlikely(dt<=0.0)){
+		fprintf(stderr,"ERROR in rc_filter_bank_alloc, dt must be >0\n");
+		return -1;
+	}
+	// free existing memory, this also zeros out all fields
+	rc_filter_bank_free(bank);
+
+	// even stride keeps every row 16 byte aligned for pairs of doubles
+	stride = (channels+1) & ~1;
+	rows = order+1;
+	// num, den, in and out have a row per order, gain, sat_min, sat_max and
+	// ss_steps have one, sat_flag comes after all the doubles
+	doubles = (size_t)(4*rows+4)*stride;
+	bytes = doubles*sizeof(double) + stride*sizeof(int);
+	bank->mem = __rc_math_alloc(bytes, 1, &bank->borrowed);
+	if(unlikely(bank->mem==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_bank_alloc, failed to allocate memory\n");
+		return -1;
+	}
+	memset(bank->mem, 0, bytes);
+	d = (double*)bank->mem;
+	bank->num	= d;	d += rows*stride;
+	bank->den	= d;	d += rows*stride;
+	bank->in	= d;	d += rows*stride;
+	bank->out	= d;	d += rows*stride;
+	bank->gain	= d;	d += stride;
+	bank->sat_min	= d;	d += stride;
+	bank->sat_max	= d;	d += stride;
+	bank->ss_steps	= d;	d += stride;
+	bank->sat_flag	= (int*)d;
+
+	// every channel starts as a pass-through with no limits
+	for(i=0;i<stride;i++){
+		if(i<channels){
+			bank->num[i] = 1.0;
+			bank->gain[i] = 1.0;
+		}
+		bank->sat_min[i] = -DBL_MAX;
+		bank->sat_max[i] = DBL_MAX;
+	}
+	bank->channels = channels;
+	bank->order = order;
+	bank->stride = stride;
+	bank->dt = dt;
+	bank->initialized = 1;
+	return 0;
+}
+
+
+int rc_filter_bank_free(rc_filter_bank_t* bank)
+{
+	rc_filter_bank_t new = RC_FILTER_BANK_INITIALIZER;
+	if(unlikely(bank==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_bank_free, received NULL pointer\n");
+		return -1;
+	}
+	if(bank->mem!=NULL && !bank->borrowed) __rc_math_free(bank->mem);
+	*bank = new;
+	return 0;
+}
+
+
+int rc_filter_bank_set_channel(rc_filter_bank_t* bank, int ch, rc_filter_t f)
+{
+	int k, rel_deg, s;
+	double den0;
+
+	// sanity checks
+	if(unlikely(bank==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_bank_set_channel, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!bank->initialized || !f.initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_set_channel, bank or filter uninitialized\n");
+		return -1;
+	}
+	if(unlikely(ch<0 || ch>=bank->channels)){
+		fprintf(stderr,"ERROR in rc_filter_bank_set_channel, channel out of range\n");
+		return -1;
+	}
+	if(unlikely(f.order>bank->order)){
+		fprintf(stderr,"ERROR in rc_filter_bank_set_channel, filter order %d exceeds bank order %d\n",
+			f.order, bank->order);
+		return -1;
+	}
+	if(unlikely(fabs(f.dt-bank->dt)>zero_tolerance)){
+		fprintf(stderr,"ERROR in rc_filter_bank_set_channel, filter dt does not match bank\n");
+		return -1;
+	}
+
+	// normalize so den[0] is 1, numerator aligned the same way rc_filter_march
+	// aligns it against the input history, zeros pad up to the bank's order
+	s = bank->stride;
+	den0 = f.den.d[0];
+	rel_deg = f.den.len - f.num.len;
+	for(k=0;k<=bank->order;k++){
+		bank->num[k*s+ch] = 0.0;
+		bank->den[k*s+ch] = 0.0;
+	}
+	for(k=0;k<f.num.len;k++) bank->num[(k+rel_deg)*s+ch] = f.num.d[k]/den0;
+	for(k=1;k<=f.order;k++) bank->den[k*s+ch] = f.den.d[k]/den0;
+
+	bank->gain[ch] = f.gain;
+	bank->sat_min[ch] = f.sat_en ? f.sat_min : -DBL_MAX;
+	bank->sat_max[ch] = f.sat_en ? f.sat_max : DBL_MAX;
+	bank->ss_steps[ch] = f.ss_en ? f.ss_steps : 0.0;
+	bank->sat_flag[ch] = 0;
+	return 0;
+}
+
+
+int rc_filter_bank_enable_saturation(rc_filter_bank_t* bank, int ch, double min, double max)
+{
+	if(unlikely(bank==NULL || !bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_saturation, bank uninitialized\n");
+		return -1;
+	}
+	if(unlikely(ch<0 || ch>=bank->channels)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_saturation, channel out of range\n");
+		return -1;
+	}
+	if(unlikely(min>max)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_saturation, max must be >= min\n");
+		return -1;
+	}
+	bank->sat_min[ch] = min;
+	bank->sat_max[ch] = max;
+	return 0;
+}
+
+
+int rc_filter_bank_enable_soft_start(rc_filter_bank_t* bank, int ch, double seconds)
+{
+	if(unlikely(bank==NULL || !bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_soft_start, bank uninitialized\n");
+		return -1;
+	}
+	if(unlikely(ch<0 || ch>=bank->channels)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_soft_start, channel out of range\n");
+		return -1;
+	}
+	if(unlikely(seconds<=0.0)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_soft_start, seconds must be >0\n");
+		return -1;
+	}
+	if(unlikely(bank->sat_max[ch]>=DBL_MAX && bank->sat_min[ch]<=-DBL_MAX)){
+		fprintf(stderr,"ERROR in rc_filter_bank_enable_soft_start, saturation must be enabled first\n");
+		return -1;
+	}
+	bank->ss_steps[ch] = seconds/bank->dt;
+	return 0;
+}
+
+
+int rc_filter_bank_march(rc_filter_bank_t* bank, const double* in, double* out)
+{
+	int i, k, s, rows, head, row;
+	double step, scale, lo, hi, y;
+	double* __restrict__ o;
+	const double* __restrict__ c;
+	const double* __restrict__ h;
+
+	if(unlikely(bank==NULL || in==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_filter_bank_march, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_march, bank uninitialized\n");
+		return -1;
+	}
+	s = bank->stride;
+	rows = bank->order+1;
+	head = bank->head+1;
+	if(head==rows) head = 0;
+
+	// log new input, in and out may be the same array
+	memcpy(bank->in+head*s, in, bank->channels*sizeof(double));
+
+	// numerator over the inputs into the newest output row, which still
+	// holds the oldest output that is no longer needed
+	o = bank->out + head*s;
+	c = bank->num;
+	h = bank->in + head*s;
+	for(i=0;i<s;i++) o[i] = c[i]*h[i];
+	for(k=1;k<rows;k++){
+		row = head-k;
+		if(row<0) row += rows;
+		c = bank->num + k*s;
+		h = bank->in + row*s;
+		for(i=0;i<s;i++) o[i] += c[i]*h[i];
+	}
+	for(i=0;i<s;i++) o[i] *= bank->gain[i];
+	// denominator over past outputs
+	for(k=1;k<rows;k++){
+		row = head-k;
+		if(row<0) row += rows;
+		c = bank->den + k*s;
+		h = bank->out + row*s;
+		for(i=0;i<s;i++) o[i] -= c[i]*h[i];
+	}
+
+	// soft start then saturation, same order as rc_filter_march. Once soft
+	// start is over its limits open up completely so the saturation flag
+	// still sees outputs past the saturation limits.
+	step = (double)bank->step;
+	for(i=0;i<s;i++){
+		if(step<bank->ss_steps[i]){
+			scale = step/bank->ss_steps[i];
+			lo = bank->sat_min[i]*scale;
+			hi = bank->sat_max[i]*scale;
+		}
+		else{
+			lo = -DBL_MAX;
+			hi = DBL_MAX;
+		}
+		y = fmax(fmin(o[i], hi), lo);
+		bank->sat_flag[i] = (y>bank->sat_max[i]) | (y<bank->sat_min[i]);
+		y = fmin(y, bank->sat_max[i]);
+		o[i] = fmax(y, bank->sat_min[i]);
+	}
+
+	memcpy(out, o, bank->channels*sizeof(double));
+	bank->head = head;
+	bank->step++;
+	return 0;
+}
+
+
+int rc_filter_bank_reset(rc_filter_bank_t* bank)
+{
+	int i;
+	size_t bytes;
+	if(unlikely(bank==NULL || !bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_reset, bank uninitialized\n");
+		return -1;
+	}
+	bytes = (size_t)(bank->order+1)*bank->stride*sizeof(double);
+	memset(bank->in, 0, bytes);
+	memset(bank->out, 0, bytes);
+	for(i=0;i<bank->stride;i++) bank->sat_flag[i] = 0;
+	bank->head = 0;
+	bank->step = 0;
+	return 0;
+}
+
+
+int rc_filter_bank_get_saturation_flag(rc_filter_bank_t* bank, int ch)
+{
+	if(unlikely(bank==NULL || !bank->initialized)){
+		fprintf(stderr,"ERROR in rc_filter_bank_get_saturation_flag, bank uninitialized\n");
+		return -1;
+	}
+	if(unlikely(ch<0 || ch>=bank->channels)){
+		fprintf(stderr,"ERROR in rc_filter_bank_get_saturation_flag, channel out of range\n");
+		return -1;
+	}
+	return bank->sat_flag[ch];
+}
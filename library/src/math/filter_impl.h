@@ -0,0 +1,346 @@
+/**
+ * @file math/filter_impl.h
+ *
+ * Body of the functions that set up and run a filter, included once by
+ * filter.c for rc_filter_t and once by single_precision.c for rc_filterf_t.
+ * The designs that only build coefficients stay in filter.c, a filter designed
+ * in double precision is converted with rc_filterf_from_filter. See
+ * precision.h for the names and types this expects. The input and output
+ * histories are used through RC_HIST_FN which must provide alloc, free,
+ * reset, insert, get_window and get_value like rc_ringbuf_t.
+ */
+
+#ifndef RC_REAL
+#error "include precision.h before filter_impl.h"
+#endif
+
+
+RC_FILT_T RC_FILT_FN(empty)(void)
+{
+	RC_FILT_T f = RC_FILT_INIT;
+	return f;
+}
+
+int RC_FILT_FN(alloc)(RC_FILT_T* f, RC_VEC_T num, RC_VEC_T den, RC_REAL dt)
+{
+	// sanity checks
+	if(unlikely(dt<=RC_R(0.0))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, dt must be >0\n");
+		return -1;
+	}
+	if(unlikely(!num.initialized||!den.initialized)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, vector uninitialized\n");
+		return -1;
+	}
+	if(unlikely(num.len>den.len)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, improper transfer function\n");
+		return -1;
+	}
+	if(unlikely(RC_FABS(den.d[0]) < RC_ZERO_TOL)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, first coefficient in denominator is 0\n");
+		return -1;
+	}
+	// free existing memory, this also zeros out all fields
+	RC_FILT_FN(free)(f);
+	// move in vectors
+	if(unlikely(RC_VEC_FN(duplicate)(num,&f->num))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, failed to duplicate numerator\n");
+		return -1;
+	}
+	if(unlikely(RC_VEC_FN(duplicate)(den,&f->den))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, failed to duplicate denominator\n");
+		RC_VEC_FN(free)(&f->num);
+		return -1;
+	}
+	// allocate buffers making sure they are at least 2 in length
+	int buflen = den.len;
+	if(buflen<2) buflen=2;
+	if(unlikely(RC_HIST_FN(alloc)(&f->in_buf,buflen))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, failed to allocate history\n");
+		RC_VEC_FN(free)(&f->num);
+		RC_VEC_FN(free)(&f->den);
+		return -1;
+	}
+	if(unlikely(RC_HIST_FN(alloc)(&f->out_buf,buflen))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, failed to allocate history\n");
+		RC_VEC_FN(free)(&f->num);
+		RC_VEC_FN(free)(&f->den);
+		RC_HIST_FN(free)(&f->in_buf);
+		return -1;
+	}
+	// populate remaining values, everything else zero'd by free
+	f->dt=dt;
+	f->order=den.len-1;
+	f->initialized=1;
+	return 0;
+}
+
+int RC_FILT_FN(alloc_from_arrays)(RC_FILT_T* f,RC_REAL dt,RC_REAL* num,int numlen,\
+							RC_REAL* den,int denlen)
+{
+	// sanity checks
+	if(unlikely(numlen<1 || denlen<1)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc_from_arrays, numlen & denlen must be >=1\n");
+		return -1;
+	}
+	if(unlikely(numlen>denlen)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc_from_arrays, improper transfer function\n");
+		return -1;
+	}
+	if(unlikely(num==NULL || den==NULL || f==NULL)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc_from_arrays, received null pointer\n");
+		return -1;
+	}
+	if(unlikely(dt<RC_R(0.0))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc_from_arrays, dt must be >0\n");
+		return -1;
+	}
+	if(unlikely(RC_FABS(den[0]) < RC_ZERO_TOL)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc_from_arrays, first coefficient in denominator is 0\n");
+		return -1;
+	}
+	// free existing memory, this also zeros out all fields
+	RC_FILT_FN(free)(f);
+	// copy numerator and denominators over
+	if(unlikely(RC_VEC_FN(from_array)(&f->num,num,numlen))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc_from_arrays, failed to alloc vector\n");
+		return -1;
+	}
+	if(unlikely(RC_VEC_FN(from_array)(&f->den,den,denlen))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc_from_arrays, failed to alloc vector\n");
+		RC_VEC_FN(free)(&f->num);
+		return -1;
+	}
+	// allocate buffers
+	if(unlikely(RC_HIST_FN(alloc)(&f->in_buf,denlen))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, failed to allocate history\n");
+		RC_VEC_FN(free)(&f->num);
+		RC_VEC_FN(free)(&f->den);
+		return -1;
+	}
+	if(unlikely(RC_HIST_FN(alloc)(&f->out_buf,denlen))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_alloc, failed to allocate history\n");
+		RC_VEC_FN(free)(&f->num);
+		RC_VEC_FN(free)(&f->den);
+		RC_HIST_FN(free)(&f->in_buf);
+		return -1;
+	}
+	// populate remaining values, everything else zero'd by free
+	f->dt=dt;
+	f->order=denlen-1;
+	f->initialized=1;
+	return 0;
+}
+
+
+int RC_FILT_FN(duplicate)(RC_FILT_T* f, RC_FILT_T old)
+{
+	if(unlikely(!old.initialized)){
+		fprintf(stderr, "ERROR in " RC_FILT_NAME "_duplicate, old filter not initialized\n");
+		return -1;
+	}
+	if(RC_FILT_FN(alloc)(f, old.num, old.den, old.dt)){
+		fprintf(stderr, "ERROR in " RC_FILT_NAME "_duplicate, failed to alloc memory\n");
+		return -1;
+	}
+	f->gain		= old.gain;
+	f->sat_en	= old.sat_en;
+	f->sat_min	= old.sat_min;
+	f->sat_max	= old.sat_max;
+	f->ss_en	= old.ss_en;
+	f->ss_steps	= old.ss_steps;
+	return 0;
+}
+
+
+int RC_FILT_FN(free)(RC_FILT_T* f)
+{
+	RC_FILT_T new = RC_FILT_INIT;
+	if(unlikely(f==NULL)){
+		fprintf(stderr, "ERROR in " RC_FILT_NAME "_free, received NULL pointer\n");
+		return -1;
+	}
+	RC_HIST_FN(free)(&f->in_buf);
+	RC_HIST_FN(free)(&f->out_buf);
+	RC_VEC_FN(free)(&f->num);
+	RC_VEC_FN(free)(&f->den);
+	*f = new;
+	return 0;
+}
+
+
+RC_REAL RC_FILT_FN(march)(RC_FILT_T* f, RC_REAL new_input)
+{
+	int i, n;
+	RC_REAL tmp1 = RC_R(0.0);
+	RC_REAL tmp2 = RC_R(0.0);
+	RC_REAL new_out;
+	const RC_REAL* w;
+	// sanity checks
+	if(unlikely(!f->initialized)){
+		printf("ERROR in " RC_FILT_NAME "_march, filter uninitialized\n");
+		return RC_R(-1.0);
+	}
+	// log new input
+	RC_HIST_FN(insert)(&f->in_buf, new_input);
+	f->newest_input = new_input;
+	// evaluate the difference equation. Over the last den.len inputs the
+	// numerator lines up with the oldest num.len, shifted back by the relative
+	// degree, and the denominator past the leading 1 with the last order
+	// outputs. Each window is contiguous with the newest value last so both
+	// are dot products against reversed coefficients. The numerator can't be
+	// longer than the denominator as alloc checks for improper transfer
+	// functions.
+	n = f->num.len;
+	w = RC_HIST_FN(get_window)(&f->in_buf, f->den.len) + n - 1;
+	for(i=0; i<n; i++) tmp1+=f->num.d[i]*w[-i];
+	if(RC_FABS(f->gain - RC_R(1.0)) > RC_ZERO_TOL) tmp1=tmp1*f->gain;
+	n = f->order;
+	if(n>0){
+		w = RC_HIST_FN(get_window)(&f->out_buf, n) + n - 1;
+		for(i=0; i<n; i++) tmp2-=f->den.d[i+1]*w[-i];
+	}
+	new_out=tmp2+tmp1;
+	// scale in case denominator doesn't have a leading 1
+	if(RC_FABS(f->den.d[0] - RC_R(1.0)) > RC_ZERO_TOL) new_out /= f->den.d[0];
+	// soft start limits
+	if(f->ss_en && f->step<f->ss_steps){
+		RC_REAL a=f->sat_max*(f->step/f->ss_steps);
+		RC_REAL b=f->sat_min*(f->step/f->ss_steps);
+		if(new_out>a) new_out=a;
+		if(new_out<b) new_out=b;
+	}
+	// saturate and set flag
+	if(f->sat_en){
+		if(new_out>f->sat_max){
+			new_out=f->sat_max;
+			f->sat_flag=1;
+		}
+		else if(new_out<f->sat_min){
+			new_out=f->sat_min;
+			f->sat_flag=1;
+		}
+		else f->sat_flag=0;
+	}
+	// record the output to filter struct and ring buffer
+	f->newest_output = new_out;
+	RC_HIST_FN(insert)(&f->out_buf, new_out);
+	// increment steps
+	f->step++;
+	return new_out;
+}
+
+
+int RC_FILT_FN(reset)(RC_FILT_T* f)
+{
+	if(unlikely(!f->initialized)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_reset, filter uninitialized\n");
+		return -1;
+	}
+	RC_HIST_FN(reset)(&f->in_buf);
+	RC_HIST_FN(reset)(&f->out_buf);
+	f->newest_input	= RC_R(0.0);
+	f->newest_output = RC_R(0.0);
+	f->sat_flag = 0;
+	f->step = 0;
+	return 0;
+}
+
+
+
+int RC_FILT_FN(enable_saturation)(RC_FILT_T* f, RC_REAL min, RC_REAL max)
+{
+	if(unlikely(!f->initialized)){
+		fprintf(stderr, "ERROR in " RC_FILT_NAME "_enable_saturation, filter uninitialized\n");
+		return -1;
+	}
+	if(unlikely(min>max)){
+		fprintf(stderr, "ERROR in " RC_FILT_NAME "_enable_saturation, max must be >= min\n");
+		return -1;
+	}
+	f->sat_en	= 1;
+	f->sat_min	= min;
+	f->sat_max	= max;
+	return 0;
+}
+
+
+int RC_FILT_FN(get_saturation_flag)(RC_FILT_T* f)
+{
+	if(unlikely(!f->initialized)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_get_saturation_flag, filter uninitialized\n");
+		return -1;
+	}
+	return f->sat_flag;
+}
+
+
+int RC_FILT_FN(enable_soft_start)(RC_FILT_T* f, RC_REAL seconds)
+{
+	if(unlikely(!f->initialized)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_enable_soft_start, filter uninitialized\n");
+		return -1;
+	}
+	if(unlikely(seconds<=RC_R(0.0))){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_enable_soft_start, seconds must be >=0\n");
+		return -1;
+	}
+	if(unlikely(!f->sat_en)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_enable_soft_start, saturation must be enabled first\n");
+		return -1;
+	}
+	f->ss_en	= 1;
+	f->ss_steps	= seconds/f->dt;
+	return 0;
+}
+
+
+RC_REAL RC_FILT_FN(previous_input)(RC_FILT_T* f, int steps)
+{
+	if(unlikely(!f->initialized)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_previous_input, filter uninitialized\n");
+		return RC_R(-1.0);
+	}
+	return RC_HIST_FN(get_value)(&f->in_buf, steps);
+}
+
+
+RC_REAL RC_FILT_FN(previous_output)(RC_FILT_T* f, int steps)
+{
+	if(unlikely(!f->initialized)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_previous_output, filter uninitialized\n");
+		return RC_R(-1.0);
+	}
+	return RC_HIST_FN(get_value)(&f->out_buf, steps);
+}
+
+
+
+int RC_FILT_FN(prefill_inputs)(RC_FILT_T* f, RC_REAL in)
+{
+	int i;
+	if(unlikely(!f->initialized)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_prefill_inputs, filter uninitialized\n");
+		return -1;
+	}
+	for(i=0;i<=f->order;i++){
+		RC_HIST_FN(insert)(&f->in_buf, in);
+	}
+	f->newest_input = in;
+	return 0;
+}
+
+
+int RC_FILT_FN(prefill_outputs)(RC_FILT_T* f, RC_REAL out)
+{
+	int i;
+	if(unlikely(!f->initialized)){
+		fprintf(stderr,"ERROR in " RC_FILT_NAME "_prefill_outputs, filter uninitialized\n");
+		return -1;
+	}
+	for(i=0;i<=f->order;i++){
+		RC_HIST_FN(insert)(&(f->out_buf), out);
+	}
+	f->newest_output = out;
+	return 0;
+}
@@ -7,6 +7,8 @@
  */
 
 #include <stdio.h>
+#include <string.h>	// for memcpy
+#include <math.h>	// for fabs
 #include <rc/math/algebra.h>
 #include <rc/math/kalman.h>
 #include "algebra_common.h"
@@ -18,6 +20,125 @@ rc_kalman_t rc_kalman_empty(void)
 }
 
 
+/*
+ * working memory for the update step, Nx states and Ny measurements
+ */
+static int __kalman_alloc_scratch(rc_kalman_t* kf, int Nx, int Ny)
+{
+	if(rc_matrix_zeros(&kf->FP, Nx, Nx)==-1) return -1;
+	if(rc_matrix_zeros(&kf->HP, Ny, Nx)==-1) return -1;
+	if(rc_matrix_zeros(&kf->LT, Ny, Nx)==-1) return -1;
+	if(rc_matrix_zeros(&kf->S, Ny, Ny)==-1) return -1;
+	if(rc_vector_zeros(&kf->z, Ny)==-1) return -1;
+	if(rc_vector_zeros(&kf->Ph, Nx)==-1) return -1;
+	return 0;
+}
+
+
+/*
+ * P[k|k-1] = F*P[k-1|k-1]*F^T + Q
+ */
+static void __kalman_predict_P(rc_kalman_t* kf)
+{
+	int i, j;
+	int Nx = kf->P.rows;
+	__vectorized_gemm(Nx, Nx, Nx, kf->F.d, kf->P.d, kf->FP.d);	// FP = F*P
+	for(i=0;i<Nx;i++){
+		for(j=0;j<Nx;j++){
+			// row j of F is column j of F^T
+			kf->P.d[i][j] = __vectorized_mult_accumulate(kf->FP.d[i], kf->F.d[j], Nx)
+								+ kf->Q.d[i][j];
+		}
+	}
+	rc_matrix_symmetrize(&kf->P);			// Force symmetric P
+}
+
+
+/*
+ * Measurement update given x_pre, the predicted P and innovation z = y-h.
+ * Uses the Cholesky factor of S to find the gain:
+ * - S = H*P*H^T + R
+ * - L^T = S^-1 * (H*P), S and P are symmetric
+ * - x[k|k] = x[k|k-1] + L*z
+ * - P[k|k] = P - L*(H*P)
+ */
+static int __kalman_measure(rc_kalman_t* kf, const char* fn)
+{
+	int i, j, r;
+	int Nx = kf->P.rows;
+	int Ny = kf->H.rows;
+
+	// HP = H*P, row j of P is also column j as P is symmetric
+	for(r=0;r<Ny;r++){
+		for(j=0;j<Nx;j++){
+			kf->HP.d[r][j] = __vectorized_mult_accumulate(kf->H.d[r], kf->P.d[j], Nx);
+		}
+	}
+	// S = (H*P)*H^T + R
+	for(r=0;r<Ny;r++){
+		for(j=0;j<Ny;j++){
+			kf->S.d[r][j] = __vectorized_mult_accumulate(kf->HP.d[r], kf->H.d[j], Nx)
+								+ kf->R.d[r][j];
+		}
+	}
+	// L^T = S^-1*(H*P) without inverting S
+	if(unlikely(rc_algebra_cholesky_decomp_inplace(&kf->S))){
+		fprintf(stderr, "ERROR in %s, innovation covariance S is not positive definite\n", fn);
+		return -1;
+	}
+	memcpy(kf->LT.d[0], kf->HP.d[0], Ny*Nx*sizeof(double));
+	rc_algebra_cholesky_solve_matrix_inplace(kf->S, &kf->LT);
+
+	// x_est = x_pre + L*z and P = P - L*(H*P), one measurement at a time
+	memcpy(kf->x_est.d, kf->x_pre.d, Nx*sizeof(double));
+	for(r=0;r<Ny;r++){
+		__vectorized_axpy(kf->z.d[r], kf->LT.d[r], kf->x_est.d, Nx);
+		for(i=0;i<Nx;i++){
+			__vectorized_axpy(-kf->LT.d[r][i], kf->HP.d[r], kf->P.d[i], Nx);
+		}
+	}
+	rc_matrix_symmetrize(&kf->P);			// Force symmetric P
+	return 0;
+}
+
+
+/*
+ * Same as __kalman_measure for diagonal R, each element of y is applied as a
+ * scalar measurement in turn so S is a scalar too. With h the row of H and
+ * r the matching diagonal entry of R:
+ * - s = h*P*h^T + r
+ * - x = x + (P*h^T)*(z - h*(x-x_pre))/s
+ * - P = P - (P*h^T)*(P*h^T)^T/s
+ */
+static int __kalman_measure_sequential(rc_kalman_t* kf, const char* fn)
+{
+	int i, j, r;
+	int Nx = kf->P.rows;
+	int Ny = kf->H.rows;
+	double s, innov;
+	double* Ph = kf->Ph.d;
+
+	memcpy(kf->x_est.d, kf->x_pre.d, Nx*sizeof(double));
+	for(r=0;r<Ny;r++){
+		for(j=0;j<Nx;j++){
+			Ph[j] = __vectorized_mult_accumulate(kf->P.d[j], kf->H.d[r], Nx);
+		}
+		s = __vectorized_mult_accumulate(kf->H.d[r], Ph, Nx) + kf->R.d[r][r];
+		if(unlikely(s<zero_tolerance)){
+			fprintf(stderr, "ERROR in %s, innovation variance of measurement %d is not positive\n", fn, r);
+			return -1;
+		}
+		// earlier measurements already moved x away from x_pre
+		innov = kf->z.d[r];
+		for(i=0;i<Nx;i++) innov -= kf->H.d[r][i]*(kf->x_est.d[i]-kf->x_pre.d[i]);
+		__vectorized_axpy(innov/s, Ph, kf->x_est.d, Nx);
+		for(i=0;i<Nx;i++) __vectorized_axpy(-Ph[i]/s, Ph, kf->P.d[i], Nx);
+	}
+	rc_matrix_symmetrize(&kf->P);			// Force symmetric P
+	return 0;
+}
+
+
 int rc_kalman_alloc_lin(rc_kalman_t* kf, rc_matrix_t F, rc_matrix_t G, rc_matrix_t H, rc_matrix_t Q, rc_matrix_t R, rc_matrix_t Pi)
 {
 	int Nx;
@@ -55,6 +176,10 @@ int rc_kalman_alloc_lin(rc_kalman_t* kf, rc_matrix_t F, rc_matrix_t G, rc_matrix
 		fprintf(stderr, "ERROR in rc_kalman_alloc_ekf, R must be square\n");
 		return -1;
 	}
+	if(R.rows != H.rows){
+		fprintf(stderr, "ERROR in rc_kalman_alloc_lin, R and H must have same number of rows\n");
+		return -1;
+	}
 
 	// free existing memory, this also zero's out the struct
 	if(rc_kalman_free(kf)==-1) return -1;
@@ -73,6 +198,7 @@ int rc_kalman_alloc_lin(rc_kalman_t* kf, rc_matrix_t F, rc_matrix_t G, rc_matrix
 
 	if(rc_vector_zeros(&kf->x_est, Nx)==-1) return -1;
 	if(rc_vector_zeros(&kf->x_pre, Nx)==-1) return -1;
+	if(__kalman_alloc_scratch(kf, Nx, H.rows)==-1) return -1;
 	kf->initialized = 1;
 	return 0;
 }
@@ -100,13 +226,16 @@ int rc_kalman_alloc_ekf(rc_kalman_t* kf, rc_matrix_t Q, rc_matrix_t R, rc_matrix
 	// free existing memory, this also zero's out the struct
 	rc_kalman_free(kf);
 
-	// allocate memory
-	rc_matrix_duplicate(Q, &kf->Q);
-	rc_matrix_duplicate(R, &kf->R);
-	rc_matrix_duplicate(Pi, &kf->Pi);
-	rc_matrix_duplicate(Pi, &kf->P);
-	rc_vector_zeros(&kf->x_est, Q.rows);
-	rc_vector_zeros(&kf->x_pre, Q.rows);
+	// allocate memory, F and H are filled in by each update
+	if(rc_matrix_duplicate(Q, &kf->Q)==-1) return -1;
+	if(rc_matrix_duplicate(R, &kf->R)==-1) return -1;
+	if(rc_matrix_duplicate(Pi, &kf->Pi)==-1) return -1;
+	if(rc_matrix_duplicate(Pi, &kf->P)==-1) return -1;
+	if(rc_matrix_zeros(&kf->F, Q.rows, Q.rows)==-1) return -1;
+	if(rc_matrix_zeros(&kf->H, R.rows, Q.rows)==-1) return -1;
+	if(rc_vector_zeros(&kf->x_est, Q.rows)==-1) return -1;
+	if(rc_vector_zeros(&kf->x_pre, Q.rows)==-1) return -1;
+	if(__kalman_alloc_scratch(kf, Q.rows, R.rows)==-1) return -1;
 	kf->initialized = 1;
 	return 0;
 }
@@ -132,6 +261,13 @@ int rc_kalman_free(rc_kalman_t* kf)
 	rc_vector_free(&kf->x_est);
 	rc_vector_free(&kf->x_pre);
 
+	rc_matrix_free(&kf->FP);
+	rc_matrix_free(&kf->HP);
+	rc_matrix_free(&kf->LT);
+	rc_matrix_free(&kf->S);
+	rc_vector_free(&kf->z);
+	rc_vector_free(&kf->Ph);
+
 	*kf = new;
 	return 0;
 }
@@ -156,16 +292,36 @@ int rc_kalman_reset(rc_kalman_t* kf)
 	return 0;
 }
 
+int rc_kalman_set_sequential(rc_kalman_t* kf, int enable)
+{
+	int i, j;
+	// sanity checks
+	if(kf==NULL){
+		fprintf(stderr, "ERROR in rc_kalman_set_sequential, received NULL pointer\n");
+		return -1;
+	}
+	if(kf->initialized !=1){
+		fprintf(stderr, "ERROR in rc_kalman_set_sequential, kf uninitialized\n");
+		return -1;
+	}
+	if(enable){
+		for(i=0;i<kf->R.rows;i++){
+			for(j=0;j<kf->R.cols;j++){
+				if(i!=j && fabs(kf->R.d[i][j])>zero_tolerance){
+					fprintf(stderr, "ERROR in rc_kalman_set_sequential, R must be diagonal\n");
+					return -1;
+				}
+			}
+		}
+	}
+	kf->sequential = enable ? 1 : 0;
+	return 0;
+}
+
+
 int rc_kalman_update_lin(rc_kalman_t* kf, rc_vector_t u, rc_vector_t y)
 {
-	rc_matrix_t L = RC_MATRIX_INITIALIZER;
-	rc_matrix_t newP = RC_MATRIX_INITIALIZER;
-	rc_matrix_t S = RC_MATRIX_INITIALIZER;
-	rc_matrix_t FT = RC_MATRIX_INITIALIZER;
-	rc_vector_t h = RC_VECTOR_INITIALIZER;
-	rc_vector_t z = RC_VECTOR_INITIALIZER;
-	rc_vector_t tmp1 = RC_VECTOR_INITIALIZER;
-	rc_vector_t tmp2 = RC_VECTOR_INITIALIZER;
+	int i;
 
 	// sanity checks
 	if(unlikely(kf==NULL)){
@@ -191,56 +347,26 @@ int rc_kalman_update_lin(rc_kalman_t* kf, rc_vector_t u, rc_vector_t y)
 
 	// for linear case only, calculate x_pre from linear system model
 	// x_pre = x[k|k-1] = F*x[k-1|k-1] +  G*u[k-1]
-	rc_matrix_times_col_vec(kf->F, kf->x_est, &tmp1);
-	rc_matrix_times_col_vec(kf->G, u, &tmp2);
-	rc_vector_sum(tmp1, tmp2, &kf->x_pre);
+	for(i=0;i<kf->x_pre.len;i++){
+		kf->x_pre.d[i] = __vectorized_mult_accumulate(kf->F.d[i], kf->x_est.d, kf->F.cols)
+				+ __vectorized_mult_accumulate(kf->G.d[i], u.d, u.len);
+	}
 
 	// F is constant in this linear case
 	// P[k|k-1] = F*P[k-1|k-1]*F^T + Q
-	rc_matrix_multiply(kf->F, kf->P, &newP);	// newP = F*P_old
-	rc_matrix_transpose(kf->F, &FT);
-	rc_matrix_right_multiply_inplace(&newP, FT);	// P = F*P*F^T
-	rc_matrix_add_inplace(&newP, kf->Q);		// P = F*P*F^T + Q
-	rc_matrix_symmetrize(&newP);			// Force symmetric P
-
-	// h[k] = H * x_pre[k]
-	rc_matrix_times_col_vec(kf->H,kf->x_pre,&h);
+	__kalman_predict_P(kf);
 
 	// H is constant in the linear case
-	// S = H*P*H^T + R
-	// Calculate H^T, borrow S for H^T
-	rc_matrix_transpose(kf->H, &S);			// S = H^T
-	// Calculate a part of L in advance before we modify S = H^T
-	rc_matrix_multiply(newP, S, &L);		// K = P*(H^T)
-	rc_matrix_left_multiply_inplace(newP, &S);	// S = P*H^T
-	rc_matrix_left_multiply_inplace(kf->H, &S);	// S = H*(P*H^T)
-	rc_matrix_add_inplace(&S, kf->R);		// S = H*P*H^T + R
-
-	// L = P*(H^T)*(S^-1)
-	rc_algebra_invert_matrix_inplace(&S);		// S2^(-1) = S^(-1)
-	rc_matrix_right_multiply_inplace(&L, S);	// L = (P*H^T)*(S^-1)
-
-	// x[k|k] = x[k|k-1] + K[k]*(y[k]-h[k])
-	rc_vector_subtract(y,h,&z);			// z = k-h
-	rc_matrix_times_col_vec(L, z, &tmp1);		// temp = L*z
-	rc_vector_sum(kf->x_pre, tmp1, &kf->x_est);	// x_est = x + K*y
-
-	// P[k|k] = (I - L*H)*P = P[k|k-1] - L*H*P[k|k-1], reuse the matrix S.
-	rc_matrix_multiply(kf->H, newP, &S);		// S = H*P
-	rc_matrix_left_multiply_inplace(L, &S);		// S = L*(H*P)
-	rc_matrix_subtract_inplace(&newP, S);		// P = P - K*H*P
-	rc_matrix_symmetrize(&newP);			// Force symmetric P
-	rc_matrix_duplicate(newP,&kf->P);
-
-	// cleanup
-	rc_matrix_free(&L);
-	rc_matrix_free(&newP);
-	rc_matrix_free(&S);
-	rc_matrix_free(&FT);
-	rc_vector_free(&h);
-	rc_vector_free(&z);
-	rc_vector_free(&tmp1);
-	rc_vector_free(&tmp2);
+	// z = y - h[k] = y - H * x_pre[k]
+	for(i=0;i<y.len;i++){
+		kf->z.d[i] = y.d[i] - __vectorized_mult_accumulate(kf->H.d[i], kf->x_pre.d, kf->H.cols);
+	}
+
+	// S, L, x[k|k] and P[k|k]
+	if(kf->sequential){
+		if(unlikely(__kalman_measure_sequential(kf, "rc_kalman_lin_update"))) return -1;
+	}
+	else if(unlikely(__kalman_measure(kf, "rc_kalman_lin_update"))) return -1;
 
 	kf->step++;
 	return 0;
@@ -249,14 +375,6 @@ int rc_kalman_update_lin(rc_kalman_t* kf, rc_vector_t u, rc_vector_t y)
 
 int rc_kalman_update_ekf(rc_kalman_t* kf, rc_matrix_t F, rc_matrix_t H, rc_vector_t x_pre, rc_vector_t y, rc_vector_t h)
 {
-	rc_matrix_t L = RC_MATRIX_INITIALIZER;
-	rc_matrix_t newP = RC_MATRIX_INITIALIZER;
-	rc_matrix_t S = RC_MATRIX_INITIALIZER;
-	rc_matrix_t FT = RC_MATRIX_INITIALIZER;
-	rc_vector_t z = RC_VECTOR_INITIALIZER;
-	rc_vector_t tmp1 = RC_VECTOR_INITIALIZER;
-	rc_vector_t tmp2 = RC_VECTOR_INITIALIZER;
-
 	// sanity checks
 	if(unlikely(kf==NULL)){
 		fprintf(stderr, "ERROR in rc_kalman_ekf_update, received NULL pointer\n");
@@ -290,60 +408,34 @@ int rc_kalman_update_ekf(rc_kalman_t* kf, rc_matrix_t F, rc_matrix_t H, rc_vecto
 		fprintf(stderr, "ERROR in rc_kalman_ekf_update y must have same dimension as rows of H\n");
 		return -1;
 	}
+	if(unlikely(F.rows != kf->F.rows || H.rows != kf->H.rows)){
+		fprintf(stderr, "ERROR in rc_kalman_ekf_update F and H must match dimensions of Q and R\n");
+		return -1;
+	}
 	if(unlikely(y.len != h.len)){
 		fprintf(stderr, "ERROR in rc_kalman_ekf_update y must have same dimension h\n");
 		return -1;
 	}
 
-	// copy in new jacobians and x prediction
+	// copy in new jacobians and x prediction, all preallocated so no
+	// allocation happens here
 	rc_matrix_duplicate(F, &kf->F);
 	rc_vector_duplicate(x_pre, &kf->x_pre);
 	rc_matrix_duplicate(H, &kf->H);
 
 	// F is new now in non-linear case
 	// P[k|k-1] = F*P[k-1|k-1]*F^T + Q
-	rc_matrix_multiply(kf->F, kf->P, &newP);	// P_new = F*P_old
-	rc_matrix_transpose(kf->F, &FT);
-	rc_matrix_right_multiply_inplace(&newP, FT);	// P = F*P*F^T
-	rc_matrix_add(newP, kf->Q, &kf->P);		// P = F*P*F^T + Q
-	rc_matrix_symmetrize(&kf->P);			// Force symmetric P
+	__kalman_predict_P(kf);
 
-	// H is constant in the linear case
-	// S = H*P*H^T + R
-	// Calculate H^T, borrow S for H^T
-	rc_matrix_transpose(kf->H, &S);			// S = H^T
-	// Calculate a part of L in advance before we modify S = H^T
-	rc_matrix_multiply(kf->P, S, &L);		// K = P*(H^T)
-	rc_matrix_left_multiply_inplace(kf->P, &S);	// S = P*H^T
-	rc_matrix_left_multiply_inplace(kf->H, &S);	// S = H*(P*H^T)
-	rc_matrix_add_inplace(&S, kf->R);		// S = H*P*H^T + R
-
-	// L = P*(H^T)*(S^-1)
-	rc_algebra_invert_matrix_inplace(&S);		// S2^(-1) = S^(-1)
-	rc_matrix_right_multiply_inplace(&L, S);	// L = (P*H^T)*(S^-1)
-
-	// x[k|k] = x[k|k-1] + L[k]*(y[k]-h[k])
-	rc_vector_subtract(y,h,&z);			// z = k-h
-	rc_matrix_times_col_vec(L, z, &tmp1);		// temp = L*z
-	rc_vector_sum(kf->x_pre, tmp1, &kf->x_est);	// x_est = x + L*y
-
-	// P[k|k] = (I - L*H)*P = P - L*H*P, reuse the matrix S.
-	rc_matrix_multiply(kf->H, newP, &S);		// S = H*P
-	rc_matrix_left_multiply_inplace(L, &S);		// S = L*(H*P)
-	rc_matrix_subtract_inplace(&newP, S);		// P = P - K*H*P
-	rc_matrix_symmetrize(&newP);			// Force symmetric P
-	rc_matrix_duplicate(newP,&kf->P);
-
-	// cleanup
-	rc_matrix_free(&L);
-	rc_matrix_free(&newP);
-	rc_matrix_free(&S);
-	rc_matrix_free(&FT);
-	rc_vector_free(&z);
-	rc_vector_free(&tmp1);
-	rc_vector_free(&tmp2);
+	// z = y - h, h comes from the user's non-linear model
+	rc_vector_subtract(y, h, &kf->z);
+
+	// S, L, x[k|k] and P[k|k]
+	if(kf->sequential){
+		if(unlikely(__kalman_measure_sequential(kf, "rc_kalman_ekf_update"))) return -1;
+	}
+	else if(unlikely(__kalman_measure(kf, "rc_kalman_ekf_update"))) return -1;
 
 	kf->step++;
 	return 0;
 }
-
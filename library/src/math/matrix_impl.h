@@ -0,0 +1,549 @@
+/**
+ * @file math/matrix_impl.h
+ *
+ * Body of the matrix functions, included once by matrix.c for rc_matrix_t and
+ * once by single_precision.c for rc_matrixf_t. See precision.h for the names
+ * and types it expects.
+ */
+
+#ifndef RC_REAL
+#error "include precision.h before matrix_impl.h"
+#endif
+
+
+RC_MAT_T RC_MAT_FN(empty)(void)
+{
+	RC_MAT_T out = RC_MAT_INIT;
+	return out;
+}
+
+
+int RC_MAT_FN(alloc)(RC_MAT_T* A, int rows, int cols)
+{
+	int i, borrowed;
+	// sanity checks
+	if(unlikely(rows<1 || cols<1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_alloc, rows and cols must be >=1\n");
+		return -1;
+	}
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_alloc, received NULL pointer\n");
+		return -1;
+	}
+	// if A is already allocated and of the right size, nothing to do!
+	if(A->initialized==1 && rows==A->rows && cols==A->cols) return 0;
+	// free any old memory
+	RC_MAT_FN(free)(A);
+	// allocate contiguous memory for the major(row) pointers, this comes from
+	// the active workspace instead of the heap if there is one
+	A->d = (RC_REAL**)__rc_math_alloc(rows*sizeof(RC_REAL*), 0, &borrowed);
+	if(unlikely(A->d==NULL)){
+		perror("ERROR in " RC_MAT_NAME "_alloc");
+		fprintf(stderr, "tried allocating a %dx%d matrix\n", rows,cols);
+		return -1;
+	}
+	// allocate contiguous memory for the actual data
+	void* ptr = __rc_math_alloc(rows*cols*sizeof(RC_REAL), 0, &borrowed);
+	if(unlikely(ptr==NULL)){
+		perror("ERROR in " RC_MAT_NAME "_alloc");
+		fprintf(stderr, "tried allocating a %dx%d matrix\n", rows,cols);
+		if(!borrowed) __rc_math_free(A->d);
+		A->d = NULL;
+		return -1;
+	}
+	// manually fill in the pointer to each row
+	for(i=0;i<rows;i++) A->d[i]=(RC_REAL*)(((char*)ptr) + (i*cols*sizeof(RC_REAL)));
+	A->rows = rows;
+	A->cols = cols;
+	A->borrowed = borrowed;
+	A->initialized = 1;
+	return 0;
+}
+
+
+int RC_MAT_FN(free)(RC_MAT_T* A)
+{
+	RC_MAT_T new = RC_MAT_INIT;
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_free, received NULL pointer\n");
+		return -1;
+	}
+	// free memory allocated for the data then the major array, memory
+	// borrowed from a workspace goes back when the workspace scope ends
+	if(!A->borrowed){
+		if(A->d!=NULL && A->initialized==1) __rc_math_free(A->d[0]);
+		__rc_math_free(A->d);
+	}
+	// zero out the struct
+	*A = new;
+	return 0;
+}
+
+
+int RC_MAT_FN(zeros)(RC_MAT_T* A, int rows, int cols)
+{
+	int i, borrowed;
+	// sanity checks
+	if(unlikely(rows<1 || cols<1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_zeros, rows and cols must be >=1\n");
+		return -1;
+	}
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_zeros, received NULL pointer\n");
+		return -1;
+	}
+	// make sure A is freed before allocating new memory
+	RC_MAT_FN(free)(A);
+	// allocate contiguous memory for the major(row) pointers
+	A->d = (RC_REAL**)__rc_math_alloc(rows*sizeof(RC_REAL*), 0, &borrowed);
+	if(unlikely(A->d==NULL)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_zeros, not enough memory\n");
+		return -1;
+	}
+	// allocate contiguous zeroed-out memory for the actual data
+	void* ptr = __rc_math_alloc(rows*cols*sizeof(RC_REAL), 1, &borrowed);
+	if(unlikely(ptr==NULL)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_zeros, not enough memory\n");
+		if(!borrowed) __rc_math_free(A->d);
+		A->d = NULL;
+		return -1;
+	}
+	// manually fill in the pointer to each row
+	for(i=0;i<rows;i++) A->d[i]=(RC_REAL*)(((char*)ptr) + (i*cols*sizeof(RC_REAL)));
+	A->rows = rows;
+	A->cols = cols;
+	A->borrowed = borrowed;
+	A->initialized = 1;
+	return 0;
+}
+
+
+int RC_MAT_FN(identity)(RC_MAT_T* A, int dim)
+{
+	int i;
+	if(unlikely(RC_MAT_FN(zeros)(A,dim,dim))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_identity, failed to allocate matrix\n");
+		return -1;
+	}
+	// fill in diagonal of ones
+	for(i=0;i<dim;i++) A->d[i][i]=RC_R(1.0);
+	return 0;
+}
+
+
+int RC_MAT_FN(diagonal)(RC_MAT_T* A, RC_VEC_T v)
+{
+	int i;
+	// sanity check
+	if(unlikely(v.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_diagonal, vector not initialized\n");
+		return -1;
+	}
+	// allocate fresh zero-initialized memory for A
+	if(unlikely(RC_MAT_FN(zeros)(A,v.len,v.len))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_diagonal, failed to allocate matrix\n");
+		return -1;
+	}
+	for(i=0;i<v.len;i++) A->d[i][i]=v.d[i];
+	return 0;
+}
+
+
+int RC_MAT_FN(duplicate)(RC_MAT_T A, RC_MAT_T* B)
+{
+	// sanity check
+	if(unlikely(A.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_duplicate not initialized yet\n");
+		return -1;
+	}
+	// make sure there is enough space in B
+	if(unlikely(RC_MAT_FN(alloc)(B,A.rows,A.cols))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_duplicate, failed to allocate memory\n");
+		return -1;
+	}
+	// all matrix data is stored contiguously so one memcpy is sufficient
+	memcpy(B->d[0],A.d[0],A.rows*A.cols*sizeof(RC_REAL));
+	return 0;
+}
+
+
+int RC_MAT_FN(print)(RC_MAT_T A)
+{
+	int i,j;
+	if(unlikely(A.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_print, matrix not initialized yet\n");
+		return -1;
+	}
+	for(i=0;i<A.rows;i++){
+		for(j=0;j<A.cols;j++){
+			printf("%7.4f  ",(double)A.d[i][j]);
+		}
+		printf("\n");
+	}
+	return 0;
+}
+
+
+int RC_MAT_FN(print_sci)(RC_MAT_T A)
+{
+	int i,j;
+	if(unlikely(A.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_print_sci, matrix not initialized yet\n");
+		return -1;
+	}
+	for(i=0;i<A.rows;i++){
+		for(j=0;j<A.cols;j++){
+			printf("%11.4e  ",(double)A.d[i][j]);
+		}
+		printf("\n");
+	}
+	return 0;
+}
+
+
+int RC_MAT_FN(zero_out)(RC_MAT_T* A)
+{
+	int i,j;
+	if(unlikely(A->initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_zero_out, matrix not initialized yet\n");
+		return -1;
+	}
+	for(i=0;i<A->rows;i++){
+		for(j=0;j<A->cols;j++){
+			A->d[i][j]=RC_R(0.0);
+		}
+	}
+	return 0;
+}
+
+
+int RC_MAT_FN(times_scalar)(RC_MAT_T* A, RC_REAL s)
+{
+	int i;
+	if(unlikely(A->initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_times_scalar. matrix uninitialized\n");
+		return -1;
+	}
+	// since A contains contiguous memory, gcc should vectorize this loop
+	for(i=0;i<(A->rows*A->cols);i++) A->d[0][i] *= s;
+	return 0;
+}
+
+
+int RC_MAT_FN(multiply)(RC_MAT_T A, RC_MAT_T B, RC_MAT_T* C)
+{
+	if(unlikely(A.initialized!=1 || B.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_multiply, matrix not initialized\n");
+		return -1;
+	}
+	if(unlikely(A.cols!=B.rows)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_multiply, dimension mismatch\n");
+		return -1;
+	}
+	// the result is written as it is computed, so when C shares memory with
+	// an input go through a temporary like the inplace functions
+	if(unlikely(C->initialized && (C->d==A.d || C->d==B.d))){
+		RC_MAT_T tmp = RC_MAT_INIT;
+		if(RC_MAT_FN(multiply)(A, B, &tmp)){
+			RC_MAT_FN(free)(&tmp);
+			return -1;
+		}
+		if(C->rows==tmp.rows && C->cols==tmp.cols){
+			memcpy(C->d[0], tmp.d[0], tmp.rows*tmp.cols*sizeof(RC_REAL));
+			RC_MAT_FN(free)(&tmp);
+		}
+		else{
+			RC_MAT_FN(free)(C);
+			*C = tmp;
+		}
+		return 0;
+	}
+	// if C is not initialized, allocate memory for it
+	if(unlikely(RC_MAT_FN(alloc)(C,A.rows,B.cols))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_multiply, can't allocate memory for C\n");
+		return -1;
+	}
+	// tiled and vectorized, see algebra_common.c
+	RC_GEMM(A.rows, A.cols, B.cols, A.d, B.d, C->d);
+	return 0;
+}
+
+
+int RC_MAT_FN(left_multiply_inplace)(RC_MAT_T A, RC_MAT_T* B)
+{
+	RC_MAT_T tmp = RC_MAT_INIT;
+	// Sanity Checks
+	if(unlikely(A.initialized!=1 || B->initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_left_multiply_inplace, matrix not initialized\n");
+		return -1;
+	}
+	if(unlikely(A.cols!=B->rows)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_left_multiply_inplace, dimension mismatch\n");
+		return -1;
+	}
+	// use the normal multiply function which will allocate memory for tmp
+	if(RC_MAT_FN(multiply)(A, *B, &tmp)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_left_multiply_inplace, failed to multiply\n");
+		RC_MAT_FN(free)(&tmp);
+		return -1;
+	}
+	RC_MAT_FN(free)(B);
+	*B=tmp;
+	return 0;
+}
+
+
+int RC_MAT_FN(right_multiply_inplace)(RC_MAT_T* A, RC_MAT_T B)
+{
+	RC_MAT_T tmp = RC_MAT_INIT;
+	// Sanity Checks
+	if(unlikely(A->initialized!=1 || B.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_right_multiply_inplace, matrix not initialized\n");
+		return -1;
+	}
+	if(unlikely(A->cols!=B.rows)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_right_multiply_inplace, dimension mismatch\n");
+		return -1;
+	}
+	if(RC_MAT_FN(multiply)(*A, B, &tmp)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_right_multiply_inplace, failed to multiply\n");
+		RC_MAT_FN(free)(&tmp);
+		return -1;
+	}
+	RC_MAT_FN(free)(A);
+	*A=tmp;
+	return 0;
+}
+
+
+int RC_MAT_FN(add)(RC_MAT_T A, RC_MAT_T B, RC_MAT_T* C)
+{
+	int i;
+	if(unlikely(A.initialized!=1 || B.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_add, matrix not initialized\n");
+		return -1;
+	}
+	if(unlikely(A.rows!=B.rows || A.cols!=B.cols)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_add, dimension mismatch\n");
+		return -1;
+	}
+	// make sure C is allocated
+	if(unlikely(RC_MAT_FN(alloc)(C,A.rows,A.cols))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_add, can't allocate memory for C\n");
+		return -1;
+	}
+	for(i=0;i<(A.rows*A.cols);i++) C->d[0][i]=A.d[0][i]+B.d[0][i];
+	return 0;
+}
+
+
+int RC_MAT_FN(add_inplace)(RC_MAT_T* A, RC_MAT_T B)
+{
+	int i;
+	if(unlikely(A->initialized!=1 || B.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_add_inplace, matrix not initialized\n");
+		return -1;
+	}
+	if(unlikely(A->rows!=B.rows || A->cols!=B.cols)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_add_inplace, dimension mismatch\n");
+		return -1;
+	}
+	for(i=0;i<(A->rows*A->cols);i++) A->d[0][i]+=B.d[0][i];
+	return 0;
+}
+
+int RC_MAT_FN(subtract_inplace)(RC_MAT_T* A, RC_MAT_T B)
+{
+	int i;
+	if(unlikely(A->initialized!=1 || B.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_subtract_inplace, matrix not initialized\n");
+		return -1;
+	}
+	if(unlikely(A->rows!=B.rows || A->cols!=B.cols)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_subtract_inplace, dimension mismatch\n");
+		return -1;
+	}
+	for(i=0;i<(A->rows*A->cols);i++) A->d[0][i]-=B.d[0][i];
+	return 0;
+}
+
+
+int RC_MAT_FN(transpose)(RC_MAT_T A, RC_MAT_T* T)
+{
+	int i,j;
+	if(unlikely(A.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_transpose, received uninitialized matrix\n");
+		return -1;
+	}
+	// make sure T is allocated
+	if(unlikely(RC_MAT_FN(alloc)(T,A.cols,A.rows))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_transpose, can't allocate memory for T\n");
+		return -1;
+	}
+	// fill in new memory
+	for(i=0;i<(A.rows);i++){
+		for(j=0;j<(A.cols);j++){
+			T->d[j][i] = A.d[i][j];
+		}
+	}
+	return 0;
+}
+
+
+int RC_MAT_FN(transpose_inplace)(RC_MAT_T* A)
+{
+	RC_MAT_T tmp = RC_MAT_INIT;
+	if(unlikely(A==NULL)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_transpose_inplace, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!A->initialized)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_transpose_inplace, matrix uninitialized\n");
+		return -1;
+	}
+	// shortcut for 1x1 matrix
+	if(A->rows==1 && A->cols==1) return 0;
+	// allocate memory for new A, easier than doing it in place since A will
+	// change size if non-square
+	if(unlikely(RC_MAT_FN(transpose)(*A, &tmp))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_transpose_inplace, can't transpose\n");
+		RC_MAT_FN(free)(&tmp);
+		return -1;
+	}
+	// free the original matrix A and set it's struct to point to the new memory
+	RC_MAT_FN(free)(A);
+	*A=tmp;
+	return 0;
+}
+
+int RC_MAT_FN(times_col_vec)(RC_MAT_T A, RC_VEC_T v, RC_VEC_T* c)
+{
+	int i;
+	// sanity checks
+	if(unlikely(A.initialized!=1 || v.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_times_col_vec, matrix or vector uninitialized\n");
+		return -1;
+	}
+	if(unlikely(A.cols!=v.len)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_times_col_vec, dimension mismatch\n");
+		return -1;
+	}
+	if(unlikely(RC_VEC_FN(alloc)(c,A.rows))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_times_col_vec, failed to allocate c\n");
+		return -1;
+	}
+	// run the sum
+	for(i=0;i<A.rows;i++) c->d[i]=RC_DOT(A.d[i],v.d,v.len);
+	return 0;
+}
+
+
+int RC_MAT_FN(row_vec_times_matrix)(RC_VEC_T v, RC_MAT_T A, RC_VEC_T* c)
+{
+	int i;
+	// sanity checks
+	if(unlikely(A.initialized!=1 || v.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_row_vec_times_matrix, matrix or vector uninitialized\n");
+		return -1;
+	}
+	if(unlikely(A.rows!=v.len)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_row_vec_times_matrix, dimension mismatch\n");
+		return -1;
+	}
+	// make sure c is allocated correctly
+	if(unlikely(RC_VEC_FN(alloc)(c,A.cols))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_row_vec_times_matrix, failed to allocate c\n");
+		return -1;
+	}
+	// c is a sum of rows of A weighted by v, this walks A row by row in
+	// contiguous memory instead of gathering columns
+	memset(c->d, 0, A.cols*sizeof(RC_REAL));
+	for(i=0;i<A.rows;i++) RC_AXPY(v.d[i], A.d[i], c->d, A.cols);
+	return 0;
+}
+
+int RC_MAT_FN(outer_product)(RC_VEC_T v1, RC_VEC_T v2, RC_MAT_T* A)
+{
+	int i, j;
+	if(unlikely(v1.initialized!=1 || v2.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_outer_product, vector uninitialized\n");
+		return -1;
+	}
+	if(unlikely(RC_MAT_FN(alloc)(A,v1.len,v2.len))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_outer_product, failed to allocate A\n");
+		return -1;
+	}
+	for(i=0;i<v1.len;i++){
+		for(j=0;j<v2.len;j++){
+			A->d[i][j] = v1.d[i]*v2.d[j];
+		}
+	}
+	return 0;
+}
+
+RC_REAL RC_MAT_FN(determinant)(RC_MAT_T A)
+{
+	int i,j;
+	RC_REAL ratio, det;
+	RC_MAT_T tmp = RC_MAT_INIT;
+	// sanity checks
+	if(unlikely(A.initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_determinant, received uninitialized matrix\n");
+		return RC_R(-1.0);
+	}
+	if(unlikely(A.rows!=A.cols)){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_determinant, expected square matrix\n");
+		return RC_R(-1.0);
+	}
+	// shortcut for 1x1 matrix
+	if(A.rows==1) return A.d[0][0];
+	// shortcut for 2x2 matrix
+	if(A.rows==2) return A.d[0][0]*A.d[1][1] - A.d[0][1]*A.d[1][0];
+	// allocate a duplicate to shuffle around
+	if(unlikely(RC_MAT_FN(duplicate)(A,&tmp))){
+		fprintf(stderr,"ERROR in " RC_MAT_NAME "_determinant, failed to allocate duplicate\n");
+		return RC_R(-1.0);
+	}
+	for(i=0;i<(A.rows-1);i++){
+		for(j=i+1;j<A.rows;j++){
+			ratio = tmp.d[j][i]/tmp.d[i][i];
+			// columns left of i are already eliminated, skip them
+			RC_AXPY(-ratio, tmp.d[i]+i, tmp.d[j]+i, A.rows-i);
+		}
+	}
+	// multiply along the main diagonal
+	det = RC_R(1.0);
+	for(i=0;i<A.rows;i++) det *= tmp.d[i][i];
+	// free memory and return
+	RC_MAT_FN(free)(&tmp);
+	return det;
+}
+
+int RC_MAT_FN(symmetrize)(RC_MAT_T* P)
+{
+	int i,j;
+	RC_REAL val;
+	// sanity checks
+	if(P==NULL){
+		fprintf(stderr, "ERROR in " RC_MAT_NAME "_symmetrize, matrix pointer is NULL\n");
+		return -1;
+	}
+	if(P->initialized!=1){
+		fprintf(stderr, "ERROR in " RC_MAT_NAME "_symmetrize, matrix uninitialized\n");
+		return -1;
+	}
+	if(P->rows != P->cols){
+		fprintf(stderr, "ERROR in " RC_MAT_NAME "_symmetrize, matrix must be square\n");
+		return -1;
+	}
+	// itterate top to bottom, skipping last row
+	for(i=0; i<(P->rows-1); i++){
+		// itterate left to right, skipping diagonal
+		for(j=i+1; j<P->cols; j++){
+			val = (P->d[i][j] + P->d[j][i])/RC_R(2.0);
+			P->d[i][j] = val;
+			P->d[j][i] = val;
+		}
+	}
+	return 0;
+}
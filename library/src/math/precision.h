@@ -0,0 +1,84 @@
+/**
+ * @file math/precision.h
+ *
+ * Type and function name macros for the templates that are compiled once in
+ * double precision and once in single precision: vector_impl.h,
+ * matrix_impl.h, filter_impl.h and small_matrix_impl.h. A source file
+ * includes this with RC_MATH_FLOAT defined to get the float names, otherwise
+ * it gets the double ones. Only one precision per translation unit.
+ *
+ * Literals in the templates go through RC_R() so float code never silently
+ * computes in double, which -Wdouble-promotion would catch anyway.
+ */
+
+#ifndef RC_MATH_PRECISION_H
+#define RC_MATH_PRECISION_H
+
+#include <float.h>	// for FLT_MAX DBL_MAX
+#include <math.h>
+
+#ifdef RC_MATH_FLOAT
+
+#include <rc/math/single_precision.h>
+
+#define RC_REAL			float
+#define RC_R(x)			x##f
+#define RC_REAL_MAX		FLT_MAX
+#define RC_FABS			fabsf
+#define RC_SQRT			sqrtf
+#define RC_POW			powf
+#define RC_ZERO_TOL		((float)zero_tolerance)
+
+#define RC_VEC_T		rc_vectorf_t
+#define RC_VEC_FN(name)		rc_vectorf_##name
+#define RC_VEC_NAME		"rc_vectorf"
+#define RC_VEC_INIT		RC_VECTORF_INITIALIZER
+#define RC_MAT_T		rc_matrixf_t
+#define RC_MAT_FN(name)		rc_matrixf_##name
+#define RC_MAT_NAME		"rc_matrixf"
+#define RC_MAT_INIT		RC_MATRIXF_INITIALIZER
+#define RC_FILT_T		rc_filterf_t
+#define RC_FILT_FN(name)	rc_filterf_##name
+#define RC_FILT_NAME		"rc_filterf"
+#define RC_FILT_INIT		RC_FILTERF_INITIALIZER
+#define RC_SM_NAME		"rc_mat%df"
+#define RC_HIST_FN(name)	__ringbuff_##name
+
+#define RC_DOT			__vectorized_mult_accumulate_f
+#define RC_SQUARE_SUM		__vectorized_square_accumulate_f
+#define RC_AXPY			__vectorized_axpy_f
+#define RC_GEMM			__vectorized_gemm_f
+
+#else
+
+#define RC_REAL			double
+#define RC_R(x)			x
+#define RC_REAL_MAX		DBL_MAX
+#define RC_FABS			fabs
+#define RC_SQRT			sqrt
+#define RC_POW			pow
+#define RC_ZERO_TOL		zero_tolerance
+
+#define RC_VEC_T		rc_vector_t
+#define RC_VEC_FN(name)		rc_vector_##name
+#define RC_VEC_NAME		"rc_vector"
+#define RC_VEC_INIT		RC_VECTOR_INITIALIZER
+#define RC_MAT_T		rc_matrix_t
+#define RC_MAT_FN(name)		rc_matrix_##name
+#define RC_MAT_NAME		"rc_matrix"
+#define RC_MAT_INIT		RC_MATRIX_INITIALIZER
+#define RC_FILT_T		rc_filter_t
+#define RC_FILT_FN(name)	rc_filter_##name
+#define RC_FILT_NAME		"rc_filter"
+#define RC_FILT_INIT		RC_FILTER_INITIALIZER
+#define RC_SM_NAME		"rc_mat%d"
+#define RC_HIST_FN(name)	rc_ringbuf_##name
+
+#define RC_DOT			__vectorized_mult_accumulate
+#define RC_SQUARE_SUM		__vectorized_square_accumulate
+#define RC_AXPY			__vectorized_axpy
+#define RC_GEMM			__vectorized_gemm
+
+#endif // RC_MATH_FLOAT
+
+#endif // RC_MATH_PRECISION_H
@@ -34,32 +34,54 @@ rc_ringbuf_t rc_ringbuf_empty(void)
 }
 
 
+// recomputes the running statistics from scratch with two passes
+static void __ringbuf_resync(rc_ringbuf_t* buf)
+{
+	int i;
+	double mean = 0.0;
+	double m2 = 0.0;
+	double diff;
+	const double* w = buf->d + buf->index + buf->capacity - buf->size + 1;
+
+	for(i=0;i<buf->size;i++) mean += w[i];
+	mean = mean/(double)buf->size;
+	for(i=0;i<buf->size;i++){
+		diff = w[i]-mean;
+		m2 += diff*diff;
+	}
+	buf->mean = mean;
+	buf->m2 = m2;
+	return;
+}
+
+
 int rc_ringbuf_alloc(rc_ringbuf_t* buf, int size)
 {
+	int capacity;
 	// sanity checks
 	if(unlikely(buf==NULL)){
 		fprintf(stderr,"ERROR in rc_ringbuf_alloc, received NULL pointer\n");
 		return -1;
 	}
-	if(unlikely(size<2)){
-		fprintf(stderr,"ERROR in rc_ringbuf_alloc, size must be >=2\n");
+	if(unlikely(size<2 || size>(1<<29))){
+		fprintf(stderr,"ERROR in rc_ringbuf_alloc, size must be >=2 and <=2^29\n");
 		return -1;
 	}
 	// if it's already allocated, nothing to do
 	if(buf->initialized && buf->size==size && buf->d!=NULL) return 0;
 	// make sure it's zero'd out
-	buf->size = 0;
-	buf->index = 0;
-	buf->initialized = 0;
-	// free memory and allocate fresh
-	free(buf->d);
-	buf->d = (double*)calloc(size,sizeof(double));
+	rc_ringbuf_free(buf);
+	// round up to a power of two and allocate both mirrored halves
+	capacity = 2;
+	while(capacity<size) capacity *= 2;
+	buf->d = (double*)calloc(2*capacity,sizeof(double));
 	if(buf->d==NULL){
 		fprintf(stderr,"ERROR in rc_ringbuf_alloc, failed to allocate memory\n");
 		return -1;
 	}
 	// write out other details
 	buf->size = size;
+	buf->capacity = capacity;
 	buf->initialized = 1;
 	return 0;
 }
@@ -89,9 +111,11 @@ int rc_ringbuf_reset(rc_ringbuf_t* buf)
 		fprintf(stderr,"ERROR rc_ringbuf_reset, ringbuf uninitialized\n");
 		return -1;
 	}
-	// wipe the data and index
-	memset(buf->d,0,buf->size*sizeof(double));
+	// wipe the data, index and statistics
+	memset(buf->d,0,2*buf->capacity*sizeof(double));
 	buf->index=0;
+	buf->mean=0.0;
+	buf->m2=0.0;
 	return 0;
 }
 
@@ -99,6 +123,7 @@ int rc_ringbuf_reset(rc_ringbuf_t* buf)
 int rc_ringbuf_insert(rc_ringbuf_t* buf, double val)
 {
 	int new_index;
+	double old, delta, new_mean;
 	// sanity checks
 	if(unlikely(buf==NULL)){
 		fprintf(stderr,"ERROR in rc_ringbuf_insert, received NULL pointer\n");
@@ -108,19 +133,28 @@ int rc_ringbuf_insert(rc_ringbuf_t* buf, double val)
 		fprintf(stderr,"ERROR in rc_ringbuf_insert, ringbuf uninitialized\n");
 		return -1;
 	}
-	// increment index and check for loop-around
-	new_index=buf->index+1;
-	if(new_index>=buf->size) new_index=0;
-	// write out new value
-	buf->d[new_index]=val;
-	buf->index=new_index;
+	// value about to drop out of the last size values, the mirror half keeps
+	// it contiguous behind the index
+	old = buf->d[buf->index + buf->capacity - buf->size + 1];
+	// increment index with loop-around, capacity is a power of two
+	new_index = (buf->index+1) & (buf->capacity-1);
+	// write out new value to both halves
+	buf->d[new_index] = val;
+	buf->d[new_index+buf->capacity] = val;
+	buf->index = new_index;
+	// replace old with val in the running mean and variance
+	delta = val - old;
+	new_mean = buf->mean + delta/(double)buf->size;
+	buf->m2 += delta*(val - new_mean + old - buf->mean);
+	buf->mean = new_mean;
+	// start from exact values once per lap so rounding can't build up
+	if(new_index==0) __ringbuf_resync(buf);
 	return 0;
 }
 
 
 double rc_ringbuf_get_value(rc_ringbuf_t* buf, int pos)
 {
-	int return_index;
 	// sanity checks
 	if(unlikely(buf==NULL)){
 		fprintf(stderr,"ERROR in rc_ringbuf_get_value, received NULL pointer\n");
@@ -134,35 +168,49 @@ double rc_ringbuf_get_value(rc_ringbuf_t* buf, int pos)
 		fprintf(stderr,"ERROR in rc_ringbuf_get_value, ringbuf uninitialized\n");
 		return -1.0f;
 	}
-	// check for looparound
-	return_index=buf->index-pos;
-	if(return_index<0) return_index+=buf->size;
-	return buf->d[return_index];
+	// the mirrored half means no looparound check
+	return buf->d[buf->index + buf->capacity - pos];
 }
 
 
-double rc_ringbuf_std_dev(rc_ringbuf_t buf)
+const double* rc_ringbuf_get_window(rc_ringbuf_t* buf, int n)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_get_window, received NULL pointer\n");
+		return NULL;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_get_window, ringbuf uninitialized\n");
+		return NULL;
+	}
+	if(unlikely(n<1 || n>buf->size)){
+		fprintf(stderr,"ERROR in rc_ringbuf_get_window, n out of bounds\n");
+		return NULL;
+	}
+	return buf->d + buf->index + buf->capacity - n + 1;
+}
+
+
+double rc_ringbuf_mean(rc_ringbuf_t buf)
 {
-	int i;
-	double mean, mean_sqr, diff;
 	// sanity checks
 	if(unlikely(!buf.initialized)){
-		fprintf(stderr,"ERROR in rc_ringbuf_std_dev, ringbuf not initialized yet\n");
+		fprintf(stderr,"ERROR in rc_ringbuf_mean, ringbuf not initialized yet\n");
 		return -1.0f;
 	}
-	// shortcut if buffer is of length 1
-	if(buf.size == 1) return 0.0f;
-	// calculate mean
-	mean = 0.0f;
-	for(i=0;i<buf.size;i++) mean+=buf.d[i];
-	mean = mean/(double)buf.size;
-	// calculate mean square
-	mean_sqr = 0.0f;
-	for(i=0;i<buf.size;i++){
-		diff = buf.d[i]-mean;
-		mean_sqr += diff*diff;
-	}
-	return sqrt(mean_sqr/(double)(buf.size-1));
+	return buf.mean;
 }
 
 
+double rc_ringbuf_std_dev(rc_ringbuf_t buf)
+{
+	// sanity checks
+	if(unlikely(!buf.initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_std_dev, ringbuf not initialized yet\n");
+		return -1.0f;
+	}
+	// rounding can leave m2 a hair below 0 when all values are equal
+	if(buf.m2<=0.0) return 0.0;
+	return sqrt(buf.m2/(double)(buf.size-1));
+}
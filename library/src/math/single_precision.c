@@ -0,0 +1,231 @@
+/**
+ * @file math/single_precision.c
+ *
+ * @brief      Float versions of the vector, matrix, filter and small matrix
+ *             functions, see <rc/math/single_precision.h>.
+ *
+ *             This compiles the same *_impl.h templates as vector.c,
+ *             matrix.c, filter.c and small_matrix.c with RC_MATH_FLOAT set.
+ *             Only the filter history and the conversions are written here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>	// for memcpy memset
+#include <math.h>
+#include <float.h>	// for FLT_MAX
+
+#define RC_MATH_FLOAT
+
+#include <rc/math/other.h>
+#include <rc/math/vector.h>	// for zero_tolerance
+#include <rc/math/single_precision.h>
+#include "algebra_common.h"
+#include "precision.h"
+
+/*
+ * Filter history, the same mirrored power of two layout as rc_ringbuf_t in
+ * ring_buffer.c so get_window is one contiguous run. The filter already
+ * checks its own arguments so these only check what could still go wrong.
+ */
+
+static int __ringbuff_free(rc_ringbuff_t* buf)
+{
+	rc_ringbuff_t new = RC_RINGBUFF_INITIALIZER;
+	if(buf->initialized) free(buf->d);
+	*buf = new;
+	return 0;
+}
+
+
+static int __ringbuff_alloc(rc_ringbuff_t* buf, int size)
+{
+	int capacity;
+	if(unlikely(size<2 || size>(1<<29))){
+		fprintf(stderr,"ERROR in rc_filterf history, size must be >=2 and <=2^29\n");
+		return -1;
+	}
+	if(buf->initialized && buf->size==size && buf->d!=NULL) return 0;
+	__ringbuff_free(buf);
+	capacity = 2;
+	while(capacity<size) capacity *= 2;
+	buf->d = (float*)calloc(2*capacity,sizeof(float));
+	if(buf->d==NULL){
+		fprintf(stderr,"ERROR in rc_filterf history, failed to allocate memory\n");
+		return -1;
+	}
+	buf->size = size;
+	buf->capacity = capacity;
+	buf->initialized = 1;
+	return 0;
+}
+
+
+static int __ringbuff_reset(rc_ringbuff_t* buf)
+{
+	if(unlikely(!buf->initialized)) return -1;
+	memset(buf->d,0,2*buf->capacity*sizeof(float));
+	buf->index=0;
+	return 0;
+}
+
+
+static int __ringbuff_insert(rc_ringbuff_t* buf, float val)
+{
+	int new_index;
+	if(unlikely(!buf->initialized)) return -1;
+	new_index = (buf->index+1) & (buf->capacity-1);
+	buf->d[new_index] = val;
+	buf->d[new_index+buf->capacity] = val;
+	buf->index = new_index;
+	return 0;
+}
+
+
+static float __ringbuff_get_value(rc_ringbuff_t* buf, int pos)
+{
+	if(unlikely(!buf->initialized || pos<0 || pos>buf->size-1)){
+		fprintf(stderr,"ERROR in rc_filterf history, position out of bounds\n");
+		return -1.0f;
+	}
+	return buf->d[buf->index + buf->capacity - pos];
+}
+
+
+static const float* __ringbuff_get_window(rc_ringbuff_t* buf, int n)
+{
+	if(unlikely(!buf->initialized || n<1 || n>buf->size)) return NULL;
+	return buf->d + buf->index + buf->capacity - n + 1;
+}
+
+
+#include "vector_impl.h"
+#include "matrix_impl.h"
+#include "filter_impl.h"
+
+#define SM_PASTE_(a,b,c)	a##b##c
+#define SM_PASTE(a,b,c)		SM_PASTE_(a,b,c)
+
+#define SM_N 2
+#include "small_matrix_impl.h"
+#undef SM_N
+
+#define SM_N 3
+#include "small_matrix_impl.h"
+#undef SM_N
+
+#define SM_N 4
+#include "small_matrix_impl.h"
+#undef SM_N
+
+#define SM_N 5
+#include "small_matrix_impl.h"
+#undef SM_N
+
+#define SM_N 6
+#include "small_matrix_impl.h"
+#undef SM_N
+
+
+int rc_vectorf_from_vector(rc_vectorf_t* out, rc_vector_t v)
+{
+	int i;
+	if(unlikely(!v.initialized)){
+		fprintf(stderr,"ERROR in rc_vectorf_from_vector, vector not initialized yet\n");
+		return -1;
+	}
+	if(unlikely(rc_vectorf_alloc(out,v.len))){
+		fprintf(stderr,"ERROR in rc_vectorf_from_vector, failed to allocate vector\n");
+		return -1;
+	}
+	for(i=0;i<v.len;i++) out->d[i] = (float)v.d[i];
+	return 0;
+}
+
+
+int rc_vectorf_to_vector(rc_vector_t* out, rc_vectorf_t v)
+{
+	int i;
+	if(unlikely(!v.initialized)){
+		fprintf(stderr,"ERROR in rc_vectorf_to_vector, vector not initialized yet\n");
+		return -1;
+	}
+	if(unlikely(rc_vector_alloc(out,v.len))){
+		fprintf(stderr,"ERROR in rc_vectorf_to_vector, failed to allocate vector\n");
+		return -1;
+	}
+	for(i=0;i<v.len;i++) out->d[i] = (double)v.d[i];
+	return 0;
+}
+
+
+int rc_matrixf_from_matrix(rc_matrixf_t* out, rc_matrix_t A)
+{
+	int i, j;
+	if(unlikely(!A.initialized)){
+		fprintf(stderr,"ERROR in rc_matrixf_from_matrix, matrix not initialized yet\n");
+		return -1;
+	}
+	if(unlikely(rc_matrixf_alloc(out,A.rows,A.cols))){
+		fprintf(stderr,"ERROR in rc_matrixf_from_matrix, failed to allocate matrix\n");
+		return -1;
+	}
+	for(i=0;i<A.rows;i++){
+		for(j=0;j<A.cols;j++) out->d[i][j] = (float)A.d[i][j];
+	}
+	return 0;
+}
+
+
+int rc_matrixf_to_matrix(rc_matrix_t* out, rc_matrixf_t A)
+{
+	int i, j;
+	if(unlikely(!A.initialized)){
+		fprintf(stderr,"ERROR in rc_matrixf_to_matrix, matrix not initialized yet\n");
+		return -1;
+	}
+	if(unlikely(rc_matrix_alloc(out,A.rows,A.cols))){
+		fprintf(stderr,"ERROR in rc_matrixf_to_matrix, failed to allocate matrix\n");
+		return -1;
+	}
+	for(i=0;i<A.rows;i++){
+		for(j=0;j<A.cols;j++) out->d[i][j] = (double)A.d[i][j];
+	}
+	return 0;
+}
+
+
+int rc_filterf_from_filter(rc_filterf_t* out, rc_filter_t f)
+{
+	rc_vectorf_t num = RC_VECTORF_INITIALIZER;
+	rc_vectorf_t den = RC_VECTORF_INITIALIZER;
+	int ret = -1;
+
+	if(unlikely(out==NULL)){
+		fprintf(stderr,"ERROR in rc_filterf_from_filter, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!f.initialized)){
+		fprintf(stderr,"ERROR in rc_filterf_from_filter, filter not initialized yet\n");
+		return -1;
+	}
+	if(rc_vectorf_from_vector(&num,f.num) || rc_vectorf_from_vector(&den,f.den)){
+		fprintf(stderr,"ERROR in rc_filterf_from_filter, failed to convert coefficients\n");
+		goto end;
+	}
+	if(rc_filterf_alloc(out,num,den,(float)f.dt)){
+		fprintf(stderr,"ERROR in rc_filterf_from_filter, failed to allocate filter\n");
+		goto end;
+	}
+	out->gain	= (float)f.gain;
+	out->sat_en	= f.sat_en;
+	out->sat_min	= (float)f.sat_min;
+	out->sat_max	= (float)f.sat_max;
+	out->ss_en	= f.ss_en;
+	out->ss_steps	= (float)f.ss_steps;
+	ret = 0;
+end:
+	rc_vectorf_free(&num);
+	rc_vectorf_free(&den);
+	return ret;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file math/small_matrix.c
+ *
+ * @brief      Fixed-size 2x2 through 6x6 matrix kernels, see
+ *             <rc/math/small_matrix.h>.
+ *
+ *             The generic kernels are written once in small_matrix_impl.h and
+ *             instantiated here for each size, single_precision.c does the
+ *             same for the float versions.
+ */
+
+#include <stdio.h>
+#include <string.h>	// for memcpy
+#include <math.h>	// for fabs, sqrt
+
+#include <rc/math/vector.h>	// for zero_tolerance
+#include <rc/math/small_matrix.h>
+#include "algebra_common.h"
+#include "precision.h"
+
+#define SM_PASTE_(a,b,c)	a##b##c
+#define SM_PASTE(a,b,c)		SM_PASTE_(a,b,c)
+
+#define SM_N 2
+#include "small_matrix_impl.h"
+#undef SM_N
+
+#define SM_N 3
+#include "small_matrix_impl.h"
+#undef SM_N
+
+#define SM_N 4
+#include "small_matrix_impl.h"
+#undef SM_N
+
+#define SM_N 5
+#include "small_matrix_impl.h"
+#undef SM_N
+
+#define SM_N 6
+#include "small_matrix_impl.h"
+#undef SM_N
+
@@ -0,0 +1,297 @@
+/**
+ * @file math/small_matrix_impl.h
+ *
+ * Body of the fixed-size matrix kernels, included once per size by
+ * small_matrix.c with SM_N defined as the dimension, and again by
+ * single_precision.c for the float rc_matNf_t. Every loop bound is the
+ * constant SM_N so the compiler unrolls the loops completely.
+ */
+
+#ifndef SM_N
+#error "define SM_N before including small_matrix_impl.h"
+#endif
+#ifndef RC_REAL
+#error "include precision.h before small_matrix_impl.h"
+#endif
+
+#ifdef RC_MATH_FLOAT
+#define SM_T		SM_PASTE(rc_mat, SM_N, f_t)
+#define SM_FN(name)	SM_PASTE(rc_mat, SM_N, f_##name)
+#else
+#define SM_T		SM_PASTE(rc_mat, SM_N, _t)
+#define SM_FN(name)	SM_PASTE(rc_mat, SM_N, _##name)
+#endif
+
+
+void SM_FN(identity)(SM_T* A)
+{
+	int i, j;
+	for(i=0;i<SM_N;i++){
+		for(j=0;j<SM_N;j++) A->d[i][j] = (i==j) ? RC_R(1.0) : RC_R(0.0);
+	}
+}
+
+
+void SM_FN(multiply)(const SM_T* A, const SM_T* B, SM_T* C)
+{
+	int i, j, k;
+	SM_T tmp;
+	for(i=0;i<SM_N;i++){
+		for(j=0;j<SM_N;j++){
+			RC_REAL sum = RC_R(0.0);
+			for(k=0;k<SM_N;k++) sum += A->d[i][k]*B->d[k][j];
+			tmp.d[i][j] = sum;
+		}
+	}
+	*C = tmp;
+}
+
+
+void SM_FN(multiply_bt)(const SM_T* A, const SM_T* B, SM_T* C)
+{
+	int i, j, k;
+	SM_T tmp;
+	for(i=0;i<SM_N;i++){
+		for(j=0;j<SM_N;j++){
+			RC_REAL sum = RC_R(0.0);
+			for(k=0;k<SM_N;k++) sum += A->d[i][k]*B->d[j][k];
+			tmp.d[i][j] = sum;
+		}
+	}
+	*C = tmp;
+}
+
+
+void SM_FN(transpose)(const SM_T* A, SM_T* T)
+{
+	int i, j;
+	SM_T tmp;
+	for(i=0;i<SM_N;i++){
+		for(j=0;j<SM_N;j++) tmp.d[j][i] = A->d[i][j];
+	}
+	*T = tmp;
+}
+
+
+void SM_FN(add)(const SM_T* A, const SM_T* B, SM_T* C)
+{
+	int i, j;
+	for(i=0;i<SM_N;i++){
+		for(j=0;j<SM_N;j++) C->d[i][j] = A->d[i][j] + B->d[i][j];
+	}
+}
+
+
+void SM_FN(times_vec)(const SM_T* A, const RC_REAL x[SM_N], RC_REAL y[SM_N])
+{
+	int i, k;
+	RC_REAL tmp[SM_N];
+	for(i=0;i<SM_N;i++){
+		RC_REAL sum = RC_R(0.0);
+		for(k=0;k<SM_N;k++) sum += A->d[i][k]*x[k];
+		tmp[i] = sum;
+	}
+	for(i=0;i<SM_N;i++) y[i] = tmp[i];
+}
+
+
+int SM_FN(invert)(const SM_T* A, SM_T* Ainv)
+{
+#if SM_N==2
+	RC_REAL det = A->d[0][0]*A->d[1][1] - A->d[0][1]*A->d[1][0];
+	RC_REAL a00 = A->d[0][0];
+	if(unlikely(RC_FABS(det)<RC_ZERO_TOL)) return -1;
+	det = RC_R(1.0)/det;
+	Ainv->d[0][0] =  A->d[1][1]*det;
+	Ainv->d[0][1] = -A->d[0][1]*det;
+	Ainv->d[1][0] = -A->d[1][0]*det;
+	Ainv->d[1][1] =  a00*det;
+	return 0;
+#elif SM_N==3
+	// adjugate over determinant
+	SM_T c;
+	RC_REAL det;
+	int i, j;
+	c.d[0][0] = A->d[1][1]*A->d[2][2] - A->d[1][2]*A->d[2][1];
+	c.d[0][1] = A->d[0][2]*A->d[2][1] - A->d[0][1]*A->d[2][2];
+	c.d[0][2] = A->d[0][1]*A->d[1][2] - A->d[0][2]*A->d[1][1];
+	c.d[1][0] = A->d[1][2]*A->d[2][0] - A->d[1][0]*A->d[2][2];
+	c.d[1][1] = A->d[0][0]*A->d[2][2] - A->d[0][2]*A->d[2][0];
+	c.d[1][2] = A->d[0][2]*A->d[1][0] - A->d[0][0]*A->d[1][2];
+	c.d[2][0] = A->d[1][0]*A->d[2][1] - A->d[1][1]*A->d[2][0];
+	c.d[2][1] = A->d[0][1]*A->d[2][0] - A->d[0][0]*A->d[2][1];
+	c.d[2][2] = A->d[0][0]*A->d[1][1] - A->d[0][1]*A->d[1][0];
+	det = A->d[0][0]*c.d[0][0] + A->d[0][1]*c.d[1][0] + A->d[0][2]*c.d[2][0];
+	if(unlikely(RC_FABS(det)<RC_ZERO_TOL)) return -1;
+	det = RC_R(1.0)/det;
+	for(i=0;i<3;i++){
+		for(j=0;j<3;j++) Ainv->d[i][j] = c.d[i][j]*det;
+	}
+	return 0;
+#else
+	// LU decomposition with partial pivoting in place, unit lower triangle
+	// below the diagonal and U on and above it, then solve for each column
+	SM_T lu = *A, out;
+	int p[SM_N];
+	int i, j, k, piv;
+	RC_REAL max, t;
+	for(i=0;i<SM_N;i++) p[i] = i;
+	for(k=0;k<SM_N;k++){
+		piv = k;
+		max = RC_FABS(lu.d[k][k]);
+		for(i=k+1;i<SM_N;i++){
+			if(RC_FABS(lu.d[i][k])>max){
+				max = RC_FABS(lu.d[i][k]);
+				piv = i;
+			}
+		}
+		if(unlikely(max<RC_ZERO_TOL)) return -1;
+		if(piv!=k){
+			for(j=0;j<SM_N;j++){
+				t = lu.d[k][j];
+				lu.d[k][j] = lu.d[piv][j];
+				lu.d[piv][j] = t;
+			}
+			i = p[k]; p[k] = p[piv]; p[piv] = i;
+		}
+		t = RC_R(1.0)/lu.d[k][k];
+		for(i=k+1;i<SM_N;i++){
+			lu.d[i][k] *= t;
+			for(j=k+1;j<SM_N;j++) lu.d[i][j] -= lu.d[i][k]*lu.d[k][j];
+		}
+	}
+	// column j of the inverse solves LU x = P e_j
+	for(j=0;j<SM_N;j++){
+		RC_REAL x[SM_N];
+		for(i=0;i<SM_N;i++){
+			t = (p[i]==j) ? RC_R(1.0) : RC_R(0.0);
+			for(k=0;k<i;k++) t -= lu.d[i][k]*x[k];
+			x[i] = t;
+		}
+		for(i=SM_N-1;i>=0;i--){
+			t = x[i];
+			for(k=i+1;k<SM_N;k++) t -= lu.d[i][k]*x[k];
+			x[i] = t/lu.d[i][i];
+		}
+		for(i=0;i<SM_N;i++) out.d[i][j] = x[i];
+	}
+	*Ainv = out;
+	return 0;
+#endif
+}
+
+
+int SM_FN(invert_spd)(const SM_T* A, SM_T* Ainv)
+{
+	// A = L*L', then inv(A) = inv(L)'*inv(L)
+	SM_T L, Li;
+	int i, j, k;
+	RC_REAL t;
+	for(j=0;j<SM_N;j++){
+		t = A->d[j][j];
+		for(k=0;k<j;k++) t -= L.d[j][k]*L.d[j][k];
+		if(unlikely(t<RC_ZERO_TOL)) return -1;
+		L.d[j][j] = RC_SQRT(t);
+		// keep the reciprocal of the diagonal, the rest only divides by it
+		Li.d[j][j] = RC_R(1.0)/L.d[j][j];
+		for(i=j+1;i<SM_N;i++){
+			t = A->d[i][j];
+			for(k=0;k<j;k++) t -= L.d[i][k]*L.d[j][k];
+			L.d[i][j] = t*Li.d[j][j];
+		}
+	}
+	// inverse of the lower triangle, column by column
+	for(j=0;j<SM_N;j++){
+		for(i=j+1;i<SM_N;i++){
+			t = RC_R(0.0);
+			for(k=j;k<i;k++) t -= L.d[i][k]*Li.d[k][j];
+			Li.d[i][j] = t*Li.d[i][i];
+		}
+	}
+	// only the lower triangle of Li is valid, fill the symmetric result
+	for(i=0;i<SM_N;i++){
+		for(j=0;j<=i;j++){
+			t = RC_R(0.0);
+			for(k=i;k<SM_N;k++) t += Li.d[k][i]*Li.d[k][j];
+			Ainv->d[i][j] = t;
+			Ainv->d[j][i] = t;
+		}
+	}
+	return 0;
+}
+
+
+int SM_FN(from_matrix)(SM_T* out, RC_MAT_T A)
+{
+	int i;
+	if(unlikely(out==NULL)){
+		fprintf(stderr,"ERROR in " RC_SM_NAME "_from_matrix, received NULL pointer\n", SM_N);
+		return -1;
+	}
+	if(unlikely(!A.initialized || A.rows!=SM_N || A.cols!=SM_N)){
+		fprintf(stderr,"ERROR in " RC_SM_NAME "_from_matrix, matrix must be initialized and %dx%d\n",
+			SM_N, SM_N, SM_N);
+		return -1;
+	}
+	for(i=0;i<SM_N;i++) memcpy(out->d[i], A.d[i], SM_N*sizeof(RC_REAL));
+	return 0;
+}
+
+
+int SM_FN(to_matrix)(const SM_T* A, RC_MAT_T* out)
+{
+	if(unlikely(A==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in " RC_SM_NAME "_to_matrix, received NULL pointer\n", SM_N);
+		return -1;
+	}
+	if(unlikely(RC_MAT_FN(alloc)(out, SM_N, SM_N))){
+		fprintf(stderr,"ERROR in " RC_SM_NAME "_to_matrix, failed to allocate matrix\n", SM_N);
+		return -1;
+	}
+	// matrix data is one contiguous row-major block, same as ours
+	memcpy(out->d[0], A->d, sizeof(A->d));
+	return 0;
+}
+
+
+#if SM_N==3
+void SM_FN(from_quaternion)(const RC_REAL q[4], SM_T* R)
+{
+	RC_REAL q0s = q[0]*q[0];
+	RC_REAL q1s = q[1]*q[1];
+	RC_REAL q2s = q[2]*q[2];
+	RC_REAL q3s = q[3]*q[3];
+	// diagonal entries
+	R->d[0][0] = q0s+q1s-q2s-q3s;
+	R->d[1][1] = q0s-q1s+q2s-q3s;
+	R->d[2][2] = q0s-q1s-q2s+q3s;
+	// upper triangle
+	R->d[0][1] = RC_R(2.0) * (q[1]*q[2] - q[0]*q[3]);
+	R->d[0][2] = RC_R(2.0) * (q[1]*q[3] + q[0]*q[2]);
+	R->d[1][2] = RC_R(2.0) * (q[2]*q[3] - q[0]*q[1]);
+	// lower triangle
+	R->d[1][0] = RC_R(2.0) * (q[1]*q[2] + q[0]*q[3]);
+	R->d[2][0] = RC_R(2.0) * (q[1]*q[3] - q[0]*q[2]);
+	R->d[2][1] = RC_R(2.0) * (q[2]*q[3] + q[0]*q[1]);
+}
+
+
+void SM_FN(rotate_quaternion)(const RC_REAL q[4], const RC_REAL v[3], RC_REAL out[3])
+{
+	// t = 2 r x v
+	RC_REAL t0 = RC_R(2.0) * (q[2]*v[2] - q[3]*v[1]);
+	RC_REAL t1 = RC_R(2.0) * (q[3]*v[0] - q[1]*v[2]);
+	RC_REAL t2 = RC_R(2.0) * (q[1]*v[1] - q[2]*v[0]);
+	// v' = v + w t + r x t
+	RC_REAL o0 = v[0] + q[0]*t0 + q[2]*t2 - q[3]*t1;
+	RC_REAL o1 = v[1] + q[0]*t1 + q[3]*t0 - q[1]*t2;
+	RC_REAL o2 = v[2] + q[0]*t2 + q[1]*t1 - q[2]*t0;
+	out[0] = o0;
+	out[1] = o1;
+	out[2] = o2;
+}
+#endif
+
+
+#undef SM_T
+#undef SM_FN
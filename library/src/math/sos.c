@@ -0,0 +1,667 @@
+/**
+ * @file math/sos.c
+ *
+ * @brief      Cascades of second order sections, see <rc/math/sos.h>.
+ *
+ * Factoring an rc_filter_t needs the roots of its numerator and denominator.
+ * Those are found with the Aberth iteration which converges on all roots at
+ * once without deflation, so an error in one root doesn't spill into the
+ * others.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>	// for malloc, free, qsort
+#include <math.h>
+#include <float.h>	// for DBL_EPSILON
+#include <complex.h>
+
+#include <rc/math/sos.h>
+#include "algebra_common.h"
+
+#define ROOT_MAX_ITER	500
+
+// poles and zeros of one section while factoring a filter
+typedef struct sos_build_t{
+	int np;			// number of poles, 0 1 or 2
+	int pcplx;		// poles are the complex pair p[0], conj(p[0])
+	double complex p[2];
+	int nz;			// number of zeros, at most np
+	int zcplx;		// zeros are the complex pair z[0], conj(z[0])
+	double complex z[2];
+	double radius;		// largest pole magnitude, sets the order of sections
+} sos_build_t;
+
+
+/**
+ * Finds all n roots of the polynomial p[0]x^n + ... + p[n] with the Aberth
+ * iteration. p[0] must not be 0.
+ */
+static void __poly_roots(const double* p, int n, double complex* r)
+{
+	int i, j, k, iter;
+	double radius, w_max, w_abs;
+	double complex val, d, ratio, sum, w;
+
+	// start evenly spread on a circle of the geometric mean root magnitude,
+	// rotated off the real axis so conjugate pairs can separate
+	radius = pow(fabs(p[n]/p[0]), 1.0/n);
+	if(!(radius>1e-8)) radius = 1.0;
+	for(i=0;i<n;i++){
+		r[i] = CMPLX(radius*cos(2.0*M_PI*i/n + 0.4), radius*sin(2.0*M_PI*i/n + 0.4));
+	}
+
+	for(iter=0;iter<ROOT_MAX_ITER;iter++){
+		w_max = 0.0;
+		for(i=0;i<n;i++){
+			// value and derivative by Horner's method
+			val = p[0];
+			d = 0.0;
+			for(k=1;k<=n;k++){
+				d = d*r[i] + val;
+				val = val*r[i] + p[k];
+			}
+			if(cabs(val)<DBL_MIN) continue;	// landed right on the root
+			if(cabs(d)<DBL_MIN){		// flat spot, nudge off it
+				r[i] += 1e-8*(1.0+cabs(r[i]));
+				w_max = 1.0;
+				continue;
+			}
+			ratio = val/d;
+			sum = 0.0;
+			for(j=0;j<n;j++) if(j!=i) sum += 1.0/(r[i]-r[j]);
+			w = ratio/(1.0 - ratio*sum);
+			r[i] -= w;
+			w_abs = cabs(w)/(1.0+cabs(r[i]));
+			if(w_abs>w_max) w_max = w_abs;
+		}
+		if(w_max<4.0*DBL_EPSILON) break;
+	}
+	return;
+}
+
+
+/**
+ * Roots of p[0]x^n + ... + p[n] as __poly_roots, but roots at exactly 0, -1
+ * and 1 are divided out first. Tustin discretization puts every zero at
+ * infinity at z=-1 and every zero at the origin at z=1, often several at once.
+ * A root of multiplicity m can only be found to about the m-th root of
+ * machine precision by iteration, which would show up as a gain error once
+ * the cluster is split across sections. work needs n+1 doubles.
+ */
+static void __poly_roots_deflated(const double* p, int n, double complex* r, double* work)
+{
+	int i, m, found, t;
+	double norm, rem, prev, target;
+	const double targets[] = {-1.0, 1.0};
+
+	for(i=0;i<=n;i++) work[i] = p[i];
+	m = n;
+	found = 0;
+	norm = 0.0;
+	for(i=0;i<=n;i++) norm += fabs(p[i]);
+	// trailing zero coefficients are roots at the origin
+	while(m>0 && fabs(work[m])<=1e-14*norm){
+		r[found++] = 0.0;
+		m--;
+	}
+	for(t=0;t<2;t++){
+		target = targets[t];
+		while(m>0){
+			// synthetic division by (x - target), done in place once the
+			// remainder shows target really is a root
+			norm = 0.0;
+			for(i=0;i<=m;i++) norm += fabs(work[i]);
+			rem = work[0];
+			for(i=1;i<=m;i++) rem = rem*target + work[i];
+			if(fabs(rem)>1e-10*norm) break;
+			prev = work[0];
+			for(i=1;i<m;i++){
+				work[i] = work[i] + prev*target;
+				prev = work[i];
+			}
+			r[found++] = target;
+			m--;
+		}
+	}
+	if(m>0) __poly_roots(work, m, r+found);
+	return;
+}
+
+
+/**
+ * Splits raw roots into n_real real roots written to re and n_cplx complex
+ * pairs written to cx as the member with positive imaginary part. Roots within
+ * rounding of the real axis are taken as real, pairs are averaged so they are
+ * exact conjugates.
+ */
+static void __sort_roots(double complex* r, int n, double* re, int* n_real,
+						double complex* cx, int* n_cplx)
+{
+	int i, j, best;
+	double tol, dist, best_dist;
+	double complex tmp;
+
+	*n_real = 0;
+	*n_cplx = 0;
+	for(i=0;i<n;i++){
+		tol = 1e-7*(1.0+cabs(r[i]));
+		if(fabs(cimag(r[i]))<=tol){
+			re[(*n_real)++] = creal(r[i]);
+			continue;
+		}
+		// find the closest partner on the other side of the real axis
+		best = -1;
+		best_dist = 0.0;
+		for(j=i+1;j<n;j++){
+			if(cimag(r[j])*cimag(r[i])>0.0) continue;
+			dist = cabs(r[j]-conj(r[i]));
+			if(best<0 || dist<best_dist){
+				best = j;
+				best_dist = dist;
+			}
+		}
+		if(best<0){
+			// no partner, only possible through rounding
+			re[(*n_real)++] = creal(r[i]);
+			continue;
+		}
+		if(cimag(r[i])>0.0) cx[(*n_cplx)++] = 0.5*(r[i]+conj(r[best]));
+		else cx[(*n_cplx)++] = 0.5*(conj(r[i])+r[best]);
+		// the partner is used up, move it past the end
+		n--;
+		tmp = r[best];
+		r[best] = r[n];
+		r[n] = tmp;
+	}
+	return;
+}
+
+
+static int __compare_abs(const void* a, const void* b)
+{
+	double x = fabs(*(const double*)a);
+	double y = fabs(*(const double*)b);
+	return (x>y) - (x<y);
+}
+
+
+static int __compare_radius(const void* a, const void* b)
+{
+	double x = ((const sos_build_t*)a)->radius;
+	double y = ((const sos_build_t*)b)->radius;
+	return (x>y) - (x<y);
+}
+
+
+// distance from a zero to the nearest pole of a section
+static double __pole_distance(sos_build_t* sec, double complex z)
+{
+	double d = cabs(z-sec->p[0]);
+	if(sec->np==2 && !sec->pcplx && cabs(z-sec->p[1])<d) d = cabs(z-sec->p[1]);
+	return d;
+}
+
+
+// writes coefficients of prod(1 - r z^-1), up to 2 roots, into c starting
+// after delay leading zeros
+static void __section_poly(double* c, int n, int cplx, double complex* r, int delay)
+{
+	c[0] = c[1] = c[2] = 0.0;
+	if(n==0) c[delay] = 1.0;
+	else if(n==1){
+		c[delay] = 1.0;
+		c[delay+1] = -creal(r[0]);
+	}
+	else if(cplx){
+		c[0] = 1.0;
+		c[1] = -2.0*creal(r[0]);
+		c[2] = creal(r[0])*creal(r[0]) + cimag(r[0])*cimag(r[0]);
+	}
+	else{
+		c[0] = 1.0;
+		c[1] = -creal(r[0])-creal(r[1]);
+		c[2] = creal(r[0])*creal(r[1]);
+	}
+	return;
+}
+
+
+rc_sos_t rc_sos_empty(void)
+{
+	rc_sos_t out = RC_SOS_INITIALIZER;
+	return out;
+}
+
+
+int rc_sos_alloc(rc_sos_t* s, rc_matrix_t sos, double dt)
+{
+	int i, j;
+	double a0;
+
+	// sanity checks
+	if(unlikely(s==NULL)){
+		fprintf(stderr,"ERROR in rc_sos_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!sos.initialized || sos.cols!=6)){
+		fprintf(stderr,"ERROR in rc_sos_alloc, sos must be initialized with 6 columns\n");
+		return -1;
+	}
+	if(unlikely(dt<=0.0)){
+		fprintf(stderr,"ERROR in rc_sos_alloc, dt must be >0\n");
+		return -1;
+	}
+	for(i=0;i<sos.rows;i++){
+		if(unlikely(fabs(sos.d[i][3])<zero_tolerance)){
+			fprintf(stderr,"ERROR in rc_sos_alloc, a0 of section %d is 0\n", i);
+			return -1;
+		}
+	}
+	// free existing memory, this also zeros out all fields
+	rc_sos_free(s);
+
+	if(unlikely(rc_matrix_duplicate(sos, &s->sos) ||
+		    rc_matrix_zeros(&s->state, sos.rows, 2))){
+		fprintf(stderr,"ERROR in rc_sos_alloc, failed to allocate memory\n");
+		rc_sos_free(s);
+		return -1;
+	}
+	// normalize every section so a0 is 1
+	for(i=0;i<sos.rows;i++){
+		a0 = s->sos.d[i][3];
+		for(j=0;j<6;j++) s->sos.d[i][j] /= a0;
+	}
+	s->sections = sos.rows;
+	s->dt = dt;
+	s->initialized = 1;
+	return 0;
+}
+
+
+int rc_sos_free(rc_sos_t* s)
+{
+	rc_sos_t new = RC_SOS_INITIALIZER;
+	if(unlikely(s==NULL)){
+		fprintf(stderr,"ERROR in rc_sos_free, received NULL pointer\n");
+		return -1;
+	}
+	rc_matrix_free(&s->sos);
+	rc_matrix_free(&s->state);
+	*s = new;
+	return 0;
+}
+
+
+int rc_sos_print(rc_sos_t s)
+{
+	int i;
+	if(unlikely(!s.initialized)){
+		fprintf(stderr,"ERROR in rc_sos_print, sos not initialized yet\n");
+		return -1;
+	}
+	printf("sections: %d\n", s.sections);
+	printf("timestep dt: %0.4f\n", s.dt);
+	printf("gain: %0.4f\n", s.gain);
+	printf("       b0         b1         b2         a1         a2\n");
+	for(i=0;i<s.sections;i++){
+		printf("%10.6f %10.6f %10.6f %10.6f %10.6f\n", s.sos.d[i][0],
+			s.sos.d[i][1], s.sos.d[i][2], s.sos.d[i][4], s.sos.d[i][5]);
+	}
+	return 0;
+}
+
+
+int rc_sos_reset(rc_sos_t* s)
+{
+	int i;
+	if(unlikely(s==NULL || !s->initialized)){
+		fprintf(stderr,"ERROR in rc_sos_reset, sos uninitialized\n");
+		return -1;
+	}
+	for(i=0;i<2*s->sections;i++) s->state.d[0][i] = 0.0;
+	s->newest_input = 0.0;
+	s->newest_output = 0.0;
+	s->step = 0;
+	return 0;
+}
+
+
+int rc_sos_prefill(rc_sos_t* s, double in)
+{
+	int i;
+	double x, y, dc;
+	double* c;
+
+	if(unlikely(s==NULL || !s->initialized)){
+		fprintf(stderr,"ERROR in rc_sos_prefill, sos uninitialized\n");
+		return -1;
+	}
+	x = in;
+	for(i=0;i<s->sections;i++){
+		c = s->sos.d[i];
+		dc = 1.0 + c[4] + c[5];
+		if(unlikely(fabs(dc)<zero_tolerance)){
+			fprintf(stderr,"ERROR in rc_sos_prefill, section %d has a pole at z=1\n", i);
+			return -1;
+		}
+		// solve the state equations with the input and output held constant
+		y = x*(c[0]+c[1]+c[2])/dc;
+		s->state.d[i][1] = c[2]*x - c[5]*y;
+		s->state.d[i][0] = y - c[0]*x;
+		x = y;
+	}
+	s->newest_input = in;
+	s->newest_output = x*s->gain;
+	return 0;
+}
+
+
+double rc_sos_march(rc_sos_t* s, double in)
+{
+	int i;
+	double x, y;
+	double* c;
+	double* z;
+
+	if(unlikely(!s->initialized)){
+		fprintf(stderr,"ERROR in rc_sos_march, sos uninitialized\n");
+		return -1.0;
+	}
+	x = in;
+	for(i=0;i<s->sections;i++){
+		c = s->sos.d[i];
+		z = s->state.d[i];
+		y = c[0]*x + z[0];
+		z[0] = c[1]*x - c[4]*y + z[1];
+		z[1] = c[2]*x - c[5]*y;
+		x = y;
+	}
+	if(fabs(s->gain - 1.0) > zero_tolerance) x *= s->gain;
+	s->newest_input = in;
+	s->newest_output = x;
+	s->step++;
+	return x;
+}
+
+
+int rc_sos_process(rc_sos_t* s, const double* in, double* out, int n)
+{
+	int i, k;
+	double b0, b1, b2, a1, a2, z1, z2, x, y, last_in;
+	const double* src;
+
+	if(unlikely(s==NULL || in==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_sos_process, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!s->initialized)){
+		fprintf(stderr,"ERROR in rc_sos_process, sos uninitialized\n");
+		return -1;
+	}
+	if(n<1) return 0;
+	last_in = in[n-1];	// in and out may be the same
+
+	// whole block through one section at a time so its coefficients and
+	// state stay in registers, later sections work in place on out
+	src = in;
+	for(i=0;i<s->sections;i++){
+		b0 = s->sos.d[i][0];
+		b1 = s->sos.d[i][1];
+		b2 = s->sos.d[i][2];
+		a1 = s->sos.d[i][4];
+		a2 = s->sos.d[i][5];
+		z1 = s->state.d[i][0];
+		z2 = s->state.d[i][1];
+		for(k=0;k<n;k++){
+			x = src[k];
+			y = b0*x + z1;
+			z1 = b1*x - a1*y + z2;
+			z2 = b2*x - a2*y;
+			out[k] = y;
+		}
+		s->state.d[i][0] = z1;
+		s->state.d[i][1] = z2;
+		src = out;
+	}
+	if(fabs(s->gain - 1.0) > zero_tolerance){
+		for(k=0;k<n;k++) out[k] *= s->gain;
+	}
+	s->newest_input = last_in;
+	s->newest_output = out[n-1];
+	s->step += n;
+	return 0;
+}
+
+
+int rc_sos_from_filter(rc_sos_t* s, rc_filter_t f)
+{
+	int i, j, first, np, nz, n_sec, n_re_p, n_cx_p, n_re_z, n_cx_z;
+	int ret = -1;
+	int best;
+	double k, num_max, d, best_d;
+	double* re_p;
+	double* re_z;
+	double* work;
+	double complex* roots = NULL;
+	double complex* cx_p;
+	double complex* cx_z;
+	sos_build_t* sec = NULL;
+	rc_matrix_t M = RC_MATRIX_INITIALIZER;
+
+	// sanity checks
+	if(unlikely(s==NULL)){
+		fprintf(stderr,"ERROR in rc_sos_from_filter, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!f.initialized)){
+		fprintf(stderr,"ERROR in rc_sos_from_filter, filter uninitialized\n");
+		return -1;
+	}
+	if(unlikely(fabs(f.den.d[0])<zero_tolerance)){
+		fprintf(stderr,"ERROR in rc_sos_from_filter, leading denominator coefficient is 0\n");
+		return -1;
+	}
+	// leading numerator coefficients that are 0 only add delay
+	num_max = 0.0;
+	for(i=0;i<f.num.len;i++) if(fabs(f.num.d[i])>num_max) num_max = fabs(f.num.d[i]);
+	for(first=0;first<f.num.len-1;first++){
+		if(fabs(f.num.d[first])>1e-12*num_max) break;
+	}
+	np = f.order;
+	nz = f.num.len-1-first;
+	k = f.num.d[first]/f.den.d[0];
+	n_sec = (np+1)/2;
+	if(n_sec<1) n_sec = 1;
+
+	// one block for all the scratch space
+	roots = (double complex*)malloc(np*3*sizeof(double complex) + (3*np+1)*sizeof(double));
+	sec = (sos_build_t*)calloc(n_sec, sizeof(sos_build_t));
+	if(unlikely(roots==NULL || sec==NULL)){
+		fprintf(stderr,"ERROR in rc_sos_from_filter, failed to allocate memory\n");
+		goto END;
+	}
+	cx_p = roots + np;
+	cx_z = cx_p + np;
+	re_p = (double*)(cx_z + np);
+	re_z = re_p + np;
+	work = re_z + np;
+
+	// poles and zeros, zeros at infinity beyond nz become delays
+	if(np>0){
+		__poly_roots_deflated(f.den.d, np, roots, work);
+		__sort_roots(roots, np, re_p, &n_re_p, cx_p, &n_cx_p);
+	}
+	else n_re_p = n_cx_p = 0;
+	if(nz>0){
+		__poly_roots_deflated(f.num.d+first, nz, roots, work);
+		__sort_roots(roots, nz, re_z, &n_re_z, cx_z, &n_cx_z);
+	}
+	else n_re_z = n_cx_z = 0;
+
+	// complex pole pairs get a section each, real poles are paired up in
+	// order of magnitude leaving a first order section if the count is odd
+	qsort(re_p, n_re_p, sizeof(double), __compare_abs);
+	j = 0;
+	for(i=0;i<n_cx_p;i++,j++){
+		sec[j].np = 2;
+		sec[j].pcplx = 1;
+		sec[j].p[0] = cx_p[i];
+		sec[j].radius = cabs(cx_p[i]);
+	}
+	for(i=0;i<n_re_p;i+=2,j++){
+		sec[j].p[0] = re_p[i];
+		sec[j].radius = fabs(re_p[i]);
+		sec[j].np = 1;
+		if(i+1<n_re_p){
+			sec[j].p[1] = re_p[i+1];
+			sec[j].radius = fabs(re_p[i+1]);
+			sec[j].np = 2;
+		}
+	}
+	qsort(sec, n_sec, sizeof(sos_build_t), __compare_radius);
+
+	// complex zero pairs first, each to the free two pole section with the
+	// nearest pole. There are never more of them than two pole sections.
+	for(i=0;i<n_cx_z;i++){
+		best = -1;
+		best_d = 0.0;
+		for(j=0;j<n_sec;j++){
+			if(sec[j].np!=2 || sec[j].nz!=0) continue;
+			d = __pole_distance(&sec[j], cx_z[i]);
+			if(best<0 || d<best_d){
+				best = j;
+				best_d = d;
+			}
+		}
+		sec[best].zcplx = 1;
+		sec[best].nz = 2;
+		sec[best].z[0] = cx_z[i];
+	}
+	// then real zeros, sections with poles nearest the unit circle first
+	// taking the zeros nearest their poles
+	for(j=n_sec-1;j>=0 && n_re_z>0;j--){
+		while(sec[j].nz<sec[j].np && n_re_z>0){
+			best = 0;
+			for(i=1;i<n_re_z;i++){
+				if(__pole_distance(&sec[j],re_z[i])<__pole_distance(&sec[j],re_z[best])) best = i;
+			}
+			sec[j].z[sec[j].nz++] = re_z[best];
+			re_z[best] = re_z[--n_re_z];
+		}
+	}
+
+	// multiply out each section, overall gain goes into the first
+	if(unlikely(rc_matrix_zeros(&M, n_sec, 6))){
+		fprintf(stderr,"ERROR in rc_sos_from_filter, failed to allocate memory\n");
+		goto END;
+	}
+	for(j=0;j<n_sec;j++){
+		if(sec[j].np==0){
+			M.d[j][0] = 1.0;
+			M.d[j][3] = 1.0;
+			continue;
+		}
+		__section_poly(&M.d[j][0], sec[j].nz, sec[j].zcplx, sec[j].z, sec[j].np-sec[j].nz);
+		__section_poly(&M.d[j][3], sec[j].np, sec[j].pcplx, sec[j].p, 0);
+	}
+	for(i=0;i<3;i++) M.d[0][i] *= k;
+
+	if(unlikely(rc_sos_alloc(s, M, f.dt))){
+		fprintf(stderr,"ERROR in rc_sos_from_filter, failed to alloc sos\n");
+		goto END;
+	}
+	s->gain = f.gain;
+	ret = 0;
+
+END:
+	free(roots);
+	free(sec);
+	rc_matrix_free(&M);
+	return ret;
+}
+
+
+// shared by the lowpass and highpass designs
+static int __sos_butterworth(rc_sos_t* s, int order, double dt, double wc, int high)
+{
+	int i, j, n_sec;
+	double a, c, alpha, beta, A0;
+	rc_matrix_t M = RC_MATRIX_INITIALIZER;
+
+	if(unlikely(order<1)){
+		fprintf(stderr,"ERROR in rc_sos_butterworth, order must be >=1\n");
+		return -1;
+	}
+	if(unlikely(dt<=0.0 || wc<=0.0)){
+		fprintf(stderr,"ERROR in rc_sos_butterworth, dt and wc must be >0\n");
+		return -1;
+	}
+	if(unlikely(wc>(M_PI/dt))){
+		fprintf(stderr,"ERROR in rc_sos_butterworth, wc larger than nyquist frequency\n");
+		return -1;
+	}
+	// prewarped tustin s = c(z-1)/(z+1), same as rc_filter_c2d_tustin
+	a = 2.0*(1.0 - cos(wc*dt)) / (wc*dt*sin(wc*dt));
+	c = 2.0/(a*dt);
+	n_sec = (order+1)/2;
+	if(unlikely(rc_matrix_zeros(&M, n_sec, 6))){
+		fprintf(stderr,"ERROR in rc_sos_butterworth, failed to allocate memory\n");
+		return -1;
+	}
+	j = 0;
+	// the real pole of odd orders, (s/wc + 1). The highpass numerators are
+	// (s/wc)^n for unity gain in the passband.
+	if(order%2){
+		alpha = c/wc;
+		if(high){
+			M.d[j][0] = alpha;
+			M.d[j][1] = -alpha;
+		}
+		else{
+			M.d[j][0] = 1.0;
+			M.d[j][1] = 1.0;
+		}
+		M.d[j][3] = alpha + 1.0;
+		M.d[j][4] = 1.0 - alpha;
+		j++;
+	}
+	// quadratic factors (s^2/wc^2 + beta s + 1) of rc_poly_butter, most
+	// damped first so the sharpest resonance is last
+	for(i=order/2;i>=1;i--,j++){
+		alpha = c*c/(wc*wc);
+		beta = -2.0*cos(((2*i) + (order-1))*M_PI/(2.0*order))*c/wc;
+		A0 = alpha + beta + 1.0;
+		if(high){
+			M.d[j][0] = alpha;
+			M.d[j][1] = -2.0*alpha;
+			M.d[j][2] = alpha;
+		}
+		else{
+			M.d[j][0] = 1.0;
+			M.d[j][1] = 2.0;
+			M.d[j][2] = 1.0;
+		}
+		M.d[j][3] = A0;
+		M.d[j][4] = 2.0 - 2.0*alpha;
+		M.d[j][5] = alpha - beta + 1.0;
+	}
+	if(unlikely(rc_sos_alloc(s, M, dt))){
+		fprintf(stderr,"ERROR in rc_sos_butterworth, failed to alloc sos\n");
+		rc_matrix_free(&M);
+		return -1;
+	}
+	rc_matrix_free(&M);
+	return 0;
+}
+
+
+int rc_sos_butterworth_lowpass(rc_sos_t* s, int order, double dt, double wc)
+{
+	return __sos_butterworth(s, order, dt, wc, 0);
+}
+
+
+int rc_sos_butterworth_highpass(rc_sos_t* s, int order, double dt, double wc)
+{
+	return __sos_butterworth(s, order, dt, wc, 1);
+}
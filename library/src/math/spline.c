@@ -0,0 +1,458 @@
+/**
+ * @file math/spline.c
+ *
+ * @brief      Cubic and quintic splines, see <rc/math/spline.h>.
+ *
+ * Cubics are fitted for the second derivative M at each knot, which gives
+ * the usual symmetric tridiagonal system. Quintics are fitted for velocity and
+ * acceleration at each knot: given those and the positions, each segment is
+ * the unique quintic Hermite polynomial between its knots, and requiring its
+ * jerk and snap to match the next segment's at every interior knot gives two
+ * equations per knot, each coupling only the knots either side.
+ *
+ * Both systems are set up with time divided by the mean segment length and
+ * the coefficients scaled back afterwards, so how well conditioned they are
+ * depends only on the ratios of segment lengths and not on the units of time.
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+#include <rc/math/algebra.h>
+#include <rc/math/spline.h>
+#include "algebra_common.h"
+
+
+/**
+ * checks the arguments of a fit, allocates s and copies the knot times in,
+ * returns the mean segment length
+ */
+static double __setup(rc_spline_t* s, rc_vector_t t, rc_matrix_t p, int order, const char* fn)
+{
+	int i;
+	if(unlikely(s==NULL)){
+		fprintf(stderr,"ERROR in %s, received NULL pointer\n",fn);
+		return -1.0;
+	}
+	if(unlikely(!t.initialized || !p.initialized)){
+		fprintf(stderr,"ERROR in %s, vector or matrix uninitialized\n",fn);
+		return -1.0;
+	}
+	if(unlikely(t.len<2 || p.rows!=t.len)){
+		fprintf(stderr,"ERROR in %s, need at least 2 knots and one row of p per knot\n",fn);
+		return -1.0;
+	}
+	for(i=0;i<t.len;i++){
+		if(unlikely(!isfinite(t.d[i]) || (i>0 && !(t.d[i]>t.d[i-1])))){
+			fprintf(stderr,"ERROR in %s, knot times must be finite and strictly increasing\n",fn);
+			return -1.0;
+		}
+	}
+	if(unlikely(rc_vector_duplicate(t,&s->t) ||
+			rc_matrix_alloc(&s->c,(t.len-1)*p.cols,order+1))){
+		fprintf(stderr,"ERROR in %s, failed to allocate memory\n",fn);
+		return -1.0;
+	}
+	s->order = order;
+	s->knots = t.len;
+	s->dim = p.cols;
+	s->last = 0;
+	s->initialized = 1;
+	return (t.d[t.len-1]-t.d[0])/(t.len-1);
+}
+
+
+/**
+ * scales the coefficients of each power of tau by 1/k^power
+ */
+static void __scale_coefficients(rc_spline_t* s, double k)
+{
+	int i,m;
+	double f;
+	for(i=0;i<s->c.rows;i++){
+		f = 1.0;
+		for(m=1;m<=s->order;m++){
+			f /= k;
+			s->c.d[i][m] *= f;
+		}
+	}
+}
+
+
+rc_spline_t rc_spline_empty(void)
+{
+	rc_spline_t out = RC_SPLINE_INITIALIZER;
+	return out;
+}
+
+
+int rc_spline_free(rc_spline_t* s)
+{
+	rc_spline_t new = RC_SPLINE_INITIALIZER;
+	if(unlikely(s==NULL)){
+		fprintf(stderr,"ERROR in rc_spline_free, received NULL pointer\n");
+		return -1;
+	}
+	rc_vector_free(&s->t);
+	rc_matrix_free(&s->c);
+	*s = new;
+	return 0;
+}
+
+
+int rc_spline_cubic(rc_spline_t* s, rc_vector_t t, rc_matrix_t p, rc_spline_end_t end)
+{
+	int i,k,n,seg;
+	double T,h,d,*c;
+	rc_vector_t sub = RC_VECTOR_INITIALIZER;
+	rc_vector_t diag = RC_VECTOR_INITIALIZER;
+	rc_vector_t sup = RC_VECTOR_INITIALIZER;
+	rc_vector_t b = RC_VECTOR_INITIALIZER;
+	rc_vector_t h_n = RC_VECTOR_INITIALIZER;
+
+	T = __setup(s,t,p,3,"rc_spline_cubic");
+	if(unlikely(T<0.0)) return -1;
+	n = t.len;
+	if(unlikely(rc_vector_alloc(&sub,n-1) || rc_vector_alloc(&diag,n) ||
+			rc_vector_alloc(&sup,n-1) || rc_vector_alloc(&b,n) ||
+			rc_vector_alloc(&h_n,n-1))){
+		fprintf(stderr,"ERROR in rc_spline_cubic, failed to allocate memory\n");
+		goto fail;
+	}
+	// segment lengths in units of the mean
+	for(i=0;i<n-1;i++) h_n.d[i] = (t.d[i+1]-t.d[i])/T;
+
+	// h[i-1]*M[i-1] + 2(h[i-1]+h[i])*M[i] + h[i]*M[i+1] = 6(d[i]/h[i]-d[i-1]/h[i-1])
+	for(i=1;i<n-1;i++){
+		sub.d[i-1] = h_n.d[i-1];
+		diag.d[i] = 2.0*(h_n.d[i-1]+h_n.d[i]);
+		sup.d[i] = h_n.d[i];
+	}
+	if(end==RC_SPLINE_REST){
+		// velocity at each end is d/h -+ h(2M+M')/6, set to 0
+		diag.d[0] = 2.0*h_n.d[0];
+		sup.d[0] = h_n.d[0];
+		sub.d[n-2] = h_n.d[n-2];
+		diag.d[n-1] = 2.0*h_n.d[n-2];
+	}
+	else{
+		diag.d[0] = 1.0;
+		sup.d[0] = 0.0;
+		sub.d[n-2] = 0.0;
+		diag.d[n-1] = 1.0;
+	}
+
+	for(k=0;k<s->dim;k++){
+		for(i=1;i<n-1;i++){
+			b.d[i] = 6.0*((p.d[i+1][k]-p.d[i][k])/h_n.d[i] - (p.d[i][k]-p.d[i-1][k])/h_n.d[i-1]);
+		}
+		if(end==RC_SPLINE_REST){
+			b.d[0] = 6.0*(p.d[1][k]-p.d[0][k])/h_n.d[0];
+			b.d[n-1] = -6.0*(p.d[n-1][k]-p.d[n-2][k])/h_n.d[n-2];
+		}
+		else b.d[0] = b.d[n-1] = 0.0;
+		// b becomes M
+		if(unlikely(rc_algebra_tridiag_solve(sub,diag,sup,b,&b))){
+			fprintf(stderr,"ERROR in rc_spline_cubic, failed to solve for knots\n");
+			goto fail;
+		}
+		for(seg=0;seg<n-1;seg++){
+			h = h_n.d[seg];
+			d = p.d[seg+1][k]-p.d[seg][k];
+			c = s->c.d[seg*s->dim+k];
+			c[0] = p.d[seg][k];
+			c[1] = d/h - h*(2.0*b.d[seg]+b.d[seg+1])/6.0;
+			c[2] = 0.5*b.d[seg];
+			c[3] = (b.d[seg+1]-b.d[seg])/(6.0*h);
+		}
+	}
+	__scale_coefficients(s,T);
+	rc_vector_free(&sub);
+	rc_vector_free(&diag);
+	rc_vector_free(&sup);
+	rc_vector_free(&b);
+	rc_vector_free(&h_n);
+	return 0;
+
+fail:
+	rc_vector_free(&sub);
+	rc_vector_free(&diag);
+	rc_vector_free(&sup);
+	rc_vector_free(&b);
+	rc_vector_free(&h_n);
+	rc_spline_free(s);
+	return -1;
+}
+
+
+int rc_spline_quintic(rc_spline_t* s, rc_vector_t t, rc_matrix_t p, rc_spline_end_t end)
+{
+	int i,k,n,seg;
+	double T,h,hl,hr,d,dl,dr,v0,v1,a0,a1,*c;
+	rc_matrix_t A = RC_MATRIX_INITIALIZER;
+	rc_vector_t b = RC_VECTOR_INITIALIZER;
+	rc_vector_t h_n = RC_VECTOR_INITIALIZER;
+
+	// with only 2 knots zero jerk and snap at both ends leaves a quadratic
+	// through 2 points, which isn't unique
+	if(unlikely(end==RC_SPLINE_NATURAL && t.initialized && t.len<3)){
+		fprintf(stderr,"ERROR in rc_spline_quintic, natural ends need at least 3 knots\n");
+		return -1;
+	}
+	T = __setup(s,t,p,5,"rc_spline_quintic");
+	if(unlikely(T<0.0)) return -1;
+	n = t.len;
+	// unknowns are v and a at each knot, interleaved v0 a0 v1 a1 ... so the
+	// equations at knot i only reach columns 2i-2 to 2i+3
+	if(unlikely(rc_matrix_zeros(&A,2*n,7) || rc_vector_alloc(&b,2*n) ||
+			rc_vector_alloc(&h_n,n-1))){
+		fprintf(stderr,"ERROR in rc_spline_quintic, failed to allocate memory\n");
+		goto fail;
+	}
+	for(i=0;i<n-1;i++) h_n.d[i] = (t.d[i+1]-t.d[i])/T;
+
+	// band storage with 3 diagonals either side, A(r,j) is A.d[r][j-r+3]
+	#define BAND(r,j) A.d[r][(j)-(r)+3]
+	// interior knots, jerk at the end of the left segment equals jerk at the
+	// start of the right one, same for snap. Jerk rows are divided by 60 and
+	// snap rows by 360.
+	for(i=1;i<n-1;i++){
+		hl = h_n.d[i-1];
+		hr = h_n.d[i];
+		BAND(2*i,2*i-2) = -0.4/(hl*hl);
+		BAND(2*i,2*i-1) = -0.05/hl;
+		BAND(2*i,2*i)   = 0.6/(hr*hr) - 0.6/(hl*hl);
+		BAND(2*i,2*i+1) = 0.15/hl + 0.15/hr;
+		BAND(2*i,2*i+2) = 0.4/(hr*hr);
+		BAND(2*i,2*i+3) = -0.05/hr;
+		BAND(2*i+1,2*i-2) = -(7.0/15.0)/(hl*hl*hl);
+		BAND(2*i+1,2*i-1) = -(1.0/15.0)/(hl*hl);
+		BAND(2*i+1,2*i)   = -(8.0/15.0)/(hl*hl*hl) - (8.0/15.0)/(hr*hr*hr);
+		BAND(2*i+1,2*i+1) = 0.1/(hl*hl) - 0.1/(hr*hr);
+		BAND(2*i+1,2*i+2) = -(7.0/15.0)/(hr*hr*hr);
+		BAND(2*i+1,2*i+3) = (1.0/15.0)/(hr*hr);
+	}
+	if(end==RC_SPLINE_REST){
+		BAND(0,0) = 1.0;
+		BAND(1,1) = 1.0;
+		BAND(2*n-2,2*n-2) = 1.0;
+		BAND(2*n-1,2*n-1) = 1.0;
+	}
+	else{
+		// zero jerk and snap at the start of the first segment
+		h = h_n.d[0];
+		BAND(0,0) = -0.6/(h*h);
+		BAND(0,1) = -0.15/h;
+		BAND(0,2) = -0.4/(h*h);
+		BAND(0,3) = 0.05/h;
+		BAND(1,0) = (8.0/15.0)/(h*h*h);
+		BAND(1,1) = 0.1/(h*h);
+		BAND(1,2) = (7.0/15.0)/(h*h*h);
+		BAND(1,3) = -(1.0/15.0)/(h*h);
+		// and at the end of the last
+		h = h_n.d[n-2];
+		BAND(2*n-2,2*n-4) = -0.4/(h*h);
+		BAND(2*n-2,2*n-3) = -0.05/h;
+		BAND(2*n-2,2*n-2) = -0.6/(h*h);
+		BAND(2*n-2,2*n-1) = 0.15/h;
+		BAND(2*n-1,2*n-4) = -(7.0/15.0)/(h*h*h);
+		BAND(2*n-1,2*n-3) = -(1.0/15.0)/(h*h);
+		BAND(2*n-1,2*n-2) = -(8.0/15.0)/(h*h*h);
+		BAND(2*n-1,2*n-1) = 0.1/(h*h);
+	}
+	#undef BAND
+
+	for(k=0;k<s->dim;k++){
+		for(i=1;i<n-1;i++){
+			hl = h_n.d[i-1];
+			hr = h_n.d[i];
+			dl = p.d[i][k]-p.d[i-1][k];
+			dr = p.d[i+1][k]-p.d[i][k];
+			b.d[2*i]   = dr/(hr*hr*hr) - dl/(hl*hl*hl);
+			b.d[2*i+1] = -dl/(hl*hl*hl*hl) - dr/(hr*hr*hr*hr);
+		}
+		if(end==RC_SPLINE_REST){
+			b.d[0] = b.d[1] = b.d[2*n-2] = b.d[2*n-1] = 0.0;
+		}
+		else{
+			h = h_n.d[0];
+			d = p.d[1][k]-p.d[0][k];
+			b.d[0] = -d/(h*h*h);
+			b.d[1] = d/(h*h*h*h);
+			h = h_n.d[n-2];
+			d = p.d[n-1][k]-p.d[n-2][k];
+			b.d[2*n-2] = -d/(h*h*h);
+			b.d[2*n-1] = -d/(h*h*h*h);
+		}
+		// b becomes v and a at each knot
+		if(unlikely(rc_algebra_band_solve(A,3,3,b,&b))){
+			fprintf(stderr,"ERROR in rc_spline_quintic, failed to solve for knots\n");
+			goto fail;
+		}
+		// quintic Hermite polynomial of each segment
+		for(seg=0;seg<n-1;seg++){
+			h = h_n.d[seg];
+			d = p.d[seg+1][k]-p.d[seg][k];
+			v0 = b.d[2*seg];
+			a0 = b.d[2*seg+1];
+			v1 = b.d[2*seg+2];
+			a1 = b.d[2*seg+3];
+			c = s->c.d[seg*s->dim+k];
+			c[0] = p.d[seg][k];
+			c[1] = v0;
+			c[2] = 0.5*a0;
+			c[3] = (20.0*d - (8.0*v1+12.0*v0)*h - (3.0*a0-a1)*h*h)/(2.0*h*h*h);
+			c[4] = (-30.0*d + (14.0*v1+16.0*v0)*h + (3.0*a0-2.0*a1)*h*h)/(2.0*h*h*h*h);
+			c[5] = (12.0*d - 6.0*(v1+v0)*h - (a0-a1)*h*h)/(2.0*h*h*h*h*h);
+		}
+	}
+	__scale_coefficients(s,T);
+	rc_matrix_free(&A);
+	rc_vector_free(&b);
+	rc_vector_free(&h_n);
+	return 0;
+
+fail:
+	rc_matrix_free(&A);
+	rc_vector_free(&b);
+	rc_vector_free(&h_n);
+	rc_spline_free(s);
+	return -1;
+}
+
+
+/**
+ * segment containing t, starting the search from the one used last.
+ * t must be within the knots.
+ */
+static int __find_segment(rc_spline_t* s, double t)
+{
+	int lo,hi,mid;
+	int i = s->last;
+	const double* k = s->t.d;
+
+	if(t>=k[i] && t<=k[i+1]) return i;
+	// most often the next one when stepping forward
+	if(i+2<s->knots && t>=k[i+1] && t<=k[i+2]){
+		s->last = i+1;
+		return i+1;
+	}
+	lo = 0;
+	hi = s->knots-2;
+	while(lo<hi){
+		mid = (lo+hi+1)/2;
+		if(k[mid]<=t) lo = mid;
+		else hi = mid-1;
+	}
+	s->last = lo;
+	return lo;
+}
+
+
+/**
+ * position, velocity and acceleration of every dimension on one segment by
+ * Horner's method, outputs may be NULL
+ */
+static void __eval_segment(const rc_spline_t* s, int seg, double tau, double* p, double* v, double* a)
+{
+	int k,m,o;
+	double x,dx,ddx;
+	const double* c;
+	o = s->order;
+	for(k=0;k<s->dim;k++){
+		c = s->c.d[seg*s->dim+k];
+		x = c[o];
+		dx = o*c[o];
+		ddx = o*(o-1)*c[o];
+		for(m=o-1;m>=0;m--){
+			x = x*tau + c[m];
+			if(m>=1) dx = dx*tau + m*c[m];
+			if(m>=2) ddx = ddx*tau + m*(m-1)*c[m];
+		}
+		if(p!=NULL) p[k] = x;
+		if(v!=NULL) v[k] = dx;
+		if(a!=NULL) a[k] = ddx;
+	}
+}
+
+
+/**
+ * rc_spline_eval without the checks
+ */
+static void __eval(rc_spline_t* s, double t, double* p, double* v, double* a)
+{
+	int k,seg,n = s->knots;
+	const double* kt = s->t.d;
+
+	if(t<kt[0] || t>kt[n-1]){
+		if(t<kt[0]) __eval_segment(s,0,0.0,p,NULL,NULL);
+		else __eval_segment(s,n-2,kt[n-1]-kt[n-2],p,NULL,NULL);
+		for(k=0;k<s->dim;k++){
+			if(v!=NULL) v[k] = 0.0;
+			if(a!=NULL) a[k] = 0.0;
+		}
+		return;
+	}
+	seg = __find_segment(s,t);
+	__eval_segment(s,seg,t-kt[seg],p,v,a);
+}
+
+
+int rc_spline_eval(rc_spline_t* s, double t, double* p, double* v, double* a)
+{
+	if(unlikely(s==NULL)){
+		fprintf(stderr,"ERROR in rc_spline_eval, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!s->initialized)){
+		fprintf(stderr,"ERROR in rc_spline_eval, spline uninitialized\n");
+		return -1;
+	}
+	__eval(s,t,p,v,a);
+	return 0;
+}
+
+
+int rc_spline_eval_batch(rc_spline_t* s, rc_vector_t t, rc_matrix_t* p, rc_matrix_t* v, rc_matrix_t* a)
+{
+	int i;
+	if(unlikely(s==NULL || p==NULL)){
+		fprintf(stderr,"ERROR in rc_spline_eval_batch, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!s->initialized || !t.initialized)){
+		fprintf(stderr,"ERROR in rc_spline_eval_batch, spline or vector uninitialized\n");
+		return -1;
+	}
+	if(unlikely(rc_matrix_alloc(p,t.len,s->dim) ||
+			(v!=NULL && rc_matrix_alloc(v,t.len,s->dim)) ||
+			(a!=NULL && rc_matrix_alloc(a,t.len,s->dim)))){
+		fprintf(stderr,"ERROR in rc_spline_eval_batch, failed to allocate memory\n");
+		return -1;
+	}
+	for(i=0;i<t.len;i++){
+		__eval(s,t.d[i],p->d[i],v?v->d[i]:NULL,a?a->d[i]:NULL);
+	}
+	return 0;
+}
+
+
+int rc_spline_scale_time(rc_spline_t* s, double k)
+{
+	int i;
+	if(unlikely(s==NULL)){
+		fprintf(stderr,"ERROR in rc_spline_scale_time, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!s->initialized)){
+		fprintf(stderr,"ERROR in rc_spline_scale_time, spline uninitialized\n");
+		return -1;
+	}
+	if(unlikely(!(k>0.0) || !isfinite(k))){
+		fprintf(stderr,"ERROR in rc_spline_scale_time, factor must be positive and finite\n");
+		return -1;
+	}
+	for(i=1;i<s->knots;i++) s->t.d[i] = s->t.d[0] + k*(s->t.d[i]-s->t.d[0]);
+	__scale_coefficients(s,k);
+	return 0;
+}
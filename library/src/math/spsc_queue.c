@@ -0,0 +1,354 @@
+/**
+ * @file math/spsc_queue.c
+ *
+ * @brief      Lock-free single producer single consumer queue and sequence
+ * lock, see <rc/math/spsc_queue.h>.
+ *
+ * The public structs only carry pointers and sizes so the header stays plain
+ * C that C++ can include. The atomics live in a control block at the start
+ * of each allocation, padded out to a cache line per writer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <rc/math/spsc_queue.h>
+
+#include "algebra_common.h"
+
+#define CACHE_LINE	64
+#define ALIGN_UP(x)	(((x)+CACHE_LINE-1) & ~(size_t)(CACHE_LINE-1))
+#define MAX_CAPACITY	(1<<30)
+
+// Each line is written by only one side. The cached copies of the other
+// side's index sit on the line of the thread that uses them.
+typedef struct spsc_ctrl_t{
+	_Alignas(CACHE_LINE) atomic_uint head;	// next slot to fill, written by producer
+	unsigned int tail_cache;		// producer's last look at tail
+	atomic_ulong dropped;			// written by producer
+	_Alignas(CACHE_LINE) atomic_uint tail;	// next slot to empty, written by consumer
+	unsigned int head_cache;		// consumer's last look at head
+} spsc_ctrl_t;
+
+typedef struct seqlock_ctrl_t{
+	_Alignas(CACHE_LINE) atomic_uint seq;	// even count of writes, odd while writing
+} seqlock_ctrl_t;
+
+#define QUEUE_CTRL(q)	((spsc_ctrl_t*)(q)->mem)
+#define SEQ_CTRL(s)	((seqlock_ctrl_t*)(s)->mem)
+#define SEQ_COPY(s,i)	((char*)(s)->mem + sizeof(seqlock_ctrl_t) + (i)*(s)->stride)
+
+
+rc_spsc_queue_t rc_spsc_queue_empty(void)
+{
+	rc_spsc_queue_t out = RC_SPSC_QUEUE_INITIALIZER;
+	return out;
+}
+
+
+int rc_spsc_queue_alloc(rc_spsc_queue_t* q, int capacity, size_t record_size)
+{
+	unsigned int cap;
+	size_t stride, bytes;
+	void* mem;
+	spsc_ctrl_t* c;
+
+	// sanity checks
+	if(unlikely(q==NULL)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(capacity<2 || capacity>MAX_CAPACITY)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_alloc, capacity must be >=2 and <=2^30\n");
+		return -1;
+	}
+	if(unlikely(record_size<1)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_alloc, record_size must be >=1\n");
+		return -1;
+	}
+	cap = 2;
+	while(cap<(unsigned int)capacity) cap *= 2;
+	// keep doubles inside records aligned
+	stride = (record_size+7) & ~(size_t)7;
+	// aligned_alloc wants the size to be a multiple of the alignment
+	bytes = ALIGN_UP(sizeof(spsc_ctrl_t) + cap*stride);
+	mem = aligned_alloc(CACHE_LINE, bytes);
+	if(unlikely(mem==NULL)){
+		perror("ERROR in rc_spsc_queue_alloc");
+		return -1;
+	}
+	rc_spsc_queue_free(q);
+	c = (spsc_ctrl_t*)mem;
+	atomic_init(&c->head, 0);
+	atomic_init(&c->tail, 0);
+	atomic_init(&c->dropped, 0);
+	c->tail_cache = 0;
+	c->head_cache = 0;
+	q->mem = mem;
+	q->data = (char*)mem + sizeof(spsc_ctrl_t);
+	q->capacity = cap;
+	q->record_size = record_size;
+	q->stride = stride;
+	q->initialized = 1;
+	return 0;
+}
+
+
+int rc_spsc_queue_free(rc_spsc_queue_t* q)
+{
+	rc_spsc_queue_t new = RC_SPSC_QUEUE_INITIALIZER;
+	if(unlikely(q==NULL)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_free, received NULL pointer\n");
+		return -1;
+	}
+	free(q->mem);
+	*q = new;
+	return 0;
+}
+
+
+int rc_spsc_queue_push(rc_spsc_queue_t* q, const void* rec)
+{
+	spsc_ctrl_t* c;
+	unsigned int h;
+
+	if(unlikely(q==NULL || rec==NULL)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_push, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!q->initialized)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_push, queue uninitialized\n");
+		return -1;
+	}
+	c = QUEUE_CTRL(q);
+	h = atomic_load_explicit(&c->head, memory_order_relaxed);
+	// only touch the consumer's cache line when the queue looks full
+	if(h - c->tail_cache >= q->capacity){
+		c->tail_cache = atomic_load_explicit(&c->tail, memory_order_acquire);
+		if(h - c->tail_cache >= q->capacity){
+			atomic_fetch_add_explicit(&c->dropped, 1, memory_order_relaxed);
+			return -1;
+		}
+	}
+	memcpy(q->data + (h & (q->capacity-1))*q->stride, rec, q->record_size);
+	// publish the record to the consumer
+	atomic_store_explicit(&c->head, h+1, memory_order_release);
+	return 0;
+}
+
+
+// number of records the consumer can read starting at tail t
+static unsigned int __available(rc_spsc_queue_t* q, unsigned int t)
+{
+	spsc_ctrl_t* c = QUEUE_CTRL(q);
+	// only touch the producer's cache line when the queue looks empty
+	if(c->head_cache == t){
+		c->head_cache = atomic_load_explicit(&c->head, memory_order_acquire);
+	}
+	return c->head_cache - t;
+}
+
+
+int rc_spsc_queue_pop(rc_spsc_queue_t* q, void* rec)
+{
+	spsc_ctrl_t* c;
+	unsigned int t;
+
+	if(unlikely(q==NULL || rec==NULL)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_pop, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!q->initialized)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_pop, queue uninitialized\n");
+		return -1;
+	}
+	c = QUEUE_CTRL(q);
+	t = atomic_load_explicit(&c->tail, memory_order_relaxed);
+	if(__available(q, t)==0) return 0;
+	memcpy(rec, q->data + (t & (q->capacity-1))*q->stride, q->record_size);
+	// hand the slot back to the producer
+	atomic_store_explicit(&c->tail, t+1, memory_order_release);
+	return 1;
+}
+
+
+void* rc_spsc_queue_peek(rc_spsc_queue_t* q, int* n)
+{
+	unsigned int t, avail, first;
+
+	if(unlikely(q==NULL || n==NULL)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_peek, received NULL pointer\n");
+		return NULL;
+	}
+	*n = 0;
+	if(unlikely(!q->initialized)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_peek, queue uninitialized\n");
+		return NULL;
+	}
+	t = atomic_load_explicit(&QUEUE_CTRL(q)->tail, memory_order_relaxed);
+	avail = __available(q, t);
+	if(avail==0) return NULL;
+	// contiguous run up to the end of the array
+	first = t & (q->capacity-1);
+	if(avail > q->capacity-first) avail = q->capacity-first;
+	*n = (int)avail;
+	return q->data + first*q->stride;
+}
+
+
+int rc_spsc_queue_release(rc_spsc_queue_t* q, int n)
+{
+	spsc_ctrl_t* c;
+	unsigned int t;
+
+	if(unlikely(q==NULL)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_release, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!q->initialized)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_release, queue uninitialized\n");
+		return -1;
+	}
+	c = QUEUE_CTRL(q);
+	t = atomic_load_explicit(&c->tail, memory_order_relaxed);
+	// head_cache was refreshed by the peek that handed these out
+	if(unlikely(n<0 || (unsigned int)n > c->head_cache - t)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_release, releasing more records than peeked\n");
+		return -1;
+	}
+	atomic_store_explicit(&c->tail, t+(unsigned int)n, memory_order_release);
+	return 0;
+}
+
+
+int rc_spsc_queue_count(rc_spsc_queue_t q)
+{
+	spsc_ctrl_t* c;
+	unsigned int t;
+	if(unlikely(!q.initialized)){
+		fprintf(stderr,"ERROR in rc_spsc_queue_count, queue uninitialized\n");
+		return -1;
+	}
+	c = QUEUE_CTRL(&q);
+	t = atomic_load_explicit(&c->tail, memory_order_acquire);
+	return (int)(atomic_load_explicit(&c->head, memory_order_acquire) - t);
+}
+
+
+unsigned long rc_spsc_queue_dropped(rc_spsc_queue_t q)
+{
+	if(unlikely(!q.initialized)) return 0;
+	return atomic_load_explicit(&QUEUE_CTRL(&q)->dropped, memory_order_relaxed);
+}
+
+
+rc_seqlock_t rc_seqlock_empty(void)
+{
+	rc_seqlock_t out = RC_SEQLOCK_INITIALIZER;
+	return out;
+}
+
+
+int rc_seqlock_alloc(rc_seqlock_t* s, size_t size)
+{
+	size_t stride;
+	void* mem;
+
+	if(unlikely(s==NULL)){
+		fprintf(stderr,"ERROR in rc_seqlock_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(size<1)){
+		fprintf(stderr,"ERROR in rc_seqlock_alloc, size must be >=1\n");
+		return -1;
+	}
+	// each copy on its own cache lines
+	stride = ALIGN_UP(size);
+	mem = aligned_alloc(CACHE_LINE, sizeof(seqlock_ctrl_t) + 2*stride);
+	if(unlikely(mem==NULL)){
+		perror("ERROR in rc_seqlock_alloc");
+		return -1;
+	}
+	rc_seqlock_free(s);
+	memset(mem, 0, sizeof(seqlock_ctrl_t) + 2*stride);
+	atomic_init(&((seqlock_ctrl_t*)mem)->seq, 0);
+	s->mem = mem;
+	s->size = size;
+	s->stride = stride;
+	s->initialized = 1;
+	return 0;
+}
+
+
+int rc_seqlock_free(rc_seqlock_t* s)
+{
+	rc_seqlock_t new = RC_SEQLOCK_INITIALIZER;
+	if(unlikely(s==NULL)){
+		fprintf(stderr,"ERROR in rc_seqlock_free, received NULL pointer\n");
+		return -1;
+	}
+	free(s->mem);
+	*s = new;
+	return 0;
+}
+
+
+int rc_seqlock_write(rc_seqlock_t* s, const void* val)
+{
+	seqlock_ctrl_t* c;
+	unsigned int seq;
+
+	if(unlikely(s==NULL || val==NULL)){
+		fprintf(stderr,"ERROR in rc_seqlock_write, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!s->initialized)){
+		fprintf(stderr,"ERROR in rc_seqlock_write, seqlock uninitialized\n");
+		return -1;
+	}
+	c = SEQ_CTRL(s);
+	// Readers copy from (seq&1). Steer them to copy 1 while copy 0 is
+	// written, then to copy 0 while copy 1 is written. The fences keep the
+	// copies from being written before readers have been steered away.
+	seq = atomic_load_explicit(&c->seq, memory_order_relaxed);
+	atomic_store_explicit(&c->seq, seq+1, memory_order_release);
+	atomic_thread_fence(memory_order_release);
+	memcpy(SEQ_COPY(s,0), val, s->size);
+	atomic_store_explicit(&c->seq, seq+2, memory_order_release);
+	atomic_thread_fence(memory_order_release);
+	memcpy(SEQ_COPY(s,1), val, s->size);
+	return 0;
+}
+
+
+int rc_seqlock_read(rc_seqlock_t* s, void* val)
+{
+	seqlock_ctrl_t* c;
+	unsigned int seq;
+
+	if(unlikely(s==NULL || val==NULL)){
+		fprintf(stderr,"ERROR in rc_seqlock_read, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!s->initialized)){
+		fprintf(stderr,"ERROR in rc_seqlock_read, seqlock uninitialized\n");
+		return -1;
+	}
+	c = SEQ_CTRL(s);
+	// retry only if the writer moved on to the copy being read
+	do{
+		seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+		memcpy(val, SEQ_COPY(s, seq&1), s->size);
+		atomic_thread_fence(memory_order_acquire);
+	}while(atomic_load_explicit(&c->seq, memory_order_relaxed) != seq);
+	return 0;
+}
+
+
+unsigned int rc_seqlock_version(rc_seqlock_t s)
+{
+	if(unlikely(!s.initialized)) return 0;
+	return atomic_load_explicit(&SEQ_CTRL(&s)->seq, memory_order_acquire)/2;
+}
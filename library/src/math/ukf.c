@@ -0,0 +1,566 @@
+/**
+ * @file math/ukf.c
+ *
+ * @brief      Unscented Kalman filter, see <rc/math/ukf.h>
+ *
+ * Sigma points and the rows of every working matrix are kept contiguous so
+ * the weighted sums are row operations with __vectorized_axpy. The square
+ * root form rebuilds the factor of each covariance from the factor of Q or R
+ * with one rank one Cholesky update per sigma point, which gives the same
+ * factor as the QR decomposition in the usual formulation without needing
+ * any working memory for it.
+ */
+
+#include <stdio.h>
+#include <string.h>	// for memcpy
+#include <math.h>	// for sqrt, sin, cos, atan2, floor
+
+#include <rc/math/algebra.h>
+#include <rc/math/ukf.h>
+#include "algebra_common.h"
+
+#define TWO_PI		(2.0*M_PI)
+#define IS_ANGLE(mask,i) ((i)<32 && (((mask)>>(i))&1u))
+
+
+rc_ukf_t rc_ukf_empty(void)
+{
+	rc_ukf_t ukf = RC_UKF_INITIALIZER;
+	return ukf;
+}
+
+
+// wraps an angle to within +-pi
+static double __wrap(double a)
+{
+	return a - TWO_PI*floor((a+M_PI)/TWO_PI);
+}
+
+
+static int __set_weights(rc_ukf_t* ukf, double alpha, double beta, double kappa)
+{
+	int i;
+	int n = ukf->nx;
+	double lambda = alpha*alpha*(n+kappa) - n;
+
+	if(unlikely(n+lambda<zero_tolerance)) return -1;
+	ukf->lambda = lambda;
+	ukf->Wm.d[0] = lambda/(n+lambda);
+	ukf->Wc.d[0] = ukf->Wm.d[0] + 1.0 - alpha*alpha + beta;
+	for(i=1;i<=2*n;i++){
+		ukf->Wm.d[i] = 0.5/(n+lambda);
+		ukf->Wc.d[i] = ukf->Wm.d[i];
+	}
+	return 0;
+}
+
+
+// L = lower Cholesky factor of A without touching A
+static int __factor(rc_matrix_t A, rc_matrix_t* L)
+{
+	memcpy(L->d[0], A.d[0], A.rows*A.cols*sizeof(double));
+	return rc_algebra_cholesky_decomp_inplace(L);
+}
+
+
+// X_0 = x, X_i = x + c*L_i and X_n+i = x - c*L_i for each column L_i of L
+static void __sigma_points(rc_ukf_t* ukf, rc_matrix_t L)
+{
+	int i, j;
+	int n = ukf->nx;
+	double c = sqrt(n+ukf->lambda);
+	double* x = ukf->x_est.d;
+
+	memcpy(ukf->X.d[0], x, n*sizeof(double));
+	for(i=0;i<n;i++){
+		for(j=0;j<n;j++){
+			ukf->X.d[1+i][j]   = x[j] + c*L.d[j][i];
+			ukf->X.d[1+n+i][j] = x[j] - c*L.d[j][i];
+		}
+	}
+}
+
+
+// weighted mean of the rows of M, angles are averaged on the circle
+static void __mean(rc_ukf_t* ukf, rc_matrix_t M, double* mean, uint32_t angles)
+{
+	int i, j;
+	double s, c;
+	double* Wm = ukf->Wm.d;
+
+	for(j=0;j<M.cols;j++){
+		if(IS_ANGLE(angles,j)){
+			s = 0.0;
+			c = 0.0;
+			for(i=0;i<M.rows;i++){
+				s += Wm[i]*sin(M.d[i][j]);
+				c += Wm[i]*cos(M.d[i][j]);
+			}
+			mean[j] = atan2(s,c);
+		}
+		else{
+			s = 0.0;
+			for(i=0;i<M.rows;i++) s += Wm[i]*M.d[i][j];
+			mean[j] = s;
+		}
+	}
+}
+
+
+// d = a - mean with angle differences wrapped
+static void __deviation(const double* a, const double* mean, double* d, int n, uint32_t angles)
+{
+	int j;
+	for(j=0;j<n;j++){
+		d[j] = a[j] - mean[j];
+		if(IS_ANGLE(angles,j)) d[j] = __wrap(d[j]);
+	}
+}
+
+
+// C += w*d*d'
+static void __outer_accumulate(rc_matrix_t* C, const double* d, double w)
+{
+	int i;
+	for(i=0;i<C->rows;i++) __vectorized_axpy(w*d[i], d, C->d[i], C->cols);
+}
+
+
+// P = S*S' for a square factor S, rows of S dotted together
+static void __multiply_out(rc_matrix_t S, rc_matrix_t* P)
+{
+	int i, j;
+	for(i=0;i<S.rows;i++){
+		for(j=0;j<S.rows;j++){
+			P->d[i][j] = __vectorized_mult_accumulate(S.d[i], S.d[j], S.cols);
+		}
+	}
+}
+
+
+// adds w*d*d' to the covariance whose lower Cholesky factor is S, d is
+// scaled in place
+static int __sqrt_rank1(rc_matrix_t* S, rc_vector_t d, double w)
+{
+	int i;
+	double s = sqrt(fabs(w));
+	for(i=0;i<d.len;i++) d.d[i] *= s;
+	if(w<0.0) return rc_algebra_cholesky_downdate(S, d);
+	return rc_algebra_cholesky_update(S, d);
+}
+
+
+int rc_ukf_alloc(rc_ukf_t* ukf, int nu, rc_matrix_t Q, rc_matrix_t R, rc_matrix_t Pi,
+			rc_ukf_process_t f, rc_ukf_measure_t h, void* arg)
+{
+	int nx, ny, pts;
+
+	// sanity checks
+	if(ukf==NULL || f==NULL || h==NULL){
+		fprintf(stderr, "ERROR in rc_ukf_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(!Q.initialized || !R.initialized || !Pi.initialized){
+		fprintf(stderr, "ERROR in rc_ukf_alloc, received uninitialized matrix\n");
+		return -1;
+	}
+	if(Q.rows != Q.cols){
+		fprintf(stderr, "ERROR in rc_ukf_alloc, Q must be square\n");
+		return -1;
+	}
+	if(R.rows != R.cols){
+		fprintf(stderr, "ERROR in rc_ukf_alloc, R must be square\n");
+		return -1;
+	}
+	if(Pi.rows != Q.rows || Pi.cols != Q.cols){
+		fprintf(stderr, "ERROR in rc_ukf_alloc, Pi must have same dimensions as Q\n");
+		return -1;
+	}
+	if(nu<0){
+		fprintf(stderr, "ERROR in rc_ukf_alloc, nu must be >=0\n");
+		return -1;
+	}
+
+	// free existing memory, this also zero's out the struct
+	if(rc_ukf_free(ukf)==-1) return -1;
+
+	nx = Q.rows;
+	ny = R.rows;
+	pts = 2*nx+1;
+	ukf->f = f;
+	ukf->h = h;
+	ukf->arg = arg;
+	ukf->nx = nx;
+	ukf->nu = nu;
+	ukf->ny = ny;
+
+	// allocate memory
+	if(rc_matrix_duplicate(Q, &ukf->Q)==-1) return -1;
+	if(rc_matrix_duplicate(R, &ukf->R)==-1) return -1;
+	if(rc_matrix_duplicate(Pi, &ukf->Pi)==-1) return -1;
+	if(rc_matrix_duplicate(Pi, &ukf->P)==-1) return -1;
+	if(rc_vector_zeros(&ukf->x_est, nx)==-1) return -1;
+	if(rc_vector_zeros(&ukf->x_pre, nx)==-1) return -1;
+	if(rc_vector_zeros(&ukf->Wm, pts)==-1) return -1;
+	if(rc_vector_zeros(&ukf->Wc, pts)==-1) return -1;
+	if(rc_matrix_zeros(&ukf->X, pts, nx)==-1) return -1;
+	if(rc_matrix_zeros(&ukf->Xf, pts, nx)==-1) return -1;
+	if(rc_matrix_zeros(&ukf->Y, pts, ny)==-1) return -1;
+	if(rc_matrix_zeros(&ukf->L, nx, nx)==-1) return -1;
+	if(rc_matrix_zeros(&ukf->Syy, ny, ny)==-1) return -1;
+	if(rc_matrix_zeros(&ukf->PxyT, ny, nx)==-1) return -1;
+	if(rc_matrix_zeros(&ukf->KT, ny, nx)==-1) return -1;
+	if(rc_vector_zeros(&ukf->y_pre, ny)==-1) return -1;
+	if(rc_vector_zeros(&ukf->dx, nx)==-1) return -1;
+	if(rc_vector_zeros(&ukf->dy, ny)==-1) return -1;
+	__set_weights(ukf, 1.0, 2.0, 0.0);
+	ukf->initialized = 1;
+	return 0;
+}
+
+
+int rc_ukf_free(rc_ukf_t* ukf)
+{
+	rc_ukf_t new = RC_UKF_INITIALIZER;
+	// sanity checks
+	if(ukf==NULL){
+		fprintf(stderr, "ERROR in rc_ukf_free, received NULL pointer\n");
+		return -1;
+	}
+	rc_matrix_free(&ukf->Q);
+	rc_matrix_free(&ukf->R);
+	rc_matrix_free(&ukf->P);
+	rc_matrix_free(&ukf->Pi);
+	rc_vector_free(&ukf->x_est);
+	rc_vector_free(&ukf->x_pre);
+	rc_vector_free(&ukf->Wm);
+	rc_vector_free(&ukf->Wc);
+
+	rc_matrix_free(&ukf->X);
+	rc_matrix_free(&ukf->Xf);
+	rc_matrix_free(&ukf->Y);
+	rc_matrix_free(&ukf->L);
+	rc_matrix_free(&ukf->Syy);
+	rc_matrix_free(&ukf->PxyT);
+	rc_matrix_free(&ukf->KT);
+	rc_vector_free(&ukf->y_pre);
+	rc_vector_free(&ukf->dx);
+	rc_vector_free(&ukf->dy);
+
+	*ukf = new;
+	return 0;
+}
+
+
+int rc_ukf_reset(rc_ukf_t* ukf)
+{
+	// sanity checks
+	if(ukf==NULL){
+		fprintf(stderr, "ERROR in rc_ukf_reset, received NULL pointer\n");
+		return -1;
+	}
+	if(ukf->initialized !=1){
+		fprintf(stderr, "ERROR in rc_ukf_reset, ukf uninitialized\n");
+		return -1;
+	}
+	if(ukf->sqrt_form){
+		if(__factor(ukf->Pi, &ukf->P)){
+			fprintf(stderr, "ERROR in rc_ukf_reset, Pi is not positive definite\n");
+			return -1;
+		}
+	}
+	else rc_matrix_duplicate(ukf->Pi, &ukf->P);
+	rc_vector_zero_out(&ukf->x_est);
+	rc_vector_zero_out(&ukf->x_pre);
+	ukf->step = 0;
+	return 0;
+}
+
+
+int rc_ukf_set_scaling(rc_ukf_t* ukf, double alpha, double beta, double kappa)
+{
+	// sanity checks
+	if(ukf==NULL){
+		fprintf(stderr, "ERROR in rc_ukf_set_scaling, received NULL pointer\n");
+		return -1;
+	}
+	if(ukf->initialized !=1){
+		fprintf(stderr, "ERROR in rc_ukf_set_scaling, ukf uninitialized\n");
+		return -1;
+	}
+	if(alpha<=0.0){
+		fprintf(stderr, "ERROR in rc_ukf_set_scaling, alpha must be positive\n");
+		return -1;
+	}
+	if(__set_weights(ukf, alpha, beta, kappa)){
+		fprintf(stderr, "ERROR in rc_ukf_set_scaling, n+lambda must be positive\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+int rc_ukf_set_state_angle(rc_ukf_t* ukf, int i)
+{
+	// sanity checks
+	if(ukf==NULL){
+		fprintf(stderr, "ERROR in rc_ukf_set_state_angle, received NULL pointer\n");
+		return -1;
+	}
+	if(ukf->initialized !=1){
+		fprintf(stderr, "ERROR in rc_ukf_set_state_angle, ukf uninitialized\n");
+		return -1;
+	}
+	if(i<0 || i>=ukf->nx || i>=32){
+		fprintf(stderr, "ERROR in rc_ukf_set_state_angle, index out of range\n");
+		return -1;
+	}
+	ukf->x_angles |= 1u<<i;
+	return 0;
+}
+
+
+int rc_ukf_set_measurement_angle(rc_ukf_t* ukf, int i)
+{
+	// sanity checks
+	if(ukf==NULL){
+		fprintf(stderr, "ERROR in rc_ukf_set_measurement_angle, received NULL pointer\n");
+		return -1;
+	}
+	if(ukf->initialized !=1){
+		fprintf(stderr, "ERROR in rc_ukf_set_measurement_angle, ukf uninitialized\n");
+		return -1;
+	}
+	if(i<0 || i>=ukf->ny || i>=32){
+		fprintf(stderr, "ERROR in rc_ukf_set_measurement_angle, index out of range\n");
+		return -1;
+	}
+	ukf->y_angles |= 1u<<i;
+	return 0;
+}
+
+
+int rc_ukf_set_sqrt(rc_ukf_t* ukf, int enable)
+{
+	// sanity checks
+	if(ukf==NULL){
+		fprintf(stderr, "ERROR in rc_ukf_set_sqrt, received NULL pointer\n");
+		return -1;
+	}
+	if(ukf->initialized !=1){
+		fprintf(stderr, "ERROR in rc_ukf_set_sqrt, ukf uninitialized\n");
+		return -1;
+	}
+	enable = enable ? 1 : 0;
+	if(enable==ukf->sqrt_form) return 0;
+	if(enable){
+		// P = S*S', keep P as it was if it can't be factored
+		if(__factor(ukf->P, &ukf->L)){
+			fprintf(stderr, "ERROR in rc_ukf_set_sqrt, P is not positive definite\n");
+			return -1;
+		}
+		rc_matrix_duplicate(ukf->L, &ukf->P);
+	}
+	else{
+		rc_matrix_duplicate(ukf->P, &ukf->L);
+		__multiply_out(ukf->L, &ukf->P);
+	}
+	ukf->sqrt_form = enable;
+	return 0;
+}
+
+
+int rc_ukf_predict(rc_ukf_t* ukf, rc_vector_t u)
+{
+	int i, k, n, pts;
+	const double* up = NULL;
+
+	// sanity checks
+	if(unlikely(ukf==NULL)){
+		fprintf(stderr, "ERROR in rc_ukf_predict, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(ukf->initialized !=1)){
+		fprintf(stderr, "ERROR in rc_ukf_predict, ukf uninitialized\n");
+		return -1;
+	}
+	if(ukf->nu>0){
+		if(unlikely(u.initialized!=1 || u.len!=ukf->nu)){
+			fprintf(stderr, "ERROR in rc_ukf_predict, u must have length nu\n");
+			return -1;
+		}
+		up = u.d;
+	}
+	n = ukf->nx;
+	pts = 2*n+1;
+
+	// sigma points around the current estimate
+	if(ukf->sqrt_form) __sigma_points(ukf, ukf->P);
+	else{
+		if(unlikely(__factor(ukf->P, &ukf->L))){
+			fprintf(stderr, "ERROR in rc_ukf_predict, P is not positive definite\n");
+			return -1;
+		}
+		__sigma_points(ukf, ukf->L);
+	}
+
+	// x_pre = sum Wm_i f(X_i,u)
+	for(i=0;i<pts;i++) ukf->f(ukf->X.d[i], up, ukf->Xf.d[i], ukf->arg);
+	__mean(ukf, ukf->Xf, ukf->x_pre.d, ukf->x_angles);
+
+	// P = Q + sum Wc_i (Xf_i-x_pre)(Xf_i-x_pre)'
+	if(ukf->sqrt_form){
+		if(unlikely(__factor(ukf->Q, &ukf->P))){
+			fprintf(stderr, "ERROR in rc_ukf_predict, Q is not positive definite\n");
+			return -1;
+		}
+		// X_0 last since its weight may be negative
+		for(k=1;k<=pts;k++){
+			i = k%pts;
+			__deviation(ukf->Xf.d[i], ukf->x_pre.d, ukf->dx.d, n, ukf->x_angles);
+			if(unlikely(__sqrt_rank1(&ukf->P, ukf->dx, ukf->Wc.d[i]))){
+				fprintf(stderr, "ERROR in rc_ukf_predict, lost positive definiteness of P\n");
+				return -1;
+			}
+		}
+	}
+	else{
+		rc_matrix_duplicate(ukf->Q, &ukf->P);
+		for(i=0;i<pts;i++){
+			__deviation(ukf->Xf.d[i], ukf->x_pre.d, ukf->dx.d, n, ukf->x_angles);
+			__outer_accumulate(&ukf->P, ukf->dx.d, ukf->Wc.d[i]);
+		}
+		rc_matrix_symmetrize(&ukf->P);		// Force symmetric P
+	}
+
+	memcpy(ukf->x_est.d, ukf->x_pre.d, n*sizeof(double));
+	return 0;
+}
+
+
+int rc_ukf_update(rc_ukf_t* ukf, rc_vector_t y)
+{
+	int i, j, k, r, n, m, pts;
+	double w;
+
+	// sanity checks
+	if(unlikely(ukf==NULL)){
+		fprintf(stderr, "ERROR in rc_ukf_update, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(ukf->initialized !=1)){
+		fprintf(stderr, "ERROR in rc_ukf_update, ukf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(y.initialized!=1 || y.len!=ukf->ny)){
+		fprintf(stderr, "ERROR in rc_ukf_update, y must have length ny\n");
+		return -1;
+	}
+	n = ukf->nx;
+	m = ukf->ny;
+	pts = 2*n+1;
+
+	// sigma points around the current estimate
+	if(ukf->sqrt_form) __sigma_points(ukf, ukf->P);
+	else{
+		if(unlikely(__factor(ukf->P, &ukf->L))){
+			fprintf(stderr, "ERROR in rc_ukf_update, P is not positive definite\n");
+			return -1;
+		}
+		__sigma_points(ukf, ukf->L);
+	}
+
+	// y_pre = sum Wm_i h(X_i)
+	for(i=0;i<pts;i++) ukf->h(ukf->X.d[i], ukf->Y.d[i], ukf->arg);
+	__mean(ukf, ukf->Y, ukf->y_pre.d, ukf->y_angles);
+
+	// Pyy = R + sum Wc_i dy_i dy_i' and Pxy' = sum Wc_i dy_i dx_i'
+	if(ukf->sqrt_form){
+		if(unlikely(__factor(ukf->R, &ukf->Syy))){
+			fprintf(stderr, "ERROR in rc_ukf_update, R is not positive definite\n");
+			return -1;
+		}
+	}
+	else rc_matrix_duplicate(ukf->R, &ukf->Syy);
+	rc_matrix_zero_out(&ukf->PxyT);
+	// X_0 last since its weight may be negative
+	for(k=1;k<=pts;k++){
+		i = k%pts;
+		w = ukf->Wc.d[i];
+		__deviation(ukf->X.d[i], ukf->x_est.d, ukf->dx.d, n, ukf->x_angles);
+		__deviation(ukf->Y.d[i], ukf->y_pre.d, ukf->dy.d, m, ukf->y_angles);
+		for(r=0;r<m;r++) __vectorized_axpy(w*ukf->dy.d[r], ukf->dx.d, ukf->PxyT.d[r], n);
+		if(ukf->sqrt_form){
+			if(unlikely(__sqrt_rank1(&ukf->Syy, ukf->dy, w))){
+				fprintf(stderr, "ERROR in rc_ukf_update, lost positive definiteness of Pyy\n");
+				return -1;
+			}
+		}
+		else __outer_accumulate(&ukf->Syy, ukf->dy.d, w);
+	}
+	if(!ukf->sqrt_form){
+		rc_matrix_symmetrize(&ukf->Syy);
+		if(unlikely(rc_algebra_cholesky_decomp_inplace(&ukf->Syy))){
+			fprintf(stderr, "ERROR in rc_ukf_update, innovation covariance is not positive definite\n");
+			return -1;
+		}
+	}
+
+	// K' = Pyy^-1 * Pxy' without inverting Pyy
+	memcpy(ukf->KT.d[0], ukf->PxyT.d[0], m*n*sizeof(double));
+	rc_algebra_cholesky_solve_matrix_inplace(ukf->Syy, &ukf->KT);
+
+	// x_est = x_est + K*(y-y_pre)
+	__deviation(y.d, ukf->y_pre.d, ukf->dy.d, m, ukf->y_angles);
+	for(r=0;r<m;r++) __vectorized_axpy(ukf->dy.d[r], ukf->KT.d[r], ukf->x_est.d, n);
+	for(j=0;j<n;j++){
+		if(IS_ANGLE(ukf->x_angles,j)) ukf->x_est.d[j] = __wrap(ukf->x_est.d[j]);
+	}
+
+	// P = P - K*Pyy*K'
+	if(ukf->sqrt_form){
+		// S*S' - U*U' with U = K*Syy, one downdate per column of U
+		for(j=0;j<m;j++){
+			for(i=0;i<n;i++){
+				w = 0.0;
+				for(r=j;r<m;r++) w += ukf->KT.d[r][i]*ukf->Syy.d[r][j];
+				ukf->dx.d[i] = w;
+			}
+			if(unlikely(rc_algebra_cholesky_downdate(&ukf->P, ukf->dx))){
+				fprintf(stderr, "ERROR in rc_ukf_update, lost positive definiteness of P\n");
+				return -1;
+			}
+		}
+	}
+	else{
+		// K*Pyy*K' = Pxy*K'
+		for(r=0;r<m;r++){
+			for(i=0;i<n;i++) __vectorized_axpy(-ukf->PxyT.d[r][i], ukf->KT.d[r], ukf->P.d[i], n);
+		}
+		rc_matrix_symmetrize(&ukf->P);		// Force symmetric P
+	}
+
+	ukf->step++;
+	return 0;
+}
+
+
+int rc_ukf_covariance(rc_ukf_t* ukf, rc_matrix_t* P)
+{
+	// sanity checks
+	if(ukf==NULL || P==NULL){
+		fprintf(stderr, "ERROR in rc_ukf_covariance, received NULL pointer\n");
+		return -1;
+	}
+	if(ukf->initialized !=1){
+		fprintf(stderr, "ERROR in rc_ukf_covariance, ukf uninitialized\n");
+		return -1;
+	}
+	if(!ukf->sqrt_form) return rc_matrix_duplicate(ukf->P, P);
+	if(rc_matrix_alloc(P, ukf->nx, ukf->nx)){
+		fprintf(stderr, "ERROR in rc_ukf_covariance, failed to alloc matrix\n");
+		return -1;
+	}
+	__multiply_out(ukf->P, P);
+	return 0;
+}
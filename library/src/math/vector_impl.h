@@ -0,0 +1,405 @@
+/**
+ * @file math/vector_impl.h
+ *
+ * Body of the vector functions, included once by vector.c for rc_vector_t and
+ * once by single_precision.c for rc_vectorf_t. See precision.h for the names
+ * and types it expects.
+ */
+
+#ifndef RC_REAL
+#error "include precision.h before vector_impl.h"
+#endif
+
+
+int RC_VEC_FN(alloc)(RC_VEC_T* v, int length)
+{
+	// sanity checks
+	if(unlikely(length<1)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_alloc, length must be >=1\n");
+		return -1;
+	}
+	if(unlikely(v==NULL)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_alloc, received NULL pointer\n");
+		return -1;
+	}
+	// if v is already allocated and of the right size, nothing to do!
+	if(v->initialized && v->len==length) return 0;
+	// free any old memory
+	RC_VEC_FN(free)(v);
+	// allocate contiguous memory for the vector, this comes from the active
+	// workspace instead of the heap if there is one
+	v->d = (RC_REAL*)__rc_math_alloc(length*sizeof(RC_REAL), 0, &v->borrowed);
+	if(unlikely(v->d==NULL)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_alloc, not enough memory\n");
+		v->borrowed = 0;
+		return -1;
+	}
+	v->len = length;
+	v->initialized = 1;
+	return 0;
+}
+
+int RC_VEC_FN(free)(RC_VEC_T* v)
+{
+	RC_VEC_T new = RC_VEC_INIT;
+	if(unlikely(v==NULL)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_free, received NULL pointer\n");
+		return -1;
+	}
+	// free memory, memory borrowed from a workspace goes back when the
+	// workspace scope ends
+	if(v->initialized && !v->borrowed) __rc_math_free(v->d);
+	// zero out the struct
+	*v = new;
+	return 0;
+}
+
+
+RC_VEC_T RC_VEC_FN(empty)(void)
+{
+	RC_VEC_T out = RC_VEC_INIT;
+	return out;
+}
+
+
+int RC_VEC_FN(zeros)(RC_VEC_T* v, int length)
+{
+	if(unlikely(length<1)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_zeros, length must be >=1\n");
+		return -1;
+	}
+	if(unlikely(v==NULL)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_zeros, received NULL pointer\n");
+		return -1;
+	}
+	// free any old memory
+	RC_VEC_FN(free)(v);
+	// allocate contiguous zeroed-out memory for the vector
+	v->d = (RC_REAL*)__rc_math_alloc(length*sizeof(RC_REAL), 1, &v->borrowed);
+	if(unlikely(v->d==NULL)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_zeros, not enough memory\n");
+		v->borrowed = 0;
+		return -1;
+	}
+	v->len = length;
+	v->initialized = 1;
+	return 0;
+}
+
+
+int RC_VEC_FN(ones)(RC_VEC_T* v, int length)
+{
+	int i;
+	if(unlikely(RC_VEC_FN(alloc)(v, length))){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_ones, failed to allocate vector\n");
+		return -1;
+	}
+	for(i=0;i<length;i++) v->d[i] = RC_R(1.0);
+	return 0;
+}
+
+
+int RC_VEC_FN(from_array)(RC_VEC_T* v, RC_REAL* ptr, int length)
+{
+	// sanity check pointer
+	if(unlikely(ptr==NULL)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_from_array, received NULL pointer\n");
+		return -1;
+	}
+	// make sure there is enough space in v
+	if(unlikely(RC_VEC_FN(alloc)(v, length))){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_from_array, failed to allocate vector\n");
+		return -1;
+	}
+	// duplicate memory over
+	memcpy(v->d, ptr, length*sizeof(RC_REAL));
+	return 0;
+}
+
+
+int RC_VEC_FN(duplicate)(RC_VEC_T a, RC_VEC_T* b)
+{
+	// sanity check
+	if(unlikely(!a.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_duplicate, a not initialized\n");
+		return -1;
+	}
+	// make sure there is enough space in b
+	if(unlikely(RC_VEC_FN(alloc)(b, a.len))){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_duplicate, failed to allocate vector\n");
+		return -1;
+	}
+	// copy memory over
+	memcpy(b->d, a.d, a.len*sizeof(RC_REAL));
+	return 0;
+}
+
+
+int RC_VEC_FN(print)(RC_VEC_T v)
+{
+	int i;
+	if(unlikely(!v.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_print, vector not initialized yet\n");
+		return -1;
+	}
+	for(i=0;i<v.len;i++) printf("%7.4f  ",(double)v.d[i]);
+	printf("\n");
+	return 0;
+}
+
+int RC_VEC_FN(print_sci)(RC_VEC_T v)
+{
+	int i;
+	if(unlikely(!v.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_print_sci, vector not initialized yet\n");
+		return -1;
+	}
+	for(i=0;i<v.len;i++) printf("%11.4e  ",(double)v.d[i]);
+	printf("\n");
+	return 0;
+}
+
+int RC_VEC_FN(zero_out)(RC_VEC_T* v)
+{
+	int i;
+	if(unlikely(v->initialized!=1)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_zero_out,vector not initialized yet\n");
+		return -1;
+	}
+	for(i=0;i<v->len;i++)	v->d[i]=RC_R(0.0);
+	return 0;
+}
+
+int RC_VEC_FN(times_scalar)(RC_VEC_T* v, RC_REAL s)
+{
+	int i;
+	if(unlikely(!v->initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_times_scalar, vector uninitialized\n");
+		return -1;
+	}
+	for(i=0;i<(v->len);i++) v->d[i] *= s;
+	return 0;
+}
+
+
+RC_REAL RC_VEC_FN(norm)(RC_VEC_T v, RC_REAL p)
+{
+	RC_REAL norm = RC_R(0.0);
+	int i;
+	if(unlikely(!v.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_norm, vector not initialized yet\n");
+		return -1;
+	}
+	if(unlikely(p<=RC_R(0.0))){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_norm, p must be a positive real value\n");
+		return -1;
+	}
+	// shortcut for 1-norm
+	if(p<RC_R(1.001) && p>RC_R(0.999)){
+		for(i=0;i<v.len;i++) norm+=RC_FABS(v.d[i]);
+		return norm;
+	}
+	// shortcut for 2-norm
+	if(p<RC_R(2.001) && p>RC_R(1.999)){
+		for(i=0;i<v.len;i++) norm+=v.d[i]*v.d[i];
+		return RC_SQRT(norm);
+	}
+	// generic norm formula, rarely used.
+	for(i=0;i<v.len;i++) norm+=RC_POW(RC_FABS(v.d[i]),p);
+	// take the pth root
+	return RC_POW(norm,(RC_R(1.0)/p));
+}
+
+
+int RC_VEC_FN(max)(RC_VEC_T v)
+{
+	int i;
+	int index = 0;
+	RC_REAL tmp = -RC_REAL_MAX;
+	if(unlikely(!v.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_max, vector not initialized yet\n");
+		return -1;
+	}
+	for(i=0;i<v.len;i++){
+		if(v.d[i]>tmp){
+			index = i;
+			tmp = v.d[i];
+		}
+	}
+	return index;
+}
+
+
+int RC_VEC_FN(min)(RC_VEC_T v)
+{
+	int i;
+	int index = 0;
+	RC_REAL tmp = RC_REAL_MAX;
+	if(unlikely(!v.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_min, vector not initialized yet\n");
+		return -1;
+	}
+	for(i=0; i<v.len; i++){
+		if(v.d[i]<tmp){
+			index=i;
+			tmp=v.d[i];
+		}
+	}
+	return index;
+}
+
+
+RC_REAL RC_VEC_FN(std_dev)(RC_VEC_T v)
+{
+	int i;
+	RC_REAL mean, mean_sqr, diff;
+	if(unlikely(!v.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_std_dev, vector not initialized yet\n");
+		return RC_R(-1.0);
+	}
+	// shortcut for length 1
+	if(v.len == 1) return RC_R(0.0);
+	// calculate mean
+	mean = RC_R(0.0);
+	for(i=0;i<v.len;i++) mean+=v.d[i];
+	mean = mean/(RC_REAL)v.len;
+	// calculate mean square
+	mean_sqr = RC_R(0.0);
+	for(i=0;i<v.len;i++){
+		diff = v.d[i]-mean;
+		mean_sqr += diff*diff;
+	}
+	return RC_SQRT(mean_sqr/(RC_REAL)(v.len-1));
+}
+
+
+RC_REAL RC_VEC_FN(mean)(RC_VEC_T v)
+{
+	int i;
+	RC_REAL sum = RC_R(0.0);
+	if(unlikely(!v.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_mean, vector not initialized yet\n");
+		return RC_R(-1.0);
+	}
+	// calculate mean
+	for(i=0;i<v.len;i++) sum+=v.d[i];
+	return sum/(RC_REAL)v.len;
+}
+
+
+int RC_VEC_FN(projection)(RC_VEC_T v, RC_VEC_T e, RC_VEC_T* p)
+{
+	int i;
+	RC_REAL factor;
+	// sanity checks
+	if(unlikely(!v.initialized || !e.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_projection, received uninitialized vector\n");
+		return -1;
+	}
+	if(unlikely(v.len!=e.len)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_projection, vectors not of same length\n");
+		return -1;
+	}
+	if(unlikely(RC_VEC_FN(alloc)(p,v.len))){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_projection, failed to allocate p\n");
+		return -1;
+	}
+	factor = RC_VEC_FN(dot_product)(v,e)/RC_VEC_FN(dot_product)(e,e);
+	for(i=0;i<v.len;i++) p->d[i]=factor*e.d[i];
+	return 0;
+}
+
+
+RC_REAL RC_VEC_FN(dot_product)(RC_VEC_T v1, RC_VEC_T v2)
+{
+	if(unlikely(!v1.initialized || !v2.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_dot_product, vector uninitialized\n");
+		return RC_R(-1.0);
+	}
+	if(unlikely(v1.len != v2.len)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_dot_product, dimension mismatch\n");
+		return RC_R(-1.0);
+	}
+	return RC_DOT(v1.d,v2.d,v1.len);
+}
+
+
+int RC_VEC_FN(cross_product)(RC_VEC_T v1, RC_VEC_T v2, RC_VEC_T* p)
+{
+	// sanity checks
+	if(unlikely(!v1.initialized || !v2.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_cross_product, vector not initialized yet.\n");
+		return -1;
+	}
+	if(unlikely(v1.len!=3 || v2.len!=3)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_cross_product, vector must have length 3\n");
+		return -1;
+	}
+	if(unlikely(RC_VEC_FN(alloc)(p,3))){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_cross_product, failed to allocate p\n");
+		return -1;
+	}
+	p->d[0] = (v1.d[1]*v2.d[2]) - (v1.d[2]*v2.d[1]);
+	p->d[1] = (v1.d[2]*v2.d[0]) - (v1.d[0]*v2.d[2]);
+	p->d[2] = (v1.d[0]*v2.d[1]) - (v1.d[1]*v2.d[0]);
+	return 0;
+}
+
+
+int RC_VEC_FN(sum)(RC_VEC_T v1, RC_VEC_T v2, RC_VEC_T* s)
+{
+	int i;
+	// sanity checks
+	if(unlikely(!v1.initialized || !v2.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_sum, received uninitialized vector\n");
+		return -1;
+	}
+	if(unlikely(v1.len!=v2.len)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_sum, vectors not of same length\n");
+		return -1;
+	}
+	if(unlikely(RC_VEC_FN(alloc)(s,v1.len))){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_sum, failed to allocate s\n");
+		return -1;
+	}
+	for(i=0;i<v1.len;i++) s->d[i]=v1.d[i]+v2.d[i];
+	return 0;
+}
+
+
+int RC_VEC_FN(sum_inplace)(RC_VEC_T* v1, RC_VEC_T v2)
+{
+	int i;
+	// sanity checks
+	if(unlikely(!v1->initialized || !v2.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_sum_inplace, received uninitialized vector\n");
+		return -1;
+	}
+	if(unlikely(v1->len!=v2.len)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_sum_inplace, vectors not of same length\n");
+		return -1;
+	}
+	for(i=0;i<v1->len;i++) v1->d[i]+=v2.d[i];
+	return 0;
+}
+
+
+int RC_VEC_FN(subtract)(RC_VEC_T v1, RC_VEC_T v2, RC_VEC_T* s)
+{
+	int i;
+	// sanity checks
+	if(unlikely(!v1.initialized || !v2.initialized)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_subtract, received uninitialized vector\n");
+		return -1;
+	}
+	if(unlikely(v1.len!=v2.len)){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_subtract, vectors not of same length\n");
+		return -1;
+	}
+	if(unlikely(RC_VEC_FN(alloc)(s,v1.len))){
+		fprintf(stderr,"ERROR in " RC_VEC_NAME "_subtract, failed to allocate s\n");
+		return -1;
+	}
+	for(i=0;i<v1.len;i++) s->d[i]=v1.d[i]-v2.d[i];
+	return 0;
+}
@@ -0,0 +1,315 @@
+/**
+ * @file math/workspace.c
+ *
+ * @brief      Preallocated scratch memory for the matrix and vector functions
+ *             and the heap guard used to check that a loop stays off the
+ *             heap. See <rc/math/workspace.h>.
+ *
+ *             Memory is handed out by bumping a byte offset into one block.
+ *             The active workspace and the heap guard are per thread so a
+ *             control loop can run inside a workspace while other threads
+ *             keep using the heap normally.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>	// for malloc,calloc,free,abort
+#include <string.h>	// for memset
+#include <stdint.h>	// for uintptr_t
+#include <errno.h>
+
+#include <rc/math/workspace.h>
+#include "algebra_common.h"
+
+#define ALIGN_UP(x)	(((x) + RC_WORKSPACE_ALIGN - 1) & ~((size_t)RC_WORKSPACE_ALIGN - 1))
+
+// innermost workspace started with rc_workspace_begin on this thread
+static _Thread_local rc_workspace_t* active_ws = NULL;
+static _Thread_local int guard_mode = RC_HEAP_GUARD_OFF;
+static _Thread_local unsigned long guard_count = 0;
+
+
+/**
+ * takes bytes from ws, returns NULL with errno set to ENOMEM if it's full
+ */
+static void* __take(rc_workspace_t* ws, size_t bytes)
+{
+	char* ptr;
+	size_t need = ALIGN_UP(bytes);
+	if(unlikely(need > ws->size - ws->used)){
+		fprintf(stderr,"ERROR in rc_workspace, out of space, %zu of %zu bytes used, %zu more requested\n",
+			ws->used, ws->size, need);
+		errno = ENOMEM;
+		return NULL;
+	}
+	ptr = ws->mem + ws->used;
+	ws->used += need;
+	if(ws->used > ws->high_water) ws->high_water = ws->used;
+	return ptr;
+}
+
+
+static void __heap_touched(const char* what, size_t bytes)
+{
+	if(likely(guard_mode==RC_HEAP_GUARD_OFF)) return;
+	guard_count++;
+	if(guard_mode==RC_HEAP_GUARD_ABORT){
+		fprintf(stderr,"ERROR in rc_workspace heap guard, %s of %zu bytes\n", what, bytes);
+		abort();
+	}
+}
+
+
+void* __rc_math_alloc(size_t bytes, int zero, int* borrowed)
+{
+	void* ptr;
+	if(active_ws!=NULL){
+		*borrowed = 1;
+		ptr = __take(active_ws, bytes);
+		if(ptr!=NULL && zero) memset(ptr, 0, bytes);
+		return ptr;
+	}
+	*borrowed = 0;
+	__heap_touched(zero ? "calloc" : "malloc", bytes);
+	return zero ? calloc(1, bytes) : malloc(bytes);
+}
+
+
+void __rc_math_free(void* ptr)
+{
+	if(ptr==NULL) return;
+	__heap_touched("free", 0);
+	free(ptr);
+}
+
+
+rc_workspace_t rc_workspace_empty(void)
+{
+	rc_workspace_t out = RC_WORKSPACE_INITIALIZER;
+	return out;
+}
+
+
+int rc_workspace_alloc(rc_workspace_t* ws, size_t bytes)
+{
+	char* mem;
+	if(unlikely(ws==NULL)){
+		fprintf(stderr,"ERROR in rc_workspace_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(bytes<1)){
+		fprintf(stderr,"ERROR in rc_workspace_alloc, size must be >=1\n");
+		return -1;
+	}
+	if(unlikely(ws->active)){
+		fprintf(stderr,"ERROR in rc_workspace_alloc, workspace is active\n");
+		return -1;
+	}
+	// aligned_alloc wants the size to be a multiple of the alignment
+	bytes = ALIGN_UP(bytes);
+	mem = aligned_alloc(RC_WORKSPACE_ALIGN, bytes);
+	if(unlikely(mem==NULL)){
+		perror("ERROR in rc_workspace_alloc");
+		return -1;
+	}
+	rc_workspace_free(ws);
+	ws->mem = mem;
+	ws->size = bytes;
+	ws->owns_mem = 1;
+	ws->initialized = 1;
+	return 0;
+}
+
+
+int rc_workspace_from_buffer(rc_workspace_t* ws, void* buf, size_t bytes)
+{
+	size_t skip;
+	if(unlikely(ws==NULL || buf==NULL)){
+		fprintf(stderr,"ERROR in rc_workspace_from_buffer, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(ws->active)){
+		fprintf(stderr,"ERROR in rc_workspace_from_buffer, workspace is active\n");
+		return -1;
+	}
+	skip = ALIGN_UP((uintptr_t)buf) - (uintptr_t)buf;
+	if(unlikely(bytes<=skip)){
+		fprintf(stderr,"ERROR in rc_workspace_from_buffer, buffer too small\n");
+		return -1;
+	}
+	rc_workspace_free(ws);
+	ws->mem = (char*)buf + skip;
+	ws->size = bytes - skip;
+	ws->owns_mem = 0;
+	ws->initialized = 1;
+	return 0;
+}
+
+
+int rc_workspace_free(rc_workspace_t* ws)
+{
+	rc_workspace_t new = RC_WORKSPACE_INITIALIZER;
+	if(unlikely(ws==NULL)){
+		fprintf(stderr,"ERROR in rc_workspace_free, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(ws->active)){
+		fprintf(stderr,"ERROR in rc_workspace_free, workspace is still active\n");
+		return -1;
+	}
+	if(ws->owns_mem) free(ws->mem);
+	*ws = new;
+	return 0;
+}
+
+
+int rc_workspace_reset(rc_workspace_t* ws)
+{
+	if(unlikely(ws==NULL)){
+		fprintf(stderr,"ERROR in rc_workspace_reset, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(ws->active)){
+		fprintf(stderr,"ERROR in rc_workspace_reset, workspace is active, use rc_workspace_end\n");
+		return -1;
+	}
+	ws->used = 0;
+	return 0;
+}
+
+
+size_t rc_workspace_matrix_bytes(int rows, int cols)
+{
+	if(rows<1 || cols<1) return 0;
+	return ALIGN_UP(rows*sizeof(double*)) + ALIGN_UP((size_t)rows*cols*sizeof(double));
+}
+
+
+size_t rc_workspace_vector_bytes(int length)
+{
+	if(length<1) return 0;
+	return ALIGN_UP(length*sizeof(double));
+}
+
+
+int rc_workspace_matrix(rc_workspace_t* ws, rc_matrix_t* A, int rows, int cols)
+{
+	int i;
+	size_t used;
+	double** rowptr;
+	double* data;
+	// sanity checks
+	if(unlikely(ws==NULL || A==NULL)){
+		fprintf(stderr,"ERROR in rc_workspace_matrix, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!ws->initialized)){
+		fprintf(stderr,"ERROR in rc_workspace_matrix, workspace not initialized\n");
+		return -1;
+	}
+	if(unlikely(rows<1 || cols<1)){
+		fprintf(stderr,"ERROR in rc_workspace_matrix, rows and cols must be >=1\n");
+		return -1;
+	}
+	used = ws->used;
+	rowptr = __take(ws, rows*sizeof(double*));
+	if(unlikely(rowptr==NULL)) return -1;
+	data = __take(ws, (size_t)rows*cols*sizeof(double));
+	if(unlikely(data==NULL)){
+		ws->used = used;
+		return -1;
+	}
+	rc_matrix_free(A);
+	for(i=0;i<rows;i++) rowptr[i] = data + i*cols;
+	A->d = rowptr;
+	A->rows = rows;
+	A->cols = cols;
+	A->borrowed = 1;
+	A->initialized = 1;
+	return 0;
+}
+
+
+int rc_workspace_vector(rc_workspace_t* ws, rc_vector_t* v, int length)
+{
+	double* data;
+	// sanity checks
+	if(unlikely(ws==NULL || v==NULL)){
+		fprintf(stderr,"ERROR in rc_workspace_vector, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!ws->initialized)){
+		fprintf(stderr,"ERROR in rc_workspace_vector, workspace not initialized\n");
+		return -1;
+	}
+	if(unlikely(length<1)){
+		fprintf(stderr,"ERROR in rc_workspace_vector, length must be >=1\n");
+		return -1;
+	}
+	data = __take(ws, length*sizeof(double));
+	if(unlikely(data==NULL)) return -1;
+	rc_vector_free(v);
+	v->d = data;
+	v->len = length;
+	v->borrowed = 1;
+	v->initialized = 1;
+	return 0;
+}
+
+
+int rc_workspace_begin(rc_workspace_t* ws)
+{
+	if(unlikely(ws==NULL)){
+		fprintf(stderr,"ERROR in rc_workspace_begin, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!ws->initialized)){
+		fprintf(stderr,"ERROR in rc_workspace_begin, workspace not initialized\n");
+		return -1;
+	}
+	if(unlikely(ws->active)){
+		fprintf(stderr,"ERROR in rc_workspace_begin, workspace already active\n");
+		return -1;
+	}
+	ws->mark = ws->used;
+	ws->prev = active_ws;
+	ws->active = 1;
+	active_ws = ws;
+	return 0;
+}
+
+
+int rc_workspace_end(rc_workspace_t* ws)
+{
+	if(unlikely(ws==NULL)){
+		fprintf(stderr,"ERROR in rc_workspace_end, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(ws!=active_ws)){
+		fprintf(stderr,"ERROR in rc_workspace_end, not the innermost active workspace of this thread\n");
+		return -1;
+	}
+	ws->used = ws->mark;
+	ws->active = 0;
+	active_ws = ws->prev;
+	ws->prev = NULL;
+	return 0;
+}
+
+
+int rc_workspace_heap_guard(int mode)
+{
+	if(unlikely(mode!=RC_HEAP_GUARD_OFF && mode!=RC_HEAP_GUARD_COUNT &&
+					mode!=RC_HEAP_GUARD_ABORT)){
+		fprintf(stderr,"ERROR in rc_workspace_heap_guard, invalid mode\n");
+		return -1;
+	}
+	guard_mode = mode;
+	guard_count = 0;
+	return 0;
+}
+
+
+unsigned long rc_workspace_heap_count(void)
+{
+	return guard_count;
+}
@@ -73,6 +73,11 @@
 #define QUAT_MAG_SQ_MAX		(QUAT_MAG_SQ_NORMALIZED + QUAT_ERROR_THRESH)
 #define GYRO_CAL_THRESH		50	// std dev below which to consider still
 #define ACCEL_CAL_THRESH	100	// std dev below which to consider still
+#define MAG_CAL_MIN_SAMPLES	100	// never stop the mag calibration before this
+#define MAG_CAL_CHECK_SAMPLES	20	// samples between checks of the mag fit
+#define MAG_CAL_STABLE_UT	0.5	// fit change in uT considered settled
+#define MAG_CAL_STABLE_CHECKS	3	// settled checks in a row to stop early
+#define MAG_CAL_MAX_RESIDUAL	0.1	// worst fit residual to stop early with
 #define GYRO_OFFSET_THRESH	500
 
 // Thread control
@@ -2780,16 +2785,15 @@ COLLECT_DATA:
 
 int rc_mpu_calibrate_mag_routine(rc_mpu_config_t conf)
 {
-	int i;
-	double new_scale[3];
+	int i, j, stable;
+	double new_scale[3], center[3], lengths[3], residual, change;
+	double last[6] = {0.0};	// center then lengths at the last check
 	const int samples = 200;
 	const int sample_time_us = 12000000; // 12 seconds ()
 	const int loop_wait_us = sample_time_us/samples;
 	const int sample_rate_hz = 1000000/loop_wait_us;
 
-	rc_matrix_t A = rc_matrix_empty();
-	rc_vector_t center = rc_vector_empty();
-	rc_vector_t lengths = rc_vector_empty();
+	rc_ellipsoid_fit_t fit = RC_ELLIPSOID_FIT_INITIALIZER;
 	rc_mpu_data_t imu_data; // to collect magnetometer data
 	// wipe it with defaults to avoid problems
 	config = rc_mpu_default_config();
@@ -2840,13 +2844,11 @@ int rc_mpu_calibrate_mag_routine(rc_mpu_config_t conf)
 	mag_scales[0]  = 1.0;
 	mag_scales[1]  = 1.0;
 	mag_scales[2]  = 1.0;
-	if(rc_matrix_alloc(&A,samples,3)){
-		fprintf(stderr,"ERROR: in rc_calibrate_mag_routine, failed to alloc data matrix\n");
-		return -1;
-	}
 
-	// sample data
+	// sample data, fitting as we go so we can stop early once the fit has
+	// settled instead of always waiting for every sample
 	i = 0;
+	stable = 0;
 	while(i<samples){
 		if(rc_mpu_read_mag(&imu_data)<0){
 			fprintf(stderr,"ERROR: failed to read magnetometer\n");
@@ -2859,12 +2861,29 @@ int rc_mpu_calibrate_mag_routine(rc_mpu_config_t conf)
 			fprintf(stderr,"ERROR: retreived all zeros from magnetometer\n");
 			break;
 		}
-		// save data to matrix for ellipse fitting
-		A.d[i][0] = imu_data.mag[0];
-		A.d[i][1] = imu_data.mag[1];
-		A.d[i][2] = imu_data.mag[2];
+		// add to the ellipsoid fit
+		rc_algebra_ellipsoid_fit_add(&fit, imu_data.mag);
 		i++;
 
+		// once there are enough points, check how much the fit moved since
+		// the last check. Stop when it has barely changed a few checks in a
+		// row, a partial sweep is still changing as new directions come in
+		if(i>=MAG_CAL_MIN_SAMPLES && i%MAG_CAL_CHECK_SAMPLES==0){
+			if(rc_algebra_ellipsoid_fit_solve(&fit, center, lengths, &residual)==0){
+				change = 0.0;
+				for(j=0;j<3;j++){
+					change = fmax(change, fabs(center[j]-last[j]));
+					change = fmax(change, fabs(lengths[j]-last[j+3]));
+					last[j] = center[j];
+					last[j+3] = lengths[j];
+				}
+				if(change<MAG_CAL_STABLE_UT && residual<MAG_CAL_MAX_RESIDUAL) stable++;
+				else stable = 0;
+				if(stable>=MAG_CAL_STABLE_CHECKS) break;
+			}
+			else stable = 0;
+		}
+
 		// print "keep going" every 4 seconds
 		if(i%(sample_rate_hz*4) == sample_rate_hz*2){
 			printf("keep spinning\n");
@@ -2886,54 +2905,43 @@ int rc_mpu_calibrate_mag_routine(rc_mpu_config_t conf)
 
 	// if data collection loop exited without getting enough data, warn the
 	// user and return -1, otherwise keep going normally
-	if(i<samples){
+	if(i<samples && stable<MAG_CAL_STABLE_CHECKS){
 		printf("exiting rc_calibrate_mag_routine without saving new data\n");
 		return -1;
 	}
-	// make empty vectors for ellipsoid fitting to populate
-	if(rc_algebra_fit_ellipsoid(A,&center,&lengths)<0){
+	if(rc_algebra_ellipsoid_fit_solve(&fit, center, lengths, &residual)<0){
 		fprintf(stderr,"failed to fit ellipsoid to magnetometer data\n");
-		rc_matrix_free(&A);
 		return -1;
 	}
-	// empty memory, we are done with A
-	rc_matrix_free(&A);
+	printf("fit %d samples, residual %5.3f\n", i, residual);
 	// do some sanity checks to make sure data is reasonable
-	if(fabs(center.d[0])>200 || fabs(center.d[1])>200 || \
-							fabs(center.d[2])>200){
+	if(fabs(center[0])>200 || fabs(center[1])>200 || \
+							fabs(center[2])>200){
 		fprintf(stderr,"ERROR: center of fitted ellipsoid out of bounds\n");
-		rc_vector_free(&center);
-		rc_vector_free(&lengths);
 		return -1;
 	}
-	if( lengths.d[0]>200 || lengths.d[0]<5 || \
-		lengths.d[1]>200 || lengths.d[1]<5 || \
-		lengths.d[2]>200 || lengths.d[2]<5){
+	if( lengths[0]>200 || lengths[0]<5 || \
+		lengths[1]>200 || lengths[1]<5 || \
+		lengths[2]>200 || lengths[2]<5){
 		fprintf(stderr,"WARNING: length of fitted ellipsoid out of bounds\n");
 		fprintf(stderr,"Saving suspicious calibration data anyway in case this is intentional\n");
 	}
 	// all seems well, calculate scaling factors to map ellipse lengths to
 	// a sphere of radius 70uT, this scale will later be multiplied by the
 	// factory corrected data
-	new_scale[0] = 70.0/lengths.d[0];
-	new_scale[1] = 70.0/lengths.d[1];
-	new_scale[2] = 70.0/lengths.d[2];
+	new_scale[0] = 70.0/lengths[0];
+	new_scale[1] = 70.0/lengths[1];
+	new_scale[2] = 70.0/lengths[2];
 	// print results
 	printf("\n");
-	printf("Offsets X: %7.3f Y: %7.3f Z: %7.3f\n",	center.d[0],\
-							center.d[1],\
-							center.d[2]);
+	printf("Offsets X: %7.3f Y: %7.3f Z: %7.3f\n",	center[0],\
+							center[1],\
+							center[2]);
 	printf("Scales  X: %7.3f Y: %7.3f Z: %7.3f\n",	new_scale[0],\
 							new_scale[1],\
 							new_scale[2]);
 	// write to disk
-	if(__write_mag_cal_to_disk(center.d,new_scale)<0){
-		rc_vector_free(&center);
-		rc_vector_free(&lengths);
-		return -1;
-	}
-	rc_vector_free(&center);
-	rc_vector_free(&lengths);
+	if(__write_mag_cal_to_disk(center,new_scale)<0) return -1;
 	return 0;
 }
 
@@ -3157,71 +3165,54 @@ int rc_mpu_calibrate_accel_routine(rc_mpu_config_t conf)
 	rc_i2c_unlock_bus(config.i2c_bus);
 
 	// fit the ellipse
-	rc_matrix_t A = rc_matrix_empty();
-	rc_vector_t center = rc_vector_empty();
-	rc_vector_t lengths = rc_vector_empty();
-
-	if(rc_matrix_alloc(&A,6,3)){
-		fprintf(stderr,"ERROR: in rc_mpu_calibrate_accel_routine, failed to alloc data matrix\n");
-		return -1;
-	}
+	rc_ellipsoid_fit_t fit = RC_ELLIPSOID_FIT_INITIALIZER;
+	double point[3], center[3], lengths[3];
 
-	// convert to G and put in matrix
+	// convert to G and add to the fit
 	for(i=0;i<6;i++){
 		for(j=0;j<3;j++){
-			A.d[i][j] = (avg_raw[i][j]/16384.0);
+			point[j] = (avg_raw[i][j]/16384.0);
 		}
+		rc_algebra_ellipsoid_fit_add(&fit, point);
 	}
 
-	// make empty vectors for ellipsoid fitting to populate
-	if(rc_algebra_fit_ellipsoid(A,&center,&lengths)<0){
-		fprintf(stderr,"failed to fit ellipsoid to magnetometer data\n");
-		rc_matrix_free(&A);
+	if(rc_algebra_ellipsoid_fit_solve(&fit, center, lengths, NULL)<0){
+		fprintf(stderr,"failed to fit ellipsoid to accelerometer data\n");
 		return -1;
 	}
-	// empty memory, we are done with A
-	rc_matrix_free(&A);
 	// do some sanity checks to make sure data is reasonable
 	for(i=0;i<3;i++){
-		if(fabs(center.d[i])>0.3){
+		if(fabs(center[i])>0.3){
 			fprintf(stderr,"ERROR in rc_mpu_calibrate_accel_routine, center of fitted ellipsoid out of bounds\n");
 			fprintf(stderr,"most likely the unit was held in incorrect orientation during data collection\n");
-			rc_vector_free(&center);
-			rc_vector_free(&lengths);
 			return -1;
 		}
-		if(isnan(center.d[i]) || isnan(lengths.d[i])){
+		if(isnan(center[i]) || isnan(lengths[i])){
 			fprintf(stderr,"ERROR in rc_mpu_calibrate_accel_routine, data fitting produced NaN\n");
 			fprintf(stderr,"most likely the unit was held in incorrect orientation during data collection\n");
-			rc_vector_free(&center);
-			rc_vector_free(&lengths);
 			return -1;
 		}
-		if(lengths.d[i]>1.3 || lengths.d[i]<0.7){
+		if(lengths[i]>1.3 || lengths[i]<0.7){
 			fprintf(stderr,"ERROR in rc_mpu_calibrate_accel_routine, scale out of bounds\n");
 			fprintf(stderr,"most likely the unit was held in incorrect orientation during data collection\n");
-			rc_vector_free(&center);
-			rc_vector_free(&lengths);
 			return -1;
 		}
 	}
 
 	// print results
 	printf("\n");
-	printf("Offsets X: %7.3f Y: %7.3f Z: %7.3f\n",	center.d[0],\
-							center.d[1],\
-							center.d[2]);
-	printf("Scales  X: %7.3f Y: %7.3f Z: %7.3f\n",	lengths.d[0],\
-							lengths.d[1],\
-							lengths.d[2]);
+	printf("Offsets X: %7.3f Y: %7.3f Z: %7.3f\n",	center[0],\
+							center[1],\
+							center[2]);
+	printf("Scales  X: %7.3f Y: %7.3f Z: %7.3f\n",	lengths[0],\
+							lengths[1],\
+							lengths[2]);
 
 	// write to disk
-	if(__write_accel_cal_to_disk(center.d, lengths.d)==-1){
+	if(__write_accel_cal_to_disk(center, lengths)==-1){
 		fprintf(stderr,"ERROR in rc_mpu_calibrate_accel_routine, failed to write to disk\n");
 		return -1;
 	}
-	rc_vector_free(&center);
-	rc_vector_free(&lengths);
 	return 0;
 }
 
@@ -0,0 +1,277 @@
+/**
+ * @file periodic.c
+ *
+ * @brief      fixed-rate periodic executor built on clock_nanosleep
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <inttypes.h> // for PRIu64
+
+#include <rc/periodic.h>
+#include <rc/pthread.h>
+
+// preposessor macros
+#define unlikely(x)	__builtin_expect (!!(x), 0)
+
+
+static uint64_t __now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec*1000000000)+ts.tv_nsec;
+}
+
+
+static int __hist_bin(uint64_t latency_ns)
+{
+	uint64_t us = latency_ns/1000;
+	int bin;
+	if(us==0) return 0;
+	bin = 64 - __builtin_clzll(us);
+	if(bin>=RC_PERIODIC_HIST_BINS) bin = RC_PERIODIC_HIST_BINS-1;
+	return bin;
+}
+
+
+static void* __executor_loop(void* ptr)
+{
+	rc_periodic_t* ex = (rc_periodic_t*)ptr;
+	struct timespec ts;
+	uint64_t next_ns, wake_ns, start_ns, end_ns, latency, exec, skip;
+	uint64_t cycle = 0;
+	int i;
+
+	if(ex->thread_init!=NULL) ex->thread_init();
+	next_ns = __now_ns();
+	while(ex->running){
+		// sleep until the absolute deadline, immune to execution time drift
+		next_ns += ex->period_ns;
+		ts.tv_sec = next_ns/1000000000;
+		ts.tv_nsec = next_ns%1000000000;
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)==EINTR);
+		wake_ns = __now_ns();
+		latency = (wake_ns>next_ns) ? wake_ns-next_ns : 0;
+		if(!ex->running) break;
+
+		// run each task due this cycle
+		for(i=0;i<ex->ntasks;i++){
+			if(cycle % ex->tasks[i].divider) continue;
+			start_ns = __now_ns();
+			ex->tasks[i].func();
+			exec = __now_ns() - start_ns;
+			if(exec>ex->tasks[i].exec_max_ns) ex->tasks[i].exec_max_ns = exec;
+		}
+		end_ns = __now_ns();
+		exec = end_ns - wake_ns;
+
+		// skip deadlines we have already missed instead of bunching up
+		skip = 0;
+		if(end_ns > next_ns + ex->period_ns){
+			skip = (end_ns - next_ns) / ex->period_ns;
+			next_ns += skip * ex->period_ns;
+		}
+
+		pthread_mutex_lock(&ex->stats_mutex);
+		ex->stats.cycles++;
+		if(skip){
+			ex->stats.overruns++;
+			ex->stats.skipped += skip;
+		}
+		if(latency>ex->stats.jitter_max_ns) ex->stats.jitter_max_ns = latency;
+		ex->stats.jitter_mean_ns += ((double)latency - ex->stats.jitter_mean_ns)/ex->stats.cycles;
+		if(exec>ex->stats.exec_max_ns) ex->stats.exec_max_ns = exec;
+		ex->stats.exec_mean_ns += ((double)exec - ex->stats.exec_mean_ns)/ex->stats.cycles;
+		ex->stats.hist[__hist_bin(latency)]++;
+		pthread_mutex_unlock(&ex->stats_mutex);
+
+		cycle += 1 + skip;
+	}
+	return NULL;
+}
+
+
+rc_periodic_t rc_periodic_empty(void)
+{
+	rc_periodic_t out = RC_PERIODIC_INITIALIZER;
+	return out;
+}
+
+
+int rc_periodic_init(rc_periodic_t* ex, double rate_hz, int policy, int priority)
+{
+	// sanity checks
+	if(unlikely(ex==NULL)){
+		fprintf(stderr,"ERROR in rc_periodic_init, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(rate_hz<=0.0 || rate_hz>100000.0)){
+		fprintf(stderr,"ERROR in rc_periodic_init, rate must be between 0 and 100khz\n");
+		return -1;
+	}
+	if(unlikely(ex->running)){
+		fprintf(stderr,"ERROR in rc_periodic_init, executor already running\n");
+		return -1;
+	}
+	ex->period_ns = (uint64_t)(1000000000.0/rate_hz);
+	ex->policy = policy;
+	ex->priority = priority;
+	ex->ntasks = 0;
+	ex->thread_init = NULL;
+	ex->thread = 0;
+	ex->running = 0;
+	pthread_mutex_init(&ex->stats_mutex, NULL);
+	ex->initialized = 1;
+	rc_periodic_reset_stats(ex);
+	return 0;
+}
+
+
+int rc_periodic_add_task(rc_periodic_t* ex, void (*func)(void), int divider)
+{
+	// sanity checks
+	if(unlikely(ex==NULL || func==NULL)){
+		fprintf(stderr,"ERROR in rc_periodic_add_task, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!ex->initialized)){
+		fprintf(stderr,"ERROR in rc_periodic_add_task, executor not initialized\n");
+		return -1;
+	}
+	if(unlikely(ex->running)){
+		fprintf(stderr,"ERROR in rc_periodic_add_task, can't add tasks while running\n");
+		return -1;
+	}
+	if(unlikely(ex->ntasks>=RC_PERIODIC_MAX_TASKS)){
+		fprintf(stderr,"ERROR in rc_periodic_add_task, at most %d tasks allowed\n", RC_PERIODIC_MAX_TASKS);
+		return -1;
+	}
+	if(unlikely(divider<1)){
+		fprintf(stderr,"ERROR in rc_periodic_add_task, divider must be >=1\n");
+		return -1;
+	}
+	ex->tasks[ex->ntasks].func = func;
+	ex->tasks[ex->ntasks].divider = divider;
+	ex->tasks[ex->ntasks].exec_max_ns = 0;
+	ex->ntasks++;
+	return 0;
+}
+
+
+int rc_periodic_set_thread_init(rc_periodic_t* ex, void (*func)(void))
+{
+	// sanity checks
+	if(unlikely(ex==NULL)){
+		fprintf(stderr,"ERROR in rc_periodic_set_thread_init, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!ex->initialized)){
+		fprintf(stderr,"ERROR in rc_periodic_set_thread_init, executor not initialized\n");
+		return -1;
+	}
+	if(unlikely(ex->running)){
+		fprintf(stderr,"ERROR in rc_periodic_set_thread_init, executor already running\n");
+		return -1;
+	}
+	ex->thread_init = func;
+	return 0;
+}
+
+
+int rc_periodic_start(rc_periodic_t* ex)
+{
+	// sanity checks
+	if(unlikely(ex==NULL)){
+		fprintf(stderr,"ERROR in rc_periodic_start, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!ex->initialized)){
+		fprintf(stderr,"ERROR in rc_periodic_start, executor not initialized\n");
+		return -1;
+	}
+	if(unlikely(ex->running)){
+		fprintf(stderr,"ERROR in rc_periodic_start, executor already running\n");
+		return -1;
+	}
+	ex->running = 1;
+	if(rc_pthread_create(&ex->thread, __executor_loop, (void*)ex, ex->policy, ex->priority)){
+		fprintf(stderr,"ERROR in rc_periodic_start, failed to start thread\n");
+		ex->running = 0;
+		return -1;
+	}
+	return 0;
+}
+
+
+int rc_periodic_stop(rc_periodic_t* ex, float timeout_sec)
+{
+	int ret;
+	if(unlikely(ex==NULL)){
+		fprintf(stderr,"ERROR in rc_periodic_stop, received NULL pointer\n");
+		return -1;
+	}
+	if(!ex->running) return 0;
+	ex->running = 0;
+	ret = rc_pthread_timed_join(ex->thread, NULL, timeout_sec);
+	ex->thread = 0;
+	return ret;
+}
+
+
+int rc_periodic_get_stats(rc_periodic_t* ex, rc_periodic_stats_t* stats)
+{
+	if(unlikely(ex==NULL || stats==NULL)){
+		fprintf(stderr,"ERROR in rc_periodic_get_stats, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!ex->initialized)){
+		fprintf(stderr,"ERROR in rc_periodic_get_stats, executor not initialized\n");
+		return -1;
+	}
+	pthread_mutex_lock(&ex->stats_mutex);
+	*stats = ex->stats;
+	pthread_mutex_unlock(&ex->stats_mutex);
+	return 0;
+}
+
+
+int rc_periodic_reset_stats(rc_periodic_t* ex)
+{
+	rc_periodic_stats_t zero = {0};
+	if(unlikely(ex==NULL)){
+		fprintf(stderr,"ERROR in rc_periodic_reset_stats, received NULL pointer\n");
+		return -1;
+	}
+	pthread_mutex_lock(&ex->stats_mutex);
+	ex->stats = zero;
+	pthread_mutex_unlock(&ex->stats_mutex);
+	return 0;
+}
+
+
+int rc_periodic_print_stats(rc_periodic_t* ex)
+{
+	rc_periodic_stats_t s;
+	int i, last;
+	if(rc_periodic_get_stats(ex, &s)) return -1;
+
+	printf("period: %" PRIu64 "ns  cycles: %" PRIu64 "  overruns: %" PRIu64 "  skipped: %" PRIu64 "\n",
+		ex->period_ns, s.cycles, s.overruns, s.skipped);
+	printf("jitter mean: %.1fus max: %.1fus\n", s.jitter_mean_ns/1000.0, s.jitter_max_ns/1000.0);
+	printf("exec   mean: %.1fus max: %.1fus\n", s.exec_mean_ns/1000.0, s.exec_max_ns/1000.0);
+	for(i=0;i<ex->ntasks;i++){
+		printf("task %d: every %d cycles, exec max: %.1fus\n", i,
+			ex->tasks[i].divider, ex->tasks[i].exec_max_ns/1000.0);
+	}
+	// only print up to the last non-empty bin
+	last = 0;
+	for(i=0;i<RC_PERIODIC_HIST_BINS;i++) if(s.hist[i]) last = i;
+	printf("jitter histogram (us):\n");
+	for(i=0;i<=last;i++){
+		if(i==0) printf("  [      0,      1) %" PRIu64 "\n", s.hist[i]);
+		else printf("  [%7u,%7u) %" PRIu64 "\n", 1u<<(i-1), 1u<<i, s.hist[i]);
+	}
+	return 0;
+}
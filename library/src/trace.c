@@ -0,0 +1,316 @@
+/**
+ * @file trace.c
+ *
+ * @brief      Lightweight latency tracing with per-thread log-linear histograms
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h> // for PRIu64
+#include <pthread.h>
+
+#include <rc/trace.h>
+#include <rc/time.h>
+
+// preposessor macros
+#define unlikely(x)	__builtin_expect (!!(x), 0)
+
+#define SUB_COUNT	(1<<RC_TRACE_SUB_BITS)
+
+// relaxed atomics, each block has exactly one writer so no RMW is needed
+#define LOAD(x)		__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define STORE(x,v)	__atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+/**
+ * histograms owned by one thread
+ */
+typedef struct trace_block_t {
+	uint64_t count[RC_TRACE_MAX_PROBES];
+	uint64_t sum[RC_TRACE_MAX_PROBES];
+	uint64_t min[RC_TRACE_MAX_PROBES];
+	uint64_t max[RC_TRACE_MAX_PROBES];
+	uint64_t hist[RC_TRACE_MAX_PROBES][RC_TRACE_BUCKETS];
+	struct trace_block_t* next;
+} trace_block_t;
+
+volatile int rc_trace_enabled = 0;
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char* names[RC_TRACE_MAX_PROBES];
+static int nprobes = 0;
+static trace_block_t* blocks = NULL; // all blocks, only ever appended to
+static _Thread_local trace_block_t* my_block = NULL;
+static const char* exit_filename = NULL;
+
+
+static int __bucket(uint64_t ns)
+{
+	int e;
+	if(ns < SUB_COUNT) return (int)ns;
+	e = 63 - __builtin_clzll(ns);
+	if(e > RC_TRACE_MAX_EXP) return RC_TRACE_BUCKETS-1;
+	return ((e-RC_TRACE_SUB_BITS+1)<<RC_TRACE_SUB_BITS)
+		+ (int)((ns>>(e-RC_TRACE_SUB_BITS)) & (SUB_COUNT-1));
+}
+
+
+static uint64_t __bucket_lower(int i)
+{
+	int e;
+	if(i < SUB_COUNT) return (uint64_t)i;
+	e = (i>>RC_TRACE_SUB_BITS) + RC_TRACE_SUB_BITS - 1;
+	return (uint64_t)(SUB_COUNT + (i&(SUB_COUNT-1))) << (e-RC_TRACE_SUB_BITS);
+}
+
+
+static uint64_t __bucket_upper(int i)
+{
+	if(i >= RC_TRACE_BUCKETS-1) return UINT64_MAX;
+	return __bucket_lower(i+1);
+}
+
+
+static trace_block_t* __new_block(void)
+{
+	int i;
+	trace_block_t* b = calloc(1, sizeof(trace_block_t));
+	if(b==NULL) return NULL;
+	for(i=0;i<RC_TRACE_MAX_PROBES;i++) b->min[i] = UINT64_MAX;
+	pthread_mutex_lock(&trace_mutex);
+	b->next = blocks;
+	blocks = b;
+	pthread_mutex_unlock(&trace_mutex);
+	return b;
+}
+
+
+int rc_trace_register(const char* name)
+{
+	int i, id;
+	if(unlikely(name==NULL)){
+		fprintf(stderr,"ERROR in rc_trace_register, received NULL pointer\n");
+		return -1;
+	}
+	pthread_mutex_lock(&trace_mutex);
+	for(i=0;i<nprobes;i++){
+		if(strcmp(names[i],name)==0){
+			pthread_mutex_unlock(&trace_mutex);
+			return i;
+		}
+	}
+	if(nprobes>=RC_TRACE_MAX_PROBES){
+		pthread_mutex_unlock(&trace_mutex);
+		fprintf(stderr,"ERROR in rc_trace_register, at most %d probes allowed\n", RC_TRACE_MAX_PROBES);
+		return -1;
+	}
+	id = nprobes;
+	names[id] = name;
+	nprobes++;
+	pthread_mutex_unlock(&trace_mutex);
+	return id;
+}
+
+
+void rc_trace_enable(int en)
+{
+	rc_trace_enabled = en ? 1 : 0;
+}
+
+
+uint64_t rc_trace_now(void)
+{
+	return rc_nanos_since_boot();
+}
+
+
+int rc_trace_thread_init(void)
+{
+	if(my_block!=NULL) return 0;
+	my_block = __new_block();
+	if(my_block==NULL){
+		fprintf(stderr,"ERROR in rc_trace_thread_init, failed to allocate memory\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+void rc_trace_record(int id, uint64_t ns)
+{
+	trace_block_t* b = my_block;
+	int k;
+	if(unlikely(id<0 || id>=RC_TRACE_MAX_PROBES)) return;
+	if(unlikely(b==NULL)){
+		if(rc_trace_thread_init()) return;
+		b = my_block;
+	}
+	k = __bucket(ns);
+	STORE(b->hist[id][k], b->hist[id][k]+1);
+	STORE(b->sum[id], b->sum[id]+ns);
+	if(ns < b->min[id]) STORE(b->min[id], ns);
+	if(ns > b->max[id]) STORE(b->max[id], ns);
+	// count last so readers never see a count without its sample
+	__atomic_store_n(&b->count[id], b->count[id]+1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * merges the histogram of probe id over all threads into hist
+ */
+static void __merge(int id, uint64_t* hist, rc_trace_summary_t* s)
+{
+	trace_block_t* b;
+	uint64_t sum = 0, v;
+	int k;
+
+	memset(hist, 0, RC_TRACE_BUCKETS*sizeof(uint64_t));
+	s->name = names[id];
+	s->count = 0;
+	s->min_ns = UINT64_MAX;
+	s->max_ns = 0;
+	pthread_mutex_lock(&trace_mutex);
+	for(b=blocks; b!=NULL; b=b->next){
+		s->count += __atomic_load_n(&b->count[id], __ATOMIC_ACQUIRE);
+		sum += LOAD(b->sum[id]);
+		v = LOAD(b->min[id]);
+		if(v < s->min_ns) s->min_ns = v;
+		v = LOAD(b->max[id]);
+		if(v > s->max_ns) s->max_ns = v;
+		for(k=0;k<RC_TRACE_BUCKETS;k++) hist[k] += LOAD(b->hist[id][k]);
+	}
+	pthread_mutex_unlock(&trace_mutex);
+	if(s->count==0) s->min_ns = 0;
+	s->mean_ns = s->count ? (double)sum/(double)s->count : 0.0;
+}
+
+
+/**
+ * value at quantile q, reported as the middle of the bucket it falls in
+ */
+static uint64_t __percentile(const uint64_t* hist, uint64_t total, double q)
+{
+	uint64_t target, seen = 0;
+	int k;
+	if(total==0) return 0;
+	target = (uint64_t)(q*(double)total);
+	if(target>=total) target = total-1;
+	for(k=0;k<RC_TRACE_BUCKETS;k++){
+		seen += hist[k];
+		if(seen>target){
+			if(k < SUB_COUNT) return __bucket_lower(k);
+			return (__bucket_lower(k) + __bucket_lower(k+1))/2;
+		}
+	}
+	return __bucket_lower(RC_TRACE_BUCKETS-1);
+}
+
+
+int rc_trace_get_summary(int id, rc_trace_summary_t* summary)
+{
+	uint64_t hist[RC_TRACE_BUCKETS];
+	if(unlikely(summary==NULL)){
+		fprintf(stderr,"ERROR in rc_trace_get_summary, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(id<0 || id>=nprobes)){
+		fprintf(stderr,"ERROR in rc_trace_get_summary, invalid probe id\n");
+		return -1;
+	}
+	__merge(id, hist, summary);
+	summary->p50_ns  = __percentile(hist, summary->count, 0.5);
+	summary->p90_ns  = __percentile(hist, summary->count, 0.9);
+	summary->p99_ns  = __percentile(hist, summary->count, 0.99);
+	summary->p999_ns = __percentile(hist, summary->count, 0.999);
+	// percentiles can't be outside the observed range
+	if(summary->count && summary->p999_ns > summary->max_ns) summary->p999_ns = summary->max_ns;
+	if(summary->count && summary->p99_ns > summary->max_ns) summary->p99_ns = summary->max_ns;
+	return 0;
+}
+
+
+int rc_trace_print(void)
+{
+	rc_trace_summary_t s;
+	int i;
+	printf("%-16s %10s %9s %9s %9s %9s %9s %9s %9s\n", "probe (us)", "count",
+		"min", "mean", "p50", "p90", "p99", "p99.9", "max");
+	for(i=0;i<nprobes;i++){
+		if(rc_trace_get_summary(i, &s)) return -1;
+		if(s.count==0) continue;
+		printf("%-16s %10" PRIu64 " %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+			s.name, s.count, s.min_ns/1000.0, s.mean_ns/1000.0,
+			s.p50_ns/1000.0, s.p90_ns/1000.0, s.p99_ns/1000.0,
+			s.p999_ns/1000.0, s.max_ns/1000.0);
+	}
+	return 0;
+}
+
+
+int rc_trace_dump(const char* filename)
+{
+	uint64_t hist[RC_TRACE_BUCKETS];
+	rc_trace_summary_t s;
+	FILE* f;
+	int i, k;
+
+	if(unlikely(filename==NULL)){
+		fprintf(stderr,"ERROR in rc_trace_dump, received NULL pointer\n");
+		return -1;
+	}
+	f = fopen(filename, "w");
+	if(f==NULL){
+		perror("ERROR in rc_trace_dump, failed to open file");
+		return -1;
+	}
+	fprintf(f, "probe,lower_ns,upper_ns,count\n");
+	for(i=0;i<nprobes;i++){
+		__merge(i, hist, &s);
+		for(k=0;k<RC_TRACE_BUCKETS;k++){
+			if(hist[k]==0) continue;
+			fprintf(f, "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", s.name,
+				__bucket_lower(k), __bucket_upper(k), hist[k]);
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+
+static void __exit_handler(void)
+{
+	rc_trace_print();
+	if(exit_filename!=NULL) rc_trace_dump(exit_filename);
+}
+
+
+int rc_trace_dump_on_exit(const char* filename)
+{
+	static int registered = 0;
+	exit_filename = filename;
+	if(registered) return 0;
+	if(atexit(__exit_handler)){
+		fprintf(stderr,"ERROR in rc_trace_dump_on_exit, failed to register exit handler\n");
+		return -1;
+	}
+	registered = 1;
+	return 0;
+}
+
+
+int rc_trace_reset(void)
+{
+	trace_block_t* b;
+	int i;
+	pthread_mutex_lock(&trace_mutex);
+	for(b=blocks; b!=NULL; b=b->next){
+		memset(b->count, 0, sizeof(b->count));
+		memset(b->sum, 0, sizeof(b->sum));
+		memset(b->max, 0, sizeof(b->max));
+		memset(b->hist, 0, sizeof(b->hist));
+		for(i=0;i<RC_TRACE_MAX_PROBES;i++) b->min[i] = UINT64_MAX;
+	}
+	pthread_mutex_unlock(&trace_mutex);
+	return 0;
+}